@@ -140,11 +140,13 @@ extern "C" {
  *   2.1.5:  new freelist; version is 3
  *   2.1.9:  changes in btree node format; version is 4
  *   2.1.13: changes in btree node format; version is 5
+ *   2.2.2:  persistent key counters in the btree header, state flags in
+ *           the environment header; version is 6
  */
 #define UPS_VERSION_MAJ     2
 #define UPS_VERSION_MIN     2
 #define UPS_VERSION_REV     1
-#define UPS_FILE_VERSION    5
+#define UPS_FILE_VERSION    6
 
 /**
  * The upscaledb Database structure
@@ -580,6 +582,17 @@ ups_get_version(uint32_t *major, uint32_t *minor,
  *      Environment.
  *     <li>@ref UPS_ENABLE_CRC32</li> Stores (and verifies) CRC32
  *      checksums. Not allowed in combination with @ref UPS_IN_MEMORY.
+ *      The journal entries are checksummed with CRC32C, and torn writes
+ *      are detected during recovery.
+ *     <li>@ref UPS_ENABLE_DEDUPLICATION</li> Records with identical
+ *      payloads share a single blob, which is reference counted. Only
+ *      applies to records which are stored in blob pages. Not allowed in
+ *      combination with @ref UPS_IN_MEMORY.
+ *     <li>@ref UPS_FLUSH_TRANSACTIONS_IN_BACKGROUND</li> Committed
+ *      Transactions are merged into the Database by a background thread,
+ *      and not by the thread which commits them. If the background thread
+ *      falls behind then the committing thread merges the Transactions.
+ *      Ignored if Transactions are disabled.
  *    </ul>
  *
  * @param mode File access rights for the new file. This is the @a mode
@@ -595,6 +608,23 @@ ups_get_version(uint32_t *major, uint32_t *minor,
  *      posix_fadvise(). Only on supported platforms. Allowed values are
  *      @ref UPS_POSIX_FADVICE_NORMAL (which is the default) or
  *      @ref UPS_POSIX_FADVICE_RANDOM.
+ *    <li>@ref UPS_PARAM_CHECKSUM_ALGORITHM</li> The algorithm of the
+ *      page checksums if @ref UPS_ENABLE_CRC32 is set; either
+ *      @ref UPS_CHECKSUM_MURMURHASH3 (the default) or
+ *      @ref UPS_CHECKSUM_CRC32C. The algorithm is persisted.
+ *    <li>@ref UPS_PARAM_HOLE_PUNCH_SECONDS</li> Releases the disk space
+ *      of large free extents after they were unused for this many
+ *      seconds. Disabled by default.
+ *    <li>@ref UPS_PARAM_MMAP_RESERVE_SIZE</li> Reserves this many bytes
+ *      of address space for a shared memory mapping of the file, which
+ *      grows with the file. Disabled by default.
+ *    <li>@ref UPS_PARAM_COLD_TIER_FILENAME</li> The path of a second
+ *      file which stores the blob pages that were evicted from the cache.
+ *      Disabled by default.
+ *    <li>@ref UPS_PARAM_FLASH_CACHE_FILENAME</li> The path of a
+ *      second-level cache on fast local storage. Disabled by default.
+ *    <li>@ref UPS_PARAM_FLASH_CACHE_SIZE</li> The size of the flash
+ *      cache, in bytes. The default size is 256 MB.
  *    <li>@ref UPS_PARAM_PAGE_SIZE</li> The size of a file page, in
  *      bytes. It is recommended not to change the default size. The
  *      default size depends on hardware and operating system.
@@ -612,6 +642,12 @@ ups_get_version(uint32_t *major, uint32_t *minor,
  *    <li>@ref UPS_PARAM_ENCRYPTION_KEY</li> The 16 byte long AES
  *      encryption key; enables AES encryption for the Environment file. Not
  *      allowed for In-Memory Environments. Ignored for remote Environments.
+ *    <li>@ref UPS_PARAM_VALUE_LOG_THRESHOLD</li> Records of at least this
+ *      size are appended to a separate value log instead of being stored
+ *      in the Environment file. Must be a power of two. Not allowed for
+ *      In-Memory Environments.
+ *    <li>@ref UPS_PARAM_VALUE_LOG_SEGMENT_SIZE</li> The size of the
+ *      value log segments, in bytes. Default is 64 MB.
  *    </ul>
  *
  * @return @ref UPS_SUCCESS upon success
@@ -698,7 +734,14 @@ ups_env_create(ups_env_t **env, const char *filename,
  *     <li>@ref UPS_AUTO_RECOVERY </li> Automatically recover the Environment,
  *      if necessary.
  *     <li>@ref UPS_ENABLE_CRC32</li> Stores (and verifies) CRC32
- *      checksums.
+ *      checksums. A journal which is recovered with this flag must also
+ *      have been written with it, otherwise the recovery stops at the
+ *      first entry without checksum.
+ *     <li>@ref UPS_ENABLE_DEDUPLICATION</li> Records with identical
+ *      payloads share a single blob. See @ref ups_env_create for details.
+ *     <li>@ref UPS_FLUSH_TRANSACTIONS_IN_BACKGROUND</li> Committed
+ *      Transactions are merged into the Database by a background thread.
+ *      See @ref ups_env_create for details.
  *    </ul>
  * @param param An array of ups_parameter_t structures. The following
  *      parameters are available:
@@ -710,6 +753,16 @@ ups_env_create(ups_env_t **env, const char *filename,
  *      posix_fadvise(). Only on supported platforms. Allowed values are
  *      @ref UPS_POSIX_FADVICE_NORMAL (which is the default) or
  *      @ref UPS_POSIX_FADVICE_RANDOM.
+ *    <li>@ref UPS_PARAM_MMAP_RESERVE_SIZE</li> Reserves this many bytes
+ *      of address space for a shared memory mapping of the file, which
+ *      grows with the file. Disabled by default.
+ *    <li>@ref UPS_PARAM_COLD_TIER_FILENAME</li> The path of a second
+ *      file which stores the blob pages that were evicted from the cache.
+ *      Disabled by default.
+ *    <li>@ref UPS_PARAM_FLASH_CACHE_FILENAME</li> The path of a
+ *      second-level cache on fast local storage. Disabled by default.
+ *    <li>@ref UPS_PARAM_FLASH_CACHE_SIZE</li> The size of the flash
+ *      cache, in bytes. The default size is 256 MB.
  *    <li>@ref UPS_PARAM_FILE_SIZE_LIMIT</li> Sets a file size limit (in bytes).
  *      Disabled by default. If the limit is exceeded, API functions
  *      return @ref UPS_LIMITS_REACHED.
@@ -723,6 +776,8 @@ ups_env_create(ups_env_t **env, const char *filename,
  *    <li>@ref UPS_PARAM_ENCRYPTION_KEY</li> The 16 byte long AES
  *      encryption key; enables AES encryption for the Environment file. Not
  *      allowed for In-Memory Environments. Ignored for remote Environments.
+ *    <li>@ref UPS_PARAM_VALUE_LOG_SEGMENT_SIZE</li> The size of new
+ *      value log segments, in bytes. Default is 64 MB.
  *    </ul>
  *
  * @return @ref UPS_SUCCESS upon success.
@@ -766,6 +821,8 @@ ups_env_open(ups_env_t **env, const char *filename,
  *    <li>@ref UPS_PARAM_JOURNAL_COMPRESSION</li> Returns the
  *        selected algorithm for journal compression, or 0 if compression
  *        is disabled
+ *    <li>@ref UPS_PARAM_CHECKSUM_ALGORITHM</li> Returns the algorithm
+ *        of the page checksums
  *    </ul>
  *
  * @param env A valid Environment handle
@@ -1078,6 +1135,76 @@ ups_env_erase_db(ups_env_t *env, uint16_t name, uint32_t flags);
 UPS_EXPORT ups_status_t UPS_CALLCONV
 ups_env_flush(ups_env_t *env, uint32_t flags);
 
+/**
+ * Trains a compression dictionary for @ref UPS_COMPRESSOR_ZSTD
+ *
+ * Small keys and records compress poorly because each of them is
+ * compressed separately. A dictionary which was trained with typical
+ * data improves the compression ratio significantly.
+ *
+ * The dictionary is stored in the Environment, and is then used by the
+ * Journal and by all Databases which compress their records with
+ * @ref UPS_COMPRESSOR_ZSTD (see @ref UPS_PARAM_JOURNAL_COMPRESSION and
+ * @ref UPS_PARAM_RECORD_COMPRESSION). Data which was compressed before
+ * the dictionary was trained can still be read.
+ *
+ * A dictionary can only be trained once, because the compressed data
+ * depends on it.
+ *
+ * @param env A valid Environment handle
+ * @param samples An array of typical records
+ * @param num_samples The number of elements in @a samples; a few hundred
+ *        samples are recommended
+ *
+ * @return @ref UPS_SUCCESS upon success
+ * @return @ref UPS_INV_PARAMETER if @a env or @a samples is NULL, if
+ *        the Environment already has a dictionary, or if the samples
+ *        are not sufficient for training a dictionary
+ * @return @ref UPS_NOT_IMPLEMENTED if upscaledb was built without zstd,
+ *        or if @a env is a remote Environment
+ * @return @ref UPS_WRITE_PROTECTED if the Environment is read-only
+ */
+UPS_EXPORT ups_status_t UPS_CALLCONV
+ups_env_train_compression_dictionary(ups_env_t *env,
+            const ups_record_t *samples, uint32_t num_samples);
+
+/**
+ * Compacts the Environment file
+ *
+ * Pages which are freed in the middle of the file (i.e. after erasing
+ * many keys) are reused by later allocations, but the file is only
+ * truncated if the free pages are at the end of the file.
+ *
+ * This function moves the btree nodes of all Databases to free pages at
+ * lower file addresses, then truncates the unused space at the end of
+ * the file. Blobs are not moved. The changes are written to the Journal,
+ * if Transactions or recovery are enabled.
+ *
+ * The work can be split into several smaller steps by limiting the number
+ * of pages which are moved. Call this function repeatedly till
+ * @a relocated is 0 to compact the whole file.
+ *
+ * If the Environment has a value log (see
+ * @ref UPS_PARAM_VALUE_LOG_THRESHOLD) then its segments are garbage
+ * collected first: the live records of each segment in which at least
+ * half of the data is obsolete are appended to the current segment, then
+ * the old segment file is deleted. This does not count towards
+ * @a max_pages.
+ *
+ * @param env A valid Environment handle
+ * @param max_pages The maximum number of pages which are moved; 0 if
+ *        there is no limit
+ * @param relocated An optional pointer; returns the number of pages which
+ *        were moved
+ *
+ * @return @ref UPS_SUCCESS upon success
+ * @return @ref UPS_INV_PARAMETER if @a env is NULL
+ * @return @ref UPS_NOT_IMPLEMENTED if @a env is a remote Environment
+ * @return @ref UPS_WRITE_PROTECTED if the Environment is read-only
+ */
+UPS_EXPORT ups_status_t UPS_CALLCONV
+ups_env_compact(ups_env_t *env, uint32_t max_pages, uint32_t *relocated);
+
 /* internal use only - don't lock mutex */
 #define UPS_DONT_LOCK        0xf0000000
 
@@ -1189,6 +1316,14 @@ typedef struct ups_txn_t ups_txn_t;
  *    <ul>
  *     <li>@ref UPS_TXN_READ_ONLY </li> This Txn is read-only and
  *      will not modify the Database.
+ *     <li>@ref UPS_TXN_SNAPSHOT </li> This Txn is a read-only snapshot
+ *      of the Database at the time when it was started. It only sees
+ *      modifications of Transactions which were committed before, and
+ *      never fails with @ref UPS_TXN_CONFLICT. Committed Transactions
+ *      which are newer than the snapshot are not flushed to disk till
+ *      the snapshot is committed or aborted. Implies
+ *      @ref UPS_TXN_READ_ONLY; modifications fail with
+ *      @ref UPS_WRITE_PROTECTED.
  *    </ul>
  *
  * @return @ref UPS_SUCCESS upon success
@@ -1204,6 +1339,9 @@ ups_txn_begin(ups_txn_t **txn, ups_env_t *env, const char *name,
 /* Internal flag for @ref ups_txn_begin */
 #define UPS_TXN_TEMPORARY                     2
 
+/** Flag for @ref ups_txn_begin */
+#define UPS_TXN_SNAPSHOT                      4
+
 /**
  * Retrieves the Txn name
  *
@@ -1275,7 +1413,9 @@ ups_txn_abort(ups_txn_t *txn, uint32_t flags);
  * This flag is non persistent. */
 #define UPS_READ_ONLY                               0x00000004
 
-/* unused                                           0x00000008 */
+/** Flag for @ref ups_env_open, @ref ups_env_create.
+ * This flag is non persistent. */
+#define UPS_ENABLE_DEDUPLICATION                    0x00000008
 
 /* unused                                           0x00000010 */
 
@@ -1338,6 +1478,10 @@ ups_txn_abort(ups_txn_t *txn, uint32_t flags);
 /* internal use only! (persistent) */
 #define UPS_FORCE_RECORDS_INLINE                    0x00800000
 
+/** Flag for @ref ups_env_open, @ref ups_env_create.
+ * This flag is non persistent. */
+#define UPS_FLUSH_TRANSACTIONS_IN_BACKGROUND        0x01000000
+
 /** Flag for @ref ups_env_open, @ref ups_env_create.
  * This flag is non persistent. */
 #define UPS_ENABLE_CRC32                            0x02000000
@@ -1622,8 +1766,11 @@ ups_db_erase(ups_db_t *db, ups_txn_t *txn, ups_key_t *key, uint32_t flags);
  * Returns the number of keys stored in the Database
  *
  * You can specify the @ref UPS_SKIP_DUPLICATES if you do now want
- * to include any duplicates in the count. This will also speed up the
- * counting.
+ * to include any duplicates in the count.
+ *
+ * The number of keys is stored persistently in the Database header;
+ * this function therefore does not iterate over the keys unless there are
+ * modifications of Transactions which were not yet flushed.
  *
  * @param db A valid Database handle
  * @param txn A Txn handle, or NULL
@@ -1686,6 +1833,81 @@ ups_db_get_parameters(ups_db_t *db, ups_parameter_t *param);
  * this threshold. */
 #define UPS_PARAM_JOURNAL_SWITCH_THRESHOLD 0x00001
 
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * A journal checkpoint is written whenever this many bytes were appended
+ * to the journal since the previous checkpoint. Recovery only re-applies
+ * the changesets which were logged after the last checkpoint.
+ * 0 (the default) disables this trigger. */
+#define UPS_PARAM_JOURNAL_CHECKPOINT_BYTES 0x00002
+
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * A journal checkpoint is written whenever this many seconds passed since
+ * the previous checkpoint. 0 (the default) disables this trigger. */
+#define UPS_PARAM_JOURNAL_CHECKPOINT_SECONDS 0x00003
+
+/** Parameter name for @ref ups_env_create;
+ * Records of at least this size (in bytes) are appended to a separate
+ * value log (files "<filename>.vlog.<n>") instead of being stored in
+ * the Environment file, which keeps the btree pages dense. The threshold
+ * must be a power of two (at least 2); it is stored in the file header.
+ * Only applies to Databases without duplicate keys. Obsolete values are
+ * garbage collected by @ref ups_env_compact.
+ * 0 (the default) disables the value log. */
+#define UPS_PARAM_VALUE_LOG_THRESHOLD   0x00004
+
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * The size of a value log segment, in bytes. */
+#define UPS_PARAM_VALUE_LOG_SEGMENT_SIZE 0x00005
+
+/** Parameter name for @ref ups_env_create;
+ * The algorithm of the checksums which are stored if
+ * @ref UPS_ENABLE_CRC32 is set. Either @ref UPS_CHECKSUM_MURMURHASH3
+ * (the default) or @ref UPS_CHECKSUM_CRC32C. The algorithm is stored in
+ * the file header. */
+#define UPS_PARAM_CHECKSUM_ALGORITHM    0x00006
+
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * Free extents of at least 1 MB which were not reused for this many
+ * seconds release their disk space with fallocate(FALLOC_FL_PUNCH_HOLE).
+ * The space is allocated again when the pages are reused. Only
+ * supported on Linux. 0 (the default) disables hole punching. */
+#define UPS_PARAM_HOLE_PUNCH_SECONDS    0x00007
+
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * Reserves this many bytes of address space and maps the file with
+ * MAP_SHARED into this range; the mapping grows with the file, and all
+ * pages are read without copying them. Ignored if @ref UPS_DISABLE_MMAP
+ * is set or if recovery is enabled, because the modified pages could
+ * then be written to the file before the journal. Only supported on
+ * POSIX platforms. 0 (the default) disables the shared mapping. */
+#define UPS_PARAM_MMAP_RESERVE_SIZE     0x00008
+
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * The path of a capacity tier, i.e. a file on slower storage. Blob pages
+ * which are evicted from the cache are moved to this file, and their disk
+ * space in the Environment file is released. They move back if they are
+ * overwritten or read repeatedly. The pages are tracked in a page map
+ * (the Environment filename with the extension ".tier"), which also stores
+ * this path; the parameter is therefore only required when the capacity
+ * tier is created, or if it was moved. Disables mmap. Not allowed in
+ * combination with @ref UPS_IN_MEMORY or AES encryption. */
+#define UPS_PARAM_COLD_TIER_FILENAME    0x00009
+
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * The path of a second-level cache file ("flash cache") on fast local
+ * storage. Clean pages which are evicted from the cache are stored in
+ * this file, and are read from it before they are read from the
+ * Environment file. The flash cache is kept when the Environment is
+ * closed, but discarded if the Environment was not closed cleanly, if it
+ * was opened for writing without the flash cache in the meantime, or if
+ * the Journal is recovered. Disables mmap. Not allowed in combination
+ * with @ref UPS_IN_MEMORY. */
+#define UPS_PARAM_FLASH_CACHE_FILENAME  0x0000a
+
+/** Parameter name for @ref ups_env_open, @ref ups_env_create;
+ * The size of the flash cache (in bytes). The default is 256 MB. */
+#define UPS_PARAM_FLASH_CACHE_SIZE      0x0000b
+
 /** Parameter name for @ref ups_env_open, @ref ups_env_create;
  * sets the cache size */
 #define UPS_PARAM_CACHE_SIZE            0x00000100
@@ -1744,6 +1966,13 @@ ups_db_get_parameters(ups_db_t *db, ups_parameter_t *param);
 /** Value for @ref UPS_PARAM_POSIX_FADVISE */
 #define UPS_POSIX_FADVICE_RANDOM                 1
 
+/** Value for @ref UPS_PARAM_CHECKSUM_ALGORITHM */
+#define UPS_CHECKSUM_MURMURHASH3                 0
+
+/** Value for @ref UPS_PARAM_CHECKSUM_ALGORITHM; uses the SSE4.2 or
+ * ARMv8 CRC32 instructions if the CPU supports them */
+#define UPS_CHECKSUM_CRC32C                      1
+
 /** Value for unlimited record sizes */
 #define UPS_RECORD_SIZE_UNLIMITED       ((uint32_t)-1)
 
@@ -1821,6 +2050,19 @@ ups_db_get_parameters(ups_db_t *db, ups_parameter_t *param);
  */
 #define UPS_COMPRESSOR_LZF          3
 
+/**
+ * selects lz4 compression
+ * http://lz4.github.io/lz4
+ */
+#define UPS_COMPRESSOR_LZ4          12
+
+/**
+ * selects zstd compression; supports dictionaries (see
+ * @ref ups_env_train_compression_dictionary)
+ * http://facebook.github.io/zstd
+ */
+#define UPS_COMPRESSOR_ZSTD         13
+
 /** uint32 key compression (varbyte) */
 #define UPS_COMPRESSOR_UINT32_VARBYTE       5
 #define UPS_COMPRESSOR_UINT32_MASKEDVBYTE   UPS_COMPRESSOR_UINT32_VARBYTE
@@ -2409,6 +2651,69 @@ ups_cursor_get_duplicate_position(ups_cursor_t *cursor,
 UPS_EXPORT ups_status_t UPS_CALLCONV
 ups_cursor_get_record_size(ups_cursor_t *cursor, uint32_t *size);
 
+/**
+ * Reads a range of the current record
+ *
+ * Reads up to @a size bytes of the record to which the Cursor currently
+ * refers, starting at @a offset. The range is truncated at the end of the
+ * record; @a record->size returns the number of bytes which were read.
+ *
+ * Large records are stored in blob pages. Only the pages of the range are
+ * read, therefore a large record can be streamed in chunks by calling this
+ * function with increasing offsets. Compressed records are uncompressed
+ * as a whole.
+ *
+ * The memory of @a record is allocated as in @ref ups_cursor_move, unless
+ * @a record->flags contains @ref UPS_RECORD_USER_ALLOC.
+ *
+ * @param cursor A valid Cursor handle
+ * @param offset The offset of the range in the record
+ * @param size The number of bytes to read
+ * @param record Returns the data of the range
+ * @param flags Unused, set to 0
+ *
+ * @return @ref UPS_SUCCESS upon success
+ * @return @ref UPS_CURSOR_IS_NIL if the Cursor does not point to an item
+ * @return @ref UPS_INV_PARAMETER if @a cursor or @a record is NULL
+ * @return @ref UPS_INV_PARAMETER if @a offset is beyond the end of the record
+ * @return @ref UPS_NOT_IMPLEMENTED if this is a remote Database
+ */
+UPS_EXPORT ups_status_t UPS_CALLCONV
+ups_cursor_read_record_range(ups_cursor_t *cursor, uint32_t offset,
+            uint32_t size, ups_record_t *record, uint32_t flags);
+
+/**
+ * Overwrites a range of the current record
+ *
+ * Overwrites @a record->size bytes of the record to which the Cursor
+ * currently refers, starting at @a offset. The record grows if the range
+ * exceeds its current size, therefore a large record can be written in
+ * chunks by appending at the end of the record.
+ *
+ * If Transactions are disabled then only the blob pages which are
+ * modified by the range are written. Records of Transactional Databases
+ * and compressed records are rewritten as a whole.
+ *
+ * @param cursor A valid Cursor handle
+ * @param offset The offset of the range in the record; must not be beyond
+ *        the end of the record
+ * @param record The data of the range
+ * @param flags Unused, set to 0
+ *
+ * @return @ref UPS_SUCCESS upon success
+ * @return @ref UPS_CURSOR_IS_NIL if the Cursor does not point to an item
+ * @return @ref UPS_INV_PARAMETER if @a cursor or @a record is NULL
+ * @return @ref UPS_INV_PARAMETER if @a offset is beyond the end of the record
+ * @return @ref UPS_INV_RECORD_SIZE if the records have a fixed size and
+ *        the range exceeds it
+ * @return @ref UPS_WRITE_PROTECTED if you tried to write to a
+ *        read-only Database or in a snapshot Transaction
+ * @return @ref UPS_NOT_IMPLEMENTED if this is a remote Database
+ */
+UPS_EXPORT ups_status_t UPS_CALLCONV
+ups_cursor_write_record_range(ups_cursor_t *cursor, uint32_t offset,
+            ups_record_t *record, uint32_t flags);
+
 /**
  * Closes a Database Cursor
  *
@@ -209,7 +209,7 @@ typedef struct btree_metrics_t {
  * Metrics marked "global" are stored globally and shared between multiple
  * Environments.
  */
-#define UPS_METRICS_VERSION         9
+#define UPS_METRICS_VERSION         19
 
 typedef struct ups_env_metrics_t {
   /* the version indicator - must be UPS_METRICS_VERSION */
@@ -247,24 +247,78 @@ typedef struct ups_env_metrics_t {
   /* number of page-manager pages in this Environment */
   uint64_t page_count_type_page_manager;
 
+  /* number of pages which were relocated by ups_env_compact() */
+  uint64_t page_count_relocated;
+
+  /* number of pages which were truncated from the end of the file */
+  uint64_t page_count_truncated;
+
+  /* number of free pages which released their disk space (hole punching) */
+  uint64_t page_count_punched;
+
+  /* number of pages which were moved to the capacity tier */
+  uint64_t page_count_demoted;
+
+  /* number of pages which were moved back to the fast tier */
+  uint64_t page_count_promoted;
+
+  /* number of pages which are stored in the capacity tier */
+  uint64_t page_count_cold;
+
   /* number of successful freelist hits */
   uint64_t freelist_hits;
 
   /* number of freelist misses */
   uint64_t freelist_misses;
 
+  /* number of extents (sequences of adjacent free pages) in the freelist */
+  uint64_t freelist_extents;
+
+  /* number of pages in the freelist */
+  uint64_t freelist_pages;
+
+  /* number of pages of the largest extent in the freelist */
+  uint64_t freelist_largest_extent;
+
   /* number of successful cache hits */
   uint64_t cache_hits;
 
   /* number of cache misses */
   uint64_t cache_misses;
 
+  /* number of pages which were read from the flash cache */
+  uint64_t flash_cache_hits;
+
+  /* number of pages which were not found in the flash cache */
+  uint64_t flash_cache_misses;
+
+  /* number of pages scheduled for read-ahead */
+  uint64_t readahead_pages;
+
+  /* number of read-ahead pages which were subsequently read */
+  uint64_t readahead_hits;
+
+  /* number of read-ahead pages which were never read */
+  uint64_t readahead_wasted;
+
   /* number of blobs allocated */
   uint64_t blob_total_allocated;
 
   /* number of blobs read */
   uint64_t blob_total_read;
 
+  /* number of records which share an existing blob (deduplication) */
+  uint64_t blob_total_deduplicated;
+
+  /* number of bytes appended to the value log */
+  uint64_t value_log_bytes_written;
+
+  /* number of value log bytes moved by the garbage collection */
+  uint64_t value_log_bytes_relocated;
+
+  /* number of value log segments deleted by the garbage collection */
+  uint64_t value_log_segments_collected;
+
   /* (global) number of btree page splits */
   uint64_t btree_smo_split;
 
@@ -286,6 +340,22 @@ typedef struct ups_env_metrics_t {
   /* log/journal bytes after compression */
   uint64_t journal_bytes_after_compression;
 
+  /* number of journal checkpoints */
+  uint64_t journal_checkpoints;
+
+  /* lsn of the newest journal checkpoint */
+  uint64_t journal_checkpoint_lsn;
+
+  /* recovery estimate: journal bytes written after the newest checkpoint */
+  uint64_t journal_recovery_bytes;
+
+  /* recovery estimate: logged pages which the recovery would re-apply */
+  uint64_t journal_recovery_pages;
+
+  /* number of pages which were read from the file to compute the
+   * modified ranges of a logged page */
+  uint64_t journal_page_base_reads;
+
   /* record bytes before compression */
   uint64_t record_bytes_before_compression;
 
@@ -391,6 +461,9 @@ struct ups_operation_t {
 #define UPS_OP_ERASE        2
 #define UPS_OP_FIND         3
 
+/** Flag for @ref ups_db_bulk_operations */
+#define UPS_WRITE_BATCH     0x0001
+
 /**
  * Perform bulk operations on a database
  *
@@ -400,12 +473,77 @@ struct ups_operation_t {
  *
  * The @ref txn parameter is passed to @ref ups_db_insert, @ref ups_db_erase
  * and @ref ups_db_find.
+ *
+ * If @a flags is @ref UPS_WRITE_BATCH then the operations are applied
+ * atomically as a write batch: either all of them succeed or none is
+ * applied. Only @ref UPS_OP_INSERT and @ref UPS_OP_ERASE are supported,
+ * @a txn must be NULL and Record Number Databases are not supported.
+ * All operations are checked before the Database is modified; if one
+ * of them fails (i.e. with @ref UPS_DUPLICATE_KEY or
+ * @ref UPS_KEY_NOT_FOUND) then its status is stored in its @a result
+ * field and returned. Otherwise the operations are sorted by key and
+ * directly applied to the B+tree, without creating Transaction
+ * operations for them. If an operation still fails (i.e. with an I/O
+ * error) then the keys which were already modified are restored. For
+ * this purpose the records of each existing key are copied to memory
+ * right before the key is modified; this costs a lookup of the key and
+ * memory for the records, including large blobs. If Transactions are
+ * enabled then all modified pages are written to the journal as a single
+ * changeset.
+ * While other Transactions are active, the batch is applied through a
+ * single internal Transaction instead.
  */
 UPS_EXPORT ups_status_t UPS_CALLCONV
 ups_db_bulk_operations(ups_db_t *db, ups_txn_t *txn,
                     struct ups_operation_t *operations,
                     size_t operations_length, uint32_t flags);
 
+/**
+ * Moves a cursor and retrieves a batch of keys and records
+ *
+ * Moves the cursor in the direction specified by @a flags and retrieves
+ * up to @a *count consecutive keys and records with a single call. The
+ * cursor is left on the last retrieved key, i.e. the next call continues
+ * where the previous one stopped. An unused (nil) cursor starts at the
+ * first key (@ref UPS_CURSOR_NEXT) or the last key
+ * (@ref UPS_CURSOR_PREVIOUS).
+ *
+ * If the Database has neither Transactions nor duplicate keys, and the
+ * cursor moves forward, then the keys and records are copied directly
+ * from the B+tree leaf nodes, leaf by leaf, without materializing each
+ * row through @ref ups_cursor_move.
+ *
+ * Records are only fetched if @a records is not NULL.
+ *
+ * If less than @a *count keys are returned then the cursor reached the
+ * end (resp. the beginning) of the Database. Like @ref ups_cursor_move,
+ * a Cursor of a transactional Database is nil afterwards, and the next
+ * @ref UPS_CURSOR_NEXT starts again at the first key.
+ *
+ * Unless @ref UPS_KEY_USER_ALLOC (resp. @ref UPS_RECORD_USER_ALLOC) is set,
+ * the returned data pointers refer to temporary memory owned by the
+ * Database; it is valid till the next call on this Database (or Cursor),
+ * just like the data returned by @ref ups_cursor_move.
+ *
+ * @param cursor A valid Cursor handle
+ * @param keys An array of at least @a *count keys
+ * @param records An array of at least @a *count records, or NULL if
+ *        the records are not required
+ * @param count Input: the capacity of the arrays. Output: the number of
+ *        keys (and records) which were retrieved
+ * @param flags Either @ref UPS_CURSOR_NEXT or @ref UPS_CURSOR_PREVIOUS,
+ *        optionally combined with @ref UPS_SKIP_DUPLICATES
+ *
+ * @return @ref UPS_SUCCESS upon success
+ * @return @ref UPS_INV_PARAMETER if @a cursor, @a keys or @a count is NULL,
+ *        if @a *count is 0 or if @a flags is invalid
+ * @return @ref UPS_KEY_NOT_FOUND if the cursor already points to the
+ *        last (resp. first) key and no key was retrieved
+ */
+UPS_EXPORT ups_status_t UPS_CALLCONV
+ups_cursor_move_batch(ups_cursor_t *cursor, ups_key_t *keys,
+                    ups_record_t *records, uint32_t *count, uint32_t flags);
+
 /**
  * @}
  */
@@ -88,6 +88,26 @@ uqi_result_get_key_data(uqi_result_t *result, uint32_t *size);
 UPS_EXPORT void *UPS_CALLCONV
 uqi_result_get_record_data(uqi_result_t *result, uint32_t *size);
 
+/**
+ * Returns the number of columns of a query result
+ *
+ * A query with several aggregate functions (i.e.
+ * "COUNT($key), SUM($key) FROM DATABASE 1") returns one column per
+ * function. All other queries return a single column.
+ */
+UPS_EXPORT uint32_t UPS_CALLCONV
+uqi_result_get_column_count(uqi_result_t *result);
+
+/**
+ * Returns the result of the |column|th aggregate function of a query
+ *
+ * Column 0 is the @a result object itself. The returned object is owned
+ * by @a result and must not be closed with @a uqi_result_close.
+ * Returns null if @a column is out of bounds.
+ */
+UPS_EXPORT uqi_result_t *UPS_CALLCONV
+uqi_result_get_column(uqi_result_t *result, uint32_t column);
+
 /**
  * Releases the resources allocated by an uqi_result_t type.
  *
@@ -320,7 +340,8 @@ uqi_select(ups_env_t *env, const char *query, uqi_result_t **result);
  *
  * The supplied @ref query string has a syntax similar to SQL:
  *
- *   [DISTINCT] <FUNCTION>(<STREAM>) FROM DATABASE <DB>
+ *   [DISTINCT] <FUNCTION>(<STREAM>)[, <FUNCTION>(<STREAM>)...]
+ *          FROM DATABASE <DB>
  *          [WHERE <PREDICATE>(<STREAM>)]
  *          [LIMIT <LIMIT>]
  *
@@ -332,6 +353,10 @@ uqi_select(ups_env_t *env, const char *query, uqi_result_t **result);
  *          Built-in functions are SUM, COUNT, AVERAGE, TOP, BOTTOM,
  *          MIN and MAX. External identifiers are names of registered plugins
  *          (with @a uqi_register_plugin) or loaded from external libraries.
+ *          Several functions can be specified, separated by comma; they
+ *          are evaluated in a single pass over the data, and each function
+ *          returns its results in a separate column (see
+ *          @a uqi_result_get_column).
  *
  *   DB: the numerical id of the database
  *
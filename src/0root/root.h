@@ -45,6 +45,12 @@
 // the default page size is 16 kb
 #define UPS_DEFAULT_PAGE_SIZE     (16 * 1024)
 
+// the default size of a value log segment is 64 MB
+#define UPS_DEFAULT_VALUE_LOG_SEGMENT_SIZE (64 * 1024 * 1024)
+
+// the default size of the flash cache is 256 MB
+#define UPS_DEFAULT_FLASH_CACHE_SIZE (256 * 1024 * 1024)
+
 // boost/asio has nasty build dependencies and requires Windows.h,
 // therefore it is included here
 #ifdef WIN32
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * Computes the page and blob checksums with the algorithm which was
+ * configured for the Environment (UPS_PARAM_CHECKSUM_ALGORITHM)
+ */
+
+#ifndef UPS_CHECKSUM_H
+#define UPS_CHECKSUM_H
+
+#include "0root/root.h"
+
+#include "ups/upscaledb.h"
+
+#include "3rdparty/murmurhash3/MurmurHash3.h"
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/crc32c.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct Checksum {
+  // Returns the checksum of |size| bytes at |data|; |seed| is used to
+  // bind the checksum to an address
+  static uint32_t compute(int algorithm, const void *data, size_t size,
+                  uint32_t seed = 0) {
+    if (algorithm == UPS_CHECKSUM_CRC32C)
+      return Crc32c::compute(data, size, seed);
+
+    uint32_t hash;
+    MurmurHash3_x86_32(data, (int)size, seed, &hash);
+    return hash;
+  }
+};
+
+} // namespace upscaledb
+
+#endif // UPS_CHECKSUM_H
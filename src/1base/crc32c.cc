@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+#include "0root/root.h"
+
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#  define UPS_CRC32C_SSE42
+#  include <cpuid.h>
+#  include <nmmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  define UPS_CRC32C_SSE42
+#  include <intrin.h>
+#  include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#  define UPS_CRC32C_ARMV8
+#  include <arm_acle.h>
+#endif
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/crc32c.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+// the reflected Castagnoli polynomial
+static const uint32_t kPolynomial = 0x82f63b78;
+
+typedef uint32_t (*Crc32cFunction)(uint32_t crc, const uint8_t *p,
+                size_t size);
+
+// The lookup tables for slice-by-8; |table[0]| is the classic byte-wise
+// table, |table[k]| advances a byte by k additional zero bytes
+struct Crc32cTables {
+  Crc32cTables() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int j = 0; j < 8; j++)
+        crc = (crc >> 1) ^ (kPolynomial & (0 - (crc & 1)));
+      table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+      for (int k = 1; k < 8; k++)
+        table[k][i] = (table[k - 1][i] >> 8)
+                          ^ table[0][table[k - 1][i] & 0xff];
+    }
+  }
+
+  uint32_t table[8][256];
+};
+
+static Crc32cTables tables;
+
+static uint32_t
+crc32c_portable(uint32_t crc, const uint8_t *p, size_t size)
+{
+  const uint32_t (*t)[256] = tables.table;
+
+  // align the pointer to 8 bytes
+  while (size > 0 && ((uintptr_t)p & 7) != 0) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+    size--;
+  }
+
+  while (size >= 8) {
+    uint32_t lo, hi;
+    ::memcpy(&lo, p, 4);
+    ::memcpy(&hi, p + 4, 4);
+    lo ^= crc;
+    crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff]
+            ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff]
+            ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+    p += 8;
+    size -= 8;
+  }
+
+  while (size > 0) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+    size--;
+  }
+
+  return crc;
+}
+
+#ifdef UPS_CRC32C_SSE42
+
+#ifdef __GNUC__
+__attribute__((target("sse4.2")))
+#endif
+static uint32_t
+crc32c_sse42(uint32_t crc, const uint8_t *p, size_t size)
+{
+  while (size > 0 && ((uintptr_t)p & 7) != 0) {
+    crc = _mm_crc32_u8(crc, *p++);
+    size--;
+  }
+
+#if defined(__x86_64__) || defined(_M_X64)
+  uint64_t crc64 = crc;
+  while (size >= 8) {
+    uint64_t v;
+    ::memcpy(&v, p, 8);
+    crc64 = _mm_crc32_u64(crc64, v);
+    p += 8;
+    size -= 8;
+  }
+  crc = (uint32_t)crc64;
+#endif
+
+  while (size >= 4) {
+    uint32_t v;
+    ::memcpy(&v, p, 4);
+    crc = _mm_crc32_u32(crc, v);
+    p += 4;
+    size -= 4;
+  }
+
+  while (size > 0) {
+    crc = _mm_crc32_u8(crc, *p++);
+    size--;
+  }
+
+  return crc;
+}
+
+static bool
+cpu_supports_sse42()
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 20)) != 0;
+#else
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return false;
+  return (ecx & bit_SSE4_2) != 0;
+#endif
+}
+
+#endif // UPS_CRC32C_SSE42
+
+#ifdef UPS_CRC32C_ARMV8
+
+static uint32_t
+crc32c_armv8(uint32_t crc, const uint8_t *p, size_t size)
+{
+  while (size > 0 && ((uintptr_t)p & 7) != 0) {
+    crc = __crc32cb(crc, *p++);
+    size--;
+  }
+
+  while (size >= 8) {
+    uint64_t v;
+    ::memcpy(&v, p, 8);
+    crc = __crc32cd(crc, v);
+    p += 8;
+    size -= 8;
+  }
+
+  while (size > 0) {
+    crc = __crc32cb(crc, *p++);
+    size--;
+  }
+
+  return crc;
+}
+
+#endif // UPS_CRC32C_ARMV8
+
+static Crc32cFunction
+select_implementation()
+{
+#if defined(UPS_CRC32C_SSE42)
+  if (cpu_supports_sse42())
+    return crc32c_sse42;
+#elif defined(UPS_CRC32C_ARMV8)
+  return crc32c_armv8;
+#endif
+  return crc32c_portable;
+}
+
+static Crc32cFunction implementation = select_implementation();
+
+uint32_t
+Crc32c::compute(const void *data, size_t size, uint32_t crc)
+{
+  return ~implementation(~crc, (const uint8_t *)data, size);
+}
+
+uint32_t
+Crc32c::compute_portable(const void *data, size_t size, uint32_t crc)
+{
+  return ~crc32c_portable(~crc, (const uint8_t *)data, size);
+}
+
+bool
+Crc32c::is_hardware_accelerated()
+{
+  return implementation != crc32c_portable;
+}
+
+} // namespace upscaledb
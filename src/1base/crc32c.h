@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * CRC32C (Castagnoli) checksums
+ *
+ * Uses the SSE4.2 or ARMv8 CRC32 instructions if the CPU supports them,
+ * otherwise a portable slice-by-8 implementation. The implementation is
+ * selected once when the library is loaded.
+ */
+
+#ifndef UPS_CRC32C_H
+#define UPS_CRC32C_H
+
+#include "0root/root.h"
+
+#include <stddef.h>
+
+#include "ups/types.h"
+
+// Always verify that a file of level N does not include headers > N!
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct Crc32c {
+  // Returns the CRC32C of |size| bytes at |data|. |crc| is the result
+  // of a previous call; this allows computing the checksum of data
+  // which is not contiguous.
+  static uint32_t compute(const void *data, size_t size, uint32_t crc = 0);
+
+  // Returns the portable (software) CRC32C; used for testing
+  static uint32_t compute_portable(const void *data, size_t size,
+                  uint32_t crc = 0);
+
+  // Returns true if the CPU instructions are used
+  static bool is_hardware_accelerated();
+};
+
+} // namespace upscaledb
+
+#endif // UPS_CRC32C_H
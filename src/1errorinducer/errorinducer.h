@@ -61,6 +61,9 @@ struct ErrorInducer {
     // let mmap fail
     kFileMmap,
 
+    // simulates a failure while a write batch is applied
+    kWriteBatch,
+
     kMaxActions
   };
 
@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * A bump-pointer allocator
+ *
+ * Memory is carved out of large chunks, which are allocated with the
+ * Memory class. Single allocations cannot be released; instead all
+ * chunks are released at once with clear() (or in the destructor).
+ */
+
+#ifndef UPS_ARENA_H
+#define UPS_ARENA_H
+
+#include "0root/root.h"
+
+#include "ups/types.h"
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/uncopyable.h"
+#include "1mem/mem.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct Arena : Uncopyable {
+  enum {
+    // The size of a regular chunk
+    kChunkSize = 16 * 1024,
+
+    // Allocations larger than this get a chunk of their own
+    kLargeAllocation = kChunkSize / 4,
+
+    // All allocations are aligned to this boundary
+    kAlignment = 8
+  };
+
+  // Constructor
+  Arena()
+    : chunks(0), ptr(0), end(0) {
+  }
+
+  // Destructor; releases all memory
+  ~Arena() {
+    clear();
+  }
+
+  // Allocates |size| bytes, casted into type |T *|. The memory is valid
+  // till clear() is called or the Arena is destroyed.
+  template<typename T>
+  T *allocate(size_t size) {
+    size = (size + kAlignment - 1) & ~((size_t)kAlignment - 1);
+    if (unlikely(ptr == 0 || size > (size_t)(end - ptr)))
+      return (T *)allocate_slow(size);
+    T *t = (T *)ptr;
+    ptr += size;
+    return t;
+  }
+
+  // Releases all chunks
+  void clear() {
+    while (chunks) {
+      Chunk *next = chunks->next;
+      Memory::release(chunks);
+      chunks = next;
+    }
+    ptr = 0;
+    end = 0;
+  }
+
+ private:
+  // The header of each chunk; the payload follows immediately
+  struct Chunk {
+    Chunk *next;
+    uint64_t reserved; // keeps the payload aligned to 16 bytes
+  };
+
+  // Allocates a new chunk and returns |size| bytes from it
+  uint8_t *allocate_slow(size_t size) {
+    // large allocations get their own chunk, which is linked behind the
+    // current one; the current chunk is still used for the next requests
+    if (size > kLargeAllocation) {
+      Chunk *c = Memory::allocate<Chunk>(sizeof(Chunk) + size);
+      if (chunks) {
+        c->next = chunks->next;
+        chunks->next = c;
+      }
+      else {
+        c->next = 0;
+        chunks = c;
+      }
+      return (uint8_t *)(c + 1);
+    }
+
+    Chunk *c = Memory::allocate<Chunk>(sizeof(Chunk) + kChunkSize);
+    c->next = chunks;
+    chunks = c;
+    ptr = (uint8_t *)(c + 1) + size;
+    end = (uint8_t *)(c + 1) + kChunkSize;
+    return (uint8_t *)(c + 1);
+  }
+
+  // Linked list of all chunks; the head is the current chunk
+  Chunk *chunks;
+
+  // The next free byte in the current chunk
+  uint8_t *ptr;
+
+  // The end of the current chunk
+  uint8_t *end;
+};
+
+} // namespace upscaledb
+
+#endif // UPS_ARENA_H
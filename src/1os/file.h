@@ -58,6 +58,15 @@ class File
 #endif
     };
 
+    // A buffer for writev()
+    struct IoBuffer {
+      // the data
+      const void *data;
+
+      // the size of the data, in bytes
+      size_t size;
+    };
+
     // Constructor: creates an empty File handle
     File()
       : m_fd(UPS_INVALID_FD), m_mmaph(UPS_INVALID_FD), m_posix_advice(0) {
@@ -100,6 +109,11 @@ class File
     // Sets the parameter for posix_fadvise()
     void set_posix_advice(int parameter);
 
+    // Asks the operating system to asynchronously read a file range into
+    // its cache (posix_fadvise(POSIX_FADV_WILLNEED)); does not block and
+    // does not throw
+    void prefetch(uint64_t addr, size_t len);
+
     // Maps a file in memory
     //
     // mmap is called with MAP_PRIVATE - the allocated buffer
@@ -111,6 +125,23 @@ class File
     // Unmaps a buffer
     void munmap(void *buffer, size_t size);
 
+    // Reserves |size| bytes of address space without mapping any file
+    // data; the range is inaccessible till parts of it are mapped with
+    // |mmap_shared|. Release the range with |munmap|.
+    static void mmap_reserve(size_t size, uint8_t **buffer);
+
+    // Maps a range of the file to |buffer|, which is part of a range
+    // returned by |mmap_reserve|. mmap is called with MAP_SHARED - writing
+    // to the buffer modifies the file.
+    void mmap_shared(uint8_t *buffer, uint64_t position, size_t size,
+                    bool readonly);
+
+    // Returns a range mapped with |mmap_shared| to the reservation
+    static void mmap_release(uint8_t *buffer, size_t size);
+
+    // Flushes the modifications of a buffer mapped with |mmap_shared|
+    static void msync(uint8_t *buffer, size_t size);
+
     // Positional read from a file
     void pread(uint64_t addr, void *buffer, size_t len);
 
@@ -120,6 +151,10 @@ class File
     // Write data to a file; uses the current file position
     void write(const void *buffer, size_t len);
 
+    // Writes |count| buffers with as few system calls as possible;
+    // uses the current file position
+    void writev(const IoBuffer *buffers, size_t count);
+
     // Get the page allocation granularity of the operating system
     static size_t granularity();
 
@@ -135,9 +170,26 @@ class File
     // Truncate/resize the file
     void truncate(uint64_t newsize);
 
+    // Allocates disk space for a range of the file (fallocate()) and grows
+    // the file, if necessary. Falls back to truncate() if the file system
+    // does not support this.
+    void allocate(uint64_t addr, uint64_t len);
+
+    // Releases the disk space of a range of the file, which afterwards
+    // reads as zeroes (fallocate(FALLOC_FL_PUNCH_HOLE)); the file size
+    // does not change. Returns false if this is not supported.
+    bool punch_hole(uint64_t addr, uint64_t len);
+
     // Closes the file descriptor
     void close();
 
+    // Deletes a file; the file must not be open. Does not fail if the
+    // file does not exist
+    static void remove(const char *filename);
+
+    // Returns true if a file exists
+    static bool exists(const char *filename);
+
   private:
     // The file handle
     ups_fd_t m_fd;
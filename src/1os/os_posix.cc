@@ -169,6 +169,20 @@ File::set_posix_advice(int advice)
 #endif
 }
 
+void
+File::prefetch(uint64_t addr, size_t len)
+{
+  os_log(("File::prefetch: fd=%d, address=%lld, size=%lld", m_fd, addr, len));
+
+#if HAVE_POSIX_FADVISE
+  // this is only a hint; a failure is not fatal
+  int r = ::posix_fadvise(m_fd, addr, len, POSIX_FADV_WILLNEED);
+  if (r != 0)
+    ups_trace(("posix_fadvise(WILLNEED) failed with status %d (%s)",
+                            r, strerror(r)));
+#endif
+}
+
 void
 File::mmap(uint64_t position, size_t size, bool readonly, uint8_t **buffer)
 {
@@ -218,6 +232,98 @@ File::munmap(void *buffer, size_t size)
 #endif
 }
 
+#if HAVE_MMAP
+#  if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#    define MAP_ANONYMOUS MAP_ANON
+#  endif
+#  ifndef MAP_NORESERVE
+#    define MAP_NORESERVE 0
+#  endif
+#endif
+
+void
+File::mmap_reserve(size_t size, uint8_t **buffer)
+{
+  os_log(("File::mmap_reserve: size=%lld", size));
+
+  UPS_INDUCE_ERROR(ErrorInducer::kFileMmap);
+
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+  *buffer = (uint8_t *)::mmap(0, size, PROT_NONE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (*buffer == (void *)-1) {
+    *buffer = 0;
+    ups_log(("mmap failed with status %d (%s)", errno, strerror(errno)));
+    throw Exception(UPS_IO_ERROR);
+  }
+#else
+  throw Exception(UPS_NOT_IMPLEMENTED);
+#endif
+}
+
+void
+File::mmap_shared(uint8_t *buffer, uint64_t position, size_t size,
+                bool readonly)
+{
+  os_log(("File::mmap_shared: fd=%d, position=%lld, size=%lld",
+                          m_fd, position, size));
+
+  int prot = PROT_READ;
+  if (!readonly)
+    prot |= PROT_WRITE;
+
+#if HAVE_MMAP
+  void *p = ::mmap(buffer, size, prot, MAP_SHARED | MAP_FIXED, m_fd, position);
+  if (p == (void *)-1) {
+    ups_log(("mmap failed with status %d (%s)", errno, strerror(errno)));
+    throw Exception(UPS_IO_ERROR);
+  }
+#else
+  throw Exception(UPS_NOT_IMPLEMENTED);
+#endif
+
+#if HAVE_MADVISE
+  // the Btree pages are accessed randomly; without this hint the kernel
+  // reads the neighbouring pages on each page fault. Sequential scans
+  // and large blobs are read ahead explicitly (see prefetch())
+  if (::madvise(buffer, size, MADV_RANDOM) != 0)
+    ups_trace(("madvise failed with status %d (%s)", errno, strerror(errno)));
+#endif
+}
+
+void
+File::mmap_release(uint8_t *buffer, size_t size)
+{
+  os_log(("File::mmap_release: size=%lld", size));
+
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+  void *p = ::mmap(buffer, size, PROT_NONE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+                  -1, 0);
+  if (p == (void *)-1) {
+    ups_log(("mmap failed with status %d (%s)", errno, strerror(errno)));
+    throw Exception(UPS_IO_ERROR);
+  }
+#else
+  throw Exception(UPS_NOT_IMPLEMENTED);
+#endif
+}
+
+void
+File::msync(uint8_t *buffer, size_t size)
+{
+  os_log(("File::msync: size=%lld", size));
+
+#if HAVE_MMAP
+  if (::msync(buffer, size, MS_SYNC) != 0) {
+    ups_log(("msync failed with status %d (%s)", errno, strerror(errno)));
+    throw Exception(UPS_IO_ERROR);
+  }
+#else
+  throw Exception(UPS_NOT_IMPLEMENTED);
+#endif
+}
+
 void
 File::pread(uint64_t addr, void *buffer, size_t len)
 {
@@ -287,6 +393,52 @@ File::write(const void *buffer, size_t len)
   os_write(m_fd, buffer, len);
 }
 
+void
+File::writev(const IoBuffer *buffers, size_t count)
+{
+  os_log(("File::writev: fd=%d, count=%d", m_fd, (int)count));
+#if HAVE_WRITEV
+  enum { kMaxIov = 64 };
+  struct iovec iov[kMaxIov];
+
+  while (count > 0) {
+    int n = 0;
+    size_t total = 0;
+    for (; n < kMaxIov && (size_t)n < count; n++) {
+      iov[n].iov_base = (void *)buffers[n].data;
+      iov[n].iov_len = buffers[n].size;
+      total += buffers[n].size;
+    }
+
+    ssize_t w = ::writev(m_fd, iov, n);
+    if (w < 0) {
+      ups_log(("writev failed with status %u (%s)", errno, strerror(errno)));
+      throw Exception(UPS_IO_ERROR);
+    }
+
+    // short write: write the remaining bytes of each buffer
+    if ((size_t)w < total) {
+      size_t skip = (size_t)w;
+      for (int i = 0; i < n; i++) {
+        if (skip >= iov[i].iov_len) {
+          skip -= iov[i].iov_len;
+          continue;
+        }
+        os_write(m_fd, (const char *)iov[i].iov_base + skip,
+                        iov[i].iov_len - skip);
+        skip = 0;
+      }
+    }
+
+    buffers += n;
+    count -= n;
+  }
+#else
+  for (size_t i = 0; i < count; i++)
+    os_write(m_fd, buffers[i].data, buffers[i].size);
+#endif
+}
+
 void
 File::seek(uint64_t offset, int whence) const
 {
@@ -322,6 +474,40 @@ File::truncate(uint64_t newsize)
     throw Exception(UPS_IO_ERROR);
 }
 
+void
+File::allocate(uint64_t addr, uint64_t len)
+{
+  os_log(("File::allocate: fd=%d, address=%lld, size=%lld", m_fd, addr, len));
+
+#if HAVE_FALLOCATE
+  if (::fallocate(m_fd, 0, addr, len) == 0)
+    return;
+  // not supported by the file system? then just resize the file
+  if (errno != EOPNOTSUPP && errno != ENOSYS) {
+    ups_log(("fallocate failed with status %d (%s)", errno, strerror(errno)));
+    throw Exception(UPS_IO_ERROR);
+  }
+#endif
+  if (addr + len > file_size())
+    truncate(addr + len);
+}
+
+bool
+File::punch_hole(uint64_t addr, uint64_t len)
+{
+  os_log(("File::punch_hole: fd=%d, address=%lld, size=%lld", m_fd, addr, len));
+
+#if HAVE_FALLOCATE && defined(FALLOC_FL_PUNCH_HOLE)
+  if (::fallocate(m_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  addr, len) == 0)
+    return true;
+  // this is only an optimization; a failure is not fatal
+  ups_trace(("fallocate(PUNCH_HOLE) failed with status %d (%s)",
+                          errno, strerror(errno)));
+#endif
+  return false;
+}
+
 void
 File::create(const char *filename, uint32_t mode)
 {
@@ -410,6 +596,24 @@ File::close()
   }
 }
 
+void
+File::remove(const char *filename)
+{
+  os_log(("File::remove: %s", filename));
+  if (::unlink(filename) == -1 && errno != ENOENT) {
+    ups_log(("removing file %s failed with status %u (%s)", filename,
+        errno, strerror(errno)));
+    throw Exception(UPS_IO_ERROR);
+  }
+}
+
+bool
+File::exists(const char *filename)
+{
+  struct stat buf;
+  return ::stat(filename, &buf) == 0;
+}
+
 void
 Socket::connect(const char *hostname, uint16_t port, uint32_t timeout_sec)
 {
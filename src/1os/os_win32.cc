@@ -105,6 +105,12 @@ File::set_posix_advice(int advice)
   // Only available for posix platforms
 }
 
+void
+File::prefetch(uint64_t addr, size_t len)
+{
+  // Only available for posix platforms
+}
+
 void
 File::mmap(uint64_t position, size_t size, bool readonly, uint8_t **buffer)
 {
@@ -169,6 +175,32 @@ File::munmap(void *buffer, size_t size)
   m_mmaph = UPS_INVALID_FD;
 }
 
+void
+File::mmap_reserve(size_t size, uint8_t **buffer)
+{
+  // not supported; the caller falls back to File::mmap()
+  throw Exception(UPS_NOT_IMPLEMENTED);
+}
+
+void
+File::mmap_shared(uint8_t *buffer, uint64_t position, size_t size,
+                bool readonly)
+{
+  throw Exception(UPS_NOT_IMPLEMENTED);
+}
+
+void
+File::mmap_release(uint8_t *buffer, size_t size)
+{
+  throw Exception(UPS_NOT_IMPLEMENTED);
+}
+
+void
+File::msync(uint8_t *buffer, size_t size)
+{
+  throw Exception(UPS_NOT_IMPLEMENTED);
+}
+
 void
 File::pread(uint64_t addr, void *buffer, size_t len)
 {
@@ -250,6 +282,13 @@ File::write(const void *buffer, size_t len)
     throw Exception(UPS_IO_ERROR);
 }
 
+void
+File::writev(const IoBuffer *buffers, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+    write(buffers[i].data, buffers[i].size);
+}
+
 #ifndef INVALID_SET_FILE_POINTER
 #   define INVALID_SET_FILE_POINTER  ((DWORD)-1)
 #endif
@@ -329,6 +368,21 @@ File::truncate(uint64_t newsize)
   assert(newsize == file_size());
 }
 
+void
+File::allocate(uint64_t addr, uint64_t len)
+{
+  // Only available for posix platforms; just resize the file
+  if (addr + len > file_size())
+    truncate(addr + len);
+}
+
+bool
+File::punch_hole(uint64_t addr, uint64_t len)
+{
+  // Only available for posix platforms
+  return false;
+}
+
 void
 File::create(const char *filename, uint32_t mode)
 {
@@ -456,6 +510,42 @@ File::close()
   }
 }
 
+void
+File::remove(const char *filename)
+{
+  BOOL ok;
+
+#ifdef UNICODE
+  int fnameWlen = calc_wlen4str(filename);
+  WCHAR *wfilename = (WCHAR *)malloc(fnameWlen * sizeof(wfilename[0]));
+  if (!wfilename)
+    throw Exception(UPS_OUT_OF_MEMORY);
+
+  /* translate ASCII filename to unicode */
+  utf8_string(filename, wfilename, fnameWlen);
+  ok = DeleteFileW(wfilename);
+  free(wfilename);
+#else
+  ok = DeleteFileA(filename);
+#endif
+
+  if (!ok) {
+    char buf[256];
+    ups_status_t st = (ups_status_t)GetLastError();
+    if (st == ERROR_FILE_NOT_FOUND)
+      return;
+    ups_log(("DeleteFile(%s) failed with OS status %u (%s)", filename, st,
+            DisplayError(buf, sizeof(buf), st)));
+    throw Exception(UPS_IO_ERROR);
+  }
+}
+
+bool
+File::exists(const char *filename)
+{
+  return GetFileAttributesA(filename) != INVALID_FILE_ATTRIBUTES;
+}
+
 void
 Socket::connect(const char *hostname, uint16_t port, uint32_t timeout_sec)
 {
@@ -72,6 +72,12 @@ struct Compressor {
   virtual void decompress(const uint8_t *inp, uint32_t inlength,
                   uint32_t outlength, uint8_t *destination) = 0;
 
+  // Sets a dictionary which was trained with
+  // CompressorFactory::train_dictionary(). Ignored by compressors which
+  // do not support dictionaries.
+  virtual void set_dictionary(const uint8_t *data, uint32_t size) {
+  }
+
   // Reserves |n| bytes in the output buffer; can be used by the caller
   // to insert flags or sizes
   void reserve(int n) {
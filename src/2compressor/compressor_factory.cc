@@ -18,11 +18,19 @@
 
 #include "0root/root.h"
 
+#include <vector>
+
 // Always verify that a file of level N does not include headers > N!
 #include "2compressor/compressor_factory.h"
 #include "2compressor/compressor_zlib.h"
 #include "2compressor/compressor_snappy.h"
 #include "2compressor/compressor_lzf.h"
+#include "2compressor/compressor_lz4.h"
+#include "2compressor/compressor_zstd.h"
+
+#ifdef HAVE_ZSTD_H
+#  include <zdict.h>
+#endif
 
 #ifndef UPS_ROOT_H
 #  error "root.h was not included"
@@ -61,6 +69,18 @@ CompressorFactory::is_available(int type)
     case UPS_COMPRESSOR_LZF:
       // this is always available
       return true;
+    case UPS_COMPRESSOR_LZ4:
+#ifdef HAVE_LZ4_H
+      return true;
+#else
+      return false;
+#endif
+    case UPS_COMPRESSOR_ZSTD:
+#ifdef HAVE_ZSTD_H
+      return true;
+#else
+      return false;
+#endif
     default:
       return false;
   }
@@ -87,6 +107,20 @@ CompressorFactory::create(int type)
     case UPS_COMPRESSOR_LZF:
       // this is always available
       return new CompressorImpl<LzfCompressor>();
+    case UPS_COMPRESSOR_LZ4:
+#ifdef HAVE_LZ4_H
+      return new CompressorImpl<Lz4Compressor>();
+#else
+      ups_log(("upscaledb was built without support for lz4 compression"));
+      throw Exception(UPS_INV_PARAMETER);
+#endif
+    case UPS_COMPRESSOR_ZSTD:
+#ifdef HAVE_ZSTD_H
+      return new ZstdCompressorImpl();
+#else
+      ups_log(("upscaledb was built without support for zstd compression"));
+      throw Exception(UPS_INV_PARAMETER);
+#endif
     default:
       ups_log(("Unknown compressor type %d", type));
       throw Exception(UPS_INV_PARAMETER);
@@ -94,4 +128,30 @@ CompressorFactory::create(int type)
   throw Exception(UPS_INV_PARAMETER);
 }
 
+void
+CompressorFactory::train_dictionary(const ups_record_t *samples,
+                uint32_t num_samples, ByteArray *dictionary)
+{
+#ifdef HAVE_ZSTD_H
+  // zdict expects all samples in a single buffer
+  ByteArray buffer;
+  std::vector<size_t> sizes(num_samples);
+  for (uint32_t i = 0; i < num_samples; i++) {
+    buffer.append((const uint8_t *)samples[i].data, samples[i].size);
+    sizes[i] = samples[i].size;
+  }
+
+  size_t size = ZDICT_trainFromBuffer(dictionary->data(), dictionary->size(),
+                  buffer.data(), sizes.data(), num_samples);
+  if (ZDICT_isError(size)) {
+    ups_log(("failed to train the dictionary: %s", ZDICT_getErrorName(size)));
+    throw Exception(UPS_INV_PARAMETER);
+  }
+  dictionary->set_size(size);
+#else
+  ups_log(("upscaledb was built without support for zstd compression"));
+  throw Exception(UPS_NOT_IMPLEMENTED);
+#endif
+}
+
 }; // namespace upscaledb
@@ -44,6 +44,13 @@ struct CompressorFactory {
   // Creates a new Compressor instance for the specified |type| (being
   // UPS_COMPRESSOR_ZLIB, UPS_COMPRESSOR_SNAPPY etc)
   static Compressor *create(int type);
+
+  // Trains a dictionary for UPS_COMPRESSOR_ZSTD with |num_samples| samples
+  // of typical data. |dictionary| must be resized to the maximum size of
+  // the dictionary; it is shrunk to the actual size. Throws
+  // UPS_NOT_IMPLEMENTED if zstd is not available.
+  static void train_dictionary(const ups_record_t *samples,
+                  uint32_t num_samples, ByteArray *dictionary);
 };
 
 }; // namespace upscaledb
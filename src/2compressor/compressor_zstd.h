@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * A compressor which uses zstd.
+ *
+ * The compressor can use a dictionary (see
+ * CompressorFactory::train_dictionary()). Small keys and records compress
+ * much better with a dictionary, because they do not have to build up
+ * their own history. Each zstd frame stores the id of its dictionary;
+ * frames which were compressed without dictionary can therefore still be
+ * decompressed after a dictionary was set.
+ *
+ * @exception_safe: strong
+ * @thread_safe: no
+ */
+
+#ifndef UPS_COMPRESSOR_ZSTD_H
+#define UPS_COMPRESSOR_ZSTD_H
+
+#ifdef HAVE_ZSTD_H
+
+#include "0root/root.h"
+
+#include <zstd.h>
+
+// Always verify that a file of level N does not include headers > N!
+#include "2compressor/compressor.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct ZstdCompressor {
+  enum {
+    // the compression level; favors speed over ratio
+    kLevel = 3
+  };
+
+  ZstdCompressor()
+    : cctx(0), dctx(0), cdict(0), ddict(0) {
+  }
+
+  ~ZstdCompressor() {
+    free_dictionary();
+    ZSTD_freeCCtx(cctx);
+    ZSTD_freeDCtx(dctx);
+  }
+
+  uint32_t compressed_length(uint32_t length) {
+    return ZSTD_compressBound(length);
+  }
+
+  uint32_t compress(const uint8_t *inp, uint32_t inlength,
+                          uint8_t *outp, uint32_t outlength) {
+    // the contexts are only allocated when they are used; many
+    // compressors (i.e. for keys) are created, but never used
+    if (!cctx) {
+      cctx = ZSTD_createCCtx();
+      if (!cctx)
+        throw Exception(UPS_OUT_OF_MEMORY);
+    }
+
+    size_t real_outlength = cdict
+            ? ZSTD_compress_usingCDict(cctx, outp, outlength, inp, inlength,
+                                cdict)
+            : ZSTD_compressCCtx(cctx, outp, outlength, inp, inlength,
+                                kLevel);
+    if (ZSTD_isError(real_outlength))
+      throw Exception(UPS_INTERNAL_ERROR);
+    return (uint32_t)real_outlength;
+  }
+
+  void decompress(const uint8_t *inp, uint32_t inlength,
+                          uint8_t *outp, uint32_t outlength) {
+    if (!dctx) {
+      dctx = ZSTD_createDCtx();
+      if (!dctx)
+        throw Exception(UPS_OUT_OF_MEMORY);
+    }
+
+    size_t real_outlength;
+    if (ZSTD_getDictID_fromFrame(inp, inlength) != 0) {
+      // the frame was compressed with a dictionary which is not loaded
+      if (!ddict)
+        throw Exception(UPS_INTEGRITY_VIOLATED);
+      real_outlength = ZSTD_decompress_usingDDict(dctx, outp, outlength,
+                            inp, inlength, ddict);
+    }
+    else
+      real_outlength = ZSTD_decompressDCtx(dctx, outp, outlength,
+                            inp, inlength);
+
+    if (ZSTD_isError(real_outlength) || real_outlength != outlength)
+      throw Exception(UPS_INTERNAL_ERROR);
+  }
+
+  // Sets the dictionary for all following operations
+  void set_dictionary(const uint8_t *data, uint32_t size) {
+    ZSTD_CDict *c = ZSTD_createCDict(data, size, kLevel);
+    ZSTD_DDict *d = ZSTD_createDDict(data, size);
+    if (!c || !d) {
+      ZSTD_freeCDict(c);
+      ZSTD_freeDDict(d);
+      throw Exception(UPS_OUT_OF_MEMORY);
+    }
+
+    free_dictionary();
+    cdict = c;
+    ddict = d;
+  }
+
+  // Releases the dictionary
+  void free_dictionary() {
+    ZSTD_freeCDict(cdict);
+    ZSTD_freeDDict(ddict);
+    cdict = 0;
+    ddict = 0;
+  }
+
+  // The compression and decompression contexts
+  ZSTD_CCtx *cctx;
+  ZSTD_DCtx *dctx;
+
+  // The (digested) dictionary; can be null
+  ZSTD_CDict *cdict;
+  ZSTD_DDict *ddict;
+};
+
+// A Compressor which supports dictionaries
+struct ZstdCompressorImpl : public CompressorImpl<ZstdCompressor>
+{
+  virtual void set_dictionary(const uint8_t *data, uint32_t size) {
+    impl.set_dictionary(data, size);
+  }
+};
+
+}; // namespace upscaledb
+
+#endif // HAVE_ZSTD_H
+
+#endif // UPS_COMPRESSOR_ZSTD_H
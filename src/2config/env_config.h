@@ -53,7 +53,13 @@ struct EnvConfig
       file_size_limit_bytes(std::numeric_limits<size_t>::max()), 
       remote_timeout_sec(0), journal_compressor(0),
       is_encryption_enabled(false), journal_switch_threshold(0),
-      posix_advice(UPS_POSIX_FADVICE_NORMAL) {
+      journal_checkpoint_bytes(0), journal_checkpoint_seconds(0),
+      value_log_threshold(0),
+      value_log_segment_size(UPS_DEFAULT_VALUE_LOG_SEGMENT_SIZE),
+      posix_advice(UPS_POSIX_FADVICE_NORMAL),
+      checksum_algorithm(UPS_CHECKSUM_MURMURHASH3), hole_punch_seconds(0),
+      mmap_reserve_size(0),
+      flash_cache_size(UPS_DEFAULT_FLASH_CACHE_SIZE) {
   }
 
   // the environment's flags
@@ -95,8 +101,42 @@ struct EnvConfig
   // threshold for switching journal files
   size_t journal_switch_threshold;
 
+  // journal checkpoint interval in bytes; 0 if disabled
+  uint64_t journal_checkpoint_bytes;
+
+  // journal checkpoint interval in seconds; 0 if disabled
+  uint32_t journal_checkpoint_seconds;
+
+  // records of at least this size are stored in the value log; 0 if
+  // the value log is disabled
+  uint32_t value_log_threshold;
+
+  // the size of a value log segment (in bytes)
+  uint64_t value_log_segment_size;
+
   // parameter for posix_fadvise()
   int posix_advice;
+
+  // the algorithm of the page checksums (UPS_ENABLE_CRC32)
+  int checksum_algorithm;
+
+  // free extents release their disk space after this many seconds; 0 if
+  // disabled
+  uint32_t hole_punch_seconds;
+
+  // the size of the address space which is reserved for a shared mapping
+  // of the file (in bytes); 0 if disabled
+  uint64_t mmap_reserve_size;
+
+  // the path of the capacity tier; empty if the pages are stored in a
+  // single file
+  std::string cold_tier_filename;
+
+  // the path of the flash cache; empty if disabled
+  std::string flash_cache_filename;
+
+  // the size of the flash cache (in bytes)
+  uint64_t flash_cache_size;
 };
 
 } // namespace upscaledb
@@ -29,7 +29,7 @@
 
 #include "0root/root.h"
 
-#include "ups/upscaledb.h"
+#include "ups/upscaledb_int.h"
 
 // Always verify that a file of level N does not include headers > N!
 #include "2config/env_config.h"
@@ -97,6 +97,10 @@ struct Device {
   // Reads a page from the device; this function CAN use mmap
   virtual void read_page(Page *page, uint64_t address) = 0;
 
+  // Schedules an asynchronous read of a range of pages; the data is not
+  // returned but will (hopefully) be cached when |read_page| is called
+  virtual void prefetch(uint64_t address, size_t len) = 0;
+
   // Allocate storage for a page from this device; this function
   // can use mmap if available
   virtual void alloc_page(Page *page) = 0;
@@ -112,6 +116,21 @@ struct Device {
   // Removes unused space at the end of the file
   virtual void reclaim_space() = 0;
 
+  // Releases the disk space of a range of free pages; returns false if
+  // this is not supported
+  virtual bool punch_hole(uint64_t address, size_t len) = 0;
+
+  // Allocates disk space for a range of pages which was released with
+  // |punch_hole|, before the pages are reused
+  virtual void fill_hole(uint64_t address, size_t len) = 0;
+
+  // A clean page is evicted from the cache; a tiered device can move
+  // the page to slower storage
+  virtual void demote_page(Page *page) = 0;
+
+  // Fills in the current metrics
+  virtual void fill_metrics(ups_env_metrics_t *metrics) const = 0;
+
   // the Environment configuration settings
   const EnvConfig &config;
 };
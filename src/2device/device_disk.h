@@ -28,6 +28,8 @@
 #ifndef UPS_DEVICE_DISK_H
 #define UPS_DEVICE_DISK_H
 
+#include <algorithm>
+#include <limits>
 #include <utility>
 
 #include "0root/root.h"
@@ -69,6 +71,10 @@ class DiskDevice : public Device {
       // the size of mmapptr as used in mmap
       uint64_t mapped_size;
 
+      // the size of the reserved address space if the file is mapped
+      // with MAP_SHARED; 0 otherwise
+      uint64_t reserved_size;
+
       // the (cached) size of the file
       uint64_t file_size;
 
@@ -88,6 +94,7 @@ class DiskDevice : public Device {
       State state;
       state.mmapptr = 0;
       state.mapped_size = 0;
+      state.reserved_size = 0;
       state.file_size = 0;
       state.excess_at_end = 0;
       swap(m_state, state);
@@ -101,6 +108,10 @@ class DiskDevice : public Device {
       file.create(config.filename.c_str(), config.file_mode);
       file.set_posix_advice(config.posix_advice);
       m_state.file = std::move(file);
+
+      // the shared mapping grows with the file
+      if (use_shared_mapping())
+        reserve_nolock(m_state);
     }
 
     // opens an existing device
@@ -123,6 +134,21 @@ class DiskDevice : public Device {
         return;
       }
 
+      // map the file with MAP_SHARED; falls back to a private mapping if
+      // this fails
+      if (use_shared_mapping() && reserve_nolock(state)) {
+        try {
+          remap_nolock(state, state.file_size);
+        }
+        catch (Exception &ex) {
+          ups_log(("mmap failed with error %d, falling back to read/write",
+                      ex.code));
+          unmap_nolock(state);
+        }
+        swap(m_state, state);
+        return;
+      }
+
       // make sure we do not exceed the "real" size of the file, otherwise
       // we crash when accessing memory which exceeds the mapping (at least
       // on Win32)
@@ -153,8 +179,7 @@ class DiskDevice : public Device {
     virtual void close() {
       ScopedSpinlock lock(m_mutex);
       State state = std::move(m_state);
-      if (state.mmapptr)
-        state.file.munmap(state.mmapptr, state.mapped_size);
+      unmap_nolock(state);
       state.file.close();
 
       swap(m_state, state);
@@ -163,6 +188,9 @@ class DiskDevice : public Device {
     // flushes the device
     virtual void flush() {
       ScopedSpinlock lock(m_mutex);
+      // pages in the shared mapping are not written with pwrite()
+      if (m_state.reserved_size && m_state.mapped_size)
+        File::msync(m_state.mmapptr, (size_t)m_state.mapped_size);
       m_state.file.flush();
     }
 
@@ -220,6 +248,9 @@ class DiskDevice : public Device {
         return;
       }
 #endif
+      // the page is in the shared mapping and therefore already modified
+      if (m_state.reserved_size && m_state.mmapptr + offset == buffer)
+        return;
       m_state.file.pwrite(offset, buffer, len);
     }
 
@@ -258,8 +289,10 @@ class DiskDevice : public Device {
             excess = requested_length * 1000;
         }
 
+        // the excess storage is preallocated with fallocate(); this is
+        // cheaper than allocating the blocks when the pages are written
         address = m_state.file_size;
-        truncate_nolock(address + requested_length + excess);
+        allocate_nolock(address, requested_length + excess);
         m_state.excess_at_end = excess;
       }
       return address;
@@ -271,7 +304,8 @@ class DiskDevice : public Device {
       ScopedSpinlock lock(m_mutex);
       // if this page is in the mapped area: return a pointer into that area.
       // otherwise fall back to read/write.
-      if (address < m_state.mapped_size && m_state.mmapptr != 0) {
+      if (address + config.page_size_bytes <= m_state.mapped_size
+              && m_state.mmapptr != 0) {
         // the following line will not throw a C++ exception, but can
         // raise a signal. If that's the case then we don't catch it because
         // something is seriously wrong and proper recovery is not possible.
@@ -298,12 +332,33 @@ class DiskDevice : public Device {
 #endif
     }
 
+    // Schedules an asynchronous read of a range of pages
+    virtual void prefetch(uint64_t address, size_t len) {
+      ScopedSpinlock lock(m_mutex);
+      if (address >= m_state.file_size)
+        return;
+      if (address + len > m_state.file_size)
+        len = (size_t)(m_state.file_size - address);
+      m_state.file.prefetch(address, len);
+    }
+
     // Allocates storage for a page from this device; this function
-    // will *NOT* return mmapped memory
+    // only returns mmapped memory if the file is mapped with MAP_SHARED
     virtual void alloc_page(Page *page) {
       uint64_t address = alloc(config.page_size_bytes);
       page->set_address(address);
 
+      // pages in the shared mapping are modified in place; the mapping
+      // must not be stale if the page is read directly from the mapping
+      {
+        ScopedSpinlock lock(m_mutex);
+        if (m_state.reserved_size
+              && address + config.page_size_bytes <= m_state.mapped_size) {
+          page->assign_mapped_buffer(&m_state.mmapptr[address], address);
+          return;
+        }
+      }
+
       // allocate a memory buffer
       uint8_t *p = Memory::allocate<uint8_t>(config.page_size_bytes);
       page->assign_allocated_buffer(p, address);
@@ -330,6 +385,29 @@ class DiskDevice : public Device {
       }
     }
 
+    // Releases the disk space of a range of free pages
+    virtual bool punch_hole(uint64_t address, size_t len) {
+      ScopedSpinlock lock(m_mutex);
+      assert(address + len <= m_state.file_size);
+      return m_state.file.punch_hole(address, len);
+    }
+
+    // Allocates disk space for a range of pages which was released with
+    // |punch_hole|
+    virtual void fill_hole(uint64_t address, size_t len) {
+      ScopedSpinlock lock(m_mutex);
+      assert(address + len <= m_state.file_size);
+      m_state.file.allocate(address, len);
+    }
+
+    // Moves an evicted page to slower storage; not supported
+    virtual void demote_page(Page *page) {
+    }
+
+    // Fills in the current metrics; nothing to do
+    virtual void fill_metrics(ups_env_metrics_t *metrics) const {
+    }
+
     // Returns a pointer directly into mapped memory
     uint8_t *mapped_pointer(uint64_t address) const {
       return &m_state.mmapptr[address];
@@ -340,8 +418,88 @@ class DiskDevice : public Device {
     void truncate_nolock(uint64_t new_file_size) {
       if (new_file_size > config.file_size_limit_bytes)
         throw Exception(UPS_LIMITS_REACHED);
+      // shrink the mapping before the file, otherwise the truncated
+      // range would be mapped beyond the end of the file
+      if (new_file_size < m_state.file_size)
+        remap_nolock(m_state, new_file_size);
       m_state.file.truncate(new_file_size);
       m_state.file_size = new_file_size;
+      remap_nolock(m_state, new_file_size);
+    }
+
+    // grows the device and allocates the disk space, sans locking
+    void allocate_nolock(uint64_t address, uint64_t len) {
+      if (address + len > config.file_size_limit_bytes)
+        throw Exception(UPS_LIMITS_REACHED);
+      m_state.file.allocate(address, len);
+      m_state.file_size = address + len;
+      remap_nolock(m_state, m_state.file_size);
+    }
+
+    // Returns true if the file is mapped with MAP_SHARED. The modified
+    // pages can then reach the file before the journal, therefore this
+    // is not possible if recovery is enabled. The pages must not straddle
+    // the end of the mapping.
+    bool use_shared_mapping() const {
+      return config.mmap_reserve_size != 0
+              && config.page_size_bytes % File::granularity() == 0
+              && NOTSET(config.flags, UPS_DISABLE_MMAP)
+              && (NOTSET(config.flags, UPS_ENABLE_TRANSACTIONS)
+                    || ISSET(config.flags, UPS_DISABLE_RECOVERY));
+    }
+
+    // Reserves the address space for the shared mapping; returns false
+    // if this fails
+    bool reserve_nolock(State &state) {
+      size_t granularity = File::granularity();
+      uint64_t size = config.mmap_reserve_size;
+      size -= size % granularity;
+      if (size == 0 || size > std::numeric_limits<size_t>::max())
+        return false;
+
+      try {
+        File::mmap_reserve((size_t)size, &state.mmapptr);
+      }
+      catch (Exception &ex) {
+        ups_log(("mmap failed with error %d, falling back to read/write",
+                    ex.code));
+        return false;
+      }
+      state.reserved_size = size;
+      state.mapped_size = 0;
+      return true;
+    }
+
+    // Maps or releases parts of the reserved address space after the
+    // file size changed
+    void remap_nolock(State &state, uint64_t file_size) {
+      if (state.reserved_size == 0)
+        return;
+
+      size_t granularity = File::granularity();
+      uint64_t size = std::min(file_size, state.reserved_size);
+      size -= size % granularity;
+
+      if (size > state.mapped_size)
+        state.file.mmap_shared(state.mmapptr + state.mapped_size,
+                        state.mapped_size,
+                        (size_t)(size - state.mapped_size),
+                        ISSET(config.flags, UPS_READ_ONLY));
+      else if (size < state.mapped_size)
+        File::mmap_release(state.mmapptr + size,
+                        (size_t)(state.mapped_size - size));
+      state.mapped_size = size;
+    }
+
+    // Unmaps the file, sans locking
+    void unmap_nolock(State &state) {
+      if (state.mmapptr)
+        state.file.munmap(state.mmapptr, state.reserved_size
+                                          ? (size_t)state.reserved_size
+                                          : (size_t)state.mapped_size);
+      state.mmapptr = 0;
+      state.mapped_size = 0;
+      state.reserved_size = 0;
     }
 
     // For synchronizing access
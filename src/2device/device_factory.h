@@ -32,6 +32,7 @@
 #include "2config/env_config.h"
 #include "2device/device_disk.h"
 #include "2device/device_inmem.h"
+#include "2device/device_tiered.h"
 
 #ifndef UPS_ROOT_H
 #  error "root.h was not included"
@@ -44,8 +45,9 @@ struct DeviceFactory {
   static Device *create(const EnvConfig &config) {
     if (ISSET(config.flags, UPS_IN_MEMORY))
       return new InMemoryDevice(config);
-    else
-      return new DiskDevice(config);
+    if (TieredDevice::is_tiered(config))
+      return new TieredDevice(config);
+    return new DiskDevice(config);
   }
 };
 
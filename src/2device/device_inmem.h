@@ -152,6 +152,27 @@ struct InMemoryDevice : public Device {
   virtual void reclaim_space() {
   }
 
+  // Releases the disk space of a range of pages; not required
+  virtual bool punch_hole(uint64_t address, size_t len) {
+    return false;
+  }
+
+  // Allocates disk space for a range of pages; not required
+  virtual void fill_hole(uint64_t address, size_t len) {
+  }
+
+  // Schedules an asynchronous read of a range of pages; not required
+  virtual void prefetch(uint64_t address, size_t len) {
+  }
+
+  // Moves an evicted page to slower storage; not required
+  virtual void demote_page(Page *page) {
+  }
+
+  // Fills in the current metrics; nothing to do
+  virtual void fill_metrics(ups_env_metrics_t *metrics) const {
+  }
+
   // releases a chunk of memory previously allocated with alloc()
   void release(void *ptr, size_t size) {
     Memory::release(ptr);
@@ -0,0 +1,609 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * A disk-based device with two tiers. The Environment file is the fast
+ * tier. Clean blob pages which are evicted from the cache are moved to a
+ * second file (the capacity tier), and their disk space in the fast tier
+ * is released. A page is moved back to the fast tier if it is overwritten
+ * or if it is read repeatedly. Index pages always stay in the fast tier.
+ *
+ * The page addresses do not change. The pages of the capacity tier are
+ * tracked in a page map ("<filename>.tier"), which stores the path of the
+ * capacity tier and one page address per slot of the capacity tier.
+ *
+ * The page map never refers to a slot before the slot was written and
+ * flushed. The entries of pages which move back to the fast tier are
+ * cleared after the fast tier was flushed; till then the slot is not
+ * reused. They are also cleared before new entries are written, because
+ * a page can be moved to the capacity tier again, and after a crash the
+ * page map must not store two slots for the same page.
+ *
+ * @exception_safe: basic/strong
+ * @thread_safe: no
+ */
+
+#ifndef UPS_DEVICE_TIERED_H
+#define UPS_DEVICE_TIERED_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "0root/root.h"
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/error.h"
+#include "1mem/mem.h"
+#include "1os/file.h"
+#include "2device/device_disk.h"
+#include "2page/page.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+#include "1base/packstart.h"
+
+/*
+ * The persistent header of the page map; followed by the path of the
+ * capacity tier and the slot directory
+ */
+typedef UPS_PACK_0 struct UPS_PACK_1 PTierMapHeader {
+  // the magic
+  uint32_t magic;
+
+  // the length of the path of the capacity tier
+  uint32_t filename_length;
+
+  // the offset of the slot directory; each slot stores the address of
+  // its page, or 0 if the slot is free
+  uint64_t directory_offset;
+} UPS_PACK_2 PTierMapHeader;
+
+#include "1base/packstop.h"
+
+/*
+ * a File-based device with a capacity tier
+ */
+class TieredDevice : public DiskDevice {
+    // A page in the capacity tier
+    struct ColdPage {
+      ColdPage(uint64_t slot_ = 0)
+        : slot(slot_), reads(0) {
+      }
+
+      // the slot in the capacity tier
+      uint64_t slot;
+
+      // number of reads since the page was demoted
+      uint32_t reads;
+    };
+
+    typedef std::map<uint64_t, ColdPage> PageMap;
+
+  public:
+    enum {
+      // the magic of the page map ("TIER")
+      kMagic = 0x52454954,
+
+      // evicted pages are moved to the capacity tier in batches
+      kDemoteBatchSize = 64,
+
+      // a page moves back to the fast tier after this many reads
+      kPromoteThreshold = 3
+    };
+
+    TieredDevice(const EnvConfig &config)
+      : DiskDevice(config), cold_filename(config.cold_tier_filename),
+        directory_offset(0), slot_count(0), page_count_demoted(0),
+        page_count_promoted(0) {
+    }
+
+    // Returns the path of the page map
+    static std::string map_filename(const EnvConfig &config) {
+      return config.filename + ".tier";
+    }
+
+    // Returns true if the Environment has a capacity tier; the page map
+    // is also loaded if the path of the capacity tier was not specified
+    static bool is_tiered(const EnvConfig &config) {
+      return !config.cold_tier_filename.empty()
+              || File::exists(map_filename(config).c_str());
+    }
+
+    // Create a new device
+    virtual void create() {
+      check_config();
+      DiskDevice::create();
+
+      ScopedSpinlock lock(tier_mutex);
+      // a stale page map would be loaded when the file is opened
+      if (cold_filename.empty())
+        File::remove(map_filename(config).c_str());
+      else
+        create_tier_nolock();
+    }
+
+    // Opens an existing device; the capacity tier is created if the
+    // Environment did not yet have one
+    virtual void open() {
+      check_config();
+      DiskDevice::open();
+
+      ScopedSpinlock lock(tier_mutex);
+      if (File::exists(map_filename(config).c_str()))
+        open_tier_nolock();
+      else if (!cold_filename.empty() && NOTSET(config.flags, UPS_READ_ONLY))
+        create_tier_nolock();
+    }
+
+    // Closes the device
+    virtual void close() {
+      {
+        ScopedSpinlock lock(tier_mutex);
+        if (map_file.is_open()) {
+          if (NOTSET(config.flags, UPS_READ_ONLY))
+            flush_nolock();
+          cold_file.close();
+          map_file.close();
+        }
+        page_map.clear();
+        free_slots.clear();
+        pending_clears.clear();
+        pending_demotions.clear();
+        slot_count = 0;
+      }
+      DiskDevice::close();
+    }
+
+    // Flushes the device
+    virtual void flush() {
+      ScopedSpinlock lock(tier_mutex);
+      if (map_file.is_open() && NOTSET(config.flags, UPS_READ_ONLY))
+        flush_nolock();
+      else
+        DiskDevice::flush();
+    }
+
+    // Truncate/resize the device
+    virtual void truncate(uint64_t new_file_size) {
+      ScopedSpinlock lock(tier_mutex);
+      release_range_nolock(new_file_size, std::numeric_limits<uint64_t>::max());
+      DiskDevice::truncate(new_file_size);
+    }
+
+    // Reads from the device; the range can span both tiers
+    virtual void read(uint64_t offset, void *buffer, size_t len) {
+      ScopedSpinlock lock(tier_mutex);
+      size_t page_size = config.page_size_bytes;
+      uint8_t *p = (uint8_t *)buffer;
+      uint64_t end = offset + len;
+
+      PageMap::iterator it = page_map.lower_bound(offset - offset % page_size);
+      while (offset < end) {
+        // the remaining range is in the fast tier
+        if (it == page_map.end() || it->first >= end) {
+          DiskDevice::read(offset, p, (size_t)(end - offset));
+          return;
+        }
+
+        // read the fast pages in front of the next cold page
+        if (it->first > offset) {
+          size_t size = (size_t)(it->first - offset);
+          DiskDevice::read(offset, p, size);
+          offset += size;
+          p += size;
+        }
+
+        size_t size = (size_t)(std::min(end, it->first + page_size) - offset);
+        cold_file.pread(slot_offset(it->second.slot) + (offset - it->first),
+                        p, size);
+        offset += size;
+        p += size;
+        ++it;
+      }
+    }
+
+    // Writes to the device; overwriting a whole page moves it back to
+    // the fast tier
+    virtual void write(uint64_t offset, void *buffer, size_t len) {
+      ScopedSpinlock lock(tier_mutex);
+      size_t page_size = config.page_size_bytes;
+      uint8_t *p = (uint8_t *)buffer;
+      uint64_t end = offset + len;
+
+      // a pending demotion of these pages is stale
+      if (!pending_demotions.empty())
+        pending_demotions.erase(
+                pending_demotions.lower_bound(offset - offset % page_size),
+                pending_demotions.lower_bound(end));
+
+      PageMap::iterator it = page_map.lower_bound(offset - offset % page_size);
+      while (offset < end) {
+        // the remaining range is in the fast tier
+        if (it == page_map.end() || it->first >= end) {
+          DiskDevice::write(offset, p, (size_t)(end - offset));
+          return;
+        }
+
+        // write the fast pages in front of the next cold page
+        if (it->first > offset) {
+          size_t size = (size_t)(it->first - offset);
+          DiskDevice::write(offset, p, size);
+          offset += size;
+          p += size;
+        }
+
+        size_t size = (size_t)(std::min(end, it->first + page_size) - offset);
+        PageMap::iterator next = it;
+        ++next;
+        if (size == page_size)
+          promote_nolock(it, p);
+        else
+          cold_file.pwrite(slot_offset(it->second.slot) + (offset - it->first),
+                          p, size);
+        offset += size;
+        p += size;
+        it = next;
+      }
+    }
+
+    // Reads a page from the device; the pages are always copied to a
+    // buffer, because the fast tier has holes where the cold pages are
+    virtual void read_page(Page *page, uint64_t address) {
+      ScopedSpinlock lock(tier_mutex);
+      size_t page_size = config.page_size_bytes;
+
+      if (page->data() == 0) {
+        uint8_t *p = Memory::allocate<uint8_t>(page_size);
+        page->assign_allocated_buffer(p, address);
+      }
+
+      PageMap::iterator it = page_map.find(address);
+      if (it == page_map.end()) {
+        DiskDevice::read(address, page->data(), page_size);
+        return;
+      }
+
+      cold_file.pread(slot_offset(it->second.slot), page->data(), page_size);
+      if (++it->second.reads >= kPromoteThreshold
+              && NOTSET(config.flags, UPS_READ_ONLY))
+        promote_nolock(it, page->data());
+    }
+
+    // Allocates storage for a page from this device; never returns
+    // mmapped memory
+    virtual void alloc_page(Page *page) {
+      uint64_t address = alloc(config.page_size_bytes);
+      uint8_t *p = Memory::allocate<uint8_t>(config.page_size_bytes);
+      page->assign_allocated_buffer(p, address);
+    }
+
+    // Returns true if the specified range is in mapped memory; the pages
+    // are never read from the mapping
+    virtual bool is_mapped(uint64_t file_offset, size_t size) const {
+      return false;
+    }
+
+    // Removes unused space at the end of the file
+    virtual void reclaim_space() {
+      ScopedSpinlock lock(tier_mutex);
+      DiskDevice::reclaim_space();
+      release_range_nolock(DiskDevice::file_size(),
+                      std::numeric_limits<uint64_t>::max());
+    }
+
+    // Releases the disk space of a range of free pages in both tiers
+    virtual bool punch_hole(uint64_t address, size_t len) {
+      ScopedSpinlock lock(tier_mutex);
+      release_range_nolock(address, address + len);
+      return DiskDevice::punch_hole(address, len);
+    }
+
+    // Moves an evicted page to the capacity tier. Only blob pages are
+    // moved; the index pages are accessed far more often.
+    virtual void demote_page(Page *page) {
+      ScopedSpinlock lock(tier_mutex);
+      if (!map_file.is_open() || ISSET(config.flags, UPS_READ_ONLY))
+        return;
+
+      uint64_t address = page->address();
+      if (address == 0 || page_map.find(address) != page_map.end())
+        return;
+
+      uint8_t *data = (uint8_t *)page->data();
+      pending_demotions[address].assign(data, data + config.page_size_bytes);
+      if (pending_demotions.size() >= kDemoteBatchSize)
+        demote_nolock();
+    }
+
+    // Fills in the current metrics
+    virtual void fill_metrics(ups_env_metrics_t *metrics) const {
+      ScopedSpinlock lock(tier_mutex);
+      metrics->page_count_demoted = page_count_demoted;
+      metrics->page_count_promoted = page_count_promoted;
+      metrics->page_count_cold = page_map.size();
+    }
+
+    // Returns true if a page is stored in the capacity tier
+    bool is_cold(uint64_t address) {
+      ScopedSpinlock lock(tier_mutex);
+      return page_map.find(address) != page_map.end();
+    }
+
+  private:
+    // The pages are encrypted with their address, which does not
+    // work for the capacity tier
+    void check_config() const {
+      if (config.is_encryption_enabled) {
+        ups_trace(("combination of AES encryption and a capacity tier "
+                "not allowed"));
+        throw Exception(UPS_INV_PARAMETER);
+      }
+    }
+
+    // Returns the file offset of a slot in the capacity tier
+    uint64_t slot_offset(uint64_t slot) const {
+      return slot * config.page_size_bytes;
+    }
+
+    // Creates the capacity tier and an empty page map
+    void create_tier_nolock() {
+      PTierMapHeader header;
+      header.magic = kMagic;
+      header.filename_length = (uint32_t)cold_filename.size();
+      header.directory_offset = (sizeof(header) + cold_filename.size() + 7)
+                                    & ~(uint64_t)7;
+
+      std::vector<uint8_t> buffer((size_t)header.directory_offset);
+      ::memcpy(&buffer[0], &header, sizeof(header));
+      ::memcpy(&buffer[sizeof(header)], cold_filename.data(),
+                      cold_filename.size());
+
+      File cold;
+      cold.create(cold_filename.c_str(), config.file_mode);
+      File file;
+      file.create(map_filename(config).c_str(), config.file_mode);
+      file.pwrite(0, &buffer[0], buffer.size());
+      file.flush();
+
+      cold_file = std::move(cold);
+      map_file = std::move(file);
+      directory_offset = header.directory_offset;
+      slot_count = 0;
+    }
+
+    // Opens the capacity tier and loads the page map
+    void open_tier_nolock() {
+      bool read_only = ISSET(config.flags, UPS_READ_ONLY);
+      std::string path = map_filename(config);
+
+      File file;
+      file.open(path.c_str(), read_only);
+
+      PTierMapHeader header;
+      uint64_t size = file.file_size();
+      if (size >= sizeof(header))
+        file.pread(0, &header, sizeof(header));
+      if (size < sizeof(header)
+              || header.magic != kMagic
+              || header.directory_offset > size
+              || header.directory_offset
+                    < sizeof(header) + header.filename_length) {
+        ups_log(("invalid page map %s", path.c_str()));
+        throw Exception(UPS_INV_FILE_HEADER);
+      }
+
+      // the parameter overrides the stored path, i.e. if the capacity
+      // tier was moved
+      if (cold_filename.empty() && header.filename_length > 0) {
+        std::vector<char> buffer(header.filename_length);
+        file.pread(sizeof(header), &buffer[0], buffer.size());
+        cold_filename.assign(buffer.begin(), buffer.end());
+      }
+
+      slot_count = (size - header.directory_offset) / sizeof(uint64_t);
+      std::vector<uint64_t> directory((size_t)slot_count);
+      if (slot_count > 0)
+        file.pread(header.directory_offset, &directory[0],
+                        directory.size() * sizeof(uint64_t));
+      for (uint64_t slot = 0; slot < slot_count; slot++) {
+        if (directory[slot] != 0)
+          page_map[directory[slot]] = ColdPage(slot);
+        else
+          free_slots.insert(slot);
+      }
+
+      File cold;
+      cold.open(cold_filename.c_str(), read_only);
+
+      cold_file = std::move(cold);
+      map_file = std::move(file);
+      directory_offset = header.directory_offset;
+    }
+
+    // Flushes both tiers and clears the directory entries of the pages
+    // which moved back to the fast tier
+    void flush_nolock() {
+      demote_nolock();
+      DiskDevice::flush();
+      cold_file.flush();
+      clear_slots_nolock();
+    }
+
+    // Clears the directory entries of the pages which moved back to the
+    // fast tier; the fast tier must have been flushed
+    void clear_slots_nolock() {
+      if (pending_clears.empty())
+        return;
+
+      uint64_t zero = 0;
+      for (std::set<uint64_t>::iterator it = pending_clears.begin();
+                      it != pending_clears.end(); ++it)
+        map_file.pwrite(directory_offset + *it * sizeof(uint64_t), &zero,
+                        sizeof(zero));
+      map_file.flush();
+      free_slots.insert(pending_clears.begin(), pending_clears.end());
+      pending_clears.clear();
+    }
+
+    // Returns a free slot of the capacity tier
+    uint64_t alloc_slot_nolock() {
+      if (free_slots.empty())
+        return slot_count++;
+      uint64_t slot = *free_slots.begin();
+      free_slots.erase(free_slots.begin());
+      return slot;
+    }
+
+    // Moves the pending pages to the capacity tier. The slots are
+    // flushed before the page map refers to them, and the disk space of
+    // the fast tier is released afterwards. This is only an optimization,
+    // therefore errors are not fatal.
+    void demote_nolock() {
+      if (pending_demotions.empty())
+        return;
+
+      size_t page_size = config.page_size_bytes;
+      std::vector<std::pair<uint64_t, uint64_t> > demoted;
+      demoted.reserve(pending_demotions.size());
+
+      try {
+        // a page which moved back to the fast tier is possibly demoted
+        // again; its previous entry must not survive a crash
+        if (!pending_clears.empty()) {
+          DiskDevice::flush();
+          clear_slots_nolock();
+        }
+
+        for (std::map<uint64_t, std::vector<uint8_t> >::iterator it
+                        = pending_demotions.begin();
+                        it != pending_demotions.end(); ++it) {
+          uint64_t slot = alloc_slot_nolock();
+          demoted.push_back(std::make_pair(it->first, slot));
+          cold_file.pwrite(slot_offset(slot), &it->second[0], page_size);
+        }
+        cold_file.flush();
+
+        for (size_t i = 0; i < demoted.size(); i++)
+          map_file.pwrite(directory_offset + demoted[i].second
+                                * sizeof(uint64_t),
+                          &demoted[i].first, sizeof(uint64_t));
+        map_file.flush();
+      }
+      catch (Exception &ex) {
+        ups_log(("moving pages to the capacity tier failed with error %d",
+                    ex.code));
+        // the directory entries were possibly written
+        for (size_t i = 0; i < demoted.size(); i++)
+          pending_clears.insert(demoted[i].second);
+        pending_demotions.clear();
+        return;
+      }
+
+      pending_demotions.clear();
+      for (size_t i = 0; i < demoted.size(); i++)
+        page_map[demoted[i].first] = ColdPage(demoted[i].second);
+      page_count_demoted += demoted.size();
+
+      // release the disk space in the fast tier; adjacent pages are
+      // released in one call
+      for (size_t i = 0; i < demoted.size(); ) {
+        size_t j = i + 1;
+        while (j < demoted.size()
+                && demoted[j].first == demoted[j - 1].first + page_size)
+          j++;
+        DiskDevice::punch_hole(demoted[i].first, (j - i) * page_size);
+        i = j;
+      }
+    }
+
+    // Moves a page back to the fast tier
+    void promote_nolock(PageMap::iterator it, const void *data) {
+      size_t page_size = config.page_size_bytes;
+      DiskDevice::fill_hole(it->first, page_size);
+      DiskDevice::write(it->first, (void *)data, page_size);
+      release_nolock(it);
+      page_count_promoted++;
+    }
+
+    // Removes a page from the capacity tier; the slot is reused after
+    // the directory entry was cleared
+    void release_nolock(PageMap::iterator it) {
+      pending_clears.insert(it->second.slot);
+      page_map.erase(it);
+    }
+
+    // Removes the pages in the range [begin, end) from the capacity tier
+    void release_range_nolock(uint64_t begin, uint64_t end) {
+      pending_demotions.erase(pending_demotions.lower_bound(begin),
+                      pending_demotions.lower_bound(end));
+
+      PageMap::iterator it = page_map.lower_bound(begin);
+      while (it != page_map.end() && it->first < end) {
+        PageMap::iterator next = it;
+        ++next;
+        release_nolock(it);
+        it = next;
+      }
+    }
+
+    // For synchronizing access; acquired before the lock of the DiskDevice
+    mutable Spinlock tier_mutex;
+
+    // the path of the capacity tier
+    std::string cold_filename;
+
+    // the capacity tier
+    File cold_file;
+
+    // the page map
+    File map_file;
+
+    // the offset of the slot directory in the page map
+    uint64_t directory_offset;
+
+    // the number of slots in the capacity tier
+    uint64_t slot_count;
+
+    // the pages in the capacity tier, indexed by address
+    PageMap page_map;
+
+    // the free slots of the capacity tier
+    std::set<uint64_t> free_slots;
+
+    // slots whose directory entries are cleared when the device is flushed
+    std::set<uint64_t> pending_clears;
+
+    // copies of evicted pages which are not yet moved to the capacity tier
+    std::map<uint64_t, std::vector<uint8_t> > pending_demotions;
+
+    // number of pages which were moved to the capacity tier
+    uint64_t page_count_demoted;
+
+    // number of pages which were moved back to the fast tier
+    uint64_t page_count_promoted;
+};
+
+} // namespace upscaledb
+
+#endif /* UPS_DEVICE_TIERED_H */
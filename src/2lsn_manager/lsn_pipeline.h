@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * An lsn-ordered commit pipeline
+ *
+ * A writer reserves a slot in a ring buffer, together with the lsn of its
+ * record. It then builds the record in this slot and publishes it. Several
+ * writers can build their records in parallel; the published records are
+ * nevertheless handed to the |Consumer| strictly in lsn order.
+ *
+ * There is no separate consumer thread. Whoever publishes a record also
+ * consumes all records which are ready, and waits till its own record
+ * was consumed (possibly by another writer). Errors of the consumer are
+ * returned to the writer of the failed record.
+ *
+ * @exception_safe: basic
+ * @thread_safe: yes
+ */
+
+#ifndef UPS_LSN_PIPELINE_H
+#define UPS_LSN_PIPELINE_H
+
+#include "0root/root.h"
+
+#include <boost/atomic.hpp>
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/dynamic_array.h"
+#include "1base/error.h"
+#include "1base/spinlock.h"
+#include "2lsn_manager/lsn_manager.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+// The reservation of a slot in the LsnPipeline
+struct LsnTicket {
+  LsnTicket()
+    : seq(0), lsn(0) {
+  }
+
+  // the position in the pipeline
+  uint64_t seq;
+
+  // the lsn of the record
+  uint64_t lsn;
+};
+
+// |Consumer| is called as consumer(lsn, record, flags) for each record;
+// |Record| requires a clear() method
+template<typename Consumer, typename Record = ByteArray>
+struct LsnPipeline
+{
+  enum {
+    // the number of slots in the ring buffer
+    kCapacity = 64
+  };
+
+  // Constructor
+  LsnPipeline(LsnManager *lsn_manager_, const Consumer &consumer_)
+    : lsn_manager(lsn_manager_), consumer(consumer_), head(0), tail(0) {
+    for (int i = 0; i < kCapacity; i++)
+      slots[i].state = kFree;
+  }
+
+  // Allocates the next lsn and reserves a slot for its record. Blocks
+  // while all slots are in use. Every reservation must be followed by
+  // publish() or cancel().
+  LsnTicket reserve() {
+    ScopedSpinlock lock(reserve_lock);
+
+    Slot &slot = slots[tail % kCapacity];
+    for (int k = 0; slot.state.load(boost::memory_order_acquire) != kFree;
+                    k++) {
+      if (!try_consume())
+        Spinlock::spin(k);
+    }
+
+    LsnTicket ticket;
+    ticket.seq = tail++;
+    ticket.lsn = lsn_manager->next();
+
+    slot.lsn = ticket.lsn;
+    slot.flags = 0;
+    slot.error = 0;
+    slot.state.store(kReserved, boost::memory_order_release);
+    return ticket;
+  }
+
+  // Returns the (empty) record of a reserved slot
+  Record &record(const LsnTicket &ticket) {
+    return slots[ticket.seq % kCapacity].record;
+  }
+
+  // Publishes a record, then consumes all records which are ready.
+  // Returns after the record of |ticket| was consumed. If the consumer
+  // failed on this record then its error is thrown.
+  void publish(const LsnTicket &ticket, uint32_t flags) {
+    Slot &slot = slots[ticket.seq % kCapacity];
+    slot.flags = flags;
+    slot.state.store(kPublished, boost::memory_order_release);
+
+    for (int k = 0; slot.state.load(boost::memory_order_acquire) != kConsumed;
+                    k++) {
+      if (!try_consume())
+        Spinlock::spin(k);
+    }
+
+    ups_status_t st = slot.error;
+    slot.state.store(kFree, boost::memory_order_release);
+    if (unlikely(st != 0))
+      throw Exception(st);
+  }
+
+  // Releases a reserved slot without a record. Does not wait for the
+  // preceding records.
+  void cancel(const LsnTicket &ticket) {
+    Slot &slot = slots[ticket.seq % kCapacity];
+    slot.state.store(kCancelled, boost::memory_order_release);
+    try_consume();
+  }
+
+  private:
+  enum {
+    kFree      = 0,
+    kReserved  = 1,
+    kPublished = 2,
+    kCancelled = 3,
+    kConsumed  = 4
+  };
+
+  // A slot of the ring buffer
+  struct Slot {
+    // kFree, kReserved, kPublished, kCancelled or kConsumed
+    boost::atomic<int> state;
+
+    // the lsn of the record
+    uint64_t lsn;
+
+    // user-defined flags of the record
+    uint32_t flags;
+
+    // the error of the consumer; returned to the publisher
+    ups_status_t error;
+
+    // the record
+    Record record;
+  };
+
+  // Consumes all consecutive published or cancelled records, unless
+  // another thread is already doing this. Returns false if the lock
+  // was not available.
+  bool try_consume() {
+    if (!consume_lock.try_lock())
+      return false;
+
+    while (true) {
+      uint64_t seq = head.load(boost::memory_order_relaxed);
+      Slot &slot = slots[seq % kCapacity];
+      int state = slot.state.load(boost::memory_order_acquire);
+
+      if (state == kPublished) {
+        try {
+          consumer(slot.lsn, slot.record, slot.flags);
+        }
+        catch (Exception &ex) {
+          slot.error = ex.code;
+        }
+        slot.record.clear();
+        // the publisher releases the slot when it picks up the result
+        slot.state.store(kConsumed, boost::memory_order_release);
+      }
+      else if (state == kCancelled) {
+        slot.record.clear();
+        slot.state.store(kFree, boost::memory_order_release);
+      }
+      else
+        break;
+
+      head.store(seq + 1, boost::memory_order_release);
+    }
+
+    consume_lock.unlock();
+    return true;
+  }
+
+  // the LsnManager which allocates the lsns
+  LsnManager *lsn_manager;
+
+  // receives the records in lsn order
+  Consumer consumer;
+
+  // the first slot which was not yet consumed; protected by |consume_lock|
+  boost::atomic<uint64_t> head;
+
+  // the next slot which is reserved; protected by |reserve_lock|
+  uint64_t tail;
+
+  // serializes the reservations
+  Spinlock reserve_lock;
+
+  // only one thread consumes the records at a time
+  Spinlock consume_lock;
+
+  // the ring buffer
+  Slot slots[kCapacity];
+};
+
+} // namespace upscaledb
+
+#endif /* UPS_LSN_PIPELINE_H */
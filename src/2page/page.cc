@@ -19,9 +19,9 @@
 #include "0root/root.h"
 
 #include <string.h>
-#include "3rdparty/murmurhash3/MurmurHash3.h"
 
 #include "1base/error.h"
+#include "1base/checksum.h"
 #include "1os/os.h"
 #include "2page/page.h"
 #include "2device/device.h"
@@ -82,10 +82,11 @@ Page::flush()
     // update crc32
     if (ISSET(device_->config.flags, UPS_ENABLE_CRC32)
         && likely(!persisted_data.is_without_header)) {
-      MurmurHash3_x86_32(persisted_data.raw_data->header.payload,
+      persisted_data.raw_data->header.crc32 = Checksum::compute(
+                         device_->config.checksum_algorithm,
+                         persisted_data.raw_data->header.payload,
                          persisted_data.size - (sizeof(PPageHeader) - 1),
-                         (uint32_t)persisted_data.address,
-                         &persisted_data.raw_data->header.crc32);
+                         (uint32_t)persisted_data.address);
     }
     device_->write(persisted_data.address, persisted_data.raw_data,
                     persisted_data.size);
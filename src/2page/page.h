@@ -84,13 +84,14 @@ class Page {
     struct PersistedData {
       PersistedData()
         : address(0), size(0), is_dirty(false), is_allocated(false),
-          is_without_header(false), raw_data(0) {
+          is_without_header(false), is_punched(false), raw_data(0) {
       }
 
       PersistedData(const PersistedData &other)
         : address(other.address), size(other.size), is_dirty(other.is_dirty),
           is_allocated(other.is_allocated),
-          is_without_header(other.is_without_header), raw_data(other.raw_data) {
+          is_without_header(other.is_without_header),
+          is_punched(other.is_punched), raw_data(other.raw_data) {
       }
 
       ~PersistedData() {
@@ -121,6 +122,10 @@ class Page {
       // True if page has no persistent header
       bool is_without_header;
 
+      // True if the page was reused after its storage was released with
+      // Device::punch_hole(); the journal then logs the full page image
+      bool is_punched;
+
       // the persistent data of this page
       PPageData *raw_data;
     };
@@ -301,6 +306,16 @@ class Page {
       persisted_data.is_without_header = is_without_header;
     }
 
+    // Returns true if the page was reused from a punched hole
+    bool is_punched() const {
+      return persisted_data.is_punched;
+    }
+
+    // Sets the flag whether the page was reused from a punched hole
+    void set_punched(bool is_punched) {
+      persisted_data.is_punched = is_punched;
+    }
+
     // Assign a buffer which was allocated with malloc()
     void assign_allocated_buffer(void *buffer, uint64_t address) {
       free_buffer();
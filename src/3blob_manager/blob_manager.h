@@ -27,9 +27,13 @@
 
 #include "0root/root.h"
 
+#include <string.h>
+#include <algorithm>
+
 #include "ups/upscaledb_int.h"
 
 // Always verify that a file of level N does not include headers > N!
+#include "1base/error.h"
 #include "1base/dynamic_array.h"
 #include "2page/page.h"
 
@@ -53,7 +57,14 @@ struct Context;
 UPS_PACK_0 struct UPS_PACK_1 PBlobHeader {
   enum {
     // Blob is compressed
-    kIsCompressed = 1
+    kIsCompressed = 1,
+
+    // The upper bits of |flags| store the number of additional references
+    // of a deduplicated blob; 0 if the blob is not shared
+    kRefCountShift = 8,
+
+    // The maximum number of additional references
+    kMaxRefCount = 0xffffff
   };
 
   PBlobHeader() {
@@ -66,11 +77,22 @@ UPS_PACK_0 struct UPS_PACK_1 PBlobHeader {
   return (PBlobHeader *)&page->raw_payload()[readstart];
   }
 
+  // Returns the number of additional references to this blob
+  uint32_t shared_count() const {
+    return flags >> kRefCountShift;
+  }
+
+  // Sets the number of additional references to this blob
+  void set_shared_count(uint32_t count) {
+    assert(count <= kMaxRefCount);
+    flags = (flags & ((1u << kRefCountShift) - 1)) | (count << kRefCountShift);
+  }
+
   // The blob id - which is the absolute address/offset of this
   // structure in the file
   uint64_t blob_id;
 
-  // Flags; store compression information
+  // Flags; store compression information and the reference count
   uint32_t flags;
 
   // The allocated size of the blob; this is the size, which is used
@@ -106,14 +128,20 @@ struct BlobManager {
   // the flags for ups_db_insert()
   enum {
     // Do not compress the blob, even if compression is enabled
-    kDisableCompression = 0x10000000
+    kDisableCompression = 0x10000000,
+
+    // The blob is a record of a leaf node and can be stored in the
+    // value log (see blob_manager_vlog.h), or it can be shared with
+    // identical records if UPS_ENABLE_DEDUPLICATION is set
+    kValueLog = 0x20000000
   };
 
   BlobManager(const EnvConfig *config_, PageManager *page_manager_,
                   Device *device_)
     : config(config_), page_manager(page_manager_), device(device_),
       metric_before_compression(0), metric_after_compression(0),
-      metric_total_allocated(0), metric_total_read(0) {
+      metric_total_allocated(0), metric_total_read(0),
+      metric_total_deduplicated(0) {
   }
 
   virtual ~BlobManager() { }
@@ -153,14 +181,102 @@ struct BlobManager {
   virtual void erase(Context *context, uint64_t blob_id, Page *page = 0,
                   uint32_t flags = 0) = 0;
 
+  // Reads |size| bytes of a blob, starting at |offset|, and stores them
+  // in |record|. The range is truncated at the end of the blob. Throws
+  // UPS_INV_PARAMETER if |offset| is beyond the end of the blob.
+  //
+  // The default implementation reads the full blob and copies the range.
+  virtual void read_range(Context *context, uint64_t blob_id,
+                  uint32_t offset, uint32_t size, ups_record_t *record,
+                  ByteArray *arena) {
+    ByteArray full_arena;
+    ups_record_t full = {0};
+    read(context, blob_id, &full, 0, &full_arena);
+
+    size = range_size(full.size, offset, size);
+    assign_range(record, (uint8_t *)full.data + offset, size, arena);
+  }
+
+  // Overwrites |record->size| bytes of a blob, starting at |offset|. The
+  // blob grows if the range exceeds its current size; |offset| must not
+  // be beyond the end of the blob. Returns the (possibly new) blob id.
+  //
+  // The default implementation reads the full blob, patches the range
+  // and calls overwrite().
+  virtual uint64_t overwrite_range(Context *context, uint64_t blob_id,
+                  uint32_t offset, ups_record_t *record, uint32_t flags) {
+    ByteArray full_arena;
+    ups_record_t full = {0};
+    read(context, blob_id, &full, UPS_FORCE_DEEP_COPY, &full_arena);
+
+    range_size(full.size, offset, 0);
+    uint32_t new_size = std::max(full.size, offset + record->size);
+    full_arena.resize(new_size);
+    ::memcpy(full_arena.data() + offset, record->data, record->size);
+
+    full.data = full_arena.data();
+    full.size = new_size;
+    return overwrite(context, blob_id, &full, flags);
+  }
+
+  // Returns the new blob id if the blob has to be moved (i.e. because
+  // the value log segment is garbage collected), otherwise returns
+  // |blob_id|. The caller has to store the new blob id.
+  virtual uint64_t relocate(Context *context, uint64_t blob_id) {
+    return blob_id;
+  }
+
+  // Starts a garbage collection run; returns false if there is nothing
+  // to collect. Afterwards the caller has to call relocate() for each
+  // record blob, then flush() and end_gc().
+  virtual bool begin_gc() {
+    return false;
+  }
+
+  // Completes a garbage collection run; the relocated blob ids must
+  // already be persisted
+  virtual void end_gc() {
+  }
+
+  // Flushes the data which is not stored in the Environment's file
+  virtual void flush() {
+  }
+
   // Fills in the current metrics
-  void fill_metrics(ups_env_metrics_t *metrics) const {
+  virtual void fill_metrics(ups_env_metrics_t *metrics) const {
     metrics->blob_total_allocated = metric_total_allocated;
     metrics->blob_total_read = metric_total_read;
+    metrics->blob_total_deduplicated = metric_total_deduplicated;
     metrics->record_bytes_before_compression = metric_before_compression;
     metrics->record_bytes_after_compression = metric_after_compression;
   }
 
+  // Returns the number of bytes of the range (|offset|, |size|) which are
+  // inside a blob of |blob_size| bytes
+  static uint32_t range_size(uint32_t blob_size, uint32_t offset,
+                  uint32_t size) {
+    if (unlikely(offset > blob_size))
+      throw Exception(UPS_INV_PARAMETER);
+    return std::min(size, blob_size - offset);
+  }
+
+  // Copies |size| bytes from |data| to the |record|; uses the |arena|
+  // unless the record's memory is allocated by the user
+  static void assign_range(ups_record_t *record, const uint8_t *data,
+                  uint32_t size, ByteArray *arena) {
+    record->size = size;
+    if (unlikely(size == 0)) {
+      if (NOTSET(record->flags, UPS_RECORD_USER_ALLOC))
+        record->data = 0;
+      return;
+    }
+    if (NOTSET(record->flags, UPS_RECORD_USER_ALLOC)) {
+      arena->resize(size);
+      record->data = arena->data();
+    }
+    ::memcpy(record->data, data, size);
+  }
+
   // The configuration of the Environment
   const EnvConfig *config;
 
@@ -181,6 +297,9 @@ struct BlobManager {
 
   // Usage tracking - number of blobs read
   uint64_t metric_total_read;
+
+  // Usage tracking - number of allocations which shared an existing blob
+  uint64_t metric_total_deduplicated;
 };
 
 } // namespace upscaledb
@@ -19,12 +19,12 @@
 #include "0root/root.h"
 
 #include <algorithm>
+#include <map>
 #include <vector>
 
-#include "3rdparty/murmurhash3/MurmurHash3.h"
-
 // Always verify that a file of level N does not include headers > N!
 #include "1base/error.h"
+#include "1base/checksum.h"
 #include "1base/dynamic_array.h"
 #include "2compressor/compressor.h"
 #include "2device/device_disk.h"
@@ -226,7 +226,9 @@ copy_chunk(DiskBlobManager *dbm, Context *context, Page *page, Page **ppage,
                 bool fetch_read_only)
 {
   uint32_t page_size = dbm->config->page_size_bytes;
-  bool first_page = true;
+  // only the page with the blob header has a persistent header; if the
+  // caller already passed this page then all other pages have none
+  bool first_page = (page == 0);
 
   while (size) {
     // get the page-id from this chunk
@@ -301,10 +303,66 @@ write_chunks(DiskBlobManager *dbm, Context *context, Page *page,
   }
 }
 
+// Looks up a blob with the same payload as |record| in the deduplication
+// index. If one is found then its reference count is incremented and its
+// id is returned; otherwise returns 0.
+static uint64_t
+share_blob(DiskBlobManager *dbm, Context *context, ups_record_t *record,
+                uint32_t hash)
+{
+  typedef std::multimap<uint32_t, uint64_t>::iterator Iterator;
+  std::pair<Iterator, Iterator> range = dbm->dedup_index.equal_range(hash);
+
+  for (; range.first != range.second; ++range.first) {
+    uint64_t blob_id = range.first->second;
+
+    Page *page;
+    PBlobHeader *blob_header = (PBlobHeader *)read_chunk(dbm, context, 0,
+                    &page, blob_id, false, false);
+    if (unlikely(blob_header->blob_id != blob_id))
+      continue;
+    if (blob_header->size != record->size
+          || blob_header->shared_count() == PBlobHeader::kMaxRefCount)
+      continue;
+
+    // the hash is only 32bit wide; compare the payloads
+    ByteArray arena;
+    ups_record_t existing = {0};
+    dbm->read(context, blob_id, &existing, UPS_FORCE_DEEP_COPY, &arena);
+    if (::memcmp(existing.data, record->data, record->size) != 0)
+      continue;
+
+    // read() might have fetched other pages; fetch the header again
+    blob_header = (PBlobHeader *)read_chunk(dbm, context, 0, &page,
+                    blob_id, false, false);
+    blob_header->set_shared_count(blob_header->shared_count() + 1);
+    page->set_dirty(true);
+    return blob_id;
+  }
+
+  return 0;
+}
+
 uint64_t
 DiskBlobManager::allocate(Context *context, ups_record_t *record,
                 uint32_t flags)
 {
+  // deduplication enabled? then try to share an existing blob with the
+  // same payload. The hash is identical to the CRC of multi-page blobs.
+  uint32_t hash = 0;
+  bool deduplicate = ISSET(config->flags, UPS_ENABLE_DEDUPLICATION)
+                        && ISSET(flags, kValueLog)
+                        && record->size > 0;
+  if (deduplicate) {
+    hash = Checksum::compute(config->checksum_algorithm,
+                    record->data, record->size);
+    uint64_t blob_id = share_blob(this, context, record, hash);
+    if (blob_id) {
+      metric_total_deduplicated++;
+      return blob_id;
+    }
+  }
+
   metric_total_allocated++;
 
   uint8_t *chunk_data[2];
@@ -375,8 +433,10 @@ DiskBlobManager::allocate(Context *context, ups_record_t *record,
     // multi-page blobs store their CRC in the first freelist offset
     if (unlikely(num_pages > 1
             && (config->flags & UPS_ENABLE_CRC32))) {
-      uint32_t crc32 = 0;
-      MurmurHash3_x86_32(record->data, record->size, 0, &crc32);
+      uint32_t crc32 = hash;
+      if (!deduplicate)
+        crc32 = Checksum::compute(config->checksum_algorithm,
+                        record->data, record->size);
       header->freelist[0].offset = crc32;
     }
 
@@ -413,6 +473,9 @@ DiskBlobManager::allocate(Context *context, ups_record_t *record,
   // store the blob_id; it will be returned to the caller
   uint64_t blob_id = blob_header.blob_id;
   assert(check_integrity(this, header));
+
+  if (deduplicate)
+    add_to_dedup_index(blob_id, hash);
   return blob_id;
 }
 
@@ -451,6 +514,10 @@ DiskBlobManager::read(Context *context, uint64_t blob_id,
         && NOTSET(record->flags, UPS_RECORD_USER_ALLOC)) {
     record->data = read_chunk(this, context, page, 0,
                         blob_id + sizeof(PBlobHeader), true, true);
+    // large blobs are read ahead; otherwise the pages are faulted in one
+    // at a time
+    if (blobsize > config->page_size_bytes)
+      device->prefetch(blob_id, blobsize + sizeof(PBlobHeader));
   }
   // otherwise resize the blob buffer and copy the blob data into the buffer
   else {
@@ -503,8 +570,8 @@ DiskBlobManager::read(Context *context, uint64_t blob_id,
   if (unlikely(header->num_pages > 1
         && ISSET(config->flags, UPS_ENABLE_CRC32))) {
     uint32_t old_crc32 = header->freelist[0].offset;
-    uint32_t new_crc32;
-    MurmurHash3_x86_32(record->data, record->size, 0, &new_crc32);
+    uint32_t new_crc32 = Checksum::compute(config->checksum_algorithm,
+                    record->data, record->size);
 
     if (unlikely(old_crc32 != new_crc32)) {
       ups_trace(("crc32 mismatch in page %lu: 0x%lx != 0x%lx",
@@ -554,6 +621,17 @@ DiskBlobManager::overwrite(Context *context, uint64_t old_blobid,
   if (unlikely(old_blob_header->blob_id != old_blobid))
     throw Exception(UPS_BLOB_NOT_FOUND);
 
+  // a shared blob is not modified; drop this reference and allocate
+  // a new blob
+  if (old_blob_header->shared_count() > 0) {
+    old_blob_header->set_shared_count(old_blob_header->shared_count() - 1);
+    page->set_dirty(true);
+    return allocate(context, record, flags);
+  }
+
+  // the payload is modified, therefore the blob can no longer be shared
+  remove_from_dedup_index(old_blobid);
+
   // now compare the sizes; does the new data fit in the old allocated
   // space?
   if (alloc_size <= old_blob_header->allocated_size) {
@@ -588,8 +666,8 @@ DiskBlobManager::overwrite(Context *context, uint64_t old_blobid,
     // multi-page blobs store their CRC in the first freelist offset
     if (unlikely(header->num_pages > 1
             && ISSET(config->flags, UPS_ENABLE_CRC32))) {
-      uint32_t crc32 = 0;
-      MurmurHash3_x86_32(record->data, record->size, 0, &crc32);
+      uint32_t crc32 = Checksum::compute(config->checksum_algorithm,
+                      record->data, record->size);
       header->freelist[0].offset = crc32;
     }
 
@@ -635,11 +713,15 @@ DiskBlobManager::overwrite_regions(Context *context, uint64_t old_blob_id,
   // only overwrite the regions if
   // - the blob does not grow
   // - blob is compressed
+  // - blob is shared
   if (alloc_size > blob_header->allocated_size
         || header->num_pages == 1
-        || ISSET(blob_header->flags, PBlobHeader::kIsCompressed))
+        || ISSET(blob_header->flags, PBlobHeader::kIsCompressed)
+        || blob_header->shared_count() > 0)
     return overwrite(context, old_blob_id, record, flags);
 
+  remove_from_dedup_index(old_blob_id);
+
   uint8_t *chunk_data[2];
   uint32_t chunk_size[2];
 
@@ -684,8 +766,8 @@ DiskBlobManager::overwrite_regions(Context *context, uint64_t old_blob_id,
   // multi-page blobs store their CRC in the first freelist offset
   if (unlikely(header->num_pages > 1
           && ISSET(config->flags, UPS_ENABLE_CRC32))) {
-    uint32_t crc32 = 0;
-    MurmurHash3_x86_32(record->data, record->size, 0, &crc32);
+    uint32_t crc32 = Checksum::compute(config->checksum_algorithm,
+                    record->data, record->size);
     header->freelist[0].offset = crc32;
     page->set_dirty(true);
   }
@@ -705,6 +787,15 @@ DiskBlobManager::erase(Context *context, uint64_t blob_id, Page *page,
   if (unlikely(blob_header->blob_id != blob_id))
     throw Exception(UPS_BLOB_NOT_FOUND);
 
+  // a shared blob is only deleted when the last reference is removed
+  if (blob_header->shared_count() > 0) {
+    blob_header->set_shared_count(blob_header->shared_count() - 1);
+    page->set_dirty(true);
+    return;
+  }
+
+  remove_from_dedup_index(blob_id);
+
   // update the "free bytes" counter in the blob page header
   PBlobPageHeader *header = PBlobPageHeader::from_page(page);
   header->free_bytes += blob_header->allocated_size;
@@ -723,3 +814,147 @@ DiskBlobManager::erase(Context *context, uint64_t blob_id, Page *page,
   add_to_freelist(this, header, (uint32_t)(blob_id - page->address()),
                   (uint32_t)blob_header->allocated_size);
 }
+
+void
+DiskBlobManager::read_range(Context *context, uint64_t blob_id,
+                uint32_t offset, uint32_t size, ups_record_t *record,
+                ByteArray *arena)
+{
+  // read the blob header
+  Page *page;
+  PBlobHeader *blob_header = (PBlobHeader *)read_chunk(this, context, 0, &page,
+                  blob_id, true, false);
+
+  // sanity check
+  if (unlikely(blob_header->blob_id != blob_id)) {
+    ups_log(("blob %lld not found", blob_id));
+    throw Exception(UPS_BLOB_NOT_FOUND);
+  }
+
+  // compressed blobs have to be uncompressed as a whole
+  if (ISSET(blob_header->flags, PBlobHeader::kIsCompressed)) {
+    BlobManager::read_range(context, blob_id, offset, size, record, arena);
+    return;
+  }
+
+  metric_total_read++;
+
+  size = range_size(blob_header->size, offset, size);
+  record->size = size;
+  if (unlikely(size == 0)) {
+    if (NOTSET(record->flags, UPS_RECORD_USER_ALLOC))
+      record->data = 0;
+    return;
+  }
+
+  if (NOTSET(record->flags, UPS_RECORD_USER_ALLOC)) {
+    arena->resize(size);
+    record->data = arena->data();
+  }
+
+  // only fetch the pages of the range. The CRC of multi-page blobs
+  // covers the whole blob and is therefore not verified.
+  copy_chunk(this, context, page, 0, blob_id + sizeof(PBlobHeader) + offset,
+                  (uint8_t *)record->data, size, true);
+}
+
+uint64_t
+DiskBlobManager::overwrite_range(Context *context, uint64_t blob_id,
+                uint32_t offset, ups_record_t *record, uint32_t flags)
+{
+  // read the blob header
+  Page *page;
+  PBlobHeader *blob_header = (PBlobHeader *)read_chunk(this, context, 0, &page,
+                  blob_id, false, false);
+
+  // sanity check
+  if (unlikely(blob_header->blob_id != blob_id)) {
+    ups_log(("blob %lld not found", blob_id));
+    throw Exception(UPS_BLOB_NOT_FOUND);
+  }
+
+  range_size(blob_header->size, offset, 0);
+
+  // compressed and shared blobs have to be rewritten as a whole
+  if (ISSET(blob_header->flags, PBlobHeader::kIsCompressed)
+        || blob_header->shared_count() > 0)
+    return BlobManager::overwrite_range(context, blob_id, offset, record,
+                    flags);
+
+  remove_from_dedup_index(blob_id);
+
+  PBlobPageHeader *header = PBlobPageHeader::from_page(page);
+  uint32_t old_size = blob_header->size;
+  uint32_t new_size = std::max(old_size, offset + record->size);
+
+  // a multi-page blob is the only blob in its pages; it can grow into
+  // the unused space of its last page
+  uint32_t capacity = blob_header->allocated_size;
+  if (header->num_pages > 1)
+    capacity += header->free_bytes;
+
+  // the blob does not fit into its pages? then move it to a new blob
+  // which leaves room for further growth; otherwise appending to a record
+  // chunk by chunk would copy the whole blob over and over
+  if (sizeof(PBlobHeader) + new_size > capacity) {
+    uint32_t new_capacity = new_size + new_size / 2;
+    ByteArray arena(new_capacity);
+    copy_chunk(this, context, page, 0, blob_id + sizeof(PBlobHeader),
+                    arena.data(), old_size, true);
+    ::memcpy(arena.data() + offset, record->data, record->size);
+    ::memset(arena.data() + new_size, 0, new_capacity - new_size);
+
+    ups_record_t tmp = {0};
+    tmp.data = arena.data();
+    tmp.size = new_capacity;
+    uint64_t new_blob_id = allocate(context, &tmp,
+                    (flags | kDisableCompression) & ~kValueLog);
+    erase(context, blob_id, 0, 0);
+
+    // the padding is part of the allocated size, but not of the record
+    blob_header = (PBlobHeader *)read_chunk(this, context, 0, &page,
+                    new_blob_id, false, false);
+    blob_header->size = new_size;
+    page->set_dirty(true);
+
+    header = PBlobPageHeader::from_page(page);
+    if (unlikely(header->num_pages > 1
+            && ISSET(config->flags, UPS_ENABLE_CRC32))) {
+      uint32_t crc32 = Checksum::compute(config->checksum_algorithm,
+                      arena.data(), new_size);
+      header->freelist[0].offset = crc32;
+    }
+    return new_blob_id;
+  }
+
+  // only write the pages which are modified
+  uint8_t *chunk_data[1] = {(uint8_t *)record->data};
+  uint32_t chunk_size[1] = {record->size};
+  write_chunks(this, context, page, blob_id + sizeof(PBlobHeader) + offset,
+                  chunk_data, chunk_size, 1);
+
+  if (new_size != old_size) {
+    uint32_t alloc_size = sizeof(PBlobHeader) + new_size;
+    if (alloc_size > blob_header->allocated_size) {
+      header->free_bytes -= alloc_size - blob_header->allocated_size;
+      blob_header->allocated_size = alloc_size;
+    }
+    blob_header->size = new_size;
+    page->set_dirty(true);
+  }
+
+  // multi-page blobs store their CRC in the first freelist offset; it
+  // covers the whole blob, which therefore has to be read
+  if (unlikely(header->num_pages > 1
+          && ISSET(config->flags, UPS_ENABLE_CRC32))) {
+    ByteArray arena(new_size);
+    copy_chunk(this, context, page, 0, blob_id + sizeof(PBlobHeader),
+                    arena.data(), new_size, true);
+    uint32_t crc32 = Checksum::compute(config->checksum_algorithm,
+                    arena.data(), new_size);
+    header->freelist[0].offset = crc32;
+    page->set_dirty(true);
+  }
+
+  return blob_id;
+}
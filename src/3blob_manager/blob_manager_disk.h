@@ -21,6 +21,8 @@
 
 #include "0root/root.h"
 
+#include <map>
+
 // Always verify that a file of level N does not include headers > N!
 #include "3blob_manager/blob_manager.h"
 
@@ -115,9 +117,54 @@ struct DiskBlobManager : public BlobManager
                   ups_record_t *record, uint32_t flags,
                   Region *regions, size_t num_regions);
 
-  // delete an existing blob
+  // Reads a range of a blob; only the pages of the range are fetched,
+  // unless the blob is compressed
+  virtual void read_range(Context *context, uint64_t blob_id,
+                  uint32_t offset, uint32_t size, ups_record_t *record,
+                  ByteArray *arena);
+
+  // Overwrites a range of a blob; only the modified pages are written,
+  // unless the blob is compressed or has to be moved because it grows
+  virtual uint64_t overwrite_range(Context *context, uint64_t blob_id,
+                  uint32_t offset, ups_record_t *record, uint32_t flags);
+
+  // delete an existing blob; a shared blob is only deleted when its
+  // last reference is removed
   virtual void erase(Context *context, uint64_t blobid,
                   Page *page = 0, uint32_t flags = 0);
+
+  // Registers a blob in the deduplication index
+  void add_to_dedup_index(uint64_t blob_id, uint32_t hash) {
+    dedup_index.insert(std::make_pair(hash, blob_id));
+    dedup_hashes[blob_id] = hash;
+  }
+
+  // Removes a blob from the deduplication index, i.e. because it is
+  // deleted or modified
+  void remove_from_dedup_index(uint64_t blob_id) {
+    std::map<uint64_t, uint32_t>::iterator it = dedup_hashes.find(blob_id);
+    if (it == dedup_hashes.end())
+      return;
+    std::pair<std::multimap<uint32_t, uint64_t>::iterator,
+              std::multimap<uint32_t, uint64_t>::iterator> range
+            = dedup_index.equal_range(it->second);
+    for (; range.first != range.second; ++range.first) {
+      if (range.first->second == blob_id) {
+        dedup_index.erase(range.first);
+        break;
+      }
+    }
+    dedup_hashes.erase(it);
+  }
+
+  // The deduplication index (UPS_ENABLE_DEDUPLICATION); maps the hash of
+  // a record to the ids of the blobs with this hash. The index is not
+  // persisted; after reopening the Environment only new blobs are shared.
+  // The reference counts are stored in the blob headers.
+  std::multimap<uint32_t, uint64_t> dedup_index;
+
+  // Maps the blob ids of the |dedup_index| to their hash
+  std::map<uint64_t, uint32_t> dedup_hashes;
 };
 
 } // namespace upscaledb
@@ -24,6 +24,7 @@
 // Always verify that a file of level N does not include headers > N!
 #include "3blob_manager/blob_manager_disk.h"
 #include "3blob_manager/blob_manager_inmem.h"
+#include "3blob_manager/blob_manager_vlog.h"
 #include "4env/env_local.h"
 
 #ifndef UPS_ROOT_H
@@ -33,13 +34,16 @@
 namespace upscaledb {
 
 struct BlobManagerFactory {
-  // creates a new BlobManager instance depending on the flags
-  static BlobManager *create(LocalEnv *env, uint32_t flags) {
+  // creates a new BlobManager instance depending on the flags; |is_new|
+  // is true if the Environment is created
+  static BlobManager *create(LocalEnv *env, uint32_t flags, bool is_new) {
     if (flags & UPS_IN_MEMORY)
       return (new InMemoryBlobManager(&env->config, env->page_manager.get(),
                               env->device.get()));
-    else
-      return (new DiskBlobManager(&env->config, env->page_manager.get(),
+    if (env->config.value_log_threshold > 0)
+      return (new ValueLogBlobManager(&env->config, env->page_manager.get(),
+                              env->device.get(), is_new));
+    return (new DiskBlobManager(&env->config, env->page_manager.get(),
                               env->device.get()));
   }
 };
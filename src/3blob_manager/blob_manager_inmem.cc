@@ -153,3 +153,39 @@ InMemoryBlobManager::overwrite_regions(Context *context, uint64_t old_blob_id,
   (void)num_regions;
   return overwrite(context, old_blob_id, record, flags);
 }
+
+void
+InMemoryBlobManager::read_range(Context *context, uint64_t blobid,
+                uint32_t offset, uint32_t size, ups_record_t *record,
+                ByteArray *arena)
+{
+  PBlobHeader *blob_header = (PBlobHeader *)blobid;
+  if (ISSET(blob_header->flags, PBlobHeader::kIsCompressed)) {
+    BlobManager::read_range(context, blobid, offset, size, record, arena);
+    return;
+  }
+
+  metric_total_read++;
+
+  size = range_size(blob_header->size, offset, size);
+  assign_range(record, (uint8_t *)blobid + sizeof(PBlobHeader) + offset,
+                  size, arena);
+}
+
+uint64_t
+InMemoryBlobManager::overwrite_range(Context *context, uint64_t blobid,
+                uint32_t offset, ups_record_t *record, uint32_t flags)
+{
+  PBlobHeader *blob_header = (PBlobHeader *)blobid;
+  range_size(blob_header->size, offset, 0);
+
+  // the blob grows, or it is compressed? then rewrite it
+  if (offset + record->size > blob_header->size
+        || ISSET(blob_header->flags, PBlobHeader::kIsCompressed))
+    return BlobManager::overwrite_range(context, blobid, offset, record,
+                    flags);
+
+  ::memmove((uint8_t *)blobid + sizeof(PBlobHeader) + offset, record->data,
+                  record->size);
+  return blobid;
+}
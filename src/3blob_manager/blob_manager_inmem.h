@@ -71,6 +71,17 @@ struct InMemoryBlobManager : public BlobManager {
                   ups_record_t *record, uint32_t flags,
                   Region *regions, size_t num_regions);
 
+  // Reads a range of a blob; uncompressed blobs are sliced without
+  // copying the whole blob
+  virtual void read_range(Context *context, uint64_t blobid,
+                  uint32_t offset, uint32_t size, ups_record_t *record,
+                  ByteArray *arena);
+
+  // Overwrites a range of a blob; uncompressed blobs are modified in place
+  // if the range fits into the blob
+  virtual uint64_t overwrite_range(Context *context, uint64_t blobid,
+                  uint32_t offset, ups_record_t *record, uint32_t flags);
+
   // Deletes an existing blob
   virtual void erase(Context *context, uint64_t blobid, Page *page = 0,
                   uint32_t flags = 0) {
@@ -0,0 +1,582 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+#include "0root/root.h"
+
+#include <stdio.h>
+#include <utility>
+#include <vector>
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/error.h"
+#include "1base/dynamic_array.h"
+#include "2compressor/compressor.h"
+#include "2config/env_config.h"
+#include "3blob_manager/blob_manager_vlog.h"
+#include "4context/context.h"
+#include "4db/db_local.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+using namespace upscaledb;
+
+#include "1base/packstart.h"
+
+// The header of the manifest file; followed by one PValueLogManifestEntry
+// per segment
+UPS_PACK_0 struct UPS_PACK_1 PValueLogManifest
+{
+  enum {
+    // magic value; used for error checking
+    kMagic = 0x766d6e66
+  };
+
+  // always kMagic
+  uint32_t magic;
+
+  // the number of the current segment
+  uint32_t head;
+
+  // the number of segments
+  uint32_t count;
+
+  // reserved
+  uint32_t _reserved;
+} UPS_PACK_2;
+
+// A segment in the manifest file
+UPS_PACK_0 struct UPS_PACK_1 PValueLogManifestEntry
+{
+  // the number of the segment
+  uint32_t segment;
+
+  // reserved
+  uint32_t _reserved;
+
+  // number of dead bytes in this segment
+  uint64_t dead_bytes;
+} UPS_PACK_2;
+
+#include "1base/packstop.h"
+
+static inline std::string
+manifest_filename(const EnvConfig *config)
+{
+  return config->filename + ".vlog";
+}
+
+static inline std::string
+segment_filename(const EnvConfig *config, uint32_t segment)
+{
+  char buffer[32];
+  ::snprintf(buffer, sizeof(buffer), ".vlog.%u", segment);
+  return config->filename + buffer;
+}
+
+static inline uint64_t
+make_blob_id(uint32_t segment, uint64_t offset)
+{
+  return (1ull << ValueLogBlobManager::kValueLogBit)
+          | ((uint64_t)segment << ValueLogBlobManager::kSegmentShift)
+          | offset;
+}
+
+static inline uint32_t
+segment_of(uint64_t blob_id)
+{
+  return (uint32_t)((blob_id & ~(1ull << ValueLogBlobManager::kValueLogBit))
+                  >> ValueLogBlobManager::kSegmentShift);
+}
+
+static inline uint64_t
+offset_of(uint64_t blob_id)
+{
+  return blob_id & ((1ull << ValueLogBlobManager::kSegmentShift) - 1);
+}
+
+static void
+store_manifest(ValueLogBlobManager *vbm)
+{
+  std::vector<uint8_t> buffer(sizeof(PValueLogManifest)
+                  + vbm->segments.size() * sizeof(PValueLogManifestEntry));
+
+  PValueLogManifest *header = (PValueLogManifest *)&buffer[0];
+  header->magic = PValueLogManifest::kMagic;
+  header->head = vbm->head;
+  header->count = (uint32_t)vbm->segments.size();
+
+  PValueLogManifestEntry *entry = (PValueLogManifestEntry *)(header + 1);
+  for (std::map<uint32_t, ValueLogSegment>::iterator it
+              = vbm->segments.begin();
+          it != vbm->segments.end(); it++, entry++) {
+    entry->segment = it->first;
+    entry->dead_bytes = it->second.dead_bytes;
+  }
+
+  vbm->manifest.pwrite(0, &buffer[0], buffer.size());
+  vbm->manifest.truncate(buffer.size());
+  vbm->is_manifest_dirty = false;
+}
+
+// Reads the header of a value log entry; returns the segment and the
+// offset of the entry
+static ValueLogSegment *
+read_entry(ValueLogBlobManager *vbm, uint64_t blob_id, PValueLogEntry *entry,
+                uint64_t *poffset)
+{
+  std::map<uint32_t, ValueLogSegment>::iterator it
+          = vbm->segments.find(segment_of(blob_id));
+  uint64_t offset = offset_of(blob_id);
+
+  if (unlikely(it == vbm->segments.end()
+              || offset + sizeof(PValueLogEntry) > it->second.size)) {
+    ups_log(("blob %llu not found", (unsigned long long)blob_id));
+    throw Exception(UPS_BLOB_NOT_FOUND);
+  }
+
+  ValueLogSegment *segment = &it->second;
+  segment->file.pread(offset, entry, sizeof(PValueLogEntry));
+
+  if (unlikely(entry->magic != PValueLogEntry::kMagic
+              || offset + sizeof(PValueLogEntry) + entry->stored_size
+                    > segment->size)) {
+    ups_log(("blob %llu not found", (unsigned long long)blob_id));
+    throw Exception(UPS_BLOB_NOT_FOUND);
+  }
+
+  *poffset = offset;
+  return segment;
+}
+
+// Starts a new segment; the previous one is flushed
+static ValueLogSegment *
+switch_segment(ValueLogBlobManager *vbm)
+{
+  if (vbm->head + 1 >= (1u << (ValueLogBlobManager::kValueLogBit
+                                  - ValueLogBlobManager::kSegmentShift))) {
+    ups_log(("too many value log segments"));
+    throw Exception(UPS_LIMITS_REACHED);
+  }
+
+  vbm->segments[vbm->head].file.flush();
+
+  vbm->head++;
+  ValueLogSegment *segment = &vbm->segments[vbm->head];
+  segment->file.create(segment_filename(vbm->config, vbm->head).c_str(),
+                  vbm->config->file_mode);
+
+  // the manifest must know the new segment before it is referenced
+  store_manifest(vbm);
+  vbm->manifest.flush();
+  return segment;
+}
+
+// Appends an entry to the current segment and returns its blob id
+static uint64_t
+append(ValueLogBlobManager *vbm, const PValueLogEntry *entry,
+                const void *data)
+{
+  uint64_t entry_size = sizeof(PValueLogEntry) + entry->stored_size;
+
+  ValueLogSegment *segment = &vbm->segments[vbm->head];
+  if (segment->size > 0
+        && segment->size + entry_size > vbm->config->value_log_segment_size)
+    segment = switch_segment(vbm);
+
+  if (unlikely((segment->size + entry_size)
+                  >> ValueLogBlobManager::kSegmentShift)) {
+    ups_log(("value log segment is too large"));
+    throw Exception(UPS_LIMITS_REACHED);
+  }
+
+  File::IoBuffer buffers[2];
+  buffers[0].data = entry;
+  buffers[0].size = sizeof(PValueLogEntry);
+  buffers[1].data = data;
+  buffers[1].size = entry->stored_size;
+
+  segment->file.seek(segment->size, File::kSeekSet);
+  segment->file.writev(buffers, 2);
+
+  if (unlikely(ISSET(vbm->config->flags, UPS_ENABLE_FSYNC)))
+    segment->file.flush();
+
+  uint64_t blob_id = make_blob_id(vbm->head, segment->size);
+  segment->size += entry_size;
+  vbm->metric_bytes_written += entry_size;
+  return blob_id;
+}
+
+ValueLogBlobManager::ValueLogBlobManager(const EnvConfig *config,
+                PageManager *page_manager, Device *device, bool is_new)
+  : DiskBlobManager(config, page_manager, device), head(0),
+    is_manifest_dirty(false), metric_bytes_written(0),
+    metric_bytes_relocated(0), metric_segments_collected(0)
+{
+  if (is_new) {
+    manifest.create(manifest_filename(config).c_str(), config->file_mode);
+    segments[0].file.create(segment_filename(config, 0).c_str(),
+                    config->file_mode);
+    store_manifest(this);
+    return;
+  }
+
+  bool read_only = ISSET(config->flags, UPS_READ_ONLY);
+  manifest.open(manifest_filename(config).c_str(), read_only);
+
+  PValueLogManifest header;
+  if (manifest.file_size() < sizeof(header))
+    throw Exception(UPS_INTEGRITY_VIOLATED);
+  manifest.pread(0, &header, sizeof(header));
+  if (header.magic != PValueLogManifest::kMagic
+        || manifest.file_size() < sizeof(header)
+              + header.count * sizeof(PValueLogManifestEntry)) {
+    ups_log(("invalid value log manifest"));
+    throw Exception(UPS_INTEGRITY_VIOLATED);
+  }
+
+  std::vector<PValueLogManifestEntry> entries(header.count);
+  if (header.count > 0)
+    manifest.pread(sizeof(header), &entries[0],
+                    entries.size() * sizeof(PValueLogManifestEntry));
+
+  head = header.head;
+
+  for (size_t i = 0; i < entries.size(); i++) {
+    File file;
+    try {
+      file.open(segment_filename(config, entries[i].segment).c_str(),
+                      read_only);
+    }
+    catch (Exception &ex) {
+      // the segment was garbage collected, but the manifest was not
+      // yet updated
+      if (ex.code != UPS_FILE_NOT_FOUND || entries[i].segment == head)
+        throw ex;
+      is_manifest_dirty = true;
+      continue;
+    }
+
+    ValueLogSegment *segment = &segments[entries[i].segment];
+    segment->size = file.file_size();
+    segment->dead_bytes = entries[i].dead_bytes;
+    segment->file = std::move(file);
+  }
+
+  if (segments.find(head) == segments.end()) {
+    ups_log(("value log segment %u is missing", head));
+    throw Exception(UPS_INTEGRITY_VIOLATED);
+  }
+}
+
+uint64_t
+ValueLogBlobManager::allocate(Context *context, ups_record_t *record,
+                uint32_t flags)
+{
+  if (NOTSET(flags, kValueLog) || record->size < config->value_log_threshold)
+    return DiskBlobManager::allocate(context, record, flags);
+
+  metric_total_allocated++;
+
+  PValueLogEntry entry;
+  entry.magic = PValueLogEntry::kMagic;
+  entry.flags = 0;
+  entry.size = record->size;
+  entry.stored_size = record->size;
+  const void *data = record->data;
+
+  // compression enabled? then try to compress the data
+  Compressor *compressor = context->db->record_compressor.get();
+  if (compressor && NOTSET(flags, kDisableCompression)) {
+    metric_before_compression += record->size;
+    uint32_t len = compressor->compress((uint8_t *)record->data,
+                        record->size);
+    if (len < record->size) {
+      data = compressor->arena.data();
+      entry.stored_size = len;
+      entry.flags = PValueLogEntry::kIsCompressed;
+    }
+    metric_after_compression += entry.stored_size;
+  }
+
+  return append(this, &entry, data);
+}
+
+void
+ValueLogBlobManager::read(Context *context, uint64_t blob_id,
+                ups_record_t *record, uint32_t flags, ByteArray *arena)
+{
+  if (!is_value_log_id(blob_id)) {
+    DiskBlobManager::read(context, blob_id, record, flags, arena);
+    return;
+  }
+
+  metric_total_read++;
+
+  PValueLogEntry entry;
+  uint64_t offset;
+  ValueLogSegment *segment = read_entry(this, blob_id, &entry, &offset);
+  offset += sizeof(PValueLogEntry);
+
+  record->size = entry.size;
+
+  // empty blob?
+  if (unlikely(entry.size == 0)) {
+    record->data = 0;
+    return;
+  }
+
+  // read compressed data into the Compressor's arena, then uncompress
+  // into the caller's memory
+  if (ISSET(entry.flags, PValueLogEntry::kIsCompressed)) {
+    Compressor *compressor = context->db->record_compressor.get();
+    assert(compressor != 0);
+
+    ByteArray *dest = &compressor->arena;
+    dest->resize(entry.stored_size);
+    segment->file.pread(offset, dest->data(), entry.stored_size);
+
+    if (ISSET(record->flags, UPS_RECORD_USER_ALLOC)) {
+      compressor->decompress(dest->data(), entry.stored_size, entry.size,
+                      (uint8_t *)record->data);
+    }
+    else {
+      arena->resize(entry.size);
+      compressor->decompress(dest->data(), entry.stored_size, entry.size,
+                      arena);
+      record->data = arena->data();
+    }
+    return;
+  }
+
+  if (NOTSET(record->flags, UPS_RECORD_USER_ALLOC)) {
+    arena->resize(entry.size);
+    record->data = arena->data();
+  }
+  segment->file.pread(offset, record->data, entry.size);
+}
+
+uint32_t
+ValueLogBlobManager::blob_size(Context *context, uint64_t blob_id)
+{
+  if (!is_value_log_id(blob_id))
+    return DiskBlobManager::blob_size(context, blob_id);
+
+  PValueLogEntry entry;
+  uint64_t offset;
+  read_entry(this, blob_id, &entry, &offset);
+  return entry.size;
+}
+
+uint64_t
+ValueLogBlobManager::overwrite(Context *context, uint64_t old_blob_id,
+                ups_record_t *record, uint32_t flags)
+{
+  // value log entries are immutable; append the new record and mark
+  // the old one as dead
+  if (is_value_log_id(old_blob_id)) {
+    uint64_t blob_id = allocate(context, record, flags);
+    erase(context, old_blob_id);
+    return blob_id;
+  }
+
+  // the record grew beyond the threshold? then move it to the value log
+  if (ISSET(flags, kValueLog)
+        && record->size >= config->value_log_threshold) {
+    uint64_t blob_id = allocate(context, record, flags);
+    DiskBlobManager::erase(context, old_blob_id);
+    return blob_id;
+  }
+
+  return DiskBlobManager::overwrite(context, old_blob_id, record, flags);
+}
+
+uint64_t
+ValueLogBlobManager::overwrite_regions(Context *context,
+                uint64_t old_blob_id, ups_record_t *record, uint32_t flags,
+                Region *regions, size_t num_regions)
+{
+  if (is_value_log_id(old_blob_id))
+    return overwrite(context, old_blob_id, record, flags);
+
+  return DiskBlobManager::overwrite_regions(context, old_blob_id, record,
+                  flags, regions, num_regions);
+}
+
+void
+ValueLogBlobManager::read_range(Context *context, uint64_t blob_id,
+                uint32_t offset, uint32_t size, ups_record_t *record,
+                ByteArray *arena)
+{
+  if (!is_value_log_id(blob_id)) {
+    DiskBlobManager::read_range(context, blob_id, offset, size, record,
+                    arena);
+    return;
+  }
+
+  PValueLogEntry entry;
+  uint64_t entry_offset;
+  ValueLogSegment *segment = read_entry(this, blob_id, &entry, &entry_offset);
+
+  // compressed entries have to be uncompressed as a whole
+  if (ISSET(entry.flags, PValueLogEntry::kIsCompressed)) {
+    BlobManager::read_range(context, blob_id, offset, size, record, arena);
+    return;
+  }
+
+  metric_total_read++;
+
+  size = range_size(entry.size, offset, size);
+  record->size = size;
+  if (unlikely(size == 0)) {
+    if (NOTSET(record->flags, UPS_RECORD_USER_ALLOC))
+      record->data = 0;
+    return;
+  }
+
+  if (NOTSET(record->flags, UPS_RECORD_USER_ALLOC)) {
+    arena->resize(size);
+    record->data = arena->data();
+  }
+  segment->file.pread(entry_offset + sizeof(PValueLogEntry) + offset,
+                  record->data, size);
+}
+
+uint64_t
+ValueLogBlobManager::overwrite_range(Context *context, uint64_t blob_id,
+                uint32_t offset, ups_record_t *record, uint32_t flags)
+{
+  // value log entries are immutable; overwrite() appends the modified
+  // record. The same happens if the record grows beyond the threshold.
+  if (is_value_log_id(blob_id)
+        || (ISSET(flags, kValueLog)
+            && offset + record->size >= config->value_log_threshold))
+    return BlobManager::overwrite_range(context, blob_id, offset, record,
+                    flags);
+
+  return DiskBlobManager::overwrite_range(context, blob_id, offset, record,
+                  flags);
+}
+
+void
+ValueLogBlobManager::erase(Context *context, uint64_t blob_id, Page *page,
+                uint32_t flags)
+{
+  if (!is_value_log_id(blob_id)) {
+    DiskBlobManager::erase(context, blob_id, page, flags);
+    return;
+  }
+
+  PValueLogEntry entry;
+  uint64_t offset;
+  ValueLogSegment *segment = read_entry(this, blob_id, &entry, &offset);
+  segment->dead_bytes += sizeof(PValueLogEntry) + entry.stored_size;
+  is_manifest_dirty = true;
+}
+
+uint64_t
+ValueLogBlobManager::relocate(Context *context, uint64_t blob_id)
+{
+  if (!is_value_log_id(blob_id))
+    return blob_id;
+
+  std::map<uint32_t, ValueLogSegment>::iterator it
+          = segments.find(segment_of(blob_id));
+  if (it == segments.end() || !it->second.is_collected)
+    return blob_id;
+
+  // copy the entry as it is; compressed data is not uncompressed
+  PValueLogEntry entry;
+  uint64_t offset;
+  ValueLogSegment *segment = read_entry(this, blob_id, &entry, &offset);
+
+  ByteArray buffer(entry.stored_size);
+  if (entry.stored_size > 0)
+    segment->file.pread(offset + sizeof(PValueLogEntry), buffer.data(),
+                    entry.stored_size);
+
+  metric_bytes_relocated += sizeof(PValueLogEntry) + entry.stored_size;
+  return append(this, &entry, buffer.data());
+}
+
+bool
+ValueLogBlobManager::begin_gc()
+{
+  bool found = false;
+
+  for (std::map<uint32_t, ValueLogSegment>::iterator it = segments.begin();
+          it != segments.end(); it++) {
+    // never collect the current segment
+    if (it->first == head)
+      continue;
+
+    ValueLogSegment *segment = &it->second;
+    if (segment->dead_bytes * 100
+            >= segment->size * kGcThresholdPercent) {
+      segment->is_collected = true;
+      found = true;
+    }
+  }
+
+  return found;
+}
+
+void
+ValueLogBlobManager::end_gc()
+{
+  std::map<uint32_t, ValueLogSegment>::iterator it = segments.begin();
+  while (it != segments.end()) {
+    if (!it->second.is_collected) {
+      it++;
+      continue;
+    }
+
+    uint32_t number = it->first;
+    segments.erase(it++);
+    File::remove(segment_filename(config, number).c_str());
+    metric_segments_collected++;
+  }
+
+  store_manifest(this);
+  manifest.flush();
+}
+
+void
+ValueLogBlobManager::flush()
+{
+  if (ISSET(config->flags, UPS_READ_ONLY))
+    return;
+
+  segments[head].file.flush();
+
+  if (is_manifest_dirty) {
+    store_manifest(this);
+    manifest.flush();
+  }
+}
+
+void
+ValueLogBlobManager::fill_metrics(ups_env_metrics_t *metrics) const
+{
+  BlobManager::fill_metrics(metrics);
+  metrics->value_log_bytes_written = metric_bytes_written;
+  metrics->value_log_bytes_relocated = metric_bytes_relocated;
+  metrics->value_log_segments_collected = metric_segments_collected;
+}
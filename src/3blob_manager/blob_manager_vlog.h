@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * A BlobManager which separates large records from the btree.
+ *
+ * Records of at least |config->value_log_threshold| bytes are appended to
+ * a value log which is split into segment files ("<filename>.vlog.<n>").
+ * All other blobs (small records, extended keys, duplicate tables) are
+ * stored in the Environment file by the DiskBlobManager.
+ *
+ * The blob id of a value log entry has the highest bit set; the following
+ * bits store the segment number and the offset of the entry in the
+ * segment.
+ *
+ * Overwritten or erased values are not reused; they are only counted as
+ * "dead" bytes. The garbage collection (which is driven by
+ * ups_env_compact) selects the segments with many dead bytes, visits the
+ * leaf nodes of all databases and appends the values which are still
+ * referenced to the current segment. Afterwards the old segments are
+ * deleted.
+ *
+ * The list of segments and their dead bytes are stored in a small
+ * manifest file ("<filename>.vlog"). The counters are only a heuristic
+ * for the garbage collection; they are not logged, and losing them in a
+ * crash only delays the collection.
+ */
+
+#ifndef UPS_BLOB_MANAGER_VLOG_H
+#define UPS_BLOB_MANAGER_VLOG_H
+
+#include "0root/root.h"
+
+#include <map>
+#include <string>
+
+// Always verify that a file of level N does not include headers > N!
+#include "1os/file.h"
+#include "3blob_manager/blob_manager_disk.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+#include "1base/packstart.h"
+
+/*
+ * The header of a value log entry; followed by the (possibly
+ * compressed) record data
+ */
+UPS_PACK_0 struct UPS_PACK_1 PValueLogEntry
+{
+  enum {
+    // magic value; used for error checking
+    kMagic = 0x766c6f67,
+
+    // the record is compressed
+    kIsCompressed = 1
+  };
+
+  // always kMagic
+  uint32_t magic;
+
+  // flags; stores compression information
+  uint32_t flags;
+
+  // the size of the record from the user's point of view
+  uint32_t size;
+
+  // the size of the stored data (excluding this header)
+  uint32_t stored_size;
+} UPS_PACK_2;
+
+#include "1base/packstop.h"
+
+/*
+ * A segment of the value log
+ */
+struct ValueLogSegment
+{
+  ValueLogSegment()
+    : size(0), dead_bytes(0), is_collected(false) {
+  }
+
+  // the segment file
+  File file;
+
+  // the size of the file; new entries are appended at this offset
+  uint64_t size;
+
+  // number of bytes of entries which are no longer referenced
+  uint64_t dead_bytes;
+
+  // true if the segment is garbage collected in the current run
+  bool is_collected;
+};
+
+/*
+ * A BlobManager which stores large records in the value log
+ */
+struct ValueLogBlobManager : public DiskBlobManager
+{
+  enum {
+    // the highest bit of a blob id is set for value log entries
+    kValueLogBit = 63,
+
+    // the segment number is stored in bits 40..62, the offset in the
+    // lower 40 bits
+    kSegmentShift = 40,
+
+    // a segment is garbage collected if at least this percentage of its
+    // bytes is dead
+    kGcThresholdPercent = 50
+  };
+
+  // Creates the value log (if |is_new| is true) or opens the existing
+  // segments
+  ValueLogBlobManager(const EnvConfig *config, PageManager *page_manager,
+                  Device *device, bool is_new);
+
+  // Appends the record to the value log if |flags| contains kValueLog and
+  // the record is large enough, otherwise stores it in the file
+  virtual uint64_t allocate(Context *context, ups_record_t *record,
+                  uint32_t flags);
+
+  // Reads a blob and stores the data in |record|
+  virtual void read(Context *context, uint64_t blob_id, ups_record_t *record,
+                  uint32_t flags, ByteArray *arena);
+
+  // Retrieves the size of a blob
+  virtual uint32_t blob_size(Context *context, uint64_t blob_id);
+
+  // Overwrites an existing blob; value log entries are never overwritten
+  // in place
+  virtual uint64_t overwrite(Context *context, uint64_t old_blob_id,
+                  ups_record_t *record, uint32_t flags);
+
+  // Overwrites regions of an existing blob
+  virtual uint64_t overwrite_regions(Context *context, uint64_t old_blob_id,
+                  ups_record_t *record, uint32_t flags,
+                  Region *regions, size_t num_regions);
+
+  // Reads a range of a blob; uncompressed value log entries are read
+  // partially
+  virtual void read_range(Context *context, uint64_t blob_id,
+                  uint32_t offset, uint32_t size, ups_record_t *record,
+                  ByteArray *arena);
+
+  // Overwrites a range of a blob; value log entries are rewritten
+  // as a whole
+  virtual uint64_t overwrite_range(Context *context, uint64_t blob_id,
+                  uint32_t offset, ups_record_t *record, uint32_t flags);
+
+  // Deletes an existing blob; value log entries are only marked as dead
+  virtual void erase(Context *context, uint64_t blob_id, Page *page = 0,
+                  uint32_t flags = 0);
+
+  // Moves a value log entry to the current segment if its segment is
+  // garbage collected
+  virtual uint64_t relocate(Context *context, uint64_t blob_id);
+
+  // Selects the segments which are garbage collected
+  virtual bool begin_gc();
+
+  // Deletes the garbage collected segments
+  virtual void end_gc();
+
+  // Flushes the current segment and stores the manifest
+  virtual void flush();
+
+  // Fills in the current metrics
+  virtual void fill_metrics(ups_env_metrics_t *metrics) const;
+
+  // Returns true if |blob_id| is stored in the value log
+  static bool is_value_log_id(uint64_t blob_id) {
+    return (blob_id >> kValueLogBit) != 0;
+  }
+
+  // The current segment; new entries are appended to this segment
+  uint32_t head;
+
+  // All segments which still exist, indexed by their number
+  std::map<uint32_t, ValueLogSegment> segments;
+
+  // The manifest file
+  File manifest;
+
+  // true if the manifest has to be stored
+  bool is_manifest_dirty;
+
+  // Usage tracking - number of bytes appended to the value log
+  uint64_t metric_bytes_written;
+
+  // Usage tracking - number of bytes moved by the garbage collection
+  uint64_t metric_bytes_relocated;
+
+  // Usage tracking - number of deleted segments
+  uint64_t metric_segments_collected;
+};
+
+} // namespace upscaledb
+
+#endif /* UPS_BLOB_MANAGER_VLOG_H */
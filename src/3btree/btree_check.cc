@@ -308,6 +308,15 @@ BtreeIndex::check_integrity(Context *context, uint32_t flags)
 {
   BtreeCheckAction bta(this, context, flags);
   bta.run();
+
+  // verify the persistent key counters
+  if (unlikely(count(false) != recount(context, false)
+              || count(true) != recount(context, true))) {
+    ups_log(("integrity check failed: key counters (%llu/%llu) do not "
+            "match the btree", (unsigned long long)count(false),
+            (unsigned long long)count(true)));
+    throw Exception(UPS_INTEGRITY_VIOLATED);
+  }
 }
 
 } // namespace upscaledb
@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * btree compaction; moves the nodes to free pages at lower file addresses
+ * so that the end of the file can be truncated
+ */
+
+#include "0root/root.h"
+
+#include <string.h>
+
+// Always verify that a file of level N does not include headers > N!
+#include "3page_manager/page_manager.h"
+#include "3btree/btree_index.h"
+#include "3btree/btree_cursor.h"
+#include "3btree/btree_node_proxy.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+struct BtreeCompactAction
+{
+  BtreeCompactAction(BtreeIndex *btree_, Context *context_,
+                  uint32_t max_pages_)
+    : btree(btree_), context(context_), max_pages(max_pages_),
+      page_manager(btree_->state.page_manager), relocated(0) {
+  }
+
+  uint32_t run() {
+    Page *page = btree->root_page(context);
+
+    // move the root page, then update the header page
+    Page *new_page = relocate(page);
+    if (new_page) {
+      btree->set_root_page(new_page);
+      Page *header = page_manager->fetch(context, 0);
+      header->set_dirty(true);
+      page = new_page;
+    }
+
+    compact_children(page);
+
+    // the cached addresses of the most recently used leafs are stale
+    if (relocated > 0) {
+      btree->statistics()->find_failed();
+      btree->statistics()->insert_failed();
+      btree->statistics()->erase_failed();
+    }
+    return relocated;
+  }
+
+  // Moves all children of |page| (and, recursively, their children) to
+  // lower addresses
+  void compact_children(Page *page) {
+    BtreeNodeProxy *node = btree->get_node_from_page(page);
+    if (node->is_leaf())
+      return;
+
+    // slot -1 is the left child
+    for (int slot = -1; slot < (int)node->length(); slot++) {
+      if (limit_reached())
+        return;
+
+      uint64_t address = slot < 0
+                            ? node->left_child()
+                            : node->record_id(context, slot);
+      Page *child = page_manager->fetch(context, address);
+
+      Page *new_page = relocate(child);
+      if (new_page) {
+        if (slot < 0)
+          node->set_left_child(new_page->address());
+        else
+          node->set_record_id(context, slot, new_page->address());
+        page->set_dirty(true);
+        child = new_page;
+      }
+
+      compact_children(child);
+    }
+  }
+
+  // Copies |page| to a free page with a lower address, fixes the
+  // pointers of its siblings and moves |page| to the freelist. The caller
+  // has to update the pointer in the parent node.
+  // Returns the new page, or NULL if there is no lower free page.
+  Page *relocate(Page *page) {
+    if (limit_reached())
+      return 0;
+
+    Page *new_page = page_manager->alloc_below(context, page->type(),
+                            page->address());
+    if (!new_page)
+      return 0;
+
+    BtreeNodeProxy *node = btree->get_node_from_page(page);
+    if (node->is_leaf())
+      BtreeCursor::uncouple_all_cursors(context, page, 0);
+
+    ::memcpy(new_page->payload(), page->payload(),
+                    page_manager->state->config.page_size_bytes
+                        - Page::kSizeofPersistentHeader);
+    new_page->set_dirty(true);
+
+    // fix the linked list
+    if (node->left_sibling()) {
+      Page *p = page_manager->fetch(context, node->left_sibling());
+      btree->get_node_from_page(p)->set_right_sibling(new_page->address());
+      p->set_dirty(true);
+    }
+    if (node->right_sibling()) {
+      Page *p = page_manager->fetch(context, node->right_sibling());
+      btree->get_node_from_page(p)->set_left_sibling(new_page->address());
+      p->set_dirty(true);
+    }
+
+    page_manager->del(context, page);
+
+    relocated++;
+    return new_page;
+  }
+
+  bool limit_reached() const {
+    return max_pages != 0 && relocated >= max_pages;
+  }
+
+  BtreeIndex *btree;
+  Context *context;
+  uint32_t max_pages;
+  PageManager *page_manager;
+  uint32_t relocated;
+};
+
+uint32_t
+BtreeIndex::compact(Context *context, uint32_t max_pages)
+{
+  BtreeCompactAction bca(this, context, max_pages);
+  return bca.run();
+}
+
+} // namespace upscaledb
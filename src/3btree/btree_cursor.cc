@@ -215,6 +215,9 @@ move_next(BtreeCursor *cursor, Context *context, uint32_t flags)
     node = st_.btree->get_node_from_page(page);
   }
 
+  // schedule asynchronous reads of the following leaves
+  env->page_manager->read_ahead(page->address(), node->right_sibling());
+
   // couple this cursor to the smallest key in this page
   cursor->couple_to(page, 0, 0);
 
@@ -411,6 +414,32 @@ BtreeCursor::overwrite(Context *context, ups_record_t *record, uint32_t flags)
   st_.coupled_page->set_dirty(true);
 }
 
+void
+BtreeCursor::overwrite_range(Context *context, uint32_t offset,
+                ups_record_t *record)
+{
+  // uncoupled cursor: couple it
+  couple_or_throw(this, context);
+
+  BtreeNodeProxy *node = st_.btree->get_node_from_page(st_.coupled_page);
+  node->set_record_range(context, st_.coupled_index, offset, record,
+                  st_.duplicate_index);
+
+  st_.coupled_page->set_dirty(true);
+}
+
+void
+BtreeCursor::record_range(Context *context, uint32_t offset, uint32_t size,
+                ups_record_t *record, ByteArray *arena)
+{
+  // uncoupled cursor: couple it
+  couple_or_throw(this, context);
+
+  BtreeNodeProxy *node = st_.btree->get_node_from_page(st_.coupled_page);
+  node->record_range(context, st_.coupled_index, offset, size, arena,
+                  record, st_.duplicate_index);
+}
+
 ups_status_t
 BtreeCursor::move(Context *context, ups_key_t *key, ByteArray *key_arena,
                 ups_record_t *record, ByteArray *record_arena, uint32_t flags)
@@ -514,6 +543,8 @@ BtreeCursor::move_to_next_page(Context *context)
 
   Page *page = env->page_manager->fetch(context, node->right_sibling(),
                         PageManager::kReadOnly);
+  node = st_.btree->get_node_from_page(page);
+  env->page_manager->read_ahead(page->address(), node->right_sibling());
   couple_to(page, 0, 0);
   return 0;
 }
@@ -200,6 +200,14 @@ struct BtreeCursor {
   // Overwrite the record of this cursor
   void overwrite(Context *context, ups_record_t *record, uint32_t flags);
 
+  // Overwrites a range of the record of this cursor
+  void overwrite_range(Context *context, uint32_t offset,
+                  ups_record_t *record);
+
+  // Reads a range of the record of this cursor
+  void record_range(Context *context, uint32_t offset, uint32_t size,
+                  ups_record_t *record, ByteArray *arena);
+
   // Returns the number of records of the referenced key
   int record_count(Context *context, uint32_t flags);
 
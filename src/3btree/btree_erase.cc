@@ -48,7 +48,7 @@ struct BtreeEraseAction : public BtreeUpdateAction
                   BtreeCursor *cursor_, ups_key_t *key_,
                   int duplicate_index_, uint32_t /* flags (not used) */)
     : BtreeUpdateAction(btree_, context_, cursor_, duplicate_index_),
-      key(key_) {
+      key(key_), is_counted(false) {
     if (cursor)
       duplicate_index = cursor->duplicate_index() + 1;
   }
@@ -119,11 +119,22 @@ fall_through:
     bool has_duplicates_left = false;
     if (node->is_leaf()) {
       // only delete a duplicate?
-      if (duplicate_index > 0)
+      if (duplicate_index > 0) {
         node->erase_record(context, slot, duplicate_index - 1, false,
                       &has_duplicates_left);
-      else
+        if (!is_counted)
+          btree->adjust_key_count(-1, has_duplicates_left ? 0 : -1);
+      }
+      else {
+        int64_t records = node->record_count(context, slot);
         node->erase_record(context, slot, 0, true, 0);
+        if (!is_counted)
+          btree->adjust_key_count(-records, -1);
+      }
+
+      // the operation is restarted if the page has to be split; make sure
+      // that the counters are not adjusted twice
+      is_counted = true;
     }
 
     page->set_dirty(true);
@@ -201,6 +212,9 @@ fall_through:
 
   // the key that is retrieved
   ups_key_t *key;
+
+  // true if the key counters were already adjusted
+  bool is_counted;
 };
 
 ups_status_t
@@ -32,6 +32,7 @@
 #include "1globals/globals.h"
 #include "1base/dynamic_array.h"
 #include "2page/page.h"
+#include "3blob_manager/blob_manager.h"
 #include "3btree/btree_node.h"
 #include "3btree/btree_keys_base.h"
 #include "3btree/btree_visitor.h"
@@ -110,6 +111,51 @@ struct BaseNodeImpl {
                       new_duplicate_index);
     }
 
+    // Reads |size| bytes of a record, starting at |offset|. If the
+    // RecordList cannot read the range directly then the full record
+    // is read
+    void record_range(Context *context, int slot, uint32_t offset,
+                    uint32_t size, ByteArray *arena, ups_record_t *record,
+                    int duplicate_index) {
+      if (records.record_range(context, slot, offset, size, arena, record,
+                              duplicate_index))
+        return;
+
+      ByteArray full_arena;
+      ups_record_t full = {0};
+      records.record(context, slot, &full_arena, &full, 0, duplicate_index);
+      size = BlobManager::range_size(full.size, offset, size);
+      BlobManager::assign_range(record, (uint8_t *)full.data + offset, size,
+                      arena);
+    }
+
+    // Overwrites a range of a record, starting at |offset|; the record
+    // grows if necessary. If the RecordList cannot overwrite the range
+    // directly then the full record is rewritten
+    void set_record_range(Context *context, int slot, uint32_t offset,
+                    ups_record_t *record, int duplicate_index) {
+      if (records.set_record_range(context, slot, offset, record,
+                              duplicate_index))
+        return;
+
+      ByteArray full_arena;
+      ups_record_t full = {0};
+      records.record(context, slot, &full_arena, &full, 0, duplicate_index);
+      BlobManager::range_size(full.size, offset, 0);
+
+      uint32_t new_size = std::max(full.size, offset + record->size);
+      ByteArray buffer(new_size);
+      if (full.size > 0)
+        ::memcpy(buffer.data(), full.data, full.size);
+      if (record->size > 0)
+        ::memcpy(buffer.data() + offset, record->data, record->size);
+
+      ups_record_t tmp = {0};
+      tmp.data = buffer.data();
+      tmp.size = new_size;
+      set_record(context, slot, &tmp, duplicate_index, UPS_OVERWRITE, 0);
+    }
+
     // Iterates all keys, calls the |visitor| on each
     void scan(Context *context, ScanVisitor *visitor,
                     SelectStatement *statement, uint32_t start, bool distinct) {
@@ -127,6 +173,25 @@ struct BaseNodeImpl {
 
       // this branch handles non-duplicate block scans without an iterator
       if (distinct) {
+        // compressed KeyLists pass their block metadata to the visitor,
+        // and only decompress the blocks that the visitor cannot handle
+        // otherwise
+        if (KeyList::kSupportsBlockMetadata && !requires_records) {
+          keys.scan_blocks(visitor, node->length(), start, 0, 0);
+          return;
+        }
+
+        if (KeyList::kSupportsBlockMetadata
+                && requires_keys
+                && RecordList::kSupportsBlockScans
+                && requires_records) {
+          ScanResult srr = records.scan(rec_arena, node->length(), start);
+          keys.scan_blocks(visitor, node->length(), start,
+                          (const uint8_t *)srr.first,
+                          records.full_record_size());
+          return;
+        }
+
         // only scan keys?
         if (KeyList::kSupportsBlockScans && !requires_records) {
           ScanResult sr = keys.scan(key_arena, node->length(), start);
@@ -396,6 +461,11 @@ struct BaseNodeImpl {
       records.fill_metrics(metrics, node_length);
     }
 
+    // Relocates the record blobs; returns true if the node was modified
+    bool relocate_blobs(Context *context, size_t node_length) {
+      return records.relocate_blobs(context, node_length);
+    }
+
     // Prints a slot to stdout (for debugging)
     void print(Context *context, int slot) {
       std::stringstream ss;
@@ -67,6 +67,12 @@ BtreeIndex::create(Context *context, PBtreeHeader *btree_header,
   PBtreeNode *node = PBtreeNode::from_page(state.root_page);
   node->set_flags(PBtreeNode::kLeafNode);
 
+  /* the slot in the header page can be re-used from an erased database */
+  state.btree_header->key_count = 0;
+  state.btree_header->distinct_key_count = 0;
+  state.key_count = 0;
+  state.distinct_key_count = 0;
+
   persist_configuration(context, dbconfig);
 }
 
@@ -87,6 +93,9 @@ BtreeIndex::open(PBtreeHeader *btree_header, DbConfig *dbconfig)
   dbconfig->record_size = btree_header->record_size;
   dbconfig->record_compressor = btree_header->record_compression();
 
+  state.key_count = btree_header->key_count;
+  state.distinct_key_count = btree_header->distinct_key_count;
+
   assert(dbconfig->key_size > 0);
 
   state.leaf_traits.reset(BtreeIndexFactory::create(state.db, true));
@@ -111,6 +120,18 @@ BtreeIndex::persist_configuration(Context *context, const DbConfig *dbconfig)
   state.btree_header->set_key_compression(dbconfig->key_compressor);
 }
 
+bool
+BtreeIndex::persist_key_count()
+{
+  if (state.btree_header->key_count == state.key_count
+        && state.btree_header->distinct_key_count == state.distinct_key_count)
+    return false;
+
+  state.btree_header->key_count = state.key_count;
+  state.btree_header->distinct_key_count = state.distinct_key_count;
+  return true;
+}
+
 Page *
 BtreeIndex::find_lower_bound(Context *context, Page *page, const ups_key_t *key,
                 uint32_t page_manager_flags, int *idxptr)
@@ -161,7 +182,7 @@ struct CalcKeysVisitor : public BtreeVisitor
 };
 
 uint64_t
-BtreeIndex::count(Context *context, bool distinct)
+BtreeIndex::recount(Context *context, bool distinct)
 {
   CalcKeysVisitor visitor(state.db, distinct);
   visit_nodes(context, visitor, false);
@@ -196,4 +217,26 @@ BtreeIndex::drop(Context *context)
   visit_nodes(context, visitor, true);
 }
 
+//
+// visitor object to relocate the record blobs
+///
+struct RelocateBlobsVisitor : public BtreeVisitor
+{
+  virtual void operator()(Context *context, BtreeNodeProxy *node) {
+    if (node->relocate_blobs(context))
+      node->page->set_dirty(true);
+  }
+
+  virtual bool is_read_only() const {
+    return false;
+  }
+};
+
+void
+BtreeIndex::relocate_blobs(Context *context)
+{
+  RelocateBlobsVisitor visitor;
+  visit_nodes(context, visitor, false);
+}
+
 } // namespace upscaledb
@@ -105,6 +105,12 @@ UPS_PACK_0 struct UPS_PACK_1 PBtreeHeader {
 
   // the record type
   uint16_t record_type;
+
+  // number of keys (including duplicates) stored in the btree
+  uint64_t key_count;
+
+  // number of distinct keys stored in the btree
+  uint64_t distinct_key_count;
 } UPS_PACK_2;
 
 #include "1base/packstop.h"
@@ -160,6 +166,13 @@ struct BtreeIndexState {
 
   // the btree statistics
   BtreeStatistics statistics;
+
+  // number of keys (including duplicates); stored in the PBtreeHeader when
+  // the Database is closed or the Environment is flushed
+  uint64_t key_count;
+
+  // number of distinct keys
+  uint64_t distinct_key_count;
 };
 
 //
@@ -180,6 +193,8 @@ struct BtreeIndex {
     state.db = db;
     state.btree_header = 0;
     state.root_page = 0;
+    state.key_count = 0;
+    state.distinct_key_count = 0;
   }
 
   // Returns the database pointer
@@ -241,8 +256,40 @@ struct BtreeIndex {
   // Checks the integrity of the btree (ups_db_check_integrity)
   void check_integrity(Context *context, uint32_t flags);
 
-  // Counts the keys in the btree
-  uint64_t count(Context *context, bool distinct);
+  // Moves the nodes of the btree to free pages with lower addresses;
+  // relocates at most |max_pages| pages (0: no limit). Returns the number
+  // of relocated pages.
+  uint32_t compact(Context *context, uint32_t max_pages);
+
+  // Asks the BlobManager to relocate the record blobs of all leaf nodes;
+  // required for the garbage collection of the value log
+  void relocate_blobs(Context *context);
+
+  // Returns the number of keys in the btree; if |distinct| is true then
+  // duplicates are not counted
+  uint64_t count(bool distinct) const {
+    return distinct ? state.distinct_key_count : state.key_count;
+  }
+
+  // Counts the keys in the btree by visiting all leaf nodes
+  uint64_t recount(Context *context, bool distinct);
+
+  // Adjusts the key counters after an insert or erase operation
+  void adjust_key_count(int64_t keys, int64_t distinct_keys) {
+    state.key_count += keys;
+    state.distinct_key_count += distinct_keys;
+  }
+
+  // Recalculates the key counters by visiting all leaf nodes; required
+  // after recovery
+  void recalculate_key_count(Context *context) {
+    state.key_count = recount(context, false);
+    state.distinct_key_count = recount(context, true);
+  }
+
+  // Stores the key counters in the PBtreeHeader. Returns true if the
+  // header was modified and the header page has to be flushed.
+  bool persist_key_count();
 
   // Drops this index. Deletes all records, overflow areas, extended
   // keys etc from the index; also used to avoid memory leaks when closing
@@ -34,6 +34,8 @@
 
 namespace upscaledb {
 
+struct ScanVisitor;
+
 struct BaseKeyList : BaseList {
   enum {
     // This KeyList cannot reduce its capacity in order to release storage
@@ -51,6 +53,9 @@ struct BaseKeyList : BaseList {
     // A flag whether this KeyList supports the scan() call
     kSupportsBlockScans = 0,
 
+    // A flag whether this KeyList supports the scan_blocks() call
+    kSupportsBlockMetadata = 0,
+
     // A flag whether this KeyList has sequential data
     kHasSequentialData = 0,
   };
@@ -76,6 +81,12 @@ struct BaseKeyList : BaseList {
     throw Exception(UPS_NOT_IMPLEMENTED);
   }
 
+  // Passes the metadata of each compressed block to the |visitor|
+  void scan_blocks(ScanVisitor *visitor, size_t node_count, uint32_t start,
+                  const uint8_t *record_data, size_t record_size) {
+    throw Exception(UPS_NOT_IMPLEMENTED);
+  }
+
   // Fills the btree_metrics structure
   void fill_metrics(btree_metrics_t *metrics, size_t node_count) {
     BtreeStatistics::update_min_max_avg(&metrics->keylist_ranges, range_size);
@@ -194,6 +194,17 @@ struct BtreeNodeProxy {
                   int duplicate_index, uint32_t flags,
                   uint32_t *new_duplicate_index) = 0;
 
+  // Reads |size| bytes of the record, starting at |offset|, and stores
+  // them in |record|. The range is truncated at the end of the record.
+  virtual void record_range(Context *context, int slot, uint32_t offset,
+                  uint32_t size, ByteArray *arena, ups_record_t *record,
+                  int duplicate_index = 0) = 0;
+
+  // Overwrites a range of the record, starting at |offset|. The record
+  // grows if the range exceeds its current size.
+  virtual void set_record_range(Context *context, int slot, uint32_t offset,
+                  ups_record_t *record, int duplicate_index = 0) = 0;
+
   // Removes the record (or the duplicate of it, if |duplicate_index| is > 0).
   // If |all_duplicates| is set then all duplicates of this key are deleted.
   // |has_duplicates_left| will return true if there are more duplicates left
@@ -234,6 +245,10 @@ struct BtreeNodeProxy {
   // Fills the btree_metrics structure
   virtual void fill_metrics(btree_metrics_t *metrics) = 0;
 
+  // Asks the BlobManager to relocate the record blobs of a leaf node;
+  // returns true if the node was modified
+  virtual bool relocate_blobs(Context *context) = 0;
+
   // Prints the node to stdout. Only for testing and debugging!
   virtual void print(Context *context, size_t length = 0) = 0;
 
@@ -426,6 +441,22 @@ struct BtreeNodeProxyImpl : BtreeNodeProxy {
                     new_duplicate_index);
   }
 
+  // Reads a range of the record
+  virtual void record_range(Context *context, int slot, uint32_t offset,
+                  uint32_t size, ByteArray *arena, ups_record_t *record,
+                  int duplicate_index = 0) {
+    assert(slot < (int)length());
+    impl.record_range(context, slot, offset, size, arena, record,
+                    duplicate_index);
+  }
+
+  // Overwrites a range of the record
+  virtual void set_record_range(Context *context, int slot, uint32_t offset,
+                  ups_record_t *record, int duplicate_index = 0) {
+    assert(slot < (int)length());
+    impl.set_record_range(context, slot, offset, record, duplicate_index);
+  }
+
   // Returns the record size of a key or one of its duplicates
   virtual uint32_t record_size(Context *context, int slot,
                   int duplicate_index) {
@@ -560,6 +591,11 @@ struct BtreeNodeProxyImpl : BtreeNodeProxy {
     impl.fill_metrics(metrics, length());
   }
 
+  // Asks the BlobManager to relocate the record blobs of a leaf node
+  virtual bool relocate_blobs(Context *context) {
+    return impl.relocate_blobs(context, length());
+  }
+
   // Prints the node to stdout (for debugging)
   virtual void print(Context *context, size_t length = 0) {
     std::cout << "page " << page->address() << ": " << this->length()
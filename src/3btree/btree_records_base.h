@@ -63,6 +63,29 @@ struct BaseRecordList : BaseList {
   void set_record_id(int slot, uint64_t ptr) {
     assert(!"shouldn't be here");
   }
+
+  // Asks the BlobManager to relocate the record blobs (see
+  // BlobManager::relocate); returns true if a record id was modified.
+  // Only required for lists which store records in the value log
+  bool relocate_blobs(Context *context, size_t node_count) {
+    return false;
+  }
+
+  // Reads a range of a record without reading the full record; returns
+  // false if this is not supported (the caller then reads the full record)
+  bool record_range(Context *context, int slot, uint32_t offset,
+                  uint32_t size, ByteArray *arena, ups_record_t *record,
+                  int duplicate_index) const {
+    return false;
+  }
+
+  // Overwrites a range of a record without rewriting the full record;
+  // returns false if this is not supported (the caller then rewrites
+  // the full record)
+  bool set_record_range(Context *context, int slot, uint32_t offset,
+                  ups_record_t *record, int duplicate_index) {
+    return false;
+  }
 };
 
 } // namespace upscaledb
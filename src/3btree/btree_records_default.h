@@ -154,7 +154,8 @@ struct DefaultRecordList : BaseRecordList {
       if (record->size <= sizeof(uint64_t))
         set_record_data(slot, record->data, record->size);
       else
-        set_record_id(slot, blob_manager->allocate(context, record, flags));
+        set_record_id(slot, blob_manager->allocate(context, record,
+                                flags | BlobManager::kValueLog));
       return;
     }
 
@@ -168,7 +169,8 @@ struct DefaultRecordList : BaseRecordList {
       if (record->size <= sizeof(uint64_t))
         set_record_data(slot, record->data, record->size);
       else
-        set_record_id(slot, blob_manager->allocate(context, record, flags));
+        set_record_id(slot, blob_manager->allocate(context, record,
+                                flags | BlobManager::kValueLog));
       return;
     }
 
@@ -179,7 +181,8 @@ struct DefaultRecordList : BaseRecordList {
         set_record_data(slot, record->data, record->size);
       }
       else {
-        ptr = blob_manager->overwrite(context, ptr, record, flags);
+        ptr = blob_manager->overwrite(context, ptr, record,
+                                flags | BlobManager::kValueLog);
         set_record_id(slot, ptr);
       }
       return;
@@ -210,6 +213,44 @@ struct DefaultRecordList : BaseRecordList {
     }
   }
 
+  // Asks the BlobManager to relocate the record blobs; returns true if
+  // a record id was modified
+  bool relocate_blobs(Context *context, size_t node_count) {
+    bool modified = false;
+    for (size_t i = 0; i < node_count; i++) {
+      if (is_record_inline(i) || record_id(i) == 0)
+        continue;
+      uint64_t blob_id = blob_manager->relocate(context, record_id(i));
+      if (blob_id != record_id(i)) {
+        set_record_id(i, blob_id);
+        modified = true;
+      }
+    }
+    return modified;
+  }
+
+  // Reads a range of a record blob; inline records are not supported
+  bool record_range(Context *context, int slot, uint32_t offset,
+                  uint32_t size, ByteArray *arena, ups_record_t *record,
+                  int = 0) const {
+    if (is_record_inline(slot) || record_id(slot) == 0)
+      return false;
+    blob_manager->read_range(context, record_id(slot), offset, size,
+                    record, arena);
+    return true;
+  }
+
+  // Overwrites a range of a record blob; inline records are not supported
+  bool set_record_range(Context *context, int slot, uint32_t offset,
+                  ups_record_t *record, int = 0) {
+    if (is_record_inline(slot) || record_id(slot) == 0)
+      return false;
+    set_record_id(slot, blob_manager->overwrite_range(context,
+                            record_id(slot), offset, record,
+                            BlobManager::kValueLog));
+    return true;
+  }
+
   // Creates space for one additional record
   void insert(Context *, size_t node_count, int slot) {
     if (slot < (int)node_count) {
@@ -380,6 +380,10 @@ BtreeUpdateAction::insert_in_page(Page *page, ups_key_t *key,
       node->set_record(context, result.slot, record, duplicate_index,
                       hints.flags, &new_duplicate_id);
 
+      // a new duplicate was added
+      if (NOTSET(hints.flags, UPS_OVERWRITE))
+        btree->adjust_key_count(1, 0);
+
       hints.processed_leaf_page = page;
       hints.processed_slot = result.slot;
     }
@@ -396,6 +400,7 @@ BtreeUpdateAction::insert_in_page(Page *page, ups_key_t *key,
         // allocate record id
         node->set_record(context, result.slot, record, duplicate_index,
                         hints.flags, &new_duplicate_id);
+        btree->adjust_key_count(1, 1);
 
         hints.processed_leaf_page = page;
         hints.processed_slot = result.slot;
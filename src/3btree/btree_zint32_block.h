@@ -28,6 +28,7 @@
 // Always verify that a file of level N does not include headers > N!
 #include "3btree/btree_node.h"
 #include "3btree/btree_keys_base.h"
+#include "4uqi/scanvisitor.h"
 
 #ifndef UPS_ROOT_H
 #  error "root.h was not included"
@@ -348,6 +349,9 @@ struct BlockKeyList : BaseKeyList {
     // A flag whether this KeyList supports the scan() call
     kSupportsBlockScans = 1,
 
+    // A flag whether this KeyList supports the scan_blocks() call
+    kSupportsBlockMetadata = 1,
+
     // This KeyList has a custom find() implementation
     kCustomFind = 1,
 
@@ -751,6 +755,44 @@ struct BlockKeyList : BaseKeyList {
     return std::make_pair(out + start, node_count - start);
   }
 
+  // Scans all keys; used for the UQI APIs. In contrast to scan(), the
+  // |visitor| first receives the metadata of each block (lowest key,
+  // highest key and key count). Only if the visitor requires the actual
+  // keys then the block is decompressed into a small buffer, which stays
+  // in the cache while the visitor aggregates the keys.
+  //
+  // |record_data| points to the records (starting at |start|), or is null
+  // if the records are not required.
+  void scan_blocks(ScanVisitor *visitor, size_t node_count, uint32_t start,
+                  const uint8_t *record_data, size_t record_size) {
+    uint32_t data[Index::kMaxKeysPerBlock + 1];
+
+    Index *it = block_index(0);
+    Index *end = block_index(block_count());
+
+    for (; it < end; it++) {
+      uint32_t key_count = it->key_count();
+      if (start >= key_count) {
+        start -= key_count;
+        continue;
+      }
+
+      // the block is consumed by the visitor without decompressing it?
+      uint32_t lowest = it->value();
+      uint32_t highest = it->highest();
+      if (start > 0 || !visitor->visit_block(&lowest, &highest,
+                              record_data, key_count)) {
+        data[0] = it->value();
+        uncompress_block(it, &data[1]);
+        (*visitor)(&data[start], record_data, key_count - start);
+      }
+
+      if (record_data)
+        record_data += (key_count - start) * record_size;
+      start = 0;
+    }
+  }
+
   // Copies all keys from this[sstart] to dest[dstart]; this method
   // is used to split and merge btree nodes.
   void copy_to(int sstart, size_t node_count, BlockKeyList &dest,
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+#include "0root/root.h"
+
+#include <string.h>
+
+// Always verify that a file of level N does not include headers > N!
+#include "1base/error.h"
+#include "1base/crc32c.h"
+#include "1mem/mem.h"
+#include "3cache/flash_cache.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+// Returns the file offset of a slot
+static inline uint64_t
+slot_offset(const FlashCache *cache, uint64_t slot)
+{
+  return cache->data_offset + slot * cache->page_size;
+}
+
+// Removes the page which is stored in a slot
+static inline void
+clear_slot(FlashCache *cache, uint64_t slot)
+{
+  PFlashCacheEntry &entry = cache->entries[slot];
+  if (entry.address != 0) {
+    cache->index.erase(entry.address);
+    ::memset(&entry, 0, sizeof(entry));
+  }
+}
+
+// Returns true if |address| was rejected recently; otherwise remembers
+// the address. Collisions only cause a page to be rejected once more.
+static inline bool
+is_ghost(FlashCache *cache, uint64_t address)
+{
+  uint64_t &ghost = cache->ghosts[(size_t)((address / cache->page_size)
+                                    % cache->ghosts.size())];
+  if (ghost == address) {
+    ghost = 0;
+    return true;
+  }
+  ghost = address;
+  return false;
+}
+
+FlashCache::FlashCache(const EnvConfig &config_)
+  : config(config_), page_size(0), slot_count(0), next_slot(0),
+    data_offset(0), hits(0), misses(0)
+{
+}
+
+void
+FlashCache::open(uint32_t write_counter)
+{
+  page_size = config.page_size_bytes;
+  slot_count = config.flash_cache_size / page_size;
+  if (slot_count == 0)
+    return;
+
+  // the slots follow the index and are aligned to the page size
+  data_offset = sizeof(PFlashCacheHeader)
+                    + slot_count * sizeof(PFlashCacheEntry);
+  data_offset = (data_offset + page_size - 1) / page_size * page_size;
+
+  PFlashCacheEntry empty;
+  ::memset(&empty, 0, sizeof(empty));
+  entries.assign((size_t)slot_count, empty);
+  ghosts.assign((size_t)slot_count, 0);
+  index.clear();
+  next_slot = 0;
+
+  const char *filename = config.flash_cache_filename.c_str();
+  try {
+    File f;
+    PFlashCacheHeader header;
+    ::memset(&header, 0, sizeof(header));
+    if (File::exists(filename)) {
+      f.open(filename, false);
+      if (f.file_size() >= data_offset)
+        f.pread(0, &header, sizeof(header));
+    }
+    else
+      f.create(filename, config.file_mode);
+
+    // the index is only valid if the cache was closed cleanly, and if the
+    // Environment file was not modified in the meantime
+    if (header.magic == kMagic
+          && header.is_clean == 1
+          && header.page_size == page_size
+          && header.slot_count == slot_count
+          && header.next_slot < slot_count
+          && header.write_counter == write_counter) {
+      f.pread(sizeof(header), &entries[0],
+                      entries.size() * sizeof(PFlashCacheEntry));
+      for (uint64_t slot = 0; slot < slot_count; slot++) {
+        if (entries[slot].address != 0)
+          index[entries[slot].address] = slot;
+      }
+      next_slot = header.next_slot;
+    }
+
+    // the index is not valid till the cache is closed
+    header.magic = kMagic;
+    header.is_clean = 0;
+    header.page_size = (uint32_t)page_size;
+    header.reserved = 0;
+    header.slot_count = slot_count;
+    header.next_slot = next_slot;
+    header.write_counter = 0;
+    f.pwrite(0, &header, sizeof(header));
+    f.flush();
+
+    file = std::move(f);
+  }
+  catch (Exception &ex) {
+    ups_log(("opening the flash cache %s failed with error %d; the flash "
+                "cache is disabled", filename, ex.code));
+    entries.assign((size_t)slot_count, empty);
+    index.clear();
+    next_slot = 0;
+  }
+}
+
+void
+FlashCache::close(uint32_t write_counter)
+{
+  if (!file.is_open())
+    return;
+
+  try {
+    // the slots and the index are flushed before the index is valid
+    file.pwrite(sizeof(PFlashCacheHeader), &entries[0],
+                    entries.size() * sizeof(PFlashCacheEntry));
+    file.flush();
+
+    PFlashCacheHeader header;
+    header.magic = kMagic;
+    header.is_clean = 1;
+    header.page_size = (uint32_t)page_size;
+    header.reserved = 0;
+    header.slot_count = slot_count;
+    header.next_slot = next_slot;
+    header.write_counter = write_counter;
+    file.pwrite(0, &header, sizeof(header));
+    file.flush();
+  }
+  catch (Exception &ex) {
+    ups_log(("closing the flash cache failed with error %d", ex.code));
+  }
+
+  file.close();
+  entries.clear();
+  index.clear();
+  ghosts.clear();
+}
+
+void
+FlashCache::put(Page *page)
+{
+  if (!file.is_open())
+    return;
+
+  uint64_t address = page->address();
+  if (address == 0 || index.find(address) != index.end())
+    return;
+
+  // index pages are always admitted, all other pages only if they were
+  // rejected recently
+  bool is_index = false;
+  if (!page->is_without_header()) {
+    uint32_t type = page->type();
+    if (type == Page::kTypeHeader || type == Page::kTypePageManager)
+      return;
+    is_index = type == Page::kTypeBroot || type == Page::kTypeBindex;
+  }
+  if (!is_index && !is_ghost(this, address))
+    return;
+
+  // overwrite the oldest slot
+  uint64_t slot = next_slot;
+  next_slot = (next_slot + 1) % slot_count;
+  clear_slot(this, slot);
+
+  try {
+    file.pwrite(slot_offset(this, slot), page->data(), page_size);
+  }
+  catch (Exception &ex) {
+    ups_log(("writing to the flash cache failed with error %d", ex.code));
+    return;
+  }
+
+  PFlashCacheEntry &entry = entries[slot];
+  entry.address = address;
+  entry.crc32 = Crc32c::compute(page->data(), page_size);
+  index[address] = slot;
+}
+
+bool
+FlashCache::get(Page *page, uint64_t address)
+{
+  if (!file.is_open())
+    return false;
+
+  std::map<uint64_t, uint64_t>::iterator it = index.find(address);
+  if (it == index.end()) {
+    misses++;
+    return false;
+  }
+
+  // the page is removed because it can now be modified
+  uint64_t slot = it->second;
+  uint32_t crc32 = entries[slot].crc32;
+  clear_slot(this, slot);
+
+  if (page->data() == 0) {
+    uint8_t *p = Memory::allocate<uint8_t>(page_size);
+    page->assign_allocated_buffer(p, address);
+  }
+
+  try {
+    file.pread(slot_offset(this, slot), page->data(), page_size);
+  }
+  catch (Exception &ex) {
+    ups_log(("reading from the flash cache failed with error %d", ex.code));
+    misses++;
+    return false;
+  }
+
+  if (Crc32c::compute(page->data(), page_size) != crc32) {
+    ups_log(("flash cache: checksum mismatch of page %lu",
+                (unsigned long)address));
+    misses++;
+    return false;
+  }
+
+  page->set_address(address);
+  hits++;
+  return true;
+}
+
+void
+FlashCache::discard()
+{
+  PFlashCacheEntry empty;
+  ::memset(&empty, 0, sizeof(empty));
+  entries.assign(entries.size(), empty);
+  index.clear();
+}
+
+void
+FlashCache::del(uint64_t address)
+{
+  std::map<uint64_t, uint64_t>::iterator it = index.find(address);
+  if (it != index.end())
+    clear_slot(this, it->second);
+}
+
+void
+FlashCache::fill_metrics(ups_env_metrics_t *metrics) const
+{
+  metrics->flash_cache_hits = hits;
+  metrics->flash_cache_misses = misses;
+}
+
+} // namespace upscaledb
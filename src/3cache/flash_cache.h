@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2005-2017 Christoph Rupp (chris@crupp.de).
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * See the file COPYING for License information.
+ */
+
+/*
+ * The flash cache: a second-level cache in a file on fast local storage.
+ *
+ * Receives the clean pages which are evicted from the Cache, and serves
+ * cache misses before the pages are read from the device. The file is
+ * written like a ring buffer; the oldest slot is overwritten.
+ *
+ * Index pages are always admitted. All other pages are only admitted if
+ * they were evicted before, recently; a table of "ghost" addresses
+ * remembers the pages which were rejected. This keeps large scans from
+ * flushing the flash cache.
+ *
+ * The flash cache is exclusive: a page is removed when it is read, because
+ * it can then be modified. Therefore a page is never stale as long as the
+ * Environment is open. The index is only written after the Environment
+ * was closed; it is discarded if the Environment was not closed cleanly,
+ * if the Environment was opened for writing without the flash cache (its
+ * write counter then changed), or if the Journal is recovered.
+ *
+ * @exception_safe: basic
+ * @thread_safe: no
+ */
+
+#ifndef UPS_FLASH_CACHE_H
+#define UPS_FLASH_CACHE_H
+
+#include "0root/root.h"
+
+#include <map>
+#include <vector>
+
+#include "ups/upscaledb_int.h"
+
+// Always verify that a file of level N does not include headers > N!
+#include "1os/file.h"
+#include "2config/env_config.h"
+#include "2page/page.h"
+
+#ifndef UPS_ROOT_H
+#  error "root.h was not included"
+#endif
+
+namespace upscaledb {
+
+#include "1base/packstart.h"
+
+/*
+ * The persistent header of the flash cache
+ */
+typedef UPS_PACK_0 struct UPS_PACK_1 PFlashCacheHeader {
+  // the magic
+  uint32_t magic;
+
+  // 1 if the index is valid, i.e. if the cache was closed cleanly
+  uint32_t is_clean;
+
+  // the page size
+  uint32_t page_size;
+
+  // reserved
+  uint32_t reserved;
+
+  // the number of slots
+  uint64_t slot_count;
+
+  // the slot which is written next
+  uint64_t next_slot;
+
+  // the write counter of the Environment when the cache was closed
+  uint64_t write_counter;
+} UPS_PACK_2 PFlashCacheHeader;
+
+/*
+ * An entry of the persistent index; one entry per slot
+ */
+typedef UPS_PACK_0 struct UPS_PACK_1 PFlashCacheEntry {
+  // the address of the page; 0 if the slot is empty
+  uint64_t address;
+
+  // the CRC32C of the page
+  uint32_t crc32;
+
+  // reserved
+  uint32_t reserved;
+} UPS_PACK_2 PFlashCacheEntry;
+
+#include "1base/packstop.h"
+
+struct FlashCache
+{
+  enum {
+    // the magic of the file ("FLSH")
+    kMagic = 0x48534c46
+  };
+
+  // Constructor
+  FlashCache(const EnvConfig &config_);
+
+  // Returns true if the flash cache is enabled
+  bool is_open() const {
+    return file.is_open();
+  }
+
+  // Opens (or creates) the cache file; the index is discarded if it is
+  // not valid for an Environment with the write counter |write_counter|.
+  // Errors are not fatal; the flash cache is then disabled.
+  void open(uint32_t write_counter);
+
+  // Writes the index and closes the file
+  void close(uint32_t write_counter);
+
+  // Removes all pages
+  void discard();
+
+  // Stores a clean page which is evicted from the Cache, if the admission
+  // policy accepts it
+  void put(Page *page);
+
+  // Reads a page from the flash cache and removes it; returns false if
+  // the page is not cached
+  bool get(Page *page, uint64_t address);
+
+  // Removes a page, i.e. because its address is reused
+  void del(uint64_t address);
+
+  // Fills in the current metrics
+  void fill_metrics(ups_env_metrics_t *metrics) const;
+
+  // Copy of the Environment's configuration
+  const EnvConfig &config;
+
+  // The cache file
+  File file;
+
+  // The page size
+  size_t page_size;
+
+  // The number of slots
+  uint64_t slot_count;
+
+  // The slot which is written next
+  uint64_t next_slot;
+
+  // The file offset of the first slot
+  uint64_t data_offset;
+
+  // The index entries, one per slot
+  std::vector<PFlashCacheEntry> entries;
+
+  // Maps the page addresses to their slots
+  std::map<uint64_t, uint64_t> index;
+
+  // The addresses of recently rejected pages; direct-mapped
+  std::vector<uint64_t> ghosts;
+
+  // tracks number of pages which were read from the flash cache
+  uint64_t hits;
+
+  // tracks number of pages which were not found in the flash cache
+  uint64_t misses;
+};
+
+} // namespace upscaledb
+
+#endif // UPS_FLASH_CACHE_H
@@ -101,7 +101,7 @@ Changeset::clear()
 }
 
 void
-Changeset::flush(uint64_t lsn)
+Changeset::flush()
 {
   // now flush all modified pages to disk
   if (collection.is_empty())
@@ -116,10 +116,17 @@ Changeset::flush(uint64_t lsn)
   if (visitor.list.empty())
     return;
 
+  // reserve the lsn of this changeset only now, because an empty
+  // changeset does not need one; it's also the position of the changeset
+  // in the journal
+  Journal *journal = env->journal.get();
+  LsnTicket ticket = journal->reserve();
+  uint64_t lsn = ticket.lsn;
+
   // Append all changes to the journal. This operation basically
   // "write-ahead logs" all changes.
-  env->journal->append_changeset(visitor.list,
-                  env->page_manager->last_blob_page_id(), lsn);
+  journal->append_changeset(visitor.list,
+                  env->page_manager->last_blob_page_id(), ticket);
 
   UPS_INDUCE_ERROR(ErrorInducer::kChangesetFlush);
 
@@ -131,8 +138,14 @@ Changeset::flush(uint64_t lsn)
   // The modified pages are now flushed (and unlocked) asynchronously
   // to the database file
   env->page_manager->run_async(boost::bind(&flush_changeset_to_file,
-                          visitor.list, env->device.get(), env->journal.get(),
+                          visitor.list, env->device.get(), journal,
                           lsn, ISSET(env->config.flags, UPS_ENABLE_FSYNC)));
+
+  // The worker thread processes its messages in order; a checkpoint is
+  // therefore written after the pages of this changeset were flushed
+  if (journal->schedule_checkpoint(lsn))
+    env->page_manager->run_async(boost::bind(&Journal::write_checkpoint,
+                          journal));
 }
 
 } // namespace upscaledb
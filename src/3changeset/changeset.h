@@ -85,10 +85,11 @@ struct Changeset {
 
   /*
    * Flush all pages in the changeset - first write them to the log, then
-   * write them to the disk.
+   * write them to the disk. The lsn of the changeset is reserved in the
+   * journal. Requires an enabled journal.
    * On success: will clear the changeset and the journal
    */
-  void flush(uint64_t lsn);
+  void flush();
 
   /* The Environment */
   LocalEnv *env;
@@ -30,7 +30,7 @@
 #include "2compressor/compressor_factory.h"
 #include "3journal/journal.h"
 #include "3page_manager/page_manager.h"
-#include "4db/db.h"
+#include "4db/db_local.h"
 #include "4txn/txn_local.h"
 #include "4env/env_local.h"
 #include "4context/context.h"
@@ -49,6 +49,10 @@ enum {
 
   // flush buffers if this limit is exceeded
   kBufferLimit = 1024 * 1024, // 1 mb
+
+  // modified ranges of a page are merged if they are separated by less
+  // than |kDeltaMergeGap| unmodified bytes
+  kDeltaMergeGap = sizeof(PJournalEntryPageDelta),
 };
 
 static inline void
@@ -95,12 +99,26 @@ log_file_path(JournalState &state, int i)
   return (path);
 }
 
+// Writes a record to a file
+static inline void
+write_record(JournalState &state, int idx, JournalRecord &record)
+{
+  std::vector<File::IoBuffer> iov(record.segments.size());
+  for (size_t i = 0; i < record.segments.size(); i++) {
+    const JournalRecord::Segment &s = record.segments[i];
+    iov[i].data = s.data ? s.data : record.buffer.data() + s.offset;
+    iov[i].size = s.size;
+  }
+
+  state.files[idx].writev(iov.data(), iov.size());
+  state.count_bytes_flushed.fetch_add(record.size());
+}
+
 static inline void
 flush_buffer(JournalState &state, int idx, bool fsync = false)
 {
-  if (likely(state.buffer.size() > 0)) {
-    state.files[idx].write(state.buffer.data(), state.buffer.size());
-    state.count_bytes_flushed += state.buffer.size();
+  if (likely(!state.buffer.is_empty())) {
+    write_record(state, idx, state.buffer);
 
     state.buffer.clear();
     if (unlikely(fsync))
@@ -108,6 +126,57 @@ flush_buffer(JournalState &state, int idx, bool fsync = false)
   }
 }
 
+// Stores the CRC32C of the entry at |position| (and all data that was
+// appended after it) in the entry header. Only if UPS_ENABLE_CRC32 is set.
+static inline void
+seal_entry(JournalState &state, JournalRecord &record, size_t position)
+{
+  if (NOTSET(state.env->config.flags, UPS_ENABLE_CRC32))
+    return;
+
+  // 0 means "no checksum"
+  uint32_t checksum = record.checksum(position);
+  if (unlikely(checksum == 0))
+    checksum = 1;
+
+  // the checksum is the last field of the header
+  record.overwrite(position + sizeof(PJournalEntry) - sizeof(uint32_t),
+                  (uint8_t *)&checksum, sizeof(checksum));
+}
+
+// Returns false if the checksum of an entry does not match its data, i.e.
+// because the entry was not completely written. If UPS_ENABLE_CRC32 is
+// set then all entries are sealed (see seal_entry()), and an entry without
+// checksum is also rejected.
+static inline bool
+verify_entry(JournalState &state, const PJournalEntry *entry,
+                const void *followup)
+{
+  if (entry->checksum == 0) {
+    if (unlikely(ISSET(state.env->config.flags, UPS_ENABLE_CRC32))) {
+      ups_log(("missing checksum in journal entry with lsn %lu",
+                  (unsigned long)entry->lsn));
+      return false;
+    }
+    return true;
+  }
+
+  PJournalEntry copy = *entry;
+  copy.checksum = 0;
+  uint32_t checksum = Crc32c::compute(&copy, sizeof(copy));
+  checksum = Crc32c::compute(followup, (size_t)entry->followup_size,
+                  checksum);
+  if (unlikely(checksum == 0))
+    checksum = 1;
+
+  if (unlikely(checksum != entry->checksum)) {
+    ups_log(("checksum mismatch in journal entry with lsn %lu",
+                (unsigned long)entry->lsn));
+    return false;
+  }
+  return true;
+}
+
 // Sequentially returns the next journal entry, starting with
 // the oldest entry.
 //
@@ -162,6 +231,13 @@ read_entry(JournalState &state, Journal::Iterator *iter, PJournalEntry *entry,
 
     iter->offset += sizeof(*entry);
 
+    // a torn entry at the end of the file?
+    if (unlikely(iter->offset + entry->followup_size > filesize)) {
+      ups_log(("truncated journal entry, aborting recovery"));
+      entry->lsn = 0;
+      return;
+    }
+
     // read auxiliary data if it's available
     if (entry->followup_size) {
       auxbuffer->resize((uint32_t)entry->followup_size);
@@ -170,6 +246,9 @@ read_entry(JournalState &state, Journal::Iterator *iter, PJournalEntry *entry,
                       (size_t)entry->followup_size);
       iter->offset += entry->followup_size;
     }
+
+    if (unlikely(!verify_entry(state, entry, auxbuffer->data())))
+      entry->lsn = 0; // this triggers the end of recovery
   }
   catch (Exception &) {
     ups_trace(("failed to read journal entry, aborting recovery"));
@@ -178,9 +257,9 @@ read_entry(JournalState &state, Journal::Iterator *iter, PJournalEntry *entry,
 }
 
 
-// Appends an entry to the journal
+// Appends an entry to a record; the data is copied
 static inline void
-append_entry(JournalState &state, int idx,
+append_entry(JournalRecord &record,
             const uint8_t *ptr1 = 0, size_t ptr1_size = 0,
             const uint8_t *ptr2 = 0, size_t ptr2_size = 0,
             const uint8_t *ptr3 = 0, size_t ptr3_size = 0,
@@ -188,15 +267,15 @@ append_entry(JournalState &state, int idx,
             const uint8_t *ptr5 = 0, size_t ptr5_size = 0)
 {
   if (ptr1_size)
-    state.buffer.append(ptr1, ptr1_size);
+    record.append(ptr1, ptr1_size);
   if (ptr2_size)
-    state.buffer.append(ptr2, ptr2_size);
+    record.append(ptr2, ptr2_size);
   if (ptr3_size)
-    state.buffer.append(ptr3, ptr3_size);
+    record.append(ptr3, ptr3_size);
   if (ptr4_size)
-    state.buffer.append(ptr4, ptr4_size);
+    record.append(ptr4, ptr4_size);
   if (ptr5_size)
-    state.buffer.append(ptr5, ptr5_size);
+    record.append(ptr5, ptr5_size);
 }
 
 // Switches the log file if necessary; returns the new log descriptor in the
@@ -283,30 +362,396 @@ abort_uncommitted_txns(JournalState &state, LocalTxnManager *txn_manager)
   }
 }
 
+// Appends the payload of an entry. The compressor's arena is reused for
+// the next payload and therefore copied; all other payloads are only
+// referenced
+static inline void
+append_payload(JournalState &state, JournalRecord &buffer, const void *data,
+                size_t size)
+{
+  if (state.compressor.get() && data == state.compressor->arena.data())
+    buffer.append((const uint8_t *)data, size);
+  else
+    buffer.append_reference((const uint8_t *)data, size);
+}
+
+// Compares a page with its persisted image and stores the modified ranges
+// in |state.page_delta|. Returns false if the page has to be logged as
+// a full image, i.e. because it is not yet stored in the file or because
+// the delta is not much smaller than the page.
+//
+// During recovery, the ranges are applied to whatever is stored in the
+// file. This works because all modifications of a page are logged in
+// changesets (and replayed in order), and the ranges of a page always
+// describe the differences to the page's previous changeset.
+//
+// The persisted image is read from the Device, i.e. each logged page
+// costs an additional synchronous read while the changeset is built
+// (see the metric journal_page_base_reads).
+static inline bool
+build_page_delta(JournalState &state, Page *page, uint32_t page_size)
+{
+  // in-memory Environments do not have a persisted image
+  if (ISSET(state.env->flags(), UPS_IN_MEMORY))
+    return false;
+
+  // the page was reused from a punched hole; older changesets, which are
+  // replayed during recovery, do not describe the zeroed file contents
+  if (page->is_punched()) {
+    page->set_punched(false);
+    return false;
+  }
+
+  Device *device = state.env->device.get();
+  if (page->address() + page_size > device->file_size())
+    return false;
+
+  state.page_base.resize(page_size);
+  device->read(page->address(), state.page_base.data(), page_size);
+  state.count_page_base_reads++;
+
+  const uint8_t *before = state.page_base.data();
+  const uint8_t *after = (const uint8_t *)page->data();
+  uint32_t limit = page_size / 2;
+
+  state.page_delta.set_size(0);
+
+  uint32_t i = 0;
+  while (true) {
+    // skip the unmodified bytes
+    while (i + 64 <= page_size && ::memcmp(before + i, after + i, 64) == 0)
+      i += 64;
+    while (i < page_size && before[i] == after[i])
+      i++;
+    if (i == page_size)
+      break;
+
+    // find the end of this range
+    uint32_t end = i + 1;
+    for (uint32_t j = end; j < page_size && j < end + kDeltaMergeGap; j++) {
+      if (before[j] != after[j])
+        end = j + 1;
+    }
+
+    if (state.page_delta.size() + sizeof(PJournalEntryPageDelta) + (end - i)
+            > limit)
+      return false;
+
+    PJournalEntryPageDelta delta(i, end - i);
+    state.page_delta.append((uint8_t *)&delta, sizeof(delta));
+    state.page_delta.append(after + i, end - i);
+    i = end;
+  }
+
+  return !state.page_delta.is_empty();
+}
+
+// Applies the modified ranges of a page (see build_page_delta())
+static inline void
+apply_page_delta(uint8_t *data, uint32_t page_size, const uint8_t *delta,
+                uint32_t delta_size)
+{
+  const uint8_t *end = delta + delta_size;
+  while (delta < end) {
+    PJournalEntryPageDelta range;
+    ::memcpy(&range, delta, sizeof(range));
+    delta += sizeof(range);
+
+    if (unlikely(range.offset + range.size > page_size
+                || delta + range.size > end)) {
+      ups_log(("invalid page delta in journal"));
+      throw Exception(UPS_INTEGRITY_VIOLATED);
+    }
+
+    ::memcpy(data + range.offset, delta, range.size);
+    delta += range.size;
+  }
+}
+
 // Helper function which adds a single page from the changeset to
-// the Journal; returns the page size (or compressed size, if compression
-// was enabled)
+// |buffer|; returns the size of the logged data (the modified ranges,
+// or the page size or compressed size, if compression was enabled)
 static inline uint32_t
-append_changeset_page(JournalState &state, Page *page, uint32_t page_size)
+build_changeset_page(JournalState &state, JournalRecord &buffer, Page *page,
+                uint32_t page_size)
 {
   PJournalEntryPageHeader header(page->address());
 
+  if (build_page_delta(state, page, page_size)) {
+    header.delta_size = (uint32_t)state.page_delta.size();
+    append_entry(buffer, (uint8_t *)&header, sizeof(header),
+                    state.page_delta.data(), header.delta_size);
+    return header.delta_size + sizeof(header);
+  }
+
   if (state.compressor.get()) {
     state.count_bytes_before_compression += page_size;
     header.compressed_size = state.compressor->compress((uint8_t *)page->data(),
                     page_size);
-    append_entry(state, state.current_fd, (uint8_t *)&header, sizeof(header),
+    append_entry(buffer, (uint8_t *)&header, sizeof(header),
                     state.compressor->arena.data(),
                     header.compressed_size);
     state.count_bytes_after_compression += header.compressed_size;
     return header.compressed_size + sizeof(header);
   }
 
-  append_entry(state, state.current_fd, (uint8_t *)&header, sizeof(header),
-                (uint8_t *)page->data(), page_size);
+  append_entry(buffer, (uint8_t *)&header, sizeof(header));
+  append_payload(state, buffer, page->data(), page_size);
   return page_size + sizeof(header);
 }
 
+// Builds the journal entry for ups_txn_begin/kEntryTypeTxnBegin
+static inline void
+build_txn_begin(JournalState &state, JournalRecord &buffer, LocalTxn *txn,
+                const char *name, uint64_t lsn)
+{
+  assert(NOTSET(txn->flags, UPS_TXN_TEMPORARY));
+
+  PJournalEntry entry;
+  entry.txn_id = txn->id;
+  entry.type = Journal::kEntryTypeTxnBegin;
+  entry.lsn = lsn;
+  if (name)
+    entry.followup_size = ::strlen(name) + 1;
+
+  size_t entry_position = buffer.position();
+
+  if (unlikely(name != 0))
+    append_entry(buffer, (uint8_t *)&entry, (uint32_t)sizeof(entry),
+                (uint8_t *)name, (uint32_t)entry.followup_size);
+  else
+    append_entry(buffer, (uint8_t *)&entry, (uint32_t)sizeof(entry));
+
+  seal_entry(state, buffer, entry_position);
+}
+
+// Builds the journal entry for ups_txn_commit/kEntryTypeTxnCommit
+static inline void
+build_txn_commit(JournalState &state, JournalRecord &buffer, LocalTxn *txn,
+                uint64_t lsn)
+{
+  assert(NOTSET(txn->flags, UPS_TXN_TEMPORARY));
+
+  PJournalEntry entry;
+  entry.lsn = lsn;
+  entry.txn_id = txn->id;
+  entry.type = Journal::kEntryTypeTxnCommit;
+
+  size_t entry_position = buffer.position();
+  append_entry(buffer, (uint8_t *)&entry, sizeof(entry));
+  seal_entry(state, buffer, entry_position);
+}
+
+// Builds the journal entry for ups_insert/kEntryTypeInsert
+static inline void
+build_insert(JournalState &state, JournalRecord &buffer, Db *db, LocalTxn *txn,
+                ups_key_t *key, ups_record_t *record, uint32_t flags,
+                uint64_t lsn)
+{
+  flags &= ~(UPS_HINT_PREPEND | UPS_HINT_APPEND);
+
+  PJournalEntry entry;
+
+  entry.lsn = lsn;
+  entry.dbname = db->name();
+  entry.type = Journal::kEntryTypeInsert;
+  entry.txn_id = ISSET(txn->flags, UPS_TXN_TEMPORARY) ? 0 : txn->id;
+  // the followup_size will be filled in later when we know whether
+  // compression is used
+  entry.followup_size = sizeof(PJournalEntryInsert) - 1;
+
+  PJournalEntryInsert insert;
+  insert.key_size = key->size;
+  insert.record_size = record->size;
+  insert.insert_flags = flags;
+
+  // we need the current position in the record. if compression is enabled
+  // then we do not know the actual followup-size of this entry. it will be
+  // patched in later.
+  size_t entry_position = buffer.position();
+
+  // write the header information
+  append_entry(buffer, (uint8_t *)&entry, sizeof(entry),
+              (uint8_t *)&insert, sizeof(PJournalEntryInsert) - 1);
+
+  // try to compress the payload; if the compressed result is smaller than
+  // the original (uncompressed) payload then use it
+  const void *key_data = key->data;
+  uint32_t key_size = key->size;
+  if (state.compressor.get()) {
+    state.count_bytes_before_compression += key_size;
+    uint32_t len = state.compressor->compress((uint8_t *)key->data, key->size);
+    if (len < key->size) {
+      key_size = len;
+      key_data = state.compressor->arena.data();
+      insert.compressed_key_size = len;
+    }
+    state.count_bytes_after_compression += key_size;
+  }
+  append_payload(state, buffer, key_data, key_size);
+  entry.followup_size += key_size;
+
+  // and now the same for the record data
+  const void *record_data = record->data;
+  uint32_t record_size = record->size;
+  if (state.compressor.get()) {
+    state.count_bytes_before_compression += record_size;
+    uint32_t len = state.compressor->compress((uint8_t *)record->data,
+                    record_size);
+    if (len < record_size) {
+      record_size = len;
+      record_data = state.compressor->arena.data();
+      insert.compressed_record_size = len;
+    }
+    state.count_bytes_after_compression += record_size;
+  }
+  append_payload(state, buffer, record_data, record_size);
+  entry.followup_size += record_size;
+
+  // now overwrite the patched entry
+  buffer.overwrite(entry_position, (uint8_t *)&entry, sizeof(entry));
+  buffer.overwrite(entry_position + sizeof(entry),
+                  (uint8_t *)&insert, sizeof(PJournalEntryInsert) - 1);
+
+  seal_entry(state, buffer, entry_position);
+}
+
+// Builds the journal entry for ups_erase/kEntryTypeErase
+static inline void
+build_erase(JournalState &state, JournalRecord &buffer, Db *db, LocalTxn *txn,
+                ups_key_t *key, int duplicate_index, uint32_t flags,
+                uint64_t lsn)
+{
+  PJournalEntry entry;
+  PJournalEntryErase erase;
+  const void *payload_data = key->data;
+  uint32_t payload_size = key->size;
+
+  // try to compress the payload; if the compressed result is smaller than
+  // the original (uncompressed) payload then use it
+  if (state.compressor.get()) {
+    state.count_bytes_before_compression += payload_size;
+    uint32_t len = state.compressor->compress((uint8_t *)key->data, key->size);
+    if (len < key->size) {
+      payload_data = state.compressor->arena.data();
+      payload_size = len;
+      erase.compressed_key_size = len;
+    }
+    state.count_bytes_after_compression += payload_size;
+  }
+
+  entry.lsn = lsn;
+  entry.dbname = db->name();
+  entry.type = Journal::kEntryTypeErase;
+  entry.txn_id = ISSET(txn->flags, UPS_TXN_TEMPORARY) ? 0 : txn->id;
+  entry.followup_size = sizeof(PJournalEntryErase) + payload_size - 1;
+  erase.key_size = key->size;
+  erase.erase_flags = flags;
+  erase.duplicate = duplicate_index;
+
+  size_t entry_position = buffer.position();
+  append_entry(buffer, (uint8_t *)&entry, sizeof(entry),
+                (uint8_t *)&erase, sizeof(PJournalEntryErase) - 1);
+  append_payload(state, buffer, payload_data, payload_size);
+  seal_entry(state, buffer, entry_position);
+}
+
+// Builds the journal entries of all operations of a Txn
+static inline void
+build_txn_operations(JournalState &state, JournalRecord &buffer, LocalTxn *txn)
+{
+  for (TxnOperation *op = txn->oldest_op;
+                  op != 0;
+                  op = op->next_in_txn) {
+    if (ISSET(op->flags, TxnOperation::kErase)) {
+      build_erase(state, buffer, op->node->db, txn,
+                      op->node->key(), op->referenced_duplicate,
+                      op->original_flags, op->lsn);
+      continue;
+    }
+    if (ISSET(op->flags, TxnOperation::kInsert)) {
+      build_insert(state, buffer, op->node->db, txn,
+                      op->node->key(), &op->record,
+                      op->original_flags, op->lsn);
+      continue;
+    }
+    if (ISSET(op->flags, TxnOperation::kInsertOverwrite)) {
+      build_insert(state, buffer, op->node->db, txn,
+                      op->node->key(), &op->record,
+                      op->original_flags | UPS_OVERWRITE, op->lsn);
+      continue;
+    }
+    if (ISSET(op->flags, TxnOperation::kInsertDuplicate)) {
+      build_insert(state, buffer, op->node->db, txn,
+                      op->node->key(), &op->record,
+                      op->original_flags | UPS_DUPLICATE, op->lsn);
+      continue;
+    }
+    assert(!"shouldn't be here");
+  }
+}
+
+// Builds the journal entry for a whole changeset/kEntryTypeChangeset
+static inline void
+build_changeset(JournalState &state, JournalRecord &buffer,
+                std::vector<Page *> &pages, uint64_t last_blob_page,
+                uint64_t lsn)
+{
+  PJournalEntry entry;
+  PJournalEntryChangeset changeset;
+  
+  entry.lsn = lsn;
+  entry.dbname = 0;
+  entry.txn_id = 0;
+  entry.type = Journal::kEntryTypeChangeset;
+  // followup_size is incomplete - the actual page sizes are added later
+  entry.followup_size = sizeof(PJournalEntryChangeset);
+  changeset.num_pages = pages.size();
+  changeset.last_blob_page = last_blob_page;
+
+  // we need the current position in the record. if compression is enabled
+  // then we do not know the actual followup-size of this entry. it will be
+  // patched in later.
+  size_t entry_position = buffer.position();
+
+  append_entry(buffer, (uint8_t *)&entry, sizeof(entry),
+                (uint8_t *)&changeset, sizeof(PJournalEntryChangeset));
+
+  size_t page_size = state.env->config.page_size_bytes;
+  for (std::vector<Page *>::iterator it = pages.begin();
+                  it != pages.end();
+                  ++it) {
+    entry.followup_size += build_changeset_page(state, buffer, *it,
+                    page_size);
+  }
+
+  UPS_INDUCE_ERROR(ErrorInducer::kChangesetFlush);
+
+  // and patch in the followup-size
+  buffer.overwrite(entry_position, (uint8_t *)&entry, sizeof(entry));
+  seal_entry(state, buffer, entry_position);
+
+  UPS_INDUCE_ERROR(ErrorInducer::kChangesetFlush);
+}
+
+// Builds the journal entry for a checkpoint/kEntryTypeCheckpoint
+static inline void
+build_checkpoint(JournalState &state, JournalRecord &buffer, uint64_t lsn,
+                uint64_t changeset_lsn)
+{
+  PJournalEntry entry;
+  PJournalEntryCheckpoint checkpoint(changeset_lsn);
+
+  entry.lsn = lsn;
+  entry.type = Journal::kEntryTypeCheckpoint;
+  entry.followup_size = sizeof(PJournalEntryCheckpoint);
+
+  size_t entry_position = buffer.position();
+  append_entry(buffer, (uint8_t *)&entry, sizeof(entry),
+                (uint8_t *)&checkpoint, sizeof(checkpoint));
+  seal_entry(state, buffer, entry_position);
+}
+
 // Scans a file for the oldest changeset. Returns the lsn of this
 // changeset.
 static inline uint64_t
@@ -341,10 +786,52 @@ scan_for_oldest_changeset(JournalState &state, File *file)
   return 0;
 }
 
-// Redo all Changesets of a log file, in chronological order
+// Scans a file for checkpoints. Returns the changeset lsn of the newest
+// checkpoint, or 0 if there is none.
+static inline uint64_t
+scan_for_newest_checkpoint(JournalState &state, File *file)
+{
+  Journal::Iterator it;
+  PJournalEntry entry;
+  uint64_t changeset_lsn = 0;
+
+  try {
+    uint64_t filesize = file->file_size();
+
+    while (it.offset < filesize) {
+      file->pread(it.offset, &entry, sizeof(entry));
+
+      if (entry.lsn == 0)
+        break;
+
+      if (entry.type == Journal::kEntryTypeCheckpoint) {
+        PJournalEntryCheckpoint checkpoint;
+        if (entry.followup_size != sizeof(checkpoint))
+          break;
+        file->pread(it.offset + sizeof(entry), &checkpoint,
+                        sizeof(checkpoint));
+        // a torn checkpoint must not cause changesets to be skipped
+        if (!verify_entry(state, &entry, &checkpoint))
+          break;
+        changeset_lsn = std::max(changeset_lsn, checkpoint.changeset_lsn);
+      }
+
+      // increment the offset
+      it.offset += sizeof(entry) + entry.followup_size;
+    }
+  }
+  catch (Exception &ex) {
+    ups_log(("exception (error %d) while reading journal", ex.code));
+  }
+
+  return changeset_lsn;
+}
+
+// Redo all Changesets of a log file, in chronological order. Changesets
+// which are covered by the checkpoint |checkpoint_lsn| are skipped.
 // Returns the highest lsn of the last changeset applied
 static inline uint64_t
-redo_all_changesets(JournalState &state, int fdidx)
+redo_all_changesets(JournalState &state, int fdidx, uint64_t checkpoint_lsn)
 {
   Journal::Iterator it;
   PJournalEntry entry;
@@ -364,14 +851,30 @@ redo_all_changesets(JournalState &state, int fdidx)
         continue;
       }
 
-      max_lsn = entry.lsn;
-
       it.offset += sizeof(entry);
 
+      // Read the whole changeset; a torn changeset (i.e. the last one in
+      // the file) is not applied
+      if (it.offset + entry.followup_size > log_file_size
+            || entry.followup_size < sizeof(PJournalEntryChangeset)) {
+        ups_log(("truncated changeset in journal"));
+        break;
+      }
+      buffer.resize((uint32_t)entry.followup_size);
+      state.files[fdidx].pread(it.offset, buffer.data(),
+                      (size_t)entry.followup_size);
+      it.offset += entry.followup_size;
+      if (!verify_entry(state, &entry, buffer.data()))
+        break;
+
+      max_lsn = entry.lsn;
+
       // Read the Changeset header
+      const uint8_t *p = buffer.data();
+      const uint8_t *end = p + entry.followup_size;
       PJournalEntryChangeset changeset;
-      state.files[fdidx].pread(it.offset, &changeset, sizeof(changeset));
-      it.offset += sizeof(changeset);
+      ::memcpy(&changeset, p, sizeof(changeset));
+      p += sizeof(changeset);
 
       uint32_t page_size = state.env->config.page_size_bytes;
       ByteArray arena(page_size);
@@ -381,35 +884,60 @@ redo_all_changesets(JournalState &state, int fdidx)
 
       state.env->page_manager->set_last_blob_page_id(changeset.last_blob_page);
 
+      // the pages of this changeset are already persisted
+      if (entry.lsn <= checkpoint_lsn) {
+        state.count_skipped_changesets++;
+        continue;
+      }
+      state.count_recovered_changesets++;
+
       // for each page in this changeset...
       for (uint32_t i = 0; i < changeset.num_pages; i++) {
         PJournalEntryPageHeader page_header;
-        state.files[fdidx].pread(it.offset, &page_header,
-                        sizeof(page_header));
-        it.offset += sizeof(page_header);
-        if (page_header.compressed_size > 0) {
-          tmp.resize(page_size);
-          state.files[fdidx].pread(it.offset, tmp.data(),
-                        page_header.compressed_size);
-          it.offset += page_header.compressed_size;
-          state.compressor->decompress(tmp.data(),
-                        page_header.compressed_size, page_size, &arena);
+        if (unlikely(p + sizeof(page_header) > end)) {
+          ups_log(("invalid changeset in journal"));
+          throw Exception(UPS_INTEGRITY_VIOLATED);
+        }
+        ::memcpy(&page_header, p, sizeof(page_header));
+        p += sizeof(page_header);
+
+        uint32_t payload_size = page_header.delta_size > 0
+                                  ? page_header.delta_size
+                                  : page_header.compressed_size > 0
+                                      ? page_header.compressed_size
+                                      : page_size;
+        if (unlikely(p + payload_size > end)) {
+          ups_log(("invalid changeset in journal"));
+          throw Exception(UPS_INTEGRITY_VIOLATED);
+        }
+
+        if (page_header.delta_size > 0) {
+          tmp.resize(page_header.delta_size);
+          ::memcpy(tmp.data(), p, page_header.delta_size);
+          p += page_header.delta_size;
+        }
+        else if (page_header.compressed_size > 0) {
+          state.compressor->decompress(p, page_header.compressed_size,
+                        page_size, &arena);
+          p += page_header.compressed_size;
         }
         else {
-          state.files[fdidx].pread(it.offset, arena.data(), page_size);
-          it.offset += page_size;
+          ::memcpy(arena.data(), p, page_size);
+          p += page_size;
         }
 
         Page *page;
 
-        // now write the page to disk
-        if (page_header.address == file_size) {
+        // now write the page to disk; a delta is applied to the persisted
+        // page, which therefore has to be fetched (or created)
+        if (page_header.address == file_size
+                && page_header.delta_size == 0) {
           file_size += page_size;
 
           page = new Page(state.env->device.get());
           page->alloc(0);
         }
-        else if (page_header.address > file_size) {
+        else if (page_header.address >= file_size) {
           file_size = (size_t)page_header.address + page_size;
           state.env->device->truncate(file_size);
 
@@ -426,7 +954,11 @@ redo_all_changesets(JournalState &state, int fdidx)
         assert(page->address() == page_header.address);
 
         // overwrite the page data
-        ::memcpy(page->data(), arena.data(), page_size);
+        if (page_header.delta_size > 0)
+          apply_page_delta((uint8_t *)page->data(), page_size, tmp.data(),
+                        page_header.delta_size);
+        else
+          ::memcpy(page->data(), arena.data(), page_size);
 
         // flush the modified page to disk
         page->set_dirty(true);
@@ -459,11 +991,18 @@ recover_changeset(JournalState &state)
   if (lsn1 == 0 && lsn2 == 0)
     return 0;
 
+  // changesets which are older than the newest checkpoint are skipped
+  uint64_t checkpoint_lsn = std::max(
+                  scan_for_newest_checkpoint(state, &state.files[0]),
+                  scan_for_newest_checkpoint(state, &state.files[1]));
+
   // now redo all changesets chronologically
   state.current_fd = lsn1 < lsn2 ? 0 : 1;
 
-  uint64_t max_lsn1 = redo_all_changesets(state, state.current_fd);
-  uint64_t max_lsn2 = redo_all_changesets(state, state.current_fd == 0 ? 1 : 0);
+  uint64_t max_lsn1 = redo_all_changesets(state, state.current_fd,
+                  checkpoint_lsn);
+  uint64_t max_lsn2 = redo_all_changesets(state,
+                  state.current_fd == 0 ? 1 : 0, checkpoint_lsn);
 
   // return the lsn of the newest changeset
   return std::max(max_lsn1, max_lsn2);
@@ -630,6 +1169,10 @@ recover_journal(JournalState &state, Context *context,
         // skip this; the changeset was already applied
         break;
       }
+      case Journal::kEntryTypeCheckpoint: {
+        // skip this; checkpoints are only relevant for the changesets
+        break;
+      }
       default:
         ups_log(("invalid journal entry type or journal is corrupt"));
         st = UPS_IO_ERROR;
@@ -659,13 +1202,46 @@ bail:
 
 
 JournalState::JournalState(LocalEnv *env_)
-  : env(env_), current_fd(0), num_transactions(0),
+  : env(env_), current_fd(0), buffer(false), num_transactions(0),
     threshold(env_->config.journal_switch_threshold),
     disable_logging(false), count_bytes_flushed(0),
-    count_bytes_before_compression(0), count_bytes_after_compression(0)
+    count_bytes_before_compression(0), count_bytes_after_compression(0),
+    count_changeset_pages(0), count_page_base_reads(0),
+    checkpoint_bytes(env_->config.journal_checkpoint_bytes),
+    checkpoint_seconds(env_->config.journal_checkpoint_seconds),
+    scheduled_checkpoint_time(::time(0)), checkpoint_pending(false),
+    count_checkpoints(0), count_recovered_changesets(0),
+    count_skipped_changesets(0),
+    pipeline(&env_->lsn_manager, JournalWriter(this))
 {
   if (threshold == 0)
     threshold = kSwitchTxnThreshold;
+
+  // in-memory Environments are never recovered
+  if (ISSET(env_->flags(), UPS_IN_MEMORY)) {
+    checkpoint_bytes = 0;
+    checkpoint_seconds = 0;
+  }
+}
+
+void
+JournalWriter::operator()(uint64_t lsn, JournalRecord &record,
+                uint32_t flags)
+{
+  // a Txn is always written to the current file; switch the files
+  // if the current file is full
+  if (ISSET(flags, kTxnRecord)) {
+    switch_files_maybe(*state);
+    state->num_transactions++;
+  }
+
+  // entries which were appended without the pipeline are written first
+  flush_buffer(*state, state->current_fd);
+
+  write_record(*state, state->current_fd, record);
+
+  if (ISSET(state->env->flags(), UPS_ENABLE_FSYNC))
+    state->files[state->current_fd].flush();
 }
 
 Journal::Journal(LocalEnv *env)
@@ -673,7 +1249,7 @@ Journal::Journal(LocalEnv *env)
 {
   int algo = env->config.journal_compressor;
   if (algo)
-    state.compressor.reset(CompressorFactory::create(algo));
+    state.compressor.reset(env->create_compressor(algo));
 }
 
 void
@@ -709,23 +1285,8 @@ Journal::append_txn_begin(LocalTxn *txn, const char *name, uint64_t lsn)
   if (unlikely(state.disable_logging))
     return;
 
-  assert(NOTSET(txn->flags, UPS_TXN_TEMPORARY));
-
-  PJournalEntry entry;
-  entry.txn_id = txn->id;
-  entry.type = Journal::kEntryTypeTxnBegin;
-  entry.lsn = lsn;
-  if (name)
-    entry.followup_size = ::strlen(name) + 1;
-
-  int cur = txn->log_descriptor = switch_files_maybe(state);
-
-  if (unlikely(txn->name.size()))
-    append_entry(state, cur, (uint8_t *)&entry, (uint32_t)sizeof(entry),
-                (uint8_t *)txn->name.c_str(), (uint32_t)txn->name.size() + 1);
-  else
-    append_entry(state, cur, (uint8_t *)&entry, (uint32_t)sizeof(entry));
-
+  txn->log_descriptor = switch_files_maybe(state);
+  build_txn_begin(state, state.buffer, txn, name, lsn);
   state.num_transactions++;
 }
 
@@ -735,14 +1296,7 @@ Journal::append_txn_commit(LocalTxn *txn, uint64_t lsn)
   if (unlikely(state.disable_logging))
     return;
 
-  assert(NOTSET(txn->flags, UPS_TXN_TEMPORARY));
-
-  PJournalEntry entry;
-  entry.lsn = lsn;
-  entry.txn_id = txn->id;
-  entry.type = Journal::kEntryTypeTxnCommit;
-
-  append_entry(state, txn->log_descriptor, (uint8_t *)&entry, sizeof(entry));
+  build_txn_commit(state, state.buffer, txn, lsn);
 
   // flush after commit
   flush_buffer(state, state.current_fd,
@@ -757,81 +1311,12 @@ Journal::append_insert(Db *db, LocalTxn *txn,
   if (unlikely(state.disable_logging))
     return;
 
-  flags &= ~(UPS_HINT_PREPEND | UPS_HINT_APPEND);
-
-  PJournalEntry entry;
-
-  entry.lsn = lsn;
-  entry.dbname = db->name();
-  entry.type = Journal::kEntryTypeInsert;
-  // the followup_size will be filled in later when we know whether
-  // compression is used
-  entry.followup_size = sizeof(PJournalEntryInsert) - 1;
-
-  int idx;
   if (ISSET(txn->flags, UPS_TXN_TEMPORARY)) {
-    entry.txn_id = 0;
-    idx = switch_files_maybe(state);
+    switch_files_maybe(state);
     state.num_transactions++;
   }
-  else {
-    entry.txn_id = txn->id;
-    idx = txn->log_descriptor;
-  }
-
-  PJournalEntryInsert insert;
-  insert.key_size = key->size;
-  insert.record_size = record->size;
-  insert.insert_flags = flags;
-
-  // we need the current position in the file buffer. if compression is enabled
-  // then we do not know the actual followup-size of this entry. it will be
-  // patched in later.
-  uint32_t entry_position = state.buffer.size();
-
-  // write the header information
-  append_entry(state, idx, (uint8_t *)&entry, sizeof(entry),
-              (uint8_t *)&insert, sizeof(PJournalEntryInsert) - 1);
-
-  // try to compress the payload; if the compressed result is smaller than
-  // the original (uncompressed) payload then use it
-  const void *key_data = key->data;
-  uint32_t key_size = key->size;
-  if (state.compressor.get()) {
-    state.count_bytes_before_compression += key_size;
-    uint32_t len = state.compressor->compress((uint8_t *)key->data, key->size);
-    if (len < key->size) {
-      key_size = len;
-      key_data = state.compressor->arena.data();
-      insert.compressed_key_size = len;
-    }
-    state.count_bytes_after_compression += key_size;
-  }
-  append_entry(state, idx, (uint8_t *)key_data, key_size);
-  entry.followup_size += key_size;
 
-  // and now the same for the record data
-  const void *record_data = record->data;
-  uint32_t record_size = record->size;
-  if (state.compressor.get()) {
-    state.count_bytes_before_compression += record_size;
-    uint32_t len = state.compressor->compress((uint8_t *)record->data,
-                    record_size);
-    if (len < record_size) {
-      record_size = len;
-      record_data = state.compressor->arena.data();
-      insert.compressed_record_size = len;
-    }
-    state.count_bytes_after_compression += record_size;
-  }
-  append_entry(state, idx, (uint8_t *)record_data, record_size);
-  entry.followup_size += record_size;
-
-  // now overwrite the patched entry
-  state.buffer.overwrite(entry_position,
-                  (uint8_t *)&entry, sizeof(entry));
-  state.buffer.overwrite(entry_position + sizeof(entry),
-                  (uint8_t *)&insert, sizeof(PJournalEntryInsert) - 1);
+  build_insert(state, state.buffer, db, txn, key, record, flags, lsn);
 
   if (ISSET(txn->flags, UPS_TXN_TEMPORARY))
     flush_buffer(state, state.current_fd,
@@ -845,104 +1330,135 @@ Journal::append_erase(Db *db, LocalTxn *txn, ups_key_t *key,
   if (unlikely(state.disable_logging))
     return;
 
-  PJournalEntry entry;
-  PJournalEntryErase erase;
-  const void *payload_data = key->data;
-  uint32_t payload_size = key->size;
-
-  // try to compress the payload; if the compressed result is smaller than
-  // the original (uncompressed) payload then use it
-  if (state.compressor.get()) {
-    state.count_bytes_before_compression += payload_size;
-    uint32_t len = state.compressor->compress((uint8_t *)key->data, key->size);
-    if (len < key->size) {
-      payload_data = state.compressor->arena.data();
-      payload_size = len;
-      erase.compressed_key_size = len;
-    }
-    state.count_bytes_after_compression += payload_size;
-  }
-
-  entry.lsn = lsn;
-  entry.dbname = db->name();
-  entry.type = Journal::kEntryTypeErase;
-  entry.followup_size = sizeof(PJournalEntryErase) + payload_size - 1;
-  erase.key_size = key->size;
-  erase.erase_flags = flags;
-  erase.duplicate = duplicate_index;
-
-  int idx;
   if (ISSET(txn->flags, UPS_TXN_TEMPORARY)) {
-    entry.txn_id = 0;
-    idx = switch_files_maybe(state);
+    switch_files_maybe(state);
     state.num_transactions++;
   }
-  else {
-    entry.txn_id = txn->id;
-    idx = txn->log_descriptor;
-  }
 
-  // append the entry to the logfile
-  append_entry(state, idx, (uint8_t *)&entry, sizeof(entry),
-                (uint8_t *)&erase, sizeof(PJournalEntryErase) - 1,
-                (uint8_t *)payload_data, payload_size);
+  build_erase(state, state.buffer, db, txn, key, duplicate_index, flags, lsn);
 
   if (ISSET(txn->flags, UPS_TXN_TEMPORARY))
     flush_buffer(state, state.current_fd,
                     ISSET(state.env->flags(), UPS_ENABLE_FSYNC));
 }
 
+void
+Journal::append_txn(LocalTxn *txn, const LsnTicket &ticket)
+{
+  if (unlikely(state.disable_logging)) {
+    state.pipeline.cancel(ticket);
+    return;
+  }
+
+  JournalRecord &buffer = state.pipeline.record(ticket);
+
+  try {
+    bool temporary = ISSET(txn->flags, UPS_TXN_TEMPORARY);
+    if (!temporary)
+      build_txn_begin(state, buffer, txn,
+                      txn->name.empty() ? 0 : txn->name.c_str(), txn->lsn);
+    build_txn_operations(state, buffer, txn);
+    if (!temporary)
+      build_txn_commit(state, buffer, txn, txn->commit_lsn);
+  }
+  catch (Exception &ex) {
+    state.pipeline.cancel(ticket);
+    throw ex;
+  }
+
+  state.pipeline.publish(ticket, JournalWriter::kTxnRecord);
+  txn->log_descriptor = state.current_fd;
+}
+
 int
 Journal::append_changeset(std::vector<Page *> &pages,
-                uint64_t last_blob_page, uint64_t lsn)
+                uint64_t last_blob_page, const LsnTicket &ticket)
 {
   assert(pages.size() > 0);
 
-  if (unlikely(state.disable_logging))
+  if (unlikely(state.disable_logging)) {
+    state.pipeline.cancel(ticket);
     return -1;
+  }
 
-  PJournalEntry entry;
-  PJournalEntryChangeset changeset;
-  
-  entry.lsn = lsn;
-  entry.dbname = 0;
-  entry.txn_id = 0;
-  entry.type = Journal::kEntryTypeChangeset;
-  // followup_size is incomplete - the actual page sizes are added later
-  entry.followup_size = sizeof(PJournalEntryChangeset);
-  changeset.num_pages = pages.size();
-  changeset.last_blob_page = last_blob_page;
+  try {
+    build_changeset(state, state.pipeline.record(ticket), pages,
+                    last_blob_page, ticket.lsn);
+  }
+  catch (Exception &ex) {
+    state.pipeline.cancel(ticket);
+    throw ex;
+  }
 
-  // we need the current position in the file buffer. if compression is enabled
-  // then we do not know the actual followup-size of this entry. it will be
-  // patched in later.
-  uint32_t entry_position = state.buffer.size();
+  // and write the record to the file
+  state.pipeline.publish(ticket, 0);
+  state.count_changeset_pages += pages.size();
 
-  // write the data to the file
-  append_entry(state, state.current_fd, (uint8_t *)&entry, sizeof(entry),
-                (uint8_t *)&changeset, sizeof(PJournalEntryChangeset));
+  UPS_INDUCE_ERROR(ErrorInducer::kChangesetFlush);
 
-  size_t page_size = state.env->config.page_size_bytes;
-  for (std::vector<Page *>::iterator it = pages.begin();
-                  it != pages.end();
-                  ++it) {
-    entry.followup_size += append_changeset_page(state, *it, page_size);
-  }
+  return state.current_fd;
+}
 
-  UPS_INDUCE_ERROR(ErrorInducer::kChangesetFlush);
+bool
+Journal::schedule_checkpoint(uint64_t lsn)
+{
+  if (likely(state.checkpoint_bytes == 0 && state.checkpoint_seconds == 0))
+    return false;
+  if (unlikely(state.disable_logging) || state.checkpoint_pending.load())
+    return false;
+
+  time_t now = ::time(0);
+  bool due = (state.checkpoint_bytes != 0
+                && state.count_bytes_flushed.load()
+                        - state.scheduled_checkpoint.bytes_flushed
+                    >= state.checkpoint_bytes)
+          || (state.checkpoint_seconds != 0
+                && now - state.scheduled_checkpoint_time
+                    >= (time_t)state.checkpoint_seconds);
+  if (!due)
+    return false;
+
+  state.scheduled_checkpoint.lsn = lsn;
+  state.scheduled_checkpoint.bytes_flushed = state.count_bytes_flushed.load();
+  state.scheduled_checkpoint.changeset_pages = state.count_changeset_pages;
+  state.scheduled_checkpoint_time = now;
+  state.checkpoint_pending = true;
+  return true;
+}
 
-  // and patch in the followup-size
-  state.buffer.overwrite(entry_position, (uint8_t *)&entry, sizeof(entry));
+void
+Journal::write_checkpoint()
+{
+  assert(state.checkpoint_pending);
 
-  UPS_INDUCE_ERROR(ErrorInducer::kChangesetFlush);
+  // |scheduled_checkpoint| is not modified while the checkpoint is pending
+  JournalCheckpoint checkpoint = state.scheduled_checkpoint;
 
-  // and flush the file
-  flush_buffer(state, state.current_fd,
-                  ISSET(state.env->flags(), UPS_ENABLE_FSYNC));
+  try {
+    // the pages of the changesets were written by the calling thread, but
+    // they might not yet be durable
+    state.env->device->flush();
+
+    LsnTicket ticket = state.pipeline.reserve();
+    try {
+      build_checkpoint(state, state.pipeline.record(ticket), ticket.lsn,
+                      checkpoint.lsn);
+    }
+    catch (Exception &ex) {
+      state.pipeline.cancel(ticket);
+      throw ex;
+    }
+    state.pipeline.publish(ticket, 0);
 
-  UPS_INDUCE_ERROR(ErrorInducer::kChangesetFlush);
+    ScopedSpinlock lock(state.checkpoint_lock);
+    state.last_checkpoint = checkpoint;
+    state.count_checkpoints++;
+  }
+  catch (Exception &ex) {
+    ups_log(("failed to write journal checkpoint (error %d)", ex.code));
+  }
 
-  return state.current_fd;
+  state.checkpoint_pending = false;
 }
 
 void
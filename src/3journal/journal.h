@@ -37,6 +37,12 @@
  * was written. In case of a commit or a changeset there will also be an
  * fsync, if UPS_ENABLE_FSYNC is enabled.
  *
+ * A committed Txn (with all its operations) and a changeset are each
+ * written as a single record. The record's lsn is reserved in an
+ * LsnPipeline (see 2lsn_manager/lsn_pipeline.h), the record is built in
+ * a private buffer of the pipeline, and the pipeline then writes the
+ * records to the files strictly in lsn order.
+ *
  * The physical information is a collection of pages which are modified in
  * one or more database operations (i.e. ups_db_erase). This collection is
  * called a "changeset" and implemented in changeset.h/.cc. As soon as the
@@ -45,6 +51,11 @@
  * Otherwise the whole changeset is appended to the journal, and afterwards
  * the database file is modified.
  *
+ * A page of a changeset is usually not logged as a full image. Instead, the
+ * page is compared with its persisted image, and only the modified byte
+ * ranges are logged. Full images are used for pages which are not yet
+ * stored in the file, and if most of the page was modified.
+ *
  * For recovery to work, each page stores the lsn of its last modification.
  *
  * When recovering, the Journal first extracts the newest/latest entry.
@@ -64,6 +75,15 @@
  * already applied, and we know that all older changesets
  * have already been written successfully to the database file.
  *
+ * Checkpoints limit the number of changesets which are re-applied. If a
+ * checkpoint interval is configured (in bytes and/or seconds), then a
+ * checkpoint is scheduled after a changeset was appended. The PageManager's
+ * worker thread, which flushes the pages of the changesets in lsn order,
+ * then syncs the database file and appends a checkpoint entry with the
+ * lsn of this changeset. Writers are not blocked in the meantime. The
+ * recovery skips all changesets which are not newer than the most recent
+ * checkpoint, because their pages are already persisted.
+ *
  * @exception_safe: basic
  * @thread_safe: no
  */
@@ -128,7 +148,10 @@ struct Journal
     kEntryTypeErase      = 5,
 
     // marks a whole changeset operation (writes modified pages)
-    kEntryTypeChangeset  = 6
+    kEntryTypeChangeset  = 6,
+
+    // marks a checkpoint; all older changesets are persisted
+    kEntryTypeCheckpoint = 7
   };
 
   //
@@ -189,11 +212,37 @@ struct Journal
                   ups_key_t *key, int duplicate_index, uint32_t flags,
                   uint64_t lsn);
 
+  // Reserves the lsn and the position of the next journal record; must
+  // be followed by append_txn(), append_changeset() or cancel()
+  LsnTicket reserve() {
+    return state.pipeline.reserve();
+  }
+
+  // Releases a reservation without writing a record
+  void cancel(const LsnTicket &ticket) {
+    state.pipeline.cancel(ticket);
+  }
+
+  // Appends all journal entries of a committed Txn (begin, operations
+  // and commit) as a single record; |ticket| was reserved when the Txn
+  // was committed
+  void append_txn(LocalTxn *txn, const LsnTicket &ticket);
+
   // Appends a journal entry for a whole changeset/kEntryTypeChangeset
   // Returns the current file descriptor, which is the parameter for
   // on_changeset_flush()
   int append_changeset(std::vector<Page *> &pages, uint64_t last_blob_page,
-                  uint64_t lsn);
+                  const LsnTicket &ticket);
+
+  // Schedules a checkpoint for the changeset |lsn| if the checkpoint
+  // interval is exceeded, and no other checkpoint is pending. Returns
+  // false if no checkpoint was scheduled.
+  bool schedule_checkpoint(uint64_t lsn);
+
+  // Syncs the database file and appends the scheduled checkpoint; called
+  // by the PageManager's worker thread after it flushed the pages of
+  // the scheduled changeset
+  void write_checkpoint();
 
   // Empties the journal, removes all entries
   void clear();
@@ -207,11 +256,21 @@ struct Journal
 
   // Fills the metrics
   void fill_metrics(ups_env_metrics_t *metrics) {
-    metrics->journal_bytes_flushed = state.count_bytes_flushed;
+    metrics->journal_bytes_flushed = state.count_bytes_flushed.load();
     metrics->journal_bytes_before_compression
             = state.count_bytes_before_compression;
     metrics->journal_bytes_after_compression
             = state.count_bytes_after_compression;
+    metrics->journal_page_base_reads = state.count_page_base_reads;
+
+
+    ScopedSpinlock lock(state.checkpoint_lock);
+    metrics->journal_checkpoints = state.count_checkpoints;
+    metrics->journal_checkpoint_lsn = state.last_checkpoint.lsn;
+    metrics->journal_recovery_bytes = state.count_bytes_flushed.load()
+            - state.last_checkpoint.bytes_flushed;
+    metrics->journal_recovery_pages = state.count_changeset_pages
+            - state.last_checkpoint.changeset_pages;
   }
 
   // Flushes all buffers to disk. Used for testing.
@@ -49,7 +49,7 @@ UPS_PACK_0 struct UPS_PACK_1 PJournalEntry {
   // Constructor - sets all fields to 0
   PJournalEntry()
     : lsn(0), followup_size(0), txn_id(0), type(0),
-        dbname(0), _reserved(0) {
+        dbname(0), checksum(0) {
   }
 
   // the lsn of this entry
@@ -62,13 +62,14 @@ UPS_PACK_0 struct UPS_PACK_1 PJournalEntry {
   uint64_t txn_id;
 
   // the type of this entry
-  uint32_t type;
+  uint16_t type;
 
   // the name of the database which is modified by this entry
   uint16_t dbname;
 
-  // a reserved value - reqd for padding
-  uint16_t _reserved;
+  // CRC32C of this header (with |checksum| set to 0) and the follow-up
+  // data; 0 if the entry was written without UPS_ENABLE_CRC32
+  uint32_t checksum;
 } UPS_PACK_2;
 
 #include "1base/packstop.h"
@@ -186,10 +187,15 @@ UPS_PACK_0 struct UPS_PACK_1 PJournalEntryChangeset {
 //
 // a Journal entry for a single page
 //
+// The entry is followed either by the full page image (which can be
+// compressed), or - if |delta_size| is not 0 - by a list of
+// PJournalEntryPageDelta structures which describe the modified ranges
+// of the page
+//
 UPS_PACK_0 struct UPS_PACK_1 PJournalEntryPageHeader {
   // Constructor - sets all fields to 0
   PJournalEntryPageHeader(uint64_t _address = 0)
-    : address(_address), compressed_size(0) {
+    : address(_address), compressed_size(0), delta_size(0) {
   }
 
   // the page address
@@ -197,6 +203,50 @@ UPS_PACK_0 struct UPS_PACK_1 PJournalEntryPageHeader {
 
   // the compressed size, if compression is enabled
   uint32_t compressed_size;
+
+  // the size of the deltas (including their headers), if the page is
+  // not stored as a full image
+  uint32_t delta_size;
+} UPS_PACK_2;
+
+#include "1base/packstop.h"
+
+
+#include "1base/packstart.h"
+
+//
+// a modified range of a page; followed by |size| bytes of the new data
+//
+UPS_PACK_0 struct UPS_PACK_1 PJournalEntryPageDelta {
+  // Constructor
+  PJournalEntryPageDelta(uint32_t _offset = 0, uint32_t _size = 0)
+    : offset(_offset), size(_size) {
+  }
+
+  // the offset of the range in the page
+  uint32_t offset;
+
+  // the size of the range
+  uint32_t size;
+} UPS_PACK_2;
+
+#include "1base/packstop.h"
+
+
+#include "1base/packstart.h"
+
+//
+// a Journal entry for a checkpoint
+//
+UPS_PACK_0 struct UPS_PACK_1 PJournalEntryCheckpoint {
+  // Constructor - sets all fields to 0
+  PJournalEntryCheckpoint(uint64_t _changeset_lsn = 0)
+    : changeset_lsn(_changeset_lsn) {
+  }
+
+  // the pages of this changeset (and of all older changesets) are
+  // persisted in the database file
+  uint64_t changeset_lsn;
 } UPS_PACK_2;
 
 #include "1base/packstop.h"
@@ -23,12 +23,18 @@
 
 #include <vector>
 #include <string>
+#include <ctime>
+#include <algorithm>
+#include <boost/atomic.hpp>
 
 #include "ups/types.h" // for metrics
 
+#include "1base/crc32c.h"
 #include "1base/dynamic_array.h"
 #include "1base/scoped_ptr.h"
+#include "1base/spinlock.h"
 #include "1os/file.h"
+#include "2lsn_manager/lsn_pipeline.h"
 #include "2page/page_collection.h"
 #include "2compressor/compressor.h"
 
@@ -42,6 +48,151 @@ namespace upscaledb {
 
 struct Db;
 struct LocalEnv;
+struct JournalState;
+
+// A journal record. Headers and small payloads are copied into a buffer,
+// large payloads are only referenced. The record is written with a single
+// File::writev().
+struct JournalRecord {
+  enum {
+    // payloads smaller than this are always copied
+    kMinReferenceSize = 512
+  };
+
+  // A part of the record
+  struct Segment {
+    // the referenced data; null if the data was copied to |buffer|
+    const uint8_t *data;
+
+    // the offset of the copied data in |buffer|
+    size_t offset;
+
+    // the size of the data
+    size_t size;
+  };
+
+  // Constructor; if |allow_references_| is false then all data is copied
+  JournalRecord(bool allow_references_ = true)
+    : allow_references(allow_references_), total_size(0) {
+  }
+
+  // Copies data to the record
+  void append(const uint8_t *ptr, size_t size) {
+    if (segments.empty() || segments.back().data != 0) {
+      Segment s = {0, buffer.size(), 0};
+      segments.push_back(s);
+    }
+    buffer.append(ptr, size);
+    segments.back().size += size;
+    total_size += size;
+  }
+
+  // Appends a payload without copying it (unless it's small); the data must
+  // remain valid till the record was written
+  void append_reference(const uint8_t *ptr, size_t size) {
+    if (!allow_references || size < kMinReferenceSize) {
+      append(ptr, size);
+      return;
+    }
+    Segment s = {ptr, 0, size};
+    segments.push_back(s);
+    total_size += size;
+  }
+
+  // Returns the position of the next copied byte; used for overwrite()
+  size_t position() const {
+    return buffer.size();
+  }
+
+  // Overwrites copied data, i.e. to patch an entry header
+  void overwrite(size_t position, const uint8_t *ptr, size_t size) {
+    buffer.overwrite((uint32_t)position, ptr, size);
+  }
+
+  // Returns the CRC32C of the data starting at the copied byte at
+  // |position|, up to the end of the record
+  uint32_t checksum(size_t position) const {
+    uint32_t crc = 0;
+    bool started = false;
+    for (size_t i = 0; i < segments.size(); i++) {
+      const Segment &s = segments[i];
+      if (s.data) {
+        if (started)
+          crc = Crc32c::compute(s.data, s.size, crc);
+        continue;
+      }
+      if (position >= s.offset + s.size)
+        continue;
+      size_t begin = std::max(position, s.offset);
+      crc = Crc32c::compute(buffer.data() + begin, s.offset + s.size - begin,
+                      crc);
+      started = true;
+    }
+    return crc;
+  }
+
+  // Returns the total size of the record
+  size_t size() const {
+    return total_size;
+  }
+
+  // Returns true if the record is empty
+  bool is_empty() const {
+    return total_size == 0;
+  }
+
+  // Removes all data
+  void clear() {
+    buffer.clear();
+    segments.clear();
+    total_size = 0;
+  }
+
+  // Set to false if all data is copied
+  bool allow_references;
+
+  // The total size of all segments
+  size_t total_size;
+
+  // The copied data
+  ByteArray buffer;
+
+  // The segments, in the order in which they are written
+  std::vector<Segment> segments;
+};
+
+// Writes the records of the LsnPipeline to the journal files
+struct JournalWriter {
+  enum {
+    // the record is a (committed or temporary) Txn
+    kTxnRecord = 1
+  };
+
+  JournalWriter(JournalState *state_)
+    : state(state_) {
+  }
+
+  // Appends a record to the current journal file
+  void operator()(uint64_t lsn, JournalRecord &record, uint32_t flags);
+
+  JournalState *state;
+};
+
+// A checkpoint; the pages of all changesets up to |lsn| are persisted
+struct JournalCheckpoint {
+  JournalCheckpoint()
+    : lsn(0), bytes_flushed(0), changeset_pages(0) {
+  }
+
+  // the lsn of the newest changeset which is covered by the checkpoint
+  uint64_t lsn;
+
+  // the value of JournalState::count_bytes_flushed after this changeset
+  uint64_t bytes_flushed;
+
+  // the value of JournalState::count_changeset_pages after this changeset
+  uint64_t changeset_pages;
+};
 
 struct JournalState {
   JournalState(LocalEnv *env_);
@@ -55,8 +206,8 @@ struct JournalState {
   // The two file descriptors
   File files[2];
 
-  // Buffer for writing data to the files
-  ByteArray buffer;
+  // Buffer for writing data to the files; copies all data
+  JournalRecord buffer;
 
   // Counts all transactions in the current file
   uint32_t num_transactions;
@@ -68,8 +219,9 @@ struct JournalState {
   // Set to false to disable logging; used during recovery
   bool disable_logging;
 
-  // Counting the flushed bytes (for ups_env_get_metrics)
-  uint64_t count_bytes_flushed;
+  // Counting the flushed bytes (for ups_env_get_metrics); updated by the
+  // consumer of the pipeline, which can run in the worker thread
+  boost::atomic<uint64_t> count_bytes_flushed;
 
   // Counting the bytes before compression (for ups_env_get_metrics)
   uint64_t count_bytes_before_compression;
@@ -77,12 +229,56 @@ struct JournalState {
   // Counting the bytes after compression (for ups_env_get_metrics)
   uint64_t count_bytes_after_compression;
 
+  // Counting the logged pages of all changesets (for ups_env_get_metrics)
+  uint64_t count_changeset_pages;
+
+  // Counting the pages which were read from the file as the base of a
+  // page delta (for ups_env_get_metrics)
+  uint64_t count_page_base_reads;
+
+  // A checkpoint is scheduled if this many bytes were flushed since the
+  // previous checkpoint; 0 if disabled
+  uint64_t checkpoint_bytes;
+
+  // A checkpoint is scheduled if this many seconds passed since the
+  // previous checkpoint; 0 if disabled
+  uint32_t checkpoint_seconds;
+
+  // The most recently scheduled checkpoint, and the time when it was
+  // scheduled
+  JournalCheckpoint scheduled_checkpoint;
+  time_t scheduled_checkpoint_time;
+
+  // true while a scheduled checkpoint was not yet written
+  boost::atomic<bool> checkpoint_pending;
+
+  // The newest checkpoint which was written, and the number of written
+  // checkpoints; both are protected by |checkpoint_lock| because they
+  // are updated by the PageManager's worker thread
+  JournalCheckpoint last_checkpoint;
+  uint64_t count_checkpoints;
+  Spinlock checkpoint_lock;
+
+  // Counting the changesets which the recovery applied, and those which
+  // it skipped because they were covered by a checkpoint (for testing)
+  uint64_t count_recovered_changesets;
+  uint64_t count_skipped_changesets;
+
   // A map of all opened databases
   typedef std::map<uint16_t, Db *> DatabaseMap;
   DatabaseMap database_map;
 
   // The compressor; can be null
   ScopedPtr<Compressor> compressor;
+
+  // Temporary buffers for the persisted image of a page and for the
+  // modified ranges of the page
+  ByteArray page_base;
+  ByteArray page_delta;
+
+  // Allocates the lsns of the journal records and writes the records
+  // in lsn order
+  LsnPipeline<JournalWriter, JournalRecord> pipeline;
 };
 
 } // namespace upscaledb
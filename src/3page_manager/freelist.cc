@@ -18,6 +18,8 @@
 
 #include "0root/root.h"
 
+#include <string.h>
+
 // Always verify that a file of level N does not include headers > N!
 #include "1base/error.h"
 #include "1base/pickle.h"
@@ -29,6 +31,76 @@
 
 namespace upscaledb {
 
+// Adds an extent to both indices; |freed| is the time when the extent
+// was freed
+static inline void
+insert_extent(Freelist *freelist, uint64_t page_id, size_t page_count,
+                time_t freed)
+{
+  freelist->free_pages[page_id] = page_count;
+  freelist->free_extents.insert(std::make_pair(page_count, page_id));
+  freelist->free_times[page_id] = freed;
+  freelist->free_page_count += page_count;
+}
+
+// Removes an extent from both indices; returns the time when the extent
+// was freed
+static inline time_t
+erase_extent(Freelist *freelist, Freelist::FreeMap::iterator it)
+{
+  time_t freed = 0;
+  Freelist::TimeMap::iterator tit = freelist->free_times.find(it->first);
+  if (tit != freelist->free_times.end()) {
+    freed = tit->second;
+    freelist->free_times.erase(tit);
+  }
+  freelist->free_extents.erase(std::make_pair(it->second, it->first));
+  freelist->free_page_count -= it->second;
+  freelist->free_pages.erase(it);
+  return freed;
+}
+
+// Returns the time when two merged extents were freed; the times are
+// weighted by the sizes of the extents, otherwise freeing a single page
+// would restart the timer of a large idle extent
+static inline time_t
+merge_free_times(time_t freed1, size_t page_count1, time_t freed2,
+                size_t page_count2)
+{
+  return freed1 + (time_t)((int64_t)(freed2 - freed1) * (int64_t)page_count2
+                            / (int64_t)(page_count1 + page_count2));
+}
+
+// Appends the parts of the range which are not yet covered by punched
+// holes to |extents|
+static inline void
+collect_unpunched(const Freelist *freelist, uint64_t page_id,
+                size_t page_count,
+                std::vector<std::pair<uint64_t, size_t> > *extents)
+{
+  uint32_t page_size = freelist->config.page_size_bytes;
+  uint64_t end = page_id + page_count * page_size;
+
+  // start with the hole which precedes |page_id|, if there is one
+  Freelist::FreeMap::const_iterator it = freelist->holes.upper_bound(page_id);
+  if (it != freelist->holes.begin())
+    it--;
+
+  for (; it != freelist->holes.end() && it->first < end; it++) {
+    uint64_t hole_end = it->first + it->second * page_size;
+    if (hole_end <= page_id)
+      continue;
+    if (it->first > page_id)
+      extents->push_back(std::make_pair(page_id,
+                              (size_t)((it->first - page_id) / page_size)));
+    page_id = hole_end;
+  }
+
+  if (page_id < end)
+    extents->push_back(std::make_pair(page_id,
+                            (size_t)((end - page_id) / page_size)));
+}
+
 std::pair<bool, Freelist::FreeMap::const_iterator>
 Freelist::encode_state(std::pair<bool, Freelist::FreeMap::const_iterator> cont,
                 uint8_t *data, size_t data_size)
@@ -46,24 +118,22 @@ Freelist::encode_state(std::pair<bool, Freelist::FreeMap::const_iterator> cont,
   p += 4;   // leave room for the counter
 
   while (it != free_pages.end()) {
-    // 9 bytes is the maximum amount of storage that we will need for a
-    // new entry; if it does not fit then break
-    if ((p + 9) - data >= (ptrdiff_t)data_size)
-      break;
-
-    // check if the next entry (and the following) are adjacent; if yes then
-    // they are merged. Up to 16 pages can be merged.
-    uint32_t page_counter = 1;
+    // check if the following entries are adjacent; if yes then they
+    // are merged
+    Freelist::FreeMap::const_iterator next = it;
     uint64_t base = it->first;
     assert(base % page_size == 0);
-    uint64_t current = it->first;
-
-    // move to the next entry, then merge all adjacent pages
-    for (it++; it != free_pages.end() && page_counter < 16 - 1; it++) {
-      if (it->first != current + page_size)
+    uint64_t page_counter = 0;
+    for (; next != free_pages.end(); next++) {
+      if (next->first != base + page_counter * page_size)
         break;
-      current += page_size;
-      page_counter++;
+      page_counter += next->second;
+    }
+
+    // skip empty entries
+    if (page_counter == 0) {
+      it = next;
+      continue;
     }
 
     // now |base| is the start of a sequence of free pages, and the
@@ -74,10 +144,32 @@ Freelist::encode_state(std::pair<bool, Freelist::FreeMap::const_iterator> cont,
     //   - 4 bits for |page_counter|
     //   - 4 bits for the number of bytes following ("n")
     // - n byte page-id (div page_size)
-    assert(page_counter < 16);
-    int num_bytes = Pickle::encode_u64(p + 1, base / page_size);
-    *p = (page_counter << 4) | num_bytes;
-    p += 1 + num_bytes;
+    //
+    // Sequences with 16 or more pages store 0 as |page_counter|, followed
+    // by
+    // - 1 byte for the number of bytes following ("m")
+    // - m byte |page_counter|
+    uint8_t entry[1 + 8 + 1 + 8];
+    int num_bytes = Pickle::encode_u64(&entry[1], base / page_size);
+    size_t entry_size = 1 + num_bytes;
+    if (page_counter < 16) {
+      entry[0] = (uint8_t)((page_counter << 4) | num_bytes);
+    }
+    else {
+      entry[0] = (uint8_t)num_bytes;
+      int counter_bytes = Pickle::encode_u64(&entry[entry_size + 1],
+                                page_counter);
+      entry[entry_size] = (uint8_t)counter_bytes;
+      entry_size += 1 + counter_bytes;
+    }
+
+    // if the entry does not fit then break
+    if ((p + entry_size) - data > (ptrdiff_t)data_size)
+      break;
+
+    ::memcpy(p, entry, entry_size);
+    p += entry_size;
+    it = next;
 
     counter++;
   }
@@ -103,16 +195,24 @@ Freelist::decode_state(uint8_t *data)
   // now read all pages
   for (uint32_t i = 0; i < counter; i++) {
     // 4 bits page_counter, 4 bits for number of following bytes
-    int page_counter = (*data & 0xf0) >> 4;
+    uint64_t page_counter = (*data & 0xf0) >> 4;
     int num_bytes = *data & 0x0f;
-    assert(page_counter > 0);
     assert(num_bytes <= 8);
     data += 1;
 
     uint64_t id = Pickle::decode_u64(num_bytes, data);
     data += num_bytes;
 
-    free_pages[id * page_size] = page_counter;
+    // a long sequence; the page counter follows
+    if (page_counter == 0) {
+      num_bytes = *data;
+      assert(num_bytes <= 8);
+      data += 1;
+      page_counter = Pickle::decode_u64(num_bytes, data);
+      data += num_bytes;
+    }
+
+    put(id * page_size, (size_t)page_counter);
   }
 }
 
@@ -122,20 +222,18 @@ Freelist::alloc(size_t num_pages)
   uint64_t address = 0;
   uint32_t page_size = config.page_size_bytes;
 
-  for (FreeMap::iterator it = free_pages.begin();
-            it != free_pages.end();
-            it++) {
-    if (it->second == num_pages) {
-      address = it->first;
-      free_pages.erase(it);
-      break;
-    }
-    if (it->second > num_pages) {
-      address = it->first;
-      free_pages[it->first + num_pages * page_size] = it->second - num_pages;
-      free_pages.erase(it);
-      break;
-    }
+  // pick the smallest extent which is large enough; if there are several
+  // then pick the one with the lowest address
+  SizeIndex::iterator sit = free_extents.lower_bound(
+                  std::make_pair(num_pages, (uint64_t)0));
+  if (sit != free_extents.end()) {
+    address = sit->second;
+    size_t page_count = sit->first;
+
+    time_t freed = erase_extent(this, free_pages.find(address));
+    if (page_count > num_pages)
+      insert_extent(this, address + num_pages * page_size,
+                      page_count - num_pages, freed);
   }
 
   if (address != 0)
@@ -146,16 +244,137 @@ Freelist::alloc(size_t num_pages)
   return address;
 }
 
+uint64_t
+Freelist::alloc_below(uint64_t upper_bound)
+{
+  if (free_pages.empty() || free_pages.begin()->first >= upper_bound)
+    return 0;
+
+  FreeMap::iterator it = free_pages.begin();
+  uint64_t address = it->first;
+  size_t page_count = it->second;
+
+  time_t freed = erase_extent(this, it);
+  if (page_count > 1)
+    insert_extent(this, address + config.page_size_bytes, page_count - 1,
+                    freed);
+  return address;
+}
+
 void
 Freelist::put(uint64_t page_id, size_t page_count)
 {
-  free_pages[page_id] = page_count;
+  uint32_t page_size = config.page_size_bytes;
+  time_t freed = ::time(0);
+
+  // merge with the following extent
+  FreeMap::iterator it = free_pages.lower_bound(page_id);
+  if (it != free_pages.end()
+          && it->first == page_id + page_count * page_size) {
+    size_t next_count = it->second;
+    freed = merge_free_times(freed, page_count, erase_extent(this, it),
+                    next_count);
+    page_count += next_count;
+    it = free_pages.lower_bound(page_id);
+  }
+
+  // merge with the previous extent
+  if (it != free_pages.begin()) {
+    it--;
+    assert(it->first + it->second * page_size <= page_id);
+    if (it->first + it->second * page_size == page_id) {
+      size_t prev_count = it->second;
+      page_id = it->first;
+      freed = merge_free_times(freed, page_count, erase_extent(this, it),
+                      prev_count);
+      page_count += prev_count;
+    }
+  }
+
+  insert_extent(this, page_id, page_count, freed);
+}
+
+void
+Freelist::collect_holes(time_t deadline, size_t min_pages,
+                std::vector<std::pair<uint64_t, size_t> > *extents)
+{
+  uint32_t page_size = config.page_size_bytes;
+
+  // a merged extent can be partially punched; only the remaining parts
+  // are returned
+  for (SizeIndex::reverse_iterator it = free_extents.rbegin();
+                  it != free_extents.rend() && it->first >= min_pages;
+                  it++) {
+    if (free_times[it->second] <= deadline)
+      collect_unpunched(this, it->second, it->first, extents);
+  }
+
+  // track the new holes; they are merged with adjacent holes
+  for (size_t i = 0; i < extents->size(); i++) {
+    uint64_t page_id = (*extents)[i].first;
+    size_t page_count = (*extents)[i].second;
+
+    FreeMap::iterator next = holes.lower_bound(page_id);
+    if (next != holes.end()
+            && next->first == page_id + page_count * page_size) {
+      page_count += next->second;
+      holes.erase(next);
+    }
+    FreeMap::iterator prev = holes.lower_bound(page_id);
+    if (prev != holes.begin()) {
+      prev--;
+      if (prev->first + prev->second * page_size == page_id) {
+        prev->second += page_count;
+        continue;
+      }
+    }
+    holes[page_id] = page_count;
+  }
+}
+
+bool
+Freelist::fill_hole(uint64_t page_id, size_t page_count)
+{
+  if (holes.empty())
+    return false;
+
+  uint32_t page_size = config.page_size_bytes;
+  uint64_t end = page_id + page_count * page_size;
+  bool filled = false;
+
+  // start with the hole which precedes |page_id|, if there is one
+  FreeMap::iterator it = holes.upper_bound(page_id);
+  if (it != holes.begin())
+    it--;
+
+  while (it != holes.end() && it->first < end) {
+    uint64_t hole_start = it->first;
+    uint64_t hole_end = it->first + it->second * page_size;
+    if (hole_end <= page_id) {
+      it++;
+      continue;
+    }
+
+    // split the hole; keep the parts which are not allocated
+    filled = true;
+    holes.erase(it++);
+    if (hole_start < page_id)
+      holes[hole_start] = (size_t)((page_id - hole_start) / page_size);
+    if (hole_end > end)
+      holes[end] = (size_t)((hole_end - end) / page_size);
+  }
+
+  return filled;
 }
 
 bool
 Freelist::has(uint64_t page_id) const
 {
-  return free_pages.find(page_id) != free_pages.end();
+  FreeMap::const_iterator it = free_pages.upper_bound(page_id);
+  if (it == free_pages.begin())
+    return false;
+  it--;
+  return page_id < it->first + it->second * config.page_size_bytes;
 }
 
 uint64_t
@@ -178,10 +397,24 @@ Freelist::truncate(uint64_t file_size)
 
   // remove all truncated pages
   while (!free_pages.empty() && free_pages.rbegin()->first >= lower_bound) {
-    free_pages.erase(free_pages.rbegin()->first);
+    erase_extent(this, --free_pages.end());
   }
+  if (lower_bound < file_size)
+    fill_hole(lower_bound, (size_t)((file_size - lower_bound) / page_size));
 
   return lower_bound;
 }
 
+void
+Freelist::fill_metrics(ups_env_metrics_t *metrics) const
+{
+  metrics->freelist_hits = freelist_hits;
+  metrics->freelist_misses = freelist_misses;
+  metrics->freelist_extents = free_pages.size();
+  metrics->freelist_pages = free_page_count;
+  metrics->freelist_largest_extent = free_extents.empty()
+                                        ? 0
+                                        : free_extents.rbegin()->first;
+}
+
 } // namespace upscaledb
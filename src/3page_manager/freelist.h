@@ -19,6 +19,14 @@
 /*
  * The Freelist manages the list of currently unused (free) pages.
  *
+ * Sequences of adjacent free pages ("extents") are merged. The extents are
+ * indexed twice: by address (for merging and for truncating the file) and
+ * by their length, which allows a best-fit allocation in O(log n).
+ *
+ * Large extents which were not reused for a while can release their disk
+ * space ("punch a hole"). The punched ranges are tracked till the pages
+ * are allocated again.
+ *
  * @exception_safe: basic
  * @thread_safe: no
  */
@@ -29,6 +37,11 @@
 #include "0root/root.h"
 
 #include <map>
+#include <set>
+#include <vector>
+#include <ctime>
+
+#include "ups/upscaledb_int.h"
 
 // Always verify that a file of level N does not include headers > N!
 #include "2config/env_config.h"
@@ -41,9 +54,20 @@ namespace upscaledb {
 
 struct Freelist
 {
-  // The freelist maps page-id to number of free pages (usually 1)
+  enum {
+    // extents smaller than this (in bytes) do not release their disk space
+    kMinHoleSize = 1024 * 1024
+  };
+
+  // The freelist maps page-id to number of free pages
   typedef std::map<uint64_t, size_t> FreeMap;
 
+  // The secondary index; stores (number of pages, page-id) of each extent
+  typedef std::set<std::pair<size_t, uint64_t> > SizeIndex;
+
+  // Maps page-id of an extent to the time when it was freed
+  typedef std::map<uint64_t, time_t> TimeMap;
+
   // Constructor
   Freelist(const EnvConfig &config_)
     : config(config_) {
@@ -54,7 +78,11 @@ struct Freelist
   void clear() {
     freelist_hits = 0;
     freelist_misses = 0;
+    free_page_count = 0;
     free_pages.clear();
+    free_extents.clear();
+    free_times.clear();
+    holes.clear();
   }
 
   // Returns true if the freelist is empty
@@ -75,16 +103,35 @@ struct Freelist
   // map
   void decode_state(uint8_t *data);
 
-  // Allocates |num_pages| sequential pages from the freelist; returns the
-  // page id of the first page, or 0 if not successfull
+  // Allocates |num_pages| sequential pages from the smallest extent which
+  // is large enough; returns the page id of the first page, or 0 if not
+  // successfull
   uint64_t alloc(size_t num_pages);
 
-  // Stores a page in the freelist
+  // Allocates the free page with the lowest address, but only if that
+  // address is lower than |upper_bound|; returns 0 otherwise. Used for
+  // compacting the file.
+  uint64_t alloc_below(uint64_t upper_bound);
+
+  // Stores a page in the freelist; merges it with adjacent extents
   void put(uint64_t page_id, size_t page_count);
 
+  // Returns the parts of all extents with at least |min_pages| pages
+  // which were freed before |deadline| and which were not yet punched.
+  // These parts are then tracked as punched holes.
+  void collect_holes(time_t deadline, size_t min_pages,
+                  std::vector<std::pair<uint64_t, size_t> > *extents);
+
+  // Removes allocated pages from the punched holes; returns true if the
+  // pages were (at least partially) punched
+  bool fill_hole(uint64_t page_id, size_t page_count);
+
   // Returns true if a page is in the freelist
   bool has(uint64_t page_id) const;
 
+  // Fills in the fragmentation statistics
+  void fill_metrics(ups_env_metrics_t *metrics) const;
+
   // Tries to truncate the file by counting how many pages at the file's end
   // are unused. Returns the address of the last unused page, or |file_size|
   // if there are no unused pages at the end.
@@ -96,6 +143,19 @@ struct Freelist
   // The map with free pages
   FreeMap free_pages;
 
+  // The extents in |free_pages|, sorted by length
+  SizeIndex free_extents;
+
+  // The time when each extent in |free_pages| was freed; merged extents
+  // store the average of their parts, weighted by size
+  TimeMap free_times;
+
+  // The ranges which released their disk space (page-id, number of pages)
+  FreeMap holes;
+
+  // The total number of pages in |free_pages|
+  uint64_t free_page_count;
+
   // number of successful freelist hits
   uint64_t freelist_hits;
 
@@ -21,10 +21,12 @@
 #include "0root/root.h"
 
 #include <string.h>
+#include <algorithm>
+#include <vector>
 
-#include "3rdparty/murmurhash3/MurmurHash3.h"
 // Always verify that a file of level N does not include headers > N!
 #include "1base/signal.h"
+#include "1base/checksum.h"
 #include "1base/dynamic_array.h"
 #include "2page/page.h"
 #include "2device/device.h"
@@ -41,11 +43,20 @@ namespace upscaledb {
 
 static inline Page *
 alloc_unlocked(PageManagerState *state, Context *context, uint32_t page_type,
-                uint32_t flags);
+                uint32_t flags, uint64_t upper_bound = 0);
 static inline Page *
 fetch_unlocked(PageManagerState *state, Context *context,
                 uint64_t address, uint32_t flags);
 
+// Reads a page from the flash cache, or from the device if the page is
+// not cached
+static inline void
+read_page(PageManagerState *state, Page *page, uint64_t address)
+{
+  if (!state->flash_cache->get(page, address))
+    page->fetch(address);
+}
+
 template <typename T>
 struct Deleter
 {
@@ -99,12 +110,12 @@ async_flush_pages(AsyncFlushMessage *message)
 }
 
 static inline void
-verify_crc32(Page *page)
+verify_crc32(PageManagerState *state, Page *page)
 {
-  uint32_t crc32;
-  MurmurHash3_x86_32(page->payload(),
+  uint32_t crc32 = Checksum::compute(state->config.checksum_algorithm,
+                  page->payload(),
                   page->persisted_data.size - (sizeof(PPageHeader) - 1),
-                  (uint32_t)page->address(), &crc32);
+                  (uint32_t)page->address());
   if (crc32 != page->crc32()) {
     ups_trace(("crc32 mismatch in page %lu: 0x%lx != 0x%lx",
                     page->address(), crc32, page->crc32()));
@@ -112,6 +123,46 @@ verify_crc32(Page *page)
   }
 }
 
+// Releases the disk space of large free extents which were not reused
+// for |config.hole_punch_seconds|
+static inline void
+punch_holes(PageManagerState *state, time_t now)
+{
+  if (state->config.hole_punch_seconds == 0
+        || ISSETANY(state->config.flags, UPS_IN_MEMORY | UPS_READ_ONLY))
+    return;
+
+  // only check once per second
+  if (now == state->last_hole_punch)
+    return;
+  state->last_hole_punch = now;
+
+  uint32_t page_size = state->config.page_size_bytes;
+  size_t min_pages = std::max((size_t)1,
+                  (size_t)Freelist::kMinHoleSize / page_size);
+
+  std::vector<std::pair<uint64_t, size_t> > extents;
+  state->freelist.collect_holes(now - state->config.hole_punch_seconds,
+                  min_pages, &extents);
+
+  for (size_t i = 0; i < extents.size(); i++) {
+    if (state->device->punch_hole(extents[i].first,
+                            extents[i].second * page_size))
+      state->page_count_punched += extents[i].second;
+  }
+}
+
+// Allocates the disk space of pages which are reused from the freelist
+// if they were punched; returns true if that was the case
+static inline bool
+fill_hole(PageManagerState *state, uint64_t address, size_t page_count)
+{
+  if (!state->freelist.fill_hole(address, page_count))
+    return false;
+  state->device->fill_hole(address, page_count * state->config.page_size_bytes);
+  return true;
+}
+
 static inline Page *
 add_to_changeset(Changeset *changeset, Page *page)
 {
@@ -250,7 +301,7 @@ fetch_unlocked(PageManagerState *state, Context *context, uint64_t address,
 
   page = new Page(state->device, context->db);
   try {
-    page->fetch(address);
+    read_page(state, page, address);
   }
   catch (Exception &ex) {
     delete page;
@@ -271,7 +322,12 @@ fetch_unlocked(PageManagerState *state, Context *context, uint64_t address,
   page->set_without_header(ISSET(flags, PageManager::kNoHeader));
   if (!page->is_without_header()
           && ISSET(state->config.flags, UPS_ENABLE_CRC32))
-    verify_crc32(page);
+    verify_crc32(state, page);
+
+  if (address >= state->readahead_start && address < state->readahead_end) {
+    state->readahead_hits++;
+    state->readahead_consumed++;
+  }
 
   state->page_count_fetched++;
   return add_to_changeset(&context->changeset, page);
@@ -279,20 +335,30 @@ fetch_unlocked(PageManagerState *state, Context *context, uint64_t address,
 
 static inline Page *
 alloc_unlocked(PageManagerState *state, Context *context, uint32_t page_type,
-                uint32_t flags)
+                uint32_t flags, uint64_t upper_bound)
 {
   uint64_t address = 0;
   Page *page = 0;
   uint32_t page_size = state->config.page_size_bytes;
   bool allocated = false;
+  bool punched = false;
+
+  /* only use a free page below |upper_bound|, or fail */
+  if (upper_bound != 0) {
+    address = state->freelist.alloc_below(upper_bound);
+    if (address == 0)
+      return 0;
+  }
 
   /* first check the internal list for a free page */
   if (NOTSET(flags, PageManager::kIgnoreFreelist)) {
-    address = state->freelist.alloc(1);
+    if (address == 0)
+      address = state->freelist.alloc(1);
 
     if (address != 0) {
       assert(address % page_size == 0);
       state->needs_flush = true;
+      punched = fill_hole(state, address, 1);
 
       /* try to fetch the page from the cache */
       page = state->cache.get(address);
@@ -300,7 +366,7 @@ alloc_unlocked(PageManagerState *state, Context *context, uint32_t page_type,
         goto done;
       /* otherwise fetch the page from disk */
       page = new Page(state->device, context->db);
-      page->fetch(address);
+      read_page(state, page, address);
       goto done;
     }
   }
@@ -312,6 +378,9 @@ alloc_unlocked(PageManagerState *state, Context *context, uint32_t page_type,
     }
 
     page->alloc(page_type);
+
+    /* the address is reused if the file was truncated */
+    state->flash_cache->del(page->address());
   }
   catch (Exception &ex) {
     if (allocated)
@@ -329,6 +398,7 @@ done:
   page->set_dirty(true);
   page->set_db(context->db);
   page->set_without_header(false);
+  page->set_punched(punched);
   page->set_crc32(0);
 
   if (page->node_proxy()) {
@@ -366,13 +436,19 @@ done:
 }
 
 
-PageManagerState::PageManagerState(LocalEnv *_env)
+PageManagerState::PageManagerState(LocalEnv *_env, FlashCache *_flash_cache)
   : env(_env), config(_env->config), header(_env->header.get()),
     device(_env->device.get()), lsn_manager(&_env->lsn_manager),
-    cache(_env->config), freelist(config), needs_flush(false),
+    cache(_env->config), flash_cache(_flash_cache), freelist(config),
+    needs_flush(false),
     state_page(0), last_blob_page(0), last_blob_page_id(0),
     page_count_fetched(0), page_count_index(0), page_count_blob(0),
-    page_count_page_manager(0), cache_hits(0), cache_misses(0), message(0),
+    page_count_page_manager(0), page_count_relocated(0),
+    page_count_truncated(0), page_count_punched(0), last_hole_punch(0),
+    cache_hits(0), cache_misses(0),
+    readahead_depth(1), readahead_start(0), readahead_end(0),
+    readahead_consumed(0), readahead_pages(0), readahead_hits(0),
+    readahead_wasted(0), message(0),
     worker(new WorkerPool(1))
 {
 }
@@ -387,6 +463,14 @@ PageManagerState::~PageManagerState()
   last_blob_page = 0;
 }
 
+PageManager::PageManager(LocalEnv *env)
+  : flash_cache(new FlashCache(env->config)),
+    state(new PageManagerState(env, flash_cache.get()))
+{
+  if (!env->config.flash_cache_filename.empty())
+    flash_cache->open(env->header->write_counter());
+}
+
 void
 PageManager::initialize(uint64_t pageid)
 {
@@ -399,7 +483,7 @@ PageManager::initialize(uint64_t pageid)
   state->state_page = new Page(state->device);
   state->state_page->fetch(pageid);
   if (ISSET(state->config.flags, UPS_ENABLE_CRC32))
-    verify_crc32(state->state_page);
+    verify_crc32(state.get(), state->state_page);
 
   Page *page = state->state_page;
 
@@ -434,6 +518,63 @@ PageManager::fetch(Context *context, uint64_t address, uint32_t flags)
   return fetch_unlocked(state.get(), context, address, flags);
 }
 
+void
+PageManager::read_ahead(uint64_t address, uint64_t next)
+{
+  // maximum read-ahead window, in pages
+  static const size_t kMaxReadAheadDepth = 32;
+
+  if (next == 0
+          || ISSET(state->config.flags, UPS_IN_MEMORY)
+          || state->config.posix_advice == UPS_POSIX_FADVICE_RANDOM)
+    return;
+
+  ScopedSpinlock lock(state->mutex);
+  uint64_t page_size = state->config.page_size_bytes;
+
+  // the leaves are physically sequential: grow the window; otherwise only
+  // the right sibling is prefetched
+  if (next == address + page_size) {
+    if (state->readahead_depth < kMaxReadAheadDepth)
+      state->readahead_depth *= 2;
+  }
+  else
+    state->readahead_depth = 1;
+
+  uint64_t from;
+  if (next >= state->readahead_start && next < state->readahead_end) {
+    // still inside the current window; refill only if less than half of
+    // the window is left
+    if (state->readahead_end - next > state->readahead_depth * page_size / 2)
+      return;
+    from = state->readahead_end;
+  }
+  else {
+    // the scan left the window; pages which were not fetched are wasted
+    uint64_t window = (state->readahead_end - state->readahead_start)
+                            / page_size;
+    if (window > state->readahead_consumed) {
+      state->readahead_wasted += window - state->readahead_consumed;
+      if (state->readahead_depth > 1)
+        state->readahead_depth /= 2;
+    }
+    state->readahead_start = next;
+    state->readahead_consumed = 0;
+    from = next;
+  }
+
+  uint64_t to = next + state->readahead_depth * page_size;
+  uint64_t file_size = state->device->file_size();
+  if (to > file_size)
+    to = file_size;
+  if (to <= from)
+    return;
+
+  state->device->prefetch(from, (size_t)(to - from));
+  state->readahead_end = to;
+  state->readahead_pages += (to - from) / page_size;
+}
+
 Page *
 PageManager::alloc(Context *context, uint32_t page_type, uint32_t flags)
 {
@@ -441,6 +582,17 @@ PageManager::alloc(Context *context, uint32_t page_type, uint32_t flags)
   return alloc_unlocked(state.get(), context, page_type, flags);
 }
 
+Page *
+PageManager::alloc_below(Context *context, uint32_t page_type,
+                uint64_t address)
+{
+  ScopedSpinlock lock(state->mutex);
+  Page *page = alloc_unlocked(state.get(), context, page_type, 0, address);
+  if (page)
+    state->page_count_relocated++;
+  return page;
+}
+
 Page *
 PageManager::alloc_multiple_blob_pages(Context *context, size_t num_pages)
 {
@@ -456,15 +608,18 @@ PageManager::alloc_multiple_blob_pages(Context *context, size_t num_pages)
   // Now check the freelist
   uint64_t address = state->freelist.alloc(num_pages);
   if (address != 0) {
+    bool punched = fill_hole(state.get(), address, num_pages);
     for (size_t i = 0; i < num_pages; i++) {
       if (i == 0) {
         page = fetch_unlocked(state.get(), context, address, 0);
         page->set_type(Page::kTypeBlob);
+        page->set_punched(punched);
       }
       else {
         Page *p = fetch_unlocked(state.get(), context,
                         address + (i * page_size), PageManager::kNoHeader);
         p->set_type(Page::kTypeBlob);
+        p->set_punched(punched);
       }
     }
 
@@ -500,9 +655,16 @@ PageManager::fill_metrics(ups_env_metrics_t *metrics) const
   metrics->page_count_type_index = state->page_count_index;
   metrics->page_count_type_blob = state->page_count_blob;
   metrics->page_count_type_page_manager = state->page_count_page_manager;
-  metrics->freelist_hits = state->freelist.freelist_hits;
-  metrics->freelist_misses = state->freelist.freelist_misses;
+  metrics->page_count_relocated = state->page_count_relocated;
+  metrics->page_count_truncated = state->page_count_truncated;
+  metrics->page_count_punched = state->page_count_punched;
+  state->device->fill_metrics(metrics);
+  state->freelist.fill_metrics(metrics);
+  metrics->readahead_pages = state->readahead_pages;
+  metrics->readahead_hits = state->readahead_hits;
+  metrics->readahead_wasted = state->readahead_wasted;
   state->cache.fill_metrics(metrics);
+  state->flash_cache->fill_metrics(metrics);
 }
 
 struct FlushAllPagesVisitor
@@ -558,8 +720,13 @@ PageManager::purge_cache(Context *context)
   //   1. this is an in-memory Environment
   //   2. there's still a "purge cache" operation pending
   //   3. the cache is not full
-  if (ISSET(state->config.flags, UPS_IN_MEMORY)
-      || (state->message && state->message->in_progress == true)
+  if (ISSET(state->config.flags, UPS_IN_MEMORY))
+    return;
+
+  if (state->config.hole_punch_seconds)
+    punch_holes(state.get(), ::time(0));
+
+  if ((state->message && state->message->in_progress == true)
       || !state->cache.is_cache_full())
     return;
 
@@ -585,6 +752,11 @@ PageManager::purge_cache(Context *context)
     if (likely(page->mutex().try_lock())) {
       assert(page->cursor_list.is_empty());
       state->cache.del(page);
+      // a tiered device moves the blob pages to the capacity tier
+      if (page->is_without_header() || page->type() == Page::kTypeBlob)
+        state->device->demote_page(page);
+      // the flash cache receives the clean page
+      state->flash_cache->put(page);
       page->mutex().unlock();
       delete page;
     }
@@ -619,6 +791,7 @@ PageManager::reclaim_space(Context *context)
     }
 
     do_truncate = true;
+    state->page_count_truncated += (file_size - address) / page_size;
     file_size = address;
   }
 
@@ -627,6 +800,59 @@ PageManager::reclaim_space(Context *context)
     state->device->truncate(file_size);
     maybe_store_state(state.get(), context, true);
   }
+
+  punch_holes(state.get(), ::time(0));
+}
+
+bool
+PageManager::relocate_state(Context *context)
+{
+  ScopedSpinlock lock(state->mutex);
+
+  Page *old_page = state->state_page;
+  if (!old_page)
+    return false;
+
+  uint64_t address = state->freelist.alloc_below(old_page->address());
+  if (address == 0)
+    return false;
+
+  // the state page is not stored in the cache; discard a stale copy of
+  // the free page
+  Page *page = state->cache.get(address);
+  if (page) {
+    state->cache.del(page);
+    delete page;
+  }
+
+  page = new Page(state->device);
+  try {
+    page->set_punched(fill_hole(state.get(), address, 1));
+    read_page(state.get(), page, address);
+  }
+  catch (Exception &ex) {
+    delete page;
+    state->freelist.put(address, 1);
+    throw ex;
+  }
+
+  ::memset(page->raw_payload(), 0, state->config.page_size_bytes);
+  page->set_type(Page::kTypePageManager);
+
+  // copy the id of the last blob page and the overflow pointer; the
+  // overflow pages are not moved
+  ::memcpy(page->payload(), old_page->payload(), 2 * sizeof(uint64_t));
+
+  if (context->changeset.has(old_page))
+    context->changeset.del(old_page);
+  state->freelist.put(old_page->address(), 1);
+  delete old_page;
+
+  state->state_page = page;
+  state->page_count_relocated++;
+  state->needs_flush = true;
+  maybe_store_state(state.get(), context, true);
+  return true;
 }
 
 struct CloseDatabaseVisitor
@@ -765,11 +991,23 @@ PageManager::close(Context *context)
   state->worker.reset(0);
 }
 
+void
+PageManager::discard_flash_cache()
+{
+  flash_cache->discard();
+}
+
+void
+PageManager::close_flash_cache(uint32_t write_counter)
+{
+  flash_cache->close(write_counter);
+}
+
 void
 PageManager::reset(Context *context)
 {
   close(context);
-  state.reset(new PageManagerState(state->env));
+  state.reset(new PageManagerState(state->env, flash_cache.get()));
 }
 
 Page *
@@ -851,4 +1089,11 @@ PageManager::test_store_state()
   return store_state_impl(state.get(), &context);
 }
 
+void
+PageManager::test_punch_holes(time_t now)
+{
+  ScopedSpinlock lock(state->mutex);
+  punch_holes(state.get(), now);
+}
+
 } // namespace upscaledb
@@ -72,9 +72,7 @@ struct PageManager
   };
 
   // Constructor
-  PageManager(LocalEnv *env)
-    : state(new PageManagerState(env)) {
-  }
+  PageManager(LocalEnv *env);
 
   // Loads the state from a blob
   void initialize(uint64_t blobid);
@@ -88,11 +86,23 @@ struct PageManager
   // The page is locked and stored in |context->changeset|.
   Page *fetch(Context *context, uint64_t address, uint32_t flags = 0);
 
+  // Called by cursors when a scan moved to the leaf at |address|; |next|
+  // is the address of its right sibling (or 0). Asks the Device to
+  // asynchronously read the following pages. The read-ahead window grows
+  // as long as the leaves are physically sequential in the file.
+  void read_ahead(uint64_t address, uint64_t next);
+
   // Allocates a new page. |page_type| is one of Page::kType* in page.h.
   // |flags| are either 0 or kClearWithZero
   // The page is locked and stored in |context->changeset|.
   Page *alloc(Context *context, uint32_t page_type, uint32_t flags = 0);
 
+  // Allocates a page from the Freelist, but only if the free page's
+  // address is lower than |address|; returns NULL otherwise. Used for
+  // compacting the file.
+  // The page is locked and stored in |context->changeset|.
+  Page *alloc_below(Context *context, uint32_t page_type, uint64_t address);
+
   // Allocates multiple adjacent pages.
   // Used by the BlobManager to store blobs that span multiple pages
   // Returns the first page in the list of pages
@@ -109,6 +119,11 @@ struct PageManager
   // Reclaim file space; truncates unused file space at the end of the file.
   void reclaim_space(Context *context);
 
+  // Moves the persisted state to a free page with a lower address, if
+  // there is one. Returns true if the state was moved. Used for
+  // compacting the file.
+  bool relocate_state(Context *context);
+
   // Flushes and closes all pages of a database
   void close_database(Context *context, LocalDb *db);
 
@@ -123,6 +138,14 @@ struct PageManager
   // the internal state after recovery was performed
   void reset(Context *context);
 
+  // Discards the index of the flash cache; called before the Journal is
+  // recovered
+  void discard_flash_cache();
+
+  // Closes the flash cache; its index is valid for the Environment file
+  // with the write counter |write_counter|
+  void close_flash_cache(uint32_t write_counter);
+
   // Returns the Page pointer where we can add more blobs
   Page *last_blob_page(Context *context);
 
@@ -153,6 +176,14 @@ struct PageManager
   // Exposed here because it's required by the unittests.
   uint64_t test_store_state();
 
+  // Punches holes for all free extents which were freed before |now|
+  // minus the configured delay. Exposed for the unittests.
+  void test_punch_holes(time_t now);
+
+  // The second-level cache on fast local storage; it is not part of the
+  // state because it survives reset()
+  ScopedPtr<FlashCache> flash_cache;
+
   // The state
   ScopedPtr<PageManagerState> state;
 };
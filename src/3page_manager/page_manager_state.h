@@ -36,6 +36,7 @@
 #include "1base/spinlock.h"
 #include "2config/env_config.h"
 #include "3cache/cache.h"
+#include "3cache/flash_cache.h"
 #include "3page_manager/freelist.h"
 
 #ifndef UPS_ROOT_H
@@ -57,7 +58,7 @@ struct WorkerPool;
  */
 struct PageManagerState {
   // constructor
-  PageManagerState(LocalEnv *env);
+  PageManagerState(LocalEnv *env, FlashCache *flash_cache);
 
   // destructor
   ~PageManagerState();
@@ -83,6 +84,9 @@ struct PageManagerState {
   // The cache
   Cache cache;
 
+  // The second-level cache on fast local storage; owned by the PageManager
+  FlashCache *flash_cache;
+
   // The freelist
   Freelist freelist;
 
@@ -111,12 +115,44 @@ struct PageManagerState {
   // tracks number of page manager pages
   uint64_t page_count_page_manager;
 
+  // tracks number of pages which were relocated by the compaction
+  uint64_t page_count_relocated;
+
+  // tracks number of pages which were truncated from the end of the file
+  uint64_t page_count_truncated;
+
+  // tracks number of free pages which released their disk space
+  uint64_t page_count_punched;
+
+  // The last time when free extents were checked for hole punching
+  time_t last_hole_punch;
+
   // tracks number of cache hits
   uint64_t cache_hits;
 
   // tracks number of cache misses
   uint64_t cache_misses;
 
+  // The current read-ahead depth (in pages); grows while leaf pages are
+  // physically sequential, shrinks if prefetched pages are not used
+  size_t readahead_depth;
+
+  // The file range [start, end) which was most recently prefetched
+  uint64_t readahead_start;
+  uint64_t readahead_end;
+
+  // Number of pages from the current read-ahead window which were fetched
+  uint64_t readahead_consumed;
+
+  // tracks number of pages scheduled for read-ahead
+  uint64_t readahead_pages;
+
+  // tracks number of read-ahead pages which were fetched from the device
+  uint64_t readahead_hits;
+
+  // tracks number of read-ahead pages which were never fetched
+  uint64_t readahead_wasted;
+
   // For sending information to the worker thread; cached to avoid memory
   // allocations
   AsyncFlushMessage *message;
@@ -123,6 +123,14 @@ struct Cursor {
   // Overwrites the record of a cursor (ups_cursor_overwrite)
   virtual ups_status_t overwrite(ups_record_t *record, uint32_t flags) = 0;
 
+  // Reads a range of the current record (ups_cursor_read_record_range)
+  virtual void read_record_range(uint32_t offset, uint32_t size,
+                  ups_record_t *record, uint32_t flags) = 0;
+
+  // Overwrites a range of the current record (ups_cursor_write_record_range)
+  virtual ups_status_t write_record_range(uint32_t offset,
+                  ups_record_t *record, uint32_t flags) = 0;
+
   // Returns position in duplicate list (ups_cursor_get_duplicate_position)
   virtual uint32_t get_duplicate_position() = 0;
 
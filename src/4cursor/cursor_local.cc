@@ -21,6 +21,7 @@
 #include <string.h>
 
 // Always verify that a file of level N does not include headers > N!
+#include "3blob_manager/blob_manager.h"
 #include "3btree/btree_cursor.h"
 #include "3btree/btree_index.h"
 #include "3btree/btree_node_proxy.h"
@@ -89,13 +90,20 @@ append_txn_duplicates(LocalCursor *cursor, Context *context)
   if (!node)
     return;
 
+  LocalTxn *txn = (LocalTxn *)cursor->txn;
+  bool snapshot = txn && txn->is_snapshot();
+
   // now start integrating the items from the transactions
   for (op = node->oldest_op; op; op = op->next_in_node) {
-    Txn *optxn = op->txn;
+    LocalTxn *optxn = op->txn;
     // collect all ops that are valid (even those that are
     // from conflicting transactions)
     if (unlikely(optxn->is_aborted()))
       continue;
+    // ... but a snapshot only sees transactions which were committed
+    // before it began
+    if (unlikely(snapshot && !txn->is_visible(optxn)))
+      continue;
 
     // a normal (overwriting) insert will overwrite ALL duplicates,
     // but an overwrite of a duplicate will only overwrite
@@ -1069,6 +1077,67 @@ LocalCursor::overwrite(ups_record_t *record, uint32_t flags)
   return st;
 }
 
+void
+LocalCursor::read_record_range(uint32_t offset, uint32_t size,
+                ups_record_t *record, uint32_t flags)
+{
+  Context context(lenv(this), (LocalTxn *)txn, ldb(this));
+
+  if (unlikely(is_nil()))
+    throw Exception(UPS_CURSOR_IS_NIL);
+
+  ByteArray *arena = &ldb(this)->record_arena(txn);
+
+  // the records of Transactional operations are stored in memory
+  if (is_txn_active()) {
+    ByteArray buffer(txn_cursor.record_size());
+    ups_record_t full = {0};
+    full.data = buffer.data();
+    full.flags = UPS_RECORD_USER_ALLOC;
+    txn_cursor.copy_coupled_record(&full);
+
+    size = BlobManager::range_size(full.size, offset, size);
+    BlobManager::assign_range(record, buffer.data() + offset, size, arena);
+    return;
+  }
+
+  btree_cursor.record_range(&context, offset, size, record, arena);
+}
+
+ups_status_t
+LocalCursor::write_record_range(uint32_t offset, ups_record_t *record,
+                uint32_t flags)
+{
+  if (unlikely(is_nil()))
+    throw Exception(UPS_CURSOR_IS_NIL);
+
+  // with Transactions the modified record is stored in the Transaction
+  // index, which only stores full records; patch the range and overwrite
+  // the full record
+  if (ISSET(ldb(this)->flags(), UPS_ENABLE_TRANSACTIONS)) {
+    uint32_t old_size = get_record_size();
+    BlobManager::range_size(old_size, offset, 0);
+
+    ByteArray buffer(std::max(old_size, offset + record->size));
+    ups_record_t full = {0};
+    full.data = buffer.data();
+    full.flags = UPS_RECORD_USER_ALLOC;
+    read_record_range(0, old_size, &full, 0);
+    if (record->size > 0)
+      ::memcpy(buffer.data() + offset, record->data, record->size);
+
+    full.size = (uint32_t)buffer.size();
+    full.flags = 0;
+    return overwrite(&full, flags);
+  }
+
+  // otherwise only the modified range is written to the btree
+  Context context(lenv(this), (LocalTxn *)txn, ldb(this));
+  btree_cursor.overwrite_range(&context, offset, record);
+  activate_btree();
+  return 0;
+}
+
 bool
 LocalCursor::is_nil(int what)
 {
@@ -183,6 +183,14 @@ struct LocalCursor : Cursor {
   // Implementation of overwrite()
   virtual ups_status_t overwrite(ups_record_t *record, uint32_t flags);
 
+  // Reads a range of the current record (ups_cursor_read_record_range)
+  virtual void read_record_range(uint32_t offset, uint32_t size,
+                  ups_record_t *record, uint32_t flags);
+
+  // Overwrites a range of the current record (ups_cursor_write_record_range)
+  virtual ups_status_t write_record_range(uint32_t offset,
+                  ups_record_t *record, uint32_t flags);
+
   // Returns number of duplicates (ups_cursor_get_duplicate_count)
   virtual uint32_t get_duplicate_count(uint32_t flags);
 
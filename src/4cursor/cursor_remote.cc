@@ -113,6 +113,20 @@ RemoteCursor::get_record_size()
   return reply.cursor_get_record_size_reply.size;
 }
 
+void
+RemoteCursor::read_record_range(uint32_t offset, uint32_t size,
+                ups_record_t *record, uint32_t flags)
+{
+  throw Exception(UPS_NOT_IMPLEMENTED);
+}
+
+ups_status_t
+RemoteCursor::write_record_range(uint32_t offset, ups_record_t *record,
+                uint32_t flags)
+{
+  throw Exception(UPS_NOT_IMPLEMENTED);
+}
+
 void
 RemoteCursor::close()
 {
@@ -49,6 +49,16 @@ struct RemoteCursor : Cursor {
   // Overwrites the current record
   virtual ups_status_t overwrite(ups_record_t *record, uint32_t flags);
 
+  // Reads a range of the current record; not supported by the remote
+  // protocol
+  virtual void read_record_range(uint32_t offset, uint32_t size,
+                  ups_record_t *record, uint32_t flags);
+
+  // Overwrites a range of the current record; not supported by the remote
+  // protocol
+  virtual ups_status_t write_record_range(uint32_t offset,
+                  ups_record_t *record, uint32_t flags);
+
   // Get current record size (ups_cursor_get_record_size)
   virtual uint32_t get_record_size();
 
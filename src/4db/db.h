@@ -110,6 +110,12 @@ struct Db
   virtual ups_status_t cursor_move(Cursor *cursor, ups_key_t *key,
                   ups_record_t *record, uint32_t flags) = 0;
 
+  // Moves a cursor and retrieves a batch of keys and records
+  // (ups_cursor_move_batch)
+  virtual ups_status_t cursor_move_batch(Cursor *cursor, ups_key_t *keys,
+                  ups_record_t *records, uint32_t *count,
+                  uint32_t flags) = 0;
+
   // Performs bulk operations
   virtual ups_status_t bulk_operations(Txn *txn, ups_operation_t *operations,
                   size_t operations_length, uint32_t flags) = 0;
@@ -18,7 +18,11 @@
 
 #include "0root/root.h"
 
+#include <algorithm>
+#include <vector>
+
 // Always verify that a file of level N does not include headers > N!
+#include "1errorinducer/errorinducer.h"
 #include "1globals/callbacks.h"
 #include "3page_manager/page_manager.h"
 #include "3journal/journal.h"
@@ -144,9 +148,13 @@ is_key_erased(Context *context, TxnIndex *txn_index, ups_key_t *key)
   for (TxnOperation *op = node->newest_op;
                   op != 0;
                   op = op->previous_in_node) {
-    Txn *optxn = op->txn;
+    LocalTxn *optxn = op->txn;
     if (optxn->is_aborted())
       continue;
+    // snapshots ignore transactions which were committed later
+    if (unlikely(context->txn && context->txn->is_snapshot()
+                && !context->txn->is_visible(optxn)))
+      continue;
     if (optxn->is_committed() || context->txn == optxn) {
       if (ISSET(op->flags, TxnOperation::kIsFlushed))
         continue;
@@ -301,6 +309,7 @@ find_txn(LocalDb *db, Context *context, LocalCursor *cursor, ups_key_t *key,
   ups_status_t st = 0;
   TxnOperation *op = 0;
   bool exact_is_erased = false;
+  bool snapshot = context->txn && context->txn->is_snapshot();
 
   ByteArray *key_arena = &db->key_arena(context->txn);
   ByteArray *record_arena = &db->record_arena(context->txn);
@@ -332,10 +341,15 @@ retry:
     op = node->newest_op;
 
   for (; op != 0; op = op->previous_in_node) {
-    Txn *optxn = op->txn;
+    LocalTxn *optxn = op->txn;
     if (optxn->is_aborted())
       continue;
 
+    // a snapshot only sees transactions which were committed before it
+    // began; all other operations are skipped, and never cause a conflict
+    if (unlikely(snapshot && !context->txn->is_visible(optxn)))
+      continue;
+
     if (optxn->is_committed() || context->txn == optxn) {
       if (unlikely(ISSET(op->flags, TxnOperation::kIsFlushed)))
         continue;
@@ -576,7 +590,7 @@ erase_txn(LocalDb *db, Context *context, ups_key_t *key, uint32_t flags,
     if (unlikely(st)) {
       if (node_created) {
         db->txn_index->remove(node);
-        delete node;
+        db->txn_index->release_node(node);
       }
       return st;
     }
@@ -725,7 +739,7 @@ LocalDb::create(Context *context, PBtreeHeader *btree_header)
   btree_index->create(context, btree_header, &config);
 
   if (config.record_compressor) {
-    record_compressor.reset(CompressorFactory::create(
+    record_compressor.reset(lenv(this)->create_compressor(
                                     config.record_compressor));
   }
 
@@ -789,7 +803,7 @@ LocalDb::open(Context *context, PBtreeHeader *btree_header)
 
   // is record compression enabled?
   if (config.record_compressor) {
-    record_compressor.reset(CompressorFactory::create(
+    record_compressor.reset(lenv(this)->create_compressor(
                                     config.record_compressor));
   }
 
@@ -909,12 +923,9 @@ LocalDb::count(Txn *htxn, bool distinct)
 
   Context context(lenv(this), txn, this);
 
-  // purge cache if necessary
-  lenv(this)->page_manager->purge_cache(&context);
-
-  // call the btree function - this will retrieve the number of keys
-  // in the btree
-  uint64_t keycount = btree_index->count(&context, distinct);
+  // the btree maintains persistent key counters; no need to visit
+  // the nodes
+  uint64_t keycount = btree_index->count(distinct);
 
   // if transactions are enabled, then also sum up the number of keys
   // from the transaction tree
@@ -1008,7 +1019,7 @@ insert_txn(LocalDb *db, Context *context, ups_key_t *key, ups_record_t *record,
   if (unlikely(st)) {
     if (node_created) {
       db->txn_index->remove(node);
-      delete node;
+      db->txn_index->release_node(node);
     }
     return st;
   }
@@ -1265,10 +1276,270 @@ LocalDb::cursor_clone(Cursor *src)
   return new LocalCursor(*(LocalCursor *)src);
 }
 
+// Orders the operations of a write batch by their keys
+struct WriteBatchComparator {
+  WriteBatchComparator(BtreeIndex *btree_)
+    : btree(btree_) {
+  }
+
+  bool operator()(ups_operation_t *lhs, ups_operation_t *rhs) const {
+    return btree->compare_keys(&lhs->key, &rhs->key) < 0;
+  }
+
+  BtreeIndex *btree;
+};
+
+// The state of a key before a write batch is applied; if an operation
+// of the batch fails then the keys which were already modified are
+// restored
+struct WriteBatchUndo {
+  WriteBatchUndo(size_t first_, bool exists_)
+    : first(first_), exists(exists_) {
+  }
+
+  // Index of the first (sorted) operation on this key
+  size_t first;
+
+  // True if the key existed before the batch was applied
+  bool exists;
+
+  // Copies of the records of an existing key, including all duplicates;
+  // they are copied right before the key is modified
+  std::vector<std::vector<uint8_t> > records;
+};
+
+// Copies all records of an existing |key| to |undo|
+static inline void
+copy_records(LocalDb *db, Context *context, ups_key_t *key,
+                WriteBatchUndo *undo)
+{
+  LocalCursor cursor(db);
+  ByteArray arena;
+  ups_record_t record = {0};
+
+  if (db->btree_index->find(context, &cursor, key, 0, 0, 0, 0) != 0)
+    return;
+
+  int count = cursor.btree_cursor.record_count(context, 0);
+  for (int i = 0; i < count; i++) {
+    cursor.btree_cursor.set_duplicate_index(i);
+    ups_status_t st = cursor.btree_cursor.move(context, 0, 0, &record,
+                            &arena, 0);
+    if (unlikely(st))
+      throw Exception(st);
+    uint8_t *p = (uint8_t *)record.data;
+    undo->records.push_back(std::vector<uint8_t>(p, p + record.size));
+  }
+}
+
+// Verifies that all operations of a (sorted) write batch will succeed,
+// before the Database is modified. The btree is only looked up once for
+// each distinct key; the remaining operations on this key are simulated.
+// Each distinct key is added to |undo|.
+static inline ups_status_t
+check_write_batch(LocalDb *db, Context *context,
+                std::vector<ups_operation_t *> &ops,
+                std::vector<WriteBatchUndo> *undo)
+{
+  size_t i = 0;
+  while (i < ops.size()) {
+    ups_key_t *key = &ops[i]->key;
+    bool exists = db->btree_index->find(context, 0, key, 0, 0, 0, 0) == 0;
+
+    undo->push_back(WriteBatchUndo(i, exists));
+
+    for (; i < ops.size()
+            && db->btree_index->compare_keys(key, &ops[i]->key) == 0; i++) {
+      ups_operation_t *op = ops[i];
+      if (op->type == UPS_OP_ERASE) {
+        if (unlikely(!exists))
+          return op->result = UPS_KEY_NOT_FOUND;
+        exists = false;
+      }
+      else {
+        if (unlikely(exists
+                  && NOTSET(op->flags, UPS_OVERWRITE | UPS_DUPLICATE)))
+          return op->result = UPS_DUPLICATE_KEY;
+        exists = true;
+      }
+    }
+  }
+  return 0;
+}
+
+// Restores the first |modified| keys of a write batch
+static inline void
+rollback_write_batch(LocalDb *db, Context *context,
+                std::vector<ups_operation_t *> &ops,
+                std::vector<WriteBatchUndo> &undo, size_t modified)
+{
+  for (size_t u = modified; u-- > 0; ) {
+    ups_key_t *key = &ops[undo[u].first]->key;
+    db->histogram.reset_if_equal(key);
+    ups_status_t st = db->btree_index->erase(context, 0, key, 0, 0);
+    if (unlikely(st != 0 && st != UPS_KEY_NOT_FOUND))
+      throw Exception(st);
+
+    std::vector<std::vector<uint8_t> > &records = undo[u].records;
+    for (size_t i = 0; i < records.size(); i++) {
+      ups_record_t record = ups_make_record(records[i].data(),
+                              (uint32_t)records[i].size());
+      st = db->btree_index->insert(context, 0, key, &record,
+                              i == 0 ? 0 : UPS_DUPLICATE);
+      if (unlikely(st))
+        throw Exception(st);
+    }
+  }
+}
+
+// Applies a write batch through a single Transaction; used if other
+// Transactions are active, because the batch must not bypass their
+// conflict checks
+static inline ups_status_t
+write_batch_txn(LocalDb *db, ups_operation_t *ops, size_t ops_length)
+{
+  LocalTxn *local_txn = begin_temp_txn(lenv(db));
+  Context context(lenv(db), local_txn, db);
+
+  ups_status_t st = 0;
+  for (size_t i = 0; st == 0 && i < ops_length; i++, ops++) {
+    if (ops->type == UPS_OP_INSERT)
+      st = db->insert(0, local_txn, &ops->key, &ops->record, ops->flags);
+    else
+      st = db->erase(0, local_txn, &ops->key, ops->flags);
+    ops->result = st;
+  }
+
+  return finalize(lenv(db), &context, st, local_txn);
+}
+
+// Applies the operations of a write batch atomically; see the
+// documentation of UPS_WRITE_BATCH
+static inline ups_status_t
+write_batch(LocalDb *db, ups_operation_t *ops, size_t ops_length)
+{
+  LocalEnv *env = lenv(db);
+  DbConfig &config = db->config;
+
+  if (unlikely(ISSETANY(db->flags(),
+                  UPS_RECORD_NUMBER32 | UPS_RECORD_NUMBER64))) {
+    ups_trace(("UPS_WRITE_BATCH does not support record number databases"));
+    return UPS_INV_PARAMETER;
+  }
+
+  std::vector<ups_operation_t *> sorted(ops_length);
+  for (size_t i = 0; i < ops_length; i++) {
+    ups_operation_t *op = &ops[i];
+    op->result = 0;
+    sorted[i] = op;
+
+    if (unlikely(op->type != UPS_OP_INSERT && op->type != UPS_OP_ERASE)) {
+      ups_trace(("UPS_WRITE_BATCH only supports UPS_OP_INSERT and "
+                              "UPS_OP_ERASE"));
+      return UPS_INV_PARAMETER;
+    }
+    if (unlikely(config.key_size != UPS_KEY_SIZE_UNLIMITED
+                          && op->key.size != config.key_size)) {
+      ups_trace(("invalid key size (%u instead of %u)",
+            op->key.size, config.key_size));
+      return op->result = UPS_INV_KEY_SIZE;
+    }
+    if (op->type == UPS_OP_ERASE)
+      continue;
+    if (unlikely(config.record_size != UPS_RECORD_SIZE_UNLIMITED
+                          && op->record.size != config.record_size)) {
+      ups_trace(("invalid record size (%u instead of %u)",
+            op->record.size, config.record_size));
+      return op->result = UPS_INV_RECORD_SIZE;
+    }
+    if (unlikely(ISSET(op->flags, UPS_DUPLICATE)
+                          && NOTSET(db->flags(), UPS_ENABLE_DUPLICATE_KEYS))) {
+      ups_trace(("database does not support duplicate keys"));
+      return op->result = UPS_INV_PARAMETER;
+    }
+  }
+
+  Context context(env, 0, db);
+
+  // the batch is directly applied to the btree; this is only possible if
+  // there are no pending Transaction operations
+  if (ISSET(db->flags(), UPS_ENABLE_TRANSACTIONS)) {
+    env->txn_manager->flush_committed_txns(&context);
+    if (env->txn_manager->oldest_txn() != 0)
+      return write_batch_txn(db, ops, ops_length);
+  }
+
+  // sort the operations by key; operations on the same key keep their order
+  std::stable_sort(sorted.begin(), sorted.end(),
+                  WriteBatchComparator(db->btree_index.get()));
+
+  // purge the cache
+  env->page_manager->purge_cache(&context);
+
+  std::vector<WriteBatchUndo> undo;
+  ups_status_t st = check_write_batch(db, &context, sorted, &undo);
+  if (unlikely(st != 0))
+    return st;
+
+  // neighbouring keys are usually stored in the same leaf, which is then
+  // already cached
+  size_t i = 0;
+  size_t modified = 0;
+  try {
+    for (; i < sorted.size(); i++) {
+      ups_operation_t *op = sorted[i];
+      // the records of an existing key are copied before the key is
+      // modified; only the keys which are reached are copied
+      if (modified < undo.size() && undo[modified].first == i) {
+        if (undo[modified].exists)
+          copy_records(db, &context, &op->key, &undo[modified]);
+        modified++;
+      }
+      UPS_INDUCE_ERROR(ErrorInducer::kWriteBatch);
+      if (op->type == UPS_OP_INSERT)
+        st = db->btree_index->insert(&context, 0, &op->key, &op->record,
+                        op->flags);
+      else {
+        db->histogram.reset_if_equal(&op->key);
+        st = db->btree_index->erase(&context, 0, &op->key, 0, op->flags);
+      }
+      if (unlikely(st != 0)) {
+        op->result = st;
+        break;
+      }
+    }
+  }
+  catch (Exception &ex) {
+    st = sorted[i]->result = ex.code;
+  }
+
+  // an operation failed (i.e. with an I/O error): undo the operations
+  // which were already applied
+  if (unlikely(st != 0)) {
+    try {
+      rollback_write_batch(db, &context, sorted, undo, modified);
+    }
+    catch (Exception &ex) {
+      ups_log(("failed to roll back a write batch: error %d", ex.code));
+    }
+  }
+
+  // write all modified pages as a single changeset to the journal; after a
+  // crash, the batch is either recovered completely or not at all
+  if (likely(st == 0) && env->journal.get())
+    context.changeset.flush();
+  else
+    context.changeset.clear();
+  return st;
+}
+
 ups_status_t
 LocalDb::bulk_operations(Txn *txn, ups_operation_t *ops, size_t ops_length,
-                uint32_t /* unused */)
+                uint32_t flags)
 {
+  if (ISSET(flags, UPS_WRITE_BATCH))
+    return write_batch(this, ops, ops_length);
+
   ByteArray ka, ra;
   ups_operation_t *initial_ops = ops;
 
@@ -1277,12 +1548,19 @@ LocalDb::bulk_operations(Txn *txn, ups_operation_t *ops, size_t ops_length,
   // accumulates all results in |ka| and |ra|, the second one lets key->data
   // and record->data pointers point into |ka| and |ra|.
   for (size_t i = 0; i < ops_length; i++, ops++) {
+    // snapshots are read-only
+    if (unlikely(txn && ISSET(txn->flags, UPS_TXN_SNAPSHOT)
+                && (ops->type == UPS_OP_INSERT || ops->type == UPS_OP_ERASE))) {
+      ops->result = UPS_WRITE_PROTECTED;
+      continue;
+    }
+
     switch (ops->type) {
       case UPS_OP_INSERT:
         ops->result = insert(0, txn, &ops->key, &ops->record, ops->flags);
         // if this a record number database? then we might have to copy the key
         if (likely(ops->result == 0)
-                && ISSETANY(flags(), UPS_RECORD_NUMBER32 | UPS_RECORD_NUMBER64)
+                && ISSETANY(this->flags(), UPS_RECORD_NUMBER32 | UPS_RECORD_NUMBER64)
                 && NOTSET(ops->key.flags, UPS_KEY_USER_ALLOC)) {
           ka.append((uint8_t *)ops->key.data, ops->key.size);
         }
@@ -1322,7 +1600,7 @@ LocalDb::bulk_operations(Txn *txn, ups_operation_t *ops, size_t ops_length,
     switch (ops->type) {
       case UPS_OP_INSERT:
         // if this a record number database? then we might have to copy the key
-        if (ISSETANY(flags(), UPS_RECORD_NUMBER32 | UPS_RECORD_NUMBER64)
+        if (ISSETANY(this->flags(), UPS_RECORD_NUMBER32 | UPS_RECORD_NUMBER64)
                 && NOTSET(ops->key.flags, UPS_KEY_USER_ALLOC)) {
           ops->key.data = kptr;
           kptr += ops->key.size;
@@ -1395,6 +1673,161 @@ LocalDb::cursor_move(Cursor *hcursor, ups_key_t *key,
   return 0;
 }
 
+// Collects the keys and records of ups_cursor_move_batch() in two arenas.
+// The sizes are stored in the caller's |keys| and |records| arrays; the
+// data pointers are assigned when the batch is complete, because the
+// arenas are reallocated while they grow.
+struct BatchScanVisitor : public ScanVisitor {
+  BatchScanVisitor(const DbConfig *config_, SelectStatement *stmt,
+                  ups_key_t *keys_, ups_record_t *records_)
+    : ScanVisitor(stmt), config(config_), keys(keys_), records(records_),
+      count(0) {
+  }
+
+  // Operates on a single key/value pair
+  virtual void operator()(const void *key_data, uint16_t key_size,
+                  const void *record_data, uint32_t record_size) {
+    if (key_size)
+      key_arena.append((const uint8_t *)key_data, key_size);
+    keys[count].size = key_size;
+    if (records) {
+      if (record_size)
+        record_arena.append((const uint8_t *)record_data, record_size);
+      records[count].size = record_size;
+    }
+    count++;
+  }
+
+  // Operates on an array of keys and/or records; both arrays are copied
+  // with a single memcpy
+  virtual void operator()(const void *key_array, const void *record_array,
+                  size_t length) {
+    key_arena.append((const uint8_t *)key_array, length * config->key_size);
+    if (records)
+      record_arena.append((const uint8_t *)record_array,
+                      length * config->record_size);
+    for (size_t i = 0; i < length; i++, count++) {
+      keys[count].size = (uint16_t)config->key_size;
+      if (records)
+        records[count].size = config->record_size;
+    }
+  }
+
+  // Not required - the result is assigned by cursor_move_batch()
+  virtual void assign_result(uqi_result_t *) {
+  }
+
+  // The database configuration
+  const DbConfig *config;
+
+  // The caller's arrays
+  ups_key_t *keys;
+  ups_record_t *records;
+
+  // Number of keys (and records) which were collected so far
+  uint32_t count;
+
+  // The collected key and record data
+  ByteArray key_arena;
+  ByteArray record_arena;
+};
+
+ups_status_t
+LocalDb::cursor_move_batch(Cursor *hcursor, ups_key_t *keys,
+                ups_record_t *records, uint32_t *count, uint32_t flags)
+{
+  LocalCursor *cursor = (LocalCursor *)hcursor;
+  uint32_t capacity = *count;
+  ups_status_t st = 0;
+
+  SelectStatement stmt;
+  stmt.requires_records = records != 0;
+  BatchScanVisitor visitor(&config, &stmt, keys, records);
+
+  // Without transactions and duplicates the cursor always points into
+  // the btree, and the remaining keys of the current leaf can be copied
+  // without moving the cursor key by key
+  bool use_leaf_scan = ISSET(flags, UPS_CURSOR_NEXT)
+                && NOTSET(this->flags(), UPS_ENABLE_TRANSACTIONS)
+                && NOTSET(this->flags(), UPS_ENABLE_DUPLICATE_KEYS);
+
+  while (visitor.count < capacity) {
+    if (use_leaf_scan
+            && cursor->is_btree_active()
+            && cursor->btree_cursor.is_coupled()) {
+      Page *page = cursor->btree_cursor.coupled_page();
+      uint32_t slot = cursor->btree_cursor.coupled_slot() + 1;
+      BtreeNodeProxy *node = btree_index->get_node_from_page(page);
+      uint32_t length = (uint32_t)node->length();
+
+      if (slot < length) {
+        Context context(lenv(this), 0, this);
+        uint32_t remaining = capacity - visitor.count;
+
+        // the remaining keys fit into the batch: scan the leaf
+        if (length - slot <= remaining) {
+          node->scan(&context, &visitor, &stmt, slot, true);
+          cursor->btree_cursor.couple_to(page, length - 1);
+        }
+        // otherwise only fetch as many keys as required
+        else {
+          ups_key_t key = {0};
+          ups_record_t record = {0};
+          ByteArray key_arena, record_arena;
+          for (uint32_t i = slot; i < slot + remaining; i++) {
+            node->key(&context, i, &key_arena, &key);
+            if (records)
+              node->record(&context, i, &record_arena, &record, 0);
+            visitor(key.data, key.size, record.data, record.size);
+          }
+          cursor->btree_cursor.couple_to(page, slot + remaining - 1);
+        }
+        cursor->last_operation = UPS_CURSOR_NEXT;
+        continue;
+      }
+    }
+
+    // move the cursor to the next key; this also handles nil cursors,
+    // transactions, duplicates and the transition to the next leaf
+    ups_key_t key = {0};
+    ups_record_t record = {0};
+    st = cursor_move(cursor, &key, records ? &record : 0, flags);
+    if (unlikely(st))
+      break;
+    visitor(key.data, key.size, record.data, record.size);
+  }
+
+  *count = visitor.count;
+  if (unlikely(st && (st != UPS_KEY_NOT_FOUND || visitor.count == 0)))
+    return st;
+
+  // now assign the data pointers, or copy the data if the memory is
+  // allocated by the caller
+  uint8_t *kptr = visitor.key_arena.data();
+  uint8_t *rptr = visitor.record_arena.data();
+  for (uint32_t i = 0; i < visitor.count; i++) {
+    if (ISSET(keys[i].flags, UPS_KEY_USER_ALLOC))
+      ::memcpy(keys[i].data, kptr, keys[i].size);
+    else
+      keys[i].data = keys[i].size ? kptr : 0;
+    kptr += keys[i].size;
+
+    if (records) {
+      if (ISSET(records[i].flags, UPS_RECORD_USER_ALLOC))
+        ::memcpy(records[i].data, rptr, records[i].size);
+      else
+        records[i].data = records[i].size ? rptr : 0;
+      rptr += records[i].size;
+    }
+  }
+
+  // swap key and record buffers
+  key_arena(cursor->txn).steal_from(visitor.key_arena);
+  record_arena(cursor->txn).steal_from(visitor.record_arena);
+
+  return 0;
+}
+
 ups_status_t
 LocalDb::close(uint32_t flags)
 {
@@ -1410,6 +1843,12 @@ LocalDb::close(uint32_t flags)
   if (btree_index && ISSET(env->flags(), UPS_IN_MEMORY))
    btree_index->drop(&context);
 
+  // store the key counters in the btree header
+  if (btree_index && btree_index->persist_key_count()) {
+    Page *header = lenv(this)->page_manager->fetch(&context, 0);
+    header->set_dirty(true);
+  }
+
   // write all pages of this database to disk
   lenv(this)->page_manager->close_database(&context, this);
 
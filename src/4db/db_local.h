@@ -102,6 +102,12 @@ struct LocalDb : public Db {
   // Clones a cursor (ups_cursor_clone)
   virtual Cursor *cursor_clone(Cursor *src);
 
+  // Moves a cursor and retrieves a batch of keys and records
+  // (ups_cursor_move_batch)
+  virtual ups_status_t cursor_move_batch(Cursor *cursor, ups_key_t *keys,
+                  ups_record_t *records, uint32_t *count,
+                  uint32_t flags);
+
   // Performs bulk operations
   virtual ups_status_t bulk_operations(Txn *txn, ups_operation_t *operations,
                   size_t operations_length, uint32_t flags);
@@ -564,6 +564,60 @@ RemoteDb::cursor_move(Cursor *hcursor, ups_key_t *key,
   return 0;
 }
 
+ups_status_t
+RemoteDb::cursor_move_batch(Cursor *hcursor, ups_key_t *keys,
+                ups_record_t *records, uint32_t *count, uint32_t flags)
+{
+  RemoteTxn *txn = dynamic_cast<RemoteTxn *>(hcursor->txn);
+  uint32_t capacity = *count;
+  ups_status_t st = 0;
+  ByteArray ka, ra;
+
+  // the protocol has no batch request; move the cursor key by key and
+  // accumulate the results, then assign the pointers (see
+  // LocalDb::bulk_operations)
+  for (*count = 0; *count < capacity; (*count)++) {
+    ups_key_t key = {0};
+    ups_record_t record = {0};
+    st = cursor_move(hcursor, &key, records ? &record : 0, flags);
+    if (unlikely(st))
+      break;
+    keys[*count].size = key.size;
+    ka.append((uint8_t *)key.data, key.size);
+    if (records) {
+      records[*count].size = record.size;
+      ra.append((uint8_t *)record.data, record.size);
+    }
+  }
+
+  if (unlikely(st && (st != UPS_KEY_NOT_FOUND || *count == 0)))
+    return st;
+
+  uint8_t *kptr = ka.data();
+  uint8_t *rptr = ra.data();
+  for (uint32_t i = 0; i < *count; i++) {
+    if (ISSET(keys[i].flags, UPS_KEY_USER_ALLOC))
+      ::memcpy(keys[i].data, kptr, keys[i].size);
+    else
+      keys[i].data = kptr;
+    kptr += keys[i].size;
+
+    if (records) {
+      if (ISSET(records[i].flags, UPS_RECORD_USER_ALLOC))
+        ::memcpy(records[i].data, rptr, records[i].size);
+      else
+        records[i].data = rptr;
+      rptr += records[i].size;
+    }
+  }
+
+  // swap key and record buffers
+  key_arena(txn).steal_from(ka);
+  record_arena(txn).steal_from(ra);
+
+  return 0;
+}
+
 ups_status_t
 RemoteDb::close(uint32_t flags)
 {
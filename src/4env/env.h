@@ -123,6 +123,15 @@ struct Env
   virtual ups_status_t select_range(const char *query, Cursor *begin,
                           const Cursor *end, Result **result) = 0;
 
+  // Trains and stores a compression dictionary
+  // (ups_env_train_compression_dictionary)
+  virtual void train_compression_dictionary(const ups_record_t *samples,
+                          uint32_t num_samples) = 0;
+
+  // Moves btree nodes to free pages at lower addresses, then truncates
+  // the file (ups_env_compact)
+  virtual uint32_t compact(uint32_t max_pages) = 0;
+
   // Creates a new database in the environment (ups_env_create_db)
   virtual Db *do_create_db(DbConfig &config, const ups_parameter_t *param) = 0;
 
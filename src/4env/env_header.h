@@ -49,8 +49,9 @@ typedef UPS_PACK_0 struct UPS_PACK_1
   // version information - major, minor, rev, file
   uint8_t version[4];
 
-  // reserved
-  uint64_t _reserved1;
+  // address of the page with the compression dictionary; 0 if there
+  // is no dictionary
+  uint64_t compression_dictionary;
 
   // size of the page
   uint32_t page_size;
@@ -58,15 +59,22 @@ typedef UPS_PACK_0 struct UPS_PACK_1
   // maximum number of databases in this environment
   uint16_t max_databases;
 
-  // for storing journal compression algorithm
+  // for storing journal compression algorithm (upper 4 bits) and the
+  // checksum algorithm (lower 4 bits)
   uint8_t journal_compression;
 
-  // reserved
-  uint8_t _reserved2;
+  // log2 of the value log threshold; 0 if there is no value log
+  uint8_t value_log_threshold;
 
   // blob id of the PageManager's state
   uint64_t page_manager_blobid;
 
+  // state flags (EnvHeader::kFlag*)
+  uint32_t flags;
+
+  // incremented whenever the Environment is opened for writing
+  uint32_t write_counter;
+
   /*
    * following here:
    *
@@ -75,10 +83,29 @@ typedef UPS_PACK_0 struct UPS_PACK_1
    */
 } UPS_PACK_2 PEnvironmentHeader;
 
+/*
+ * the payload of the page with the compression dictionary
+ */
+typedef UPS_PACK_0 struct UPS_PACK_1
+{
+  // size of the dictionary
+  uint32_t size;
+
+  // the dictionary data
+  uint8_t data[1];
+
+} UPS_PACK_2 PCompressionDictionary;
+
 #include "1base/packstop.h"
 
 struct EnvHeader
 {
+  enum {
+    // the key counters of the btrees were stored when the Environment
+    // was closed; cleared while the Environment is open for writing
+    kFlagKeyCountsValid = 1
+  };
+
   // Constructor
   EnvHeader(Page *page)
     : header_page(page) {
@@ -149,6 +176,16 @@ struct EnvHeader
     header()->page_manager_blobid = blobid;
   }
 
+  // Returns the address of the compression dictionary's page
+  uint64_t compression_dictionary() {
+    return header()->compression_dictionary;
+  }
+
+  // Sets the address of the compression dictionary's page
+  void set_compression_dictionary(uint64_t address) {
+    header()->compression_dictionary = address;
+  }
+
   // Returns the Journal compression configuration
   int journal_compression() {
     return header()->journal_compression >> 4;
@@ -156,7 +193,62 @@ struct EnvHeader
 
   // Sets the Journal compression configuration
   void set_journal_compression(int algorithm) {
-    header()->journal_compression = algorithm << 4;
+    header()->journal_compression = (algorithm << 4)
+            | (header()->journal_compression & 0x0f);
+  }
+
+  // Returns the checksum algorithm for pages and blobs
+  int checksum_algorithm() {
+    return header()->journal_compression & 0x0f;
+  }
+
+  // Sets the checksum algorithm for pages and blobs
+  void set_checksum_algorithm(int algorithm) {
+    header()->journal_compression = (algorithm & 0x0f)
+            | (header()->journal_compression & 0xf0);
+  }
+
+  // Returns the minimum size of records which are stored in the
+  // value log; 0 if the value log is disabled
+  uint32_t value_log_threshold() {
+    uint8_t shift = header()->value_log_threshold;
+    return shift ? 1u << shift : 0;
+  }
+
+  // Sets the value log threshold; it must be a power of two
+  void set_value_log_threshold(uint32_t threshold) {
+    if (threshold == 0) {
+      header()->value_log_threshold = 0;
+      return;
+    }
+    uint8_t shift = 1;
+    while (shift < 31 && (1u << shift) < threshold)
+      shift++;
+    header()->value_log_threshold = shift;
+  }
+
+  // Returns true if the key counters of the btrees are up to date
+  bool key_counts_valid() {
+    return ISSET(header()->flags, kFlagKeyCountsValid);
+  }
+
+  // Sets or clears the kFlagKeyCountsValid flag
+  void set_key_counts_valid(bool valid) {
+    if (valid)
+      header()->flags |= kFlagKeyCountsValid;
+    else
+      header()->flags &= ~kFlagKeyCountsValid;
+  }
+
+  // Returns the number of times the Environment was opened for writing;
+  // identifies the state of the file
+  uint32_t write_counter() {
+    return header()->write_counter;
+  }
+
+  // Sets the write counter
+  void set_write_counter(uint32_t counter) {
+    header()->write_counter = counter;
   }
 
   // Returns a pointer to the header data
@@ -44,7 +44,57 @@ using namespace upscaledb;
 
 namespace upscaledb {
 
+static inline PBtreeHeader *
+btree_header(EnvHeader *header, int i)
+{
+  PBtreeHeader *base = (PBtreeHeader *)
+        (header->header_page->payload() + sizeof(PEnvironmentHeader));
+  return base + i;
+}
+
+static inline LocalDb *
+get_or_open_database(LocalEnv *env, uint16_t dbname, bool *is_opened)
+{
+  LocalDb *db;
+
+  LocalEnv::DatabaseMap::iterator it = env->_database_map.find(dbname);
+  if (it == env->_database_map.end()) {
+    DbConfig config(dbname);
+    db = (LocalDb *)env->do_open_db(config, 0);
+    env->_database_map[dbname] = db;
+    *is_opened = true;
+    return db;
+  }
+
+  *is_opened = false;
+  return (LocalDb *)it->second;
+}
+
+// The key counters of the btrees are only stored when a Database is
+// closed or the Environment is flushed. They are recalculated if the
+// Environment was not closed cleanly, or if the Journal was recovered.
 static inline void
+recalculate_key_counts(LocalEnv *env)
+{
+  for (uint32_t i = 0; i < env->header->max_databases(); i++) {
+    uint16_t name = btree_header(env->header.get(), i)->dbname;
+    if (name == 0)
+      continue;
+
+    bool is_opened = false;
+    LocalDb *db = get_or_open_database(env, name, &is_opened);
+
+    Context context(env, 0, db);
+    db->btree_index->recalculate_key_count(&context);
+    context.changeset.clear();
+
+    if (is_opened)
+      (void)ups_db_close((ups_db_t *)db, UPS_DONT_LOCK);
+  }
+}
+
+// Returns true if the Journal was recovered
+static inline bool
 recover(LocalEnv *env, uint32_t flags)
 {
   assert(ISSET(env->flags(), UPS_ENABLE_TRANSACTIONS));
@@ -58,14 +108,19 @@ recover(LocalEnv *env, uint32_t flags)
   catch (Exception &ex) {
     if (ex.code == UPS_FILE_NOT_FOUND) {
       env->journal->create();
-      return;
+      return false;
     }
   }
 
   /* success - check if we need recovery */
+  bool recovered = false;
   if (!env->journal->is_empty()) {
     if (ISSET(flags, UPS_AUTO_RECOVERY)) {
+      /* the recovery writes the pages directly to the device; the flash
+       * cache would then return stale copies */
+      env->page_manager->discard_flash_cache();
       env->journal->recover((LocalTxnManager *)env->txn_manager.get());
+      recovered = true;
     }
     else {
       /* otherwise close log and journal, but do not delete the files */
@@ -76,32 +131,7 @@ recover(LocalEnv *env, uint32_t flags)
 
   /* reset the page manager */
   env->page_manager->reset(&context);
-}
-
-static inline PBtreeHeader *
-btree_header(EnvHeader *header, int i)
-{
-  PBtreeHeader *base = (PBtreeHeader *)
-        (header->header_page->payload() + sizeof(PEnvironmentHeader));
-  return base + i;
-}
-
-static inline LocalDb *
-get_or_open_database(LocalEnv *env, uint16_t dbname, bool *is_opened)
-{
-  LocalDb *db;
-
-  LocalEnv::DatabaseMap::iterator it = env->_database_map.find(dbname);
-  if (it == env->_database_map.end()) {
-    DbConfig config(dbname);
-    db = (LocalDb *)env->do_open_db(config, 0);
-    env->_database_map[dbname] = db;
-    *is_opened = true;
-    return db;
-  }
-
-  *is_opened = false;
-  return (LocalDb *)it->second;
+  return recovered;
 }
 
 // Sets the dirty-flag of the header page and adds the header page
@@ -115,6 +145,47 @@ mark_header_page_dirty(LocalEnv *env, Context *context)
     context->changeset.put(page);
 }
 
+// Garbage collection of the value log: the BlobManager selects the
+// segments, then the leaf nodes of all databases are visited and the
+// record ids of the live values are updated. The old segments are only
+// deleted after the modified pages were written.
+static inline void
+collect_value_log(LocalEnv *env)
+{
+  if (!env->blob_manager->begin_gc())
+    return;
+
+  for (uint32_t i = 0; i < env->header->max_databases(); i++) {
+    uint16_t name = btree_header(env->header.get(), i)->dbname;
+    if (name == 0)
+      continue;
+
+    bool is_opened = false;
+    LocalDb *db = get_or_open_database(env, name, &is_opened);
+
+    {
+      Context context(env, 0, db);
+      db->btree_index->relocate_blobs(&context);
+
+      /* the relocated values must be persistent before the changeset
+       * is logged */
+      env->blob_manager->flush();
+      if (env->journal)
+        context.changeset.flush();
+      else
+        context.changeset.clear();
+    }
+
+    if (is_opened)
+      (void)ups_db_close((ups_db_t *)db, UPS_DONT_LOCK);
+  }
+
+  env->page_manager->flush_all_pages();
+  env->device->flush();
+
+  env->blob_manager->end_gc();
+}
+
 ups_status_t
 LocalEnv::create()
 {
@@ -129,6 +200,10 @@ LocalEnv::create()
   /* create the file */
   device->create();
 
+  /* a stale flash cache belongs to a different file */
+  if (!config.flash_cache_filename.empty())
+    File::remove(config.flash_cache_filename.c_str());
+
   /* allocate the header page */
   Page *page = new Page(device.get());
   page->alloc(Page::kTypeHeader, config.page_size_bytes);
@@ -144,12 +219,15 @@ LocalEnv::create()
           UPS_FILE_VERSION);
   header->set_page_size(config.page_size_bytes);
   header->set_max_databases(config.max_databases);
+  header->set_value_log_threshold(config.value_log_threshold);
+  config.value_log_threshold = header->value_log_threshold();
+  header->set_checksum_algorithm(config.checksum_algorithm);
 
   /* load page manager after setting up the blobmanager and the device! */
   page_manager.reset(new PageManager(this));
 
   /* the blob manager needs a device and an initialized page manager */
-  blob_manager.reset(BlobManagerFactory::create(this, config.flags));
+  blob_manager.reset(BlobManagerFactory::create(this, config.flags, true));
 
   /* create a logfile and a journal (if requested) */
   if (ISSET(flags(), UPS_ENABLE_TRANSACTIONS)
@@ -168,6 +246,11 @@ LocalEnv::create()
   if (journal.get())
     header->header_page->flush();
 
+  /* committed Transactions are merged in the background (if requested) */
+  if (ISSET(flags(), UPS_FLUSH_TRANSACTIONS_IN_BACKGROUND)
+        && txn_manager.get() != 0)
+    ((LocalTxnManager *)txn_manager.get())->start_background_merge();
+
   return 0;
 }
 
@@ -267,21 +350,49 @@ fail_with_fake_cleansing:
   /* Now that the header page was fetched we can retrieve the compression
    * information */
   config.journal_compressor = header->journal_compression();
+  config.value_log_threshold = header->value_log_threshold();
+  config.checksum_algorithm = header->checksum_algorithm();
 
   /* load page manager after setting up the blobmanager and the device! */
   page_manager.reset(new PageManager(this));
 
   /* the blob manager needs a device and an initialized page manager */
-  blob_manager.reset(BlobManagerFactory::create(this, config.flags));
+  blob_manager.reset(BlobManagerFactory::create(this, config.flags, false));
+
+  /* the journal and the records might be compressed with the
+   * compression dictionary */
+  load_compression_dictionary();
 
   /* check if recovery is required */
+  bool recovered = false;
   if (ISSET(flags(), UPS_ENABLE_TRANSACTIONS))
-    recover(this, config.flags);
+    recovered = recover(this, config.flags);
 
   /* load the state of the PageManager */
   if (header->page_manager_blobid() != 0)
     page_manager->initialize(header->page_manager_blobid());
 
+  /* the key counters are stale if the Environment was not closed cleanly */
+  if (recovered || !header->key_counts_valid())
+    recalculate_key_counts(this);
+
+  /* clear the flag on disk before the file is modified; it is set again
+   * in do_close(). The write counter invalidates the flash cache if the
+   * file is modified without it. */
+  if (NOTSET(flags(), UPS_READ_ONLY)) {
+    header->set_key_counts_valid(false);
+    header->set_write_counter(header->write_counter() + 1);
+    header->header_page->set_dirty(true);
+    header->header_page->flush();
+    device->flush();
+  }
+
+  /* committed Transactions are merged in the background (if requested);
+   * the recovery is already completed at this point */
+  if (ISSET(flags(), UPS_FLUSH_TRANSACTIONS_IN_BACKGROUND)
+        && txn_manager.get() != 0)
+    ((LocalTxnManager *)txn_manager.get())->start_background_merge();
+
   return 0;
 }
 
@@ -341,9 +452,45 @@ LocalEnv::get_parameters(ups_parameter_t *param)
       case UPS_PARAM_JOURNAL_SWITCH_THRESHOLD:
         p->value = config.journal_switch_threshold;
         break;
+      case UPS_PARAM_JOURNAL_CHECKPOINT_BYTES:
+        p->value = config.journal_checkpoint_bytes;
+        break;
+      case UPS_PARAM_JOURNAL_CHECKPOINT_SECONDS:
+        p->value = config.journal_checkpoint_seconds;
+        break;
       case UPS_PARAM_JOURNAL_COMPRESSION:
         p->value = config.journal_compressor;
         break;
+      case UPS_PARAM_VALUE_LOG_THRESHOLD:
+        p->value = config.value_log_threshold;
+        break;
+      case UPS_PARAM_VALUE_LOG_SEGMENT_SIZE:
+        p->value = config.value_log_segment_size;
+        break;
+      case UPS_PARAM_CHECKSUM_ALGORITHM:
+        p->value = config.checksum_algorithm;
+        break;
+      case UPS_PARAM_HOLE_PUNCH_SECONDS:
+        p->value = config.hole_punch_seconds;
+        break;
+      case UPS_PARAM_MMAP_RESERVE_SIZE:
+        p->value = config.mmap_reserve_size;
+        break;
+      case UPS_PARAM_COLD_TIER_FILENAME:
+        if (config.cold_tier_filename.size())
+          p->value = (uint64_t)(config.cold_tier_filename.c_str());
+        else
+          p->value = 0;
+        break;
+      case UPS_PARAM_FLASH_CACHE_FILENAME:
+        if (config.flash_cache_filename.size())
+          p->value = (uint64_t)(config.flash_cache_filename.c_str());
+        else
+          p->value = 0;
+        break;
+      case UPS_PARAM_FLASH_CACHE_SIZE:
+        p->value = config.flash_cache_size;
+        break;
       case UPS_PARAM_POSIX_FADVISE:
         p->value = config.posix_advice;
         break;
@@ -370,6 +517,17 @@ LocalEnv::flush(uint32_t flags)
          || ISSET(this->flags(), UPS_IN_MEMORY))
     return 0;
 
+  /* store the key counters of all open databases */
+  for (DatabaseMap::iterator it = _database_map.begin();
+          it != _database_map.end(); it++) {
+    LocalDb *db = (LocalDb *)it->second;
+    if (db->btree_index->persist_key_count())
+      header->header_page->set_dirty(true);
+  }
+
+  /* the pages can reference blobs which are stored outside of the file */
+  blob_manager->flush();
+
   /* Flush all open pages to disk. This operation is blocking. */
   page_manager->flush_all_pages();
 
@@ -379,6 +537,191 @@ LocalEnv::flush(uint32_t flags)
   return 0;
 }
 
+void
+LocalEnv::train_compression_dictionary(const ups_record_t *samples,
+                uint32_t num_samples)
+{
+  if (ISSET(flags(), UPS_READ_ONLY))
+    throw Exception(UPS_WRITE_PROTECTED);
+
+  // a dictionary cannot be replaced; the existing records would no
+  // longer be readable
+  if (header->compression_dictionary() != 0
+        || !compression_dictionary.is_empty()) {
+    ups_trace(("the Environment already has a compression dictionary"));
+    throw Exception(UPS_INV_PARAMETER);
+  }
+
+  // the dictionary is stored in a single page
+  uint32_t capacity = config.page_size_bytes - Page::kSizeofPersistentHeader
+                - sizeof(PCompressionDictionary);
+  if (capacity > 16 * 1024)
+    capacity = 16 * 1024;
+
+  ByteArray dictionary;
+  dictionary.resize(capacity);
+  CompressorFactory::train_dictionary(samples, num_samples, &dictionary);
+
+  if (NOTSET(flags(), UPS_IN_MEMORY)) {
+    Context context(this, 0, 0);
+
+    Page *page = page_manager->alloc(&context, Page::kTypeHeader,
+                    PageManager::kClearWithZero);
+    PCompressionDictionary *pd = (PCompressionDictionary *)page->payload();
+    pd->size = (uint32_t)dictionary.size();
+    ::memcpy(pd->data, dictionary.data(), dictionary.size());
+    page->set_dirty(true);
+
+    header->set_compression_dictionary(page->address());
+    mark_header_page_dirty(this, &context);
+
+    /* force-flush the changeset */
+    if (journal)
+      context.changeset.flush();
+    else
+      context.changeset.clear();
+
+    /* The journal is compressed with the dictionary from now on, and
+     * the recovery has to load it from the file. Therefore the pages
+     * are written synchronously. */
+    page_manager->flush_all_pages();
+    device->flush();
+  }
+
+  compression_dictionary.copy(dictionary.data(), dictionary.size());
+
+  if (journal && journal->state.compressor.get())
+    journal->state.compressor->set_dictionary(compression_dictionary.data(),
+                    (uint32_t)compression_dictionary.size());
+
+  // the open databases use the dictionary for all following operations
+  for (DatabaseMap::iterator it = _database_map.begin();
+          it != _database_map.end(); it++) {
+    LocalDb *db = (LocalDb *)it->second;
+    if (db->record_compressor.get())
+      db->record_compressor->set_dictionary(compression_dictionary.data(),
+                      (uint32_t)compression_dictionary.size());
+  }
+}
+
+void
+LocalEnv::load_compression_dictionary()
+{
+  uint64_t address = header->compression_dictionary();
+  if (address == 0)
+    return;
+
+  // the page is read directly from the file; the dictionary is loaded
+  // before the recovery, and the page must not end up in the cache
+  Page page(device.get());
+  page.fetch(address);
+
+  PCompressionDictionary *pd = (PCompressionDictionary *)page.payload();
+  uint32_t capacity = config.page_size_bytes - Page::kSizeofPersistentHeader
+                - sizeof(PCompressionDictionary);
+  if (unlikely(pd->size > capacity)) {
+    ups_log(("compression dictionary at %lld is corrupt", address));
+    throw Exception(UPS_INTEGRITY_VIOLATED);
+  }
+
+  compression_dictionary.copy(pd->data, pd->size);
+}
+
+Compressor *
+LocalEnv::create_compressor(int algorithm)
+{
+  Compressor *compressor = CompressorFactory::create(algorithm);
+  if (!compression_dictionary.is_empty()) {
+    try {
+      compressor->set_dictionary(compression_dictionary.data(),
+                      (uint32_t)compression_dictionary.size());
+    }
+    catch (Exception &ex) {
+      delete compressor;
+      throw ex;
+    }
+  }
+  return compressor;
+}
+
+uint32_t
+LocalEnv::compact(uint32_t max_pages)
+{
+  if (ISSET(flags(), UPS_READ_ONLY))
+    throw Exception(UPS_WRITE_PROTECTED);
+
+  if (ISSET(flags(), UPS_IN_MEMORY))
+    return 0;
+
+  collect_value_log(this);
+
+  uint32_t relocated = 0;
+
+  for (uint32_t i = 0; i < header->max_databases(); i++) {
+    uint16_t name = btree_header(header.get(), i)->dbname;
+    if (name == 0)
+      continue;
+
+    uint32_t limit = 0;
+    if (max_pages != 0) {
+      if (relocated >= max_pages)
+        break;
+      limit = max_pages - relocated;
+    }
+
+    bool is_opened = false;
+    LocalDb *db = get_or_open_database(this, name, &is_opened);
+
+    {
+      Context context(this, 0, db);
+      relocated += db->btree_index->compact(&context, limit);
+
+      /* force-flush the changeset */
+      if (journal)
+        context.changeset.flush();
+      else
+        context.changeset.clear();
+    }
+
+    if (is_opened)
+      (void)ups_db_close((ups_db_t *)db, UPS_DONT_LOCK);
+  }
+
+  bool try_reclaim = NOTSET(config.flags, UPS_DISABLE_RECLAIM_INTERNAL);
+
+#ifdef WIN32
+  // Win32: it's not possible to truncate the file while there's an active
+  // mapping, therefore only reclaim if memory mapped I/O is disabled
+  if (NOTSET(config.flags, UPS_DISABLE_MMAP))
+    try_reclaim = false;
+#endif
+
+  Context context(this, 0, 0);
+
+  /* the freed pages are deleted from the cache; make sure that the
+   * worker thread no longer flushes them */
+  page_manager->flush_all_pages();
+
+  /* the state of the PageManager is usually appended to the file */
+  if (max_pages == 0 || relocated < max_pages) {
+    if (page_manager->relocate_state(&context))
+      relocated++;
+  }
+
+  if (try_reclaim) {
+    device->reclaim_space();
+    page_manager->reclaim_space(&context);
+  }
+
+  /* force-flush the changeset with the PageManager's state */
+  if (journal)
+    context.changeset.flush();
+  else
+    context.changeset.clear();
+
+  return relocated;
+}
+
 ups_status_t
 LocalEnv::select_range(const char *query, Cursor *begin,
                             const Cursor *end, Result **result)
@@ -537,7 +880,9 @@ LocalEnv::do_create_db(DbConfig &dbconfig, const ups_parameter_t *param)
   // variable-length binary keys
   if (dbconfig.key_compressor == UPS_COMPRESSOR_LZF
         || dbconfig.key_compressor == UPS_COMPRESSOR_SNAPPY
-        || dbconfig.key_compressor == UPS_COMPRESSOR_ZLIB) {
+        || dbconfig.key_compressor == UPS_COMPRESSOR_ZLIB
+        || dbconfig.key_compressor == UPS_COMPRESSOR_LZ4
+        || dbconfig.key_compressor == UPS_COMPRESSOR_ZSTD) {
     if (unlikely(dbconfig.key_type != UPS_TYPE_BINARY
           || dbconfig.key_size != UPS_KEY_SIZE_UNLIMITED)) {
       ups_trace(("Key compression only allowed for unlimited binary keys "
@@ -595,7 +940,7 @@ LocalEnv::do_create_db(DbConfig &dbconfig, const ups_parameter_t *param)
 
   /* force-flush the changeset */
   if (journal)
-    context.changeset.flush(lsn_manager.next());
+    context.changeset.flush();
 
   return db;
 }
@@ -782,14 +1127,35 @@ LocalEnv::do_close(uint32_t flags)
 {
   Context context(this);
 
-  /* flush all committed transactions */
-  if (likely(txn_manager.get() != 0))
+  /* stop the background merge, then flush all committed transactions */
+  if (likely(txn_manager.get() != 0)) {
+    ((LocalTxnManager *)txn_manager.get())->stop_background_merge();
     txn_manager->flush_committed_txns(&context);
+  }
+
+  /* the pages can reference blobs which are stored outside of the file */
+  if (likely(blob_manager.get() != 0)
+        && NOTSET(this->flags(), UPS_IN_MEMORY))
+    blob_manager->flush();
+
+  /* the key counters are valid if all Databases were closed (and their
+   * counters stored); the header page is flushed by the PageManager */
+  if (likely(header && header->header_page)
+        && NOTSET(this->flags(), UPS_IN_MEMORY | UPS_READ_ONLY)
+        && _database_map.empty()) {
+    header->set_key_counts_valid(true);
+    header->header_page->set_dirty(true);
+  }
 
   /* flush all pages and the freelist, reduce the file size */
   if (likely(page_manager.get() != 0))
     page_manager->close(&context);
 
+  /* the flash cache is valid for the current state of the file */
+  uint32_t write_counter = 0;
+  if (likely(header && header->header_page))
+    write_counter = header->write_counter();
+
   /* close the header page */
   if (likely(header && header->header_page)) {
     Page *page = header->header_page;
@@ -810,6 +1176,10 @@ LocalEnv::do_close(uint32_t flags)
   if (journal)
     journal->close(ISSET(flags, UPS_DONT_CLEAR_LOG));
 
+  /* the index of the flash cache is only valid if all pages were written */
+  if (likely(page_manager.get() != 0))
+    page_manager->close_flash_cache(write_counter);
+
   return 0;
 }
 
@@ -97,6 +97,23 @@ struct LocalEnv : public Env
   virtual ups_status_t select_range(const char *query, Cursor *begin,
                           const Cursor *end, Result **result);
 
+  // Trains and stores a compression dictionary
+  // (ups_env_train_compression_dictionary)
+  virtual void train_compression_dictionary(const ups_record_t *samples,
+                          uint32_t num_samples);
+
+  // Moves btree nodes to free pages at lower addresses, then truncates
+  // the file (ups_env_compact)
+  virtual uint32_t compact(uint32_t max_pages);
+
+  // Loads the compression dictionary (if there is one). Called when the
+  // Environment is opened, before the recovery.
+  void load_compression_dictionary();
+
+  // Creates a compressor; the compression dictionary is set if the
+  // compressor supports it
+  Compressor *create_compressor(int algorithm);
+
   // Closes the Environment (ups_env_close)
   virtual ups_status_t do_close(uint32_t flags);
 
@@ -117,6 +134,9 @@ struct LocalEnv : public Env
 
   // The lsn manager
   LsnManager lsn_manager;
+
+  // The compression dictionary; empty if there is none
+  ByteArray compression_dictionary;
 };
 
 } // namespace upscaledb
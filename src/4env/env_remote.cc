@@ -505,6 +505,19 @@ RemoteEnv::fill_metrics(ups_env_metrics_t *metrics)
   throw Exception(UPS_NOT_IMPLEMENTED);
 }
 
+void
+RemoteEnv::train_compression_dictionary(const ups_record_t *samples,
+                uint32_t num_samples)
+{
+  throw Exception(UPS_NOT_IMPLEMENTED);
+}
+
+uint32_t
+RemoteEnv::compact(uint32_t max_pages)
+{
+  throw Exception(UPS_NOT_IMPLEMENTED);
+}
+
 } // namespace upscaledb
 
 #endif // UPS_ENABLE_REMOTE
@@ -92,6 +92,15 @@ struct RemoteEnv : public Env
   virtual ups_status_t select_range(const char *query, Cursor *begin,
                           const Cursor *end, Result **result);
 
+  // Trains and stores a compression dictionary
+  // (ups_env_train_compression_dictionary)
+  virtual void train_compression_dictionary(const ups_record_t *samples,
+                          uint32_t num_samples);
+
+  // Moves btree nodes to free pages at lower addresses, then truncates
+  // the file (ups_env_compact)
+  virtual uint32_t compact(uint32_t max_pages);
+
   // Creates a new database in the environment (ups_env_create_db)
   virtual Db *do_create_db(DbConfig &config, const ups_parameter_t *param);
 
@@ -26,7 +26,7 @@
  * When a Database is created, it contains a BtreeIndex for persistent
  * (committed and flushed) data, and a TxnIndex for active transactions
  * and those transactions which were committed but not yet flushed to disk.
- * This TxnTree is implemented as a binary search tree (see rb.h).
+ * This TxnTree is implemented as an in-memory B+tree (see txn_local.h).
  *
  * Each node in the TxnTree is implemented by TxnNode. Each
  * node is identified by its database key, and groups all modifications of this
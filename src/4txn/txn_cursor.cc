@@ -71,11 +71,18 @@ move_top_in_node(TxnCursor *cursor, TxnNode *node, bool ignore_conflicts,
                 uint32_t flags)
 {
   TxnCursorState &state_ = cursor->state_;
+  LocalTxn *txn = (LocalTxn *)state_.parent->txn;
+  bool snapshot = txn && txn->is_snapshot();
 
   for (TxnOperation *op = node->newest_op;
                   op != 0;
                   op = op->previous_in_node) {
-    Txn *optxn = op->txn;
+    LocalTxn *optxn = op->txn;
+    // a snapshot skips all transactions which were not yet committed
+    // when it began
+    if (unlikely(snapshot && !txn->is_visible(optxn)))
+      continue;
+
     // only look at ops from the current transaction and from
     // committed transactions
     if (optxn == state_.parent->txn || optxn->is_committed()) {
@@ -169,18 +176,28 @@ TxnCursor::move(uint32_t flags)
     set_to_nil();
 
     node = db(state_)->txn_index->first();
-    if (unlikely(!node))
-      return UPS_KEY_NOT_FOUND;
-    return move_top_in_node(this, node, false, flags);
+    while (node) {
+      // skip nodes without visible operations (see UPS_TXN_SNAPSHOT)
+      st = move_top_in_node(this, node, false, flags);
+      if (st != UPS_KEY_NOT_FOUND)
+        return st;
+      node = node->next_sibling();
+    }
+    return UPS_KEY_NOT_FOUND;
   }
 
   if (ISSET(flags, UPS_CURSOR_LAST)) {
     set_to_nil();
 
     node = db(state_)->txn_index->last();
-    if (unlikely(!node))
-      return UPS_KEY_NOT_FOUND;
-    return move_top_in_node(this, node, false, flags);
+    while (node) {
+      // skip nodes without visible operations (see UPS_TXN_SNAPSHOT)
+      st = move_top_in_node(this, node, false, flags);
+      if (st != UPS_KEY_NOT_FOUND)
+        return st;
+      node = node->previous_sibling();
+    }
+    return UPS_KEY_NOT_FOUND;
   }
 
   if (ISSET(flags, UPS_CURSOR_NEXT)) {
@@ -29,7 +29,7 @@
 
 // Always verify that a file of level N does not include headers > N!
 #include "1mem/mem.h"
-#include "4txn/txn.h"
+#include "4txn/txn_local.h"
 
 #ifndef UPS_ROOT_H
 #  error "root.h was not included"
@@ -38,12 +38,13 @@
 namespace upscaledb {
 
 struct TxnFactory {
-  // Creates a new TxnOperation
+  // Creates a new TxnOperation; the memory is allocated from the arena
+  // of the Txn
   static TxnOperation *create_operation(LocalTxn *txn,
             TxnNode *node, uint32_t flags, uint32_t orig_flags,
             uint64_t lsn, ups_key_t *key, ups_record_t *record) {
     TxnOperation *op;
-    op = Memory::allocate<TxnOperation>(sizeof(*op)
+    op = txn->arena.allocate<TxnOperation>(sizeof(*op)
                                             + (record ? record->size : 0)
                                             + (key ? key->size : 0));
     op->initialize(txn, node, flags, orig_flags, lsn, key, record);
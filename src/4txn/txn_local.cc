@@ -35,34 +35,126 @@
 
 namespace upscaledb {
 
-// stuff for rb.h
-#ifndef __ssize_t_defined
-typedef signed ssize_t;
-#endif
-#ifndef __cplusplus
-typedef int bool;
-#define true 1
-#define false (!true)
-#endif // __cpluscplus
+// The first bytes of a key, which are stored inline in the TxnIndex
+struct TxnKeyPrefix {
+  enum {
+    // the number of key bytes which are stored inline
+    kSize = 14
+  };
+
+  // the first bytes of the key
+  uint8_t data[kSize];
+
+  // the full size of the key
+  uint16_t size;
+};
+
+//
+// A page of the in-memory B+tree of the TxnIndex. Leaf pages store the
+// TxnNodes in sorted order, internal pages store their child pages and the
+// smallest TxnNode of each child. The first bytes of each key are stored
+// inline; most comparisons therefore do not have to touch the TxnNode and
+// its operations, which are scattered all over the heap.
+//
+struct TxnIndexPage {
+  enum {
+    // the number of slots per page
+    kCapacity = 32
+  };
+
+  // Constructor
+  TxnIndexPage(bool is_leaf_)
+    : is_leaf(is_leaf_), length(0), parent(0), left(0), right(0) {
+  }
+
+  // Returns the slot of |node| in this leaf
+  int slot_of(TxnNode *node) const {
+    int slot = 0;
+    while (nodes[slot] != node)
+      slot++;
+    assert(slot < length);
+    return slot;
+  }
+
+  // Returns the slot of |child| in this internal page
+  int slot_of(TxnIndexPage *child) const {
+    int slot = 0;
+    while (children[slot] != child)
+      slot++;
+    assert(slot < length);
+    return slot;
+  }
+
+  // true if this is a leaf page
+  bool is_leaf;
+
+  // the number of used slots
+  int length;
 
-static int
-compare(void *vlhs, void *vrhs)
+  // the parent page, or null for the root page
+  TxnIndexPage *parent;
+
+  // the siblings on the leaf level
+  TxnIndexPage *left;
+  TxnIndexPage *right;
+
+  // the key prefixes of all slots
+  TxnKeyPrefix prefixes[kCapacity];
+
+  // leaf pages: the TxnNodes; internal pages: the smallest TxnNode
+  // of each child
+  TxnNode *nodes[kCapacity];
+
+  // the child pages (only for internal pages)
+  TxnIndexPage *children[kCapacity];
+};
+
+// Copies the first bytes of |key| to |prefix|
+static inline void
+set_prefix(TxnKeyPrefix *prefix, ups_key_t *key)
 {
-  TxnNode *lhs = (TxnNode *)vlhs;
-  TxnNode *rhs = (TxnNode *)vrhs;
-  LocalDb *db = lhs->db;
+  prefix->size = key->size;
+  if (likely(key->size > 0))
+    ::memcpy(prefix->data, key->data,
+            std::min<uint32_t>(key->size, TxnKeyPrefix::kSize));
+}
 
-  if (unlikely(lhs == rhs))
-    return 0;
+// Returns the |slot|th node of a leaf; |slot| can point to the last node
+// of the left sibling (-1) or the first node of the right sibling (length)
+static inline TxnNode *
+node_at(TxnIndexPage *leaf, int slot)
+{
+  if (slot < 0)
+    return leaf->left ? leaf->left->nodes[leaf->left->length - 1] : 0;
+  if (slot >= leaf->length)
+    return leaf->right ? leaf->right->nodes[0] : 0;
+  return leaf->nodes[slot];
+}
 
-  ups_key_t *lhskey = lhs->key();
-  ups_key_t *rhskey = rhs->key();
-  assert(lhskey && rhskey);
-  return db->btree_index->compare_keys(lhskey, rhskey);
+// Propagates the smallest key of |page| to the parent pages
+static inline void
+propagate_smallest_key(TxnIndexPage *page)
+{
+  while (page->parent) {
+    TxnIndexPage *parent = page->parent;
+    int slot = parent->slot_of(page);
+    parent->nodes[slot] = page->nodes[0];
+    parent->prefixes[slot] = page->prefixes[0];
+    if (slot != 0)
+      break;
+    page = parent;
+  }
 }
 
-rb_proto(static, rbt_, TxnIndex, TxnNode)
-rb_gen(static, rbt_, TxnIndex, TxnNode, node, compare)
+// Deletes a page and all its child pages
+static void
+delete_pages(TxnIndexPage *page)
+{
+  if (!page->is_leaf)
+    for (int i = 0; i < page->length; i++)
+      delete_pages(page->children[i]);
+  delete page;
+}
 
 static inline int
 count_flushable_transactions(LocalTxnManager *tm)
@@ -87,6 +179,19 @@ count_flushable_transactions(LocalTxnManager *tm)
   return to_flush;
 }
 
+// Returns the lsn of the oldest active snapshot, or 0 if there is none
+static inline uint64_t
+oldest_snapshot_lsn(LocalTxnManager *tm)
+{
+  for (LocalTxn *txn = (LocalTxn *)tm->oldest_txn();
+                  txn != 0;
+                  txn = (LocalTxn *)txn->next()) {
+    if (txn->is_snapshot() && !txn->is_committed() && !txn->is_aborted())
+      return txn->lsn;
+  }
+  return 0;
+}
+
 static inline void
 flush_committed_txns_impl(LocalTxnManager *tm, Context *context)
 {
@@ -95,10 +200,17 @@ flush_committed_txns_impl(LocalTxnManager *tm, Context *context)
 
   assert(context->changeset.is_empty());
 
+  // transactions which were committed after an active snapshot began
+  // must not be flushed; otherwise their modifications would become
+  // visible to the snapshot
+  uint64_t snapshot_lsn = oldest_snapshot_lsn(tm);
+
   // always get the oldest transaction; if it was committed: flush
   // it; if it was aborted: discard it; otherwise return
   while ((oldest = (LocalTxn *)tm->oldest_txn())) {
     if (oldest->is_committed()) {
+      if (unlikely(snapshot_lsn && oldest->commit_lsn > snapshot_lsn))
+        break;
       uint64_t lsn = tm->flush_txn_to_changeset(context, (LocalTxn *)oldest);
       if (lsn > highest_lsn)
         highest_lsn = lsn;
@@ -118,12 +230,67 @@ flush_committed_txns_impl(LocalTxnManager *tm, Context *context)
 
   // now flush the changeset and write the modified pages to disk
   if (highest_lsn && tm->lenv()->journal.get())
-    context->changeset.flush(tm->lenv()->lsn_manager.next());
+    context->changeset.flush();
   else
     context->changeset.clear();
   assert(context->changeset.is_empty());
 }
 
+// Merges the committed Txns into the btree; runs in the background thread
+static void
+async_merge_txns(LocalTxnManager *tm)
+{
+  ScopedLock lock(tm->env->mutex);
+
+  tm->merge_pending = false;
+  if (unlikely(tm->closing))
+    return;
+
+  Context context(tm->lenv(), 0, 0);
+
+  try {
+    flush_committed_txns_impl(tm, &context);
+  }
+  catch (Exception &ex) {
+    // the remaining Txns are flushed by the next merge (or when the
+    // Environment is closed)
+    ups_log(("failed to merge committed Txns: %d", ex.code));
+  }
+}
+
+// Flushes the committed Txns if the flush threshold is reached, or
+// schedules a background merge if UPS_FLUSH_TRANSACTIONS_IN_BACKGROUND
+// is enabled
+static inline void
+maybe_flush_committed_txns(LocalTxnManager *tm, Context *context)
+{
+  uint32_t flags = tm->lenv()->flags();
+
+  if (unlikely(ISSET(flags, UPS_DONT_FLUSH_TRANSACTIONS)))
+    return;
+
+  if (unlikely(ISSET(flags, UPS_FLUSH_TRANSACTIONS_IMMEDIATELY))) {
+    flush_committed_txns_impl(tm, context);
+    return;
+  }
+
+  int to_flush = count_flushable_transactions(tm);
+  if (likely(to_flush < Globals::ms_flush_threshold))
+    return;
+
+  // let the background thread do the work, unless it falls behind
+  if (tm->merger.get() && to_flush < Globals::ms_flush_threshold
+                                * LocalTxnManager::kMaxBacklogFactor) {
+    if (!tm->merge_pending) {
+      tm->merge_pending = true;
+      tm->run_async(boost::bind(&async_merge_txns, tm));
+    }
+    return;
+  }
+
+  flush_committed_txns_impl(tm, context);
+}
+
 void
 TxnOperation::initialize(LocalTxn *txn_, TxnNode *node_,
             uint32_t flags_, uint32_t original_flags_, uint64_t lsn_,
@@ -186,26 +353,25 @@ TxnOperation::destroy()
   if (previous_in_txn)
     previous_in_txn->next_in_txn = next_in_txn;
 
+  // the memory of this operation is owned by the Txn's arena
   if (delete_node)
-    delete node;
-
-  Memory::release(this);
+    node->db->txn_index->release_node(node);
 }
 
 TxnNode *
 TxnNode::next_sibling()
 {
-  return rbt_next(db->txn_index.get(), this);
+  return node_at(leaf, leaf->slot_of(this) + 1);
 }
 
 TxnNode *
 TxnNode::previous_sibling()
 {
-  return rbt_prev(db->txn_index.get(), this);
+  return node_at(leaf, leaf->slot_of(this) - 1);
 }
 
 TxnNode::TxnNode(LocalDb *db_, ups_key_t *key)
-  : db(db_), oldest_op(0), newest_op(0), _key(key)
+  : leaf(0), db(db_), oldest_op(0), newest_op(0), _key(key)
 {
 }
 
@@ -253,71 +419,253 @@ TxnNode *
 TxnIndex::store(ups_key_t *key, bool *node_created)
 {
   *node_created = false;
-  TxnNode *node = get(key, 0);
-  if (!node) {
-    node = new TxnNode(db, key);
-    *node_created = true;
-    rbt_insert(this, node);
-  }
 
+  int cmp;
+  TxnIndexPage *leaf = find_leaf(key);
+  int slot = lower_bound(leaf, key, &cmp);
+  if (slot < leaf->length && cmp == 0)
+    return leaf->nodes[slot];
+
+  TxnNode *node = allocate_node(key);
+  *node_created = true;
+
+  TxnKeyPrefix prefix;
+  set_prefix(&prefix, key);
+  insert_slot(leaf, slot, node, &prefix, 0);
   return node;
 }
 
 void
 TxnIndex::remove(TxnNode *node)
 {
-  rbt_remove(this, node);
+  remove_slot(node->leaf, node->leaf->slot_of(node));
 }
 
-static inline void
-flush_transaction_to_journal(LocalTxn *txn)
+int
+TxnIndex::compare(ups_key_t *key, TxnIndexPage *page, int slot) const
 {
-  LocalEnv *lenv = (LocalEnv *)txn->env;
-  Journal *journal = lenv->journal.get();
+  const TxnKeyPrefix &prefix = page->prefixes[slot];
+
+  // binary keys: compare the inline prefix; only if both prefixes are
+  // identical then the full keys are compared
+  if (memcmp_order) {
+    uint32_t size = std::min<uint32_t>(key->size, prefix.size);
+    if (size <= TxnKeyPrefix::kSize) {
+      int m = ::memcmp(key->data, prefix.data, size);
+      if (m != 0)
+        return m;
+      return (int)key->size - (int)prefix.size;
+    }
+    int m = ::memcmp(key->data, prefix.data, TxnKeyPrefix::kSize);
+    if (m != 0)
+      return m;
+  }
+  // all other key types: use the inline key if it's complete
+  else if (prefix.size <= TxnKeyPrefix::kSize) {
+    ups_key_t rhs = ups_make_key((void *)prefix.data, prefix.size);
+    return db->btree_index->compare_keys(key, &rhs);
+  }
 
-  if (unlikely(journal == 0))
-    return;
- 
-  if (NOTSET(txn->flags, UPS_TXN_TEMPORARY))
-    journal->append_txn_begin(txn, txn->name.empty() ? 0 : txn->name.c_str(),
-                    txn->lsn);
+  return db->btree_index->compare_keys(key, page->nodes[slot]->key());
+}
 
-  for (TxnOperation *op = txn->oldest_op;
-                  op != 0;
-                  op = op->next_in_txn) {
-    if (ISSET(op->flags, TxnOperation::kErase)) {
-      journal->append_erase(op->node->db, txn,
-                      op->node->key(), op->referenced_duplicate,
-                      op->original_flags, op->lsn);
-      continue;
+int
+TxnIndex::lower_bound(TxnIndexPage *page, ups_key_t *key, int *pcmp) const
+{
+  int lo = 0;
+  int hi = page->length;
+  *pcmp = 1;
+
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    int cmp = compare(key, page, mid);
+    if (cmp > 0)
+      lo = mid + 1;
+    else {
+      hi = mid;
+      *pcmp = cmp;
     }
-    if (ISSET(op->flags, TxnOperation::kInsert)) {
-      journal->append_insert(op->node->db, txn,
-                      op->node->key(), &op->record,
-                      op->original_flags, op->lsn);
-      continue;
+  }
+  return lo;
+}
+
+TxnIndexPage *
+TxnIndex::find_leaf(ups_key_t *key) const
+{
+  TxnIndexPage *page = root;
+
+  while (!page->is_leaf) {
+    int cmp;
+    int slot = lower_bound(page, key, &cmp);
+    if (slot == page->length || cmp != 0)
+      slot--;
+    page = page->children[slot < 0 ? 0 : slot];
+  }
+  return page;
+}
+
+void
+TxnIndex::insert_slot(TxnIndexPage *page, int slot, TxnNode *node,
+                const TxnKeyPrefix *prefix, TxnIndexPage *child)
+{
+  if (page->length == TxnIndexPage::kCapacity) {
+    TxnIndexPage *sibling = split(page);
+    if (slot > page->length) {
+      slot -= page->length;
+      page = sibling;
     }
-    if (ISSET(op->flags, TxnOperation::kInsertOverwrite)) {
-      journal->append_insert(op->node->db, txn,
-                      op->node->key(), &op->record,
-                      op->original_flags | UPS_OVERWRITE, op->lsn);
-      continue;
+  }
+
+  int shift = page->length - slot;
+  if (shift > 0) {
+    ::memmove(&page->nodes[slot + 1], &page->nodes[slot],
+                    sizeof(page->nodes[0]) * shift);
+    ::memmove(&page->prefixes[slot + 1], &page->prefixes[slot],
+                    sizeof(page->prefixes[0]) * shift);
+    if (!page->is_leaf)
+      ::memmove(&page->children[slot + 1], &page->children[slot],
+                    sizeof(page->children[0]) * shift);
+  }
+
+  page->nodes[slot] = node;
+  page->prefixes[slot] = *prefix;
+  if (page->is_leaf)
+    node->leaf = page;
+  else {
+    page->children[slot] = child;
+    child->parent = page;
+  }
+  page->length++;
+
+  if (slot == 0)
+    propagate_smallest_key(page);
+}
+
+TxnIndexPage *
+TxnIndex::split(TxnIndexPage *page)
+{
+  TxnIndexPage *sibling = new TxnIndexPage(page->is_leaf);
+  int pivot = page->length / 2;
+
+  sibling->length = page->length - pivot;
+  ::memcpy(&sibling->nodes[0], &page->nodes[pivot],
+                  sizeof(page->nodes[0]) * sibling->length);
+  ::memcpy(&sibling->prefixes[0], &page->prefixes[pivot],
+                  sizeof(page->prefixes[0]) * sibling->length);
+  if (page->is_leaf) {
+    for (int i = 0; i < sibling->length; i++)
+      sibling->nodes[i]->leaf = sibling;
+
+    sibling->left = page;
+    sibling->right = page->right;
+    if (page->right)
+      page->right->left = sibling;
+    page->right = sibling;
+  }
+  else {
+    ::memcpy(&sibling->children[0], &page->children[pivot],
+                  sizeof(page->children[0]) * sibling->length);
+    for (int i = 0; i < sibling->length; i++)
+      sibling->children[i]->parent = sibling;
+  }
+  page->length = pivot;
+
+  // a new root is required if the root page was split
+  if (!page->parent) {
+    root = new TxnIndexPage(false);
+    root->length = 1;
+    root->nodes[0] = page->nodes[0];
+    root->prefixes[0] = page->prefixes[0];
+    root->children[0] = page;
+    page->parent = root;
+  }
+
+  insert_slot(page->parent, page->parent->slot_of(page) + 1,
+                  sibling->nodes[0], &sibling->prefixes[0], sibling);
+  return sibling;
+}
+
+void
+TxnIndex::remove_slot(TxnIndexPage *page, int slot)
+{
+  page->length--;
+
+  int shift = page->length - slot;
+  if (shift > 0) {
+    ::memmove(&page->nodes[slot], &page->nodes[slot + 1],
+                    sizeof(page->nodes[0]) * shift);
+    ::memmove(&page->prefixes[slot], &page->prefixes[slot + 1],
+                    sizeof(page->prefixes[0]) * shift);
+    if (!page->is_leaf)
+      ::memmove(&page->children[slot], &page->children[slot + 1],
+                    sizeof(page->children[0]) * shift);
+  }
+
+  // the root page is never removed, but it's replaced by its only child
+  // (which can again be an internal page with a single child)
+  if (page == root) {
+    while (!root->is_leaf && root->length == 1) {
+      page = root;
+      root = page->children[0];
+      root->parent = 0;
+      delete page;
     }
-    if (ISSET(op->flags, TxnOperation::kInsertDuplicate)) {
-      journal->append_insert(op->node->db, txn,
-                    op->node->key(), &op->record,
-                      op->original_flags | UPS_DUPLICATE, op->lsn);
-      continue;
+    return;
+  }
+
+  if (page->length == 0) {
+    if (page->is_leaf) {
+      if (page->left)
+        page->left->right = page->right;
+      if (page->right)
+        page->right->left = page->left;
     }
-    assert(!"shouldn't be here");
+    TxnIndexPage *parent = page->parent;
+    int parent_slot = parent->slot_of(page);
+    delete page;
+    remove_slot(parent, parent_slot);
+    return;
   }
 
-  if (NOTSET(txn->flags, UPS_TXN_TEMPORARY))
-    journal->append_txn_commit(txn, lenv->lsn_manager.next());
+  if (slot == 0)
+    propagate_smallest_key(page);
+}
+
+TxnNode *
+TxnIndex::allocate_node(ups_key_t *key)
+{
+  void *p;
+  if (free_nodes) {
+    p = free_nodes;
+    free_nodes = *(TxnNode **)free_nodes;
+  }
+  else
+    p = node_arena.allocate<void>(sizeof(TxnNode));
+  return new (p) TxnNode(db, key);
+}
+
+void
+TxnIndex::release_node(TxnNode *node)
+{
+  // the first bytes of a released node are used as the link to the
+  // next released node
+  *(TxnNode **)node = free_nodes;
+  free_nodes = node;
+}
+
+static inline void
+flush_transaction_to_journal(LocalTxn *txn)
+{
+  LocalEnv *lenv = (LocalEnv *)txn->env;
+  Journal *journal = lenv->journal.get();
+
+  if (likely(journal != 0))
+    journal->append_txn(txn, txn->commit_ticket);
 }
 
 LocalTxn::LocalTxn(LocalEnv *env, const char *name, uint32_t flags)
-  : Txn(env, name, flags), log_descriptor(0), oldest_op(0), newest_op(0)
+  : Txn(env, name, flags), log_descriptor(0), commit_lsn(0), oldest_op(0),
+    newest_op(0)
 {
   LocalTxnManager *ltm = (LocalTxnManager *)env->txn_manager.get();
   id = ltm->incremented_txn_id();
@@ -338,8 +686,16 @@ LocalTxn::commit()
     throw Exception(UPS_CURSOR_STILL_OPEN);
   }
 
-  // this transaction is now committed!
+  // this transaction is now committed! if journalling is enabled then the
+  // commit lsn also reserves the position of the journal record
   flags |= kStateCommitted;
+  LocalEnv *lenv = (LocalEnv *)env;
+  if (lenv->journal.get()) {
+    commit_ticket = lenv->journal->reserve();
+    commit_lsn = commit_ticket.lsn;
+  }
+  else
+    commit_lsn = lenv->lsn_manager.next();
 }
 
 void
@@ -371,25 +727,21 @@ LocalTxn::free_operations()
 
   oldest_op = 0;
   newest_op = 0;
+
+  // and release the memory of all operations in a single step
+  arena.clear();
 }
 
 TxnIndex::TxnIndex(LocalDb *db)
-  : db(db)
+  : db(db), root(new TxnIndexPage(true)),
+    memcmp_order(db->config.key_type == UPS_TYPE_BINARY), free_nodes(0)
 {
-  rbt_new(this);
 }
 
 TxnIndex::~TxnIndex()
 {
-  TxnNode *node;
-
-  while ((node = rbt_last(this))) {
-    remove(node);
-    delete node;
-  }
-
-  // re-initialize the tree
-  rbt_new(this);
+  // the memory of the nodes is released by |node_arena|
+  delete_pages(root);
 }
 
 TxnNode *
@@ -397,39 +749,33 @@ TxnIndex::get(ups_key_t *key, uint32_t flags)
 {
   TxnNode *node = 0;
   int match = 0;
+  int cmp;
 
-  // create a temporary node that we can search for
-  TxnNode tmp(db, key);
+  TxnIndexPage *leaf = find_leaf(key);
+  int slot = lower_bound(leaf, key, &cmp);
+  bool exact = slot < leaf->length && cmp == 0;
 
   // search if node already exists - if yes, return it
   if (ISSET(flags, UPS_FIND_GEQ_MATCH)) {
-    node = rbt_nsearch(this, &tmp);
+    node = node_at(leaf, slot);
     if (node)
-      match = compare(&tmp, node);
+      match = exact ? 0 : db->btree_index->compare_keys(key, node->key());
   }
   else if (ISSET(flags, UPS_FIND_LEQ_MATCH)) {
-    node = rbt_psearch(this, &tmp);
+    node = node_at(leaf, exact ? slot : slot - 1);
     if (node)
-      match = compare(&tmp, node);
+      match = exact ? 0 : db->btree_index->compare_keys(key, node->key());
   }
   else if (ISSET(flags, UPS_FIND_GT_MATCH)) {
-    node = rbt_search(this, &tmp);
-    if (node)
-      node = node->next_sibling();
-    else
-      node = rbt_nsearch(this, &tmp);
+    node = node_at(leaf, exact ? slot + 1 : slot);
     match = 1;
   }
   else if (ISSET(flags, UPS_FIND_LT_MATCH)) {
-    node = rbt_search(this, &tmp);
-    if (node)
-      node = node->previous_sibling();
-    else
-      node = rbt_psearch(this, &tmp);
+    node = node_at(leaf, slot - 1);
     match = -1;
   }
   else
-    return rbt_search(this, &tmp);
+    return exact ? leaf->nodes[slot] : 0;
 
   // Nothing found?
   if (!node)
@@ -449,23 +795,29 @@ TxnIndex::get(ups_key_t *key, uint32_t flags)
 TxnNode *
 TxnIndex::first()
 {
-  return rbt_first(this);
+  TxnIndexPage *page = root;
+  while (!page->is_leaf)
+    page = page->children[0];
+  return page->length > 0 ? page->nodes[0] : 0;
 }
 
 TxnNode *
 TxnIndex::last()
 {
-  return rbt_last(this);
+  TxnIndexPage *page = root;
+  while (!page->is_leaf)
+    page = page->children[page->length - 1];
+  return page->length > 0 ? page->nodes[page->length - 1] : 0;
 }
 
 void
 TxnIndex::enumerate(Context *context, TxnIndex::Visitor *visitor)
 {
-  TxnNode *node = rbt_first(this);
+  TxnNode *node = first();
 
   while (node) {
     visitor->visit(context, node);
-    node = rbt_next(this, node);
+    node = node->next_sibling();
   }
 }
 
@@ -497,6 +849,10 @@ struct KeyCounter : TxnIndex::Visitor {
       if (optxn->is_aborted())
         continue;
 
+      // snapshots ignore transactions which were committed later
+      if (unlikely(txn && txn->is_snapshot() && !txn->is_visible(optxn)))
+        continue;
+
       if (optxn->is_committed() || txn == optxn) {
         if (ISSET(op->flags, TxnOperation::kIsFlushed))
           continue;
@@ -584,14 +940,7 @@ LocalTxnManager::commit(Txn *htxn)
     flush_transaction_to_journal(txn);
 
     // flush committed transactions
-    if (likely(NOTSET(lenv()->flags(), UPS_DONT_FLUSH_TRANSACTIONS))) {
-      if (unlikely(ISSET(lenv()->flags(), UPS_FLUSH_TRANSACTIONS_IMMEDIATELY)
-                || count_flushable_transactions(this)
-                        >= Globals::ms_flush_threshold)) {
-        flush_committed_txns_impl(this, &context);
-        return 0;
-      }
-    }
+    maybe_flush_committed_txns(this, &context);
   }
   catch (Exception &ex) {
     return ex.code;
@@ -610,14 +959,7 @@ LocalTxnManager::abort(Txn *htxn)
     txn->abort();
 
     // flush committed transactions
-    if (likely(NOTSET(lenv()->flags(), UPS_DONT_FLUSH_TRANSACTIONS))) {
-      if (unlikely(ISSET(lenv()->flags(), UPS_FLUSH_TRANSACTIONS_IMMEDIATELY)
-                || count_flushable_transactions(this)
-                        >= Globals::ms_flush_threshold)) {
-        flush_committed_txns_impl(this, &context);
-        return 0;
-      }
-    }
+    maybe_flush_committed_txns(this, &context);
   }
   catch (Exception &ex) {
     return ex.code;
@@ -625,6 +967,25 @@ LocalTxnManager::abort(Txn *htxn)
   return 0;
 }
 
+LocalTxnManager::~LocalTxnManager()
+{
+  if (merger.get()) {
+    // a merge which is still waiting for the mutex is skipped
+    {
+      ScopedLock lock(env->mutex);
+      closing = true;
+    }
+    merger.reset(0);
+  }
+}
+
+void
+LocalTxnManager::start_background_merge()
+{
+  if (!merger.get())
+    merger.reset(new WorkerPool(1));
+}
+
 void
 LocalTxnManager::flush_committed_txns(Context *context /* = 0 */)
 {
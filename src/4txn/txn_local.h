@@ -22,7 +22,10 @@
 #include "0root/root.h"
 
 // Always verify that a file of level N does not include headers > N!
-#include "1rb/rb.h"
+#include "1base/scoped_ptr.h"
+#include "1mem/arena.h"
+#include "2lsn_manager/lsn_pipeline.h"
+#include "2worker/worker.h"
 #include "4txn/txn.h"
 
 #ifndef UPS_ROOT_H
@@ -34,6 +37,8 @@ namespace upscaledb {
 struct Context;
 struct TxnNode;
 struct TxnIndex;
+struct TxnIndexPage;
+struct TxnKeyPrefix;
 struct TxnCursor;
 struct LocalTxn;
 struct LocalDb;
@@ -130,7 +135,7 @@ struct TxnOperation {
 
 
 //
-// A node in the Txn Index, used as the node structure in rb.h.
+// A node in the Txn Index, stored in the leaf pages of the TxnIndex.
 // Manages a group of TxnOperation objects which all modify the
 // same key.
 //
@@ -143,12 +148,11 @@ struct TxnOperation {
 //
 struct TxnNode {
   // Constructor;
-  // The default parameters are required for the compilation of rb.h.
   // |key| is just a temporary pointer which allows to create a
   // TxnNode without further memory allocations/copying. The actual
   // key is then fetched from |oldest_op| as soon as this node is fully
   // initialized.
-  TxnNode(LocalDb *db = 0, ups_key_t *key = 0);
+  TxnNode(LocalDb *db, ups_key_t *key);
 
   // Returns the modified key
   ups_key_t *key() {
@@ -168,8 +172,8 @@ struct TxnNode {
               uint32_t flags, uint64_t lsn, ups_key_t *key,
               ups_record_t *record);
 
-  // red-black tree stub, required for rb.h
-  rb_node(TxnNode) node;
+  // the leaf page of the TxnIndex which stores this node
+  TxnIndexPage *leaf;
 
   // the database - need this to get the compare function
   LocalDb *db;
@@ -181,14 +185,16 @@ struct TxnNode {
   TxnOperation *newest_op;
 
   // Pointer to the key data; only used as long as there are no operations
-  // attached. Otherwise we have a chicken-egg problem in rb.h.
+  // attached
   ups_key_t *_key;
 };
 
 
 //
-// Each Database has a binary tree which stores the current Txn
-// operations; this tree is implemented in TxnIndex
+// Each Database has an index which stores the current Txn operations.
+// The TxnIndex is an in-memory B+tree; its pages store pointers to the
+// TxnNodes and the first bytes of each key, which keeps lookups and
+// sibling traversal within a few cache lines.
 //
 struct TxnIndex {
   // Traverses a TxnIndex; for each node, a callback is executed
@@ -199,7 +205,7 @@ struct TxnIndex {
   // Constructor
   TxnIndex(LocalDb *db);
 
-  // Destructor; frees all nodes and their operations
+  // Destructor; frees all pages and nodes
   ~TxnIndex();
 
   // Stores a new TxnNode in the index, but only if the node does not yet
@@ -228,13 +234,52 @@ struct TxnIndex {
   // Returns the key count of this index
   uint64_t count(Context *context, LocalTxn *txn, bool distinct);
 
+  // Allocates and constructs a new TxnNode; the memory is recycled from
+  // previously released nodes, if possible
+  TxnNode *allocate_node(ups_key_t *key);
+
+  // Returns a TxnNode to the pool. The node must no longer be part of the
+  // tree.
+  void release_node(TxnNode *node);
+
+  // Compares |key| with the key in |slot| of |page|
+  int compare(ups_key_t *key, TxnIndexPage *page, int slot) const;
+
+  // Returns the first slot of |page| with a key >= |key|; |pcmp| receives
+  // the result of the comparison with this slot
+  int lower_bound(TxnIndexPage *page, ups_key_t *key, int *pcmp) const;
+
+  // Returns the leaf page which stores (or would store) |key|
+  TxnIndexPage *find_leaf(ups_key_t *key) const;
+
+  // Inserts a new slot at position |slot| of |page|, and splits the page
+  // if it is full. |child| is the new child of an internal page.
+  void insert_slot(TxnIndexPage *page, int slot, TxnNode *node,
+                  const TxnKeyPrefix *prefix, TxnIndexPage *child);
+
+  // Moves the upper half of a full page to a new sibling, which is then
+  // inserted into the parent. Returns the new sibling.
+  TxnIndexPage *split(TxnIndexPage *page);
+
+  // Removes a slot from |page|; empty pages are removed from the tree
+  void remove_slot(TxnIndexPage *page, int slot);
+
   // the Database for all operations in this tree
-  // TODO is this required?
   LocalDb *db;
 
-  // stuff for rb.h
-  TxnNode *rbt_root;
-  TxnNode rbt_nil;
+  // the root page of the B+tree; this is a leaf as long as the index is
+  // small
+  TxnIndexPage *root;
+
+  // true if the keys are sorted with memcmp (UPS_TYPE_BINARY); then the
+  // inline key prefixes are sufficient for most comparisons
+  bool memcmp_order;
+
+  // linked list of released TxnNodes which can be reused
+  TxnNode *free_nodes;
+
+  // the memory of all TxnNodes; released when the index is destroyed
+  Arena node_arena;
 };
 
 
@@ -243,7 +288,7 @@ struct TxnIndex {
 //
 struct LocalTxn : Txn {
   // Constructor; "begins" the Txn
-  // supported flags: UPS_TXN_READ_ONLY, UPS_TXN_TEMPORARY
+  // supported flags: UPS_TXN_READ_ONLY, UPS_TXN_TEMPORARY, UPS_TXN_SNAPSHOT
   LocalTxn(LocalEnv *env, const char *name, uint32_t flags);
 
   // Destructor; frees all TxnOperation structures associated
@@ -261,17 +306,39 @@ struct LocalTxn : Txn {
   // (before it's deleted by the Environment).
   void free_operations();
 
+  // Returns true if this Txn is a read-only snapshot (UPS_TXN_SNAPSHOT)
+  bool is_snapshot() const {
+    return ISSET(flags, UPS_TXN_SNAPSHOT);
+  }
+
+  // Returns true if the operations of |other| are visible to this
+  // snapshot, i.e. if |other| was committed before this Txn began
+  bool is_visible(const LocalTxn *other) const {
+    return other->is_committed() && other->commit_lsn < lsn;
+  }
+
   // index of the log file descriptor for this transaction [0..1]
   int log_descriptor;
 
   // the lsn of the "txn begin" operation
   uint64_t lsn;
 
+  // the lsn of the "txn commit" operation; 0 as long as the Txn is active
+  uint64_t commit_lsn;
+
+  // the journal's reservation for the commit record (if journalling is
+  // enabled)
+  LsnTicket commit_ticket;
+
   // the linked list of operations - head is oldest operation
   TxnOperation *oldest_op;
 
   // the linked list of operations - tail is newest operation
   TxnOperation *newest_op;
+
+  // the memory of all TxnOperations of this Txn; released in a single
+  // step when the Txn is flushed or aborted
+  Arena arena;
 };
 
 
@@ -279,11 +346,21 @@ struct LocalTxn : Txn {
 // A TxnManager for local Txns
 //
 struct LocalTxnManager : TxnManager {
+  enum {
+    // If UPS_FLUSH_TRANSACTIONS_IN_BACKGROUND is set, and the number of
+    // committed Txns exceeds this multiple of the flush threshold, then
+    // the committing thread flushes them itself (backpressure)
+    kMaxBacklogFactor = 4
+  };
+
   // Constructor
   LocalTxnManager(Env *env)
-    : TxnManager(env), _txn_id(0) {
+    : TxnManager(env), _txn_id(0), merge_pending(false), closing(false) {
   }
 
+  // Destructor; joins the background thread
+  virtual ~LocalTxnManager();
+
   // Begins a new Txn
   virtual void begin(Txn *txn);
 
@@ -298,6 +375,23 @@ struct LocalTxnManager : TxnManager {
   // Flushes committed (queued) transactions
   virtual void flush_committed_txns(Context *context = 0);
 
+  // Starts the background thread which merges committed transactions
+  // into the btree. Called after the Environment was opened (and
+  // recovered).
+  void start_background_merge();
+
+  // Stops merging in the background; called when the Environment is
+  // closed, while the Environment's mutex is held
+  void stop_background_merge() {
+    closing = true;
+  }
+
+  // Adds a message to the queue of the background thread
+  template<typename WorkerMessage>
+  void run_async(WorkerMessage message) {
+    merger->enqueue(message);
+  }
+
   // Increments the global transaction ID and returns the new value. 
   uint64_t incremented_txn_id() {
     return ++_txn_id;
@@ -319,6 +413,16 @@ struct LocalTxnManager : TxnManager {
 
   // The current transaction ID
   uint64_t _txn_id;
+
+  // The background thread for merging committed Txns; only created if
+  // UPS_FLUSH_TRANSACTIONS_IN_BACKGROUND is set
+  ScopedPtr<WorkerPool> merger;
+
+  // true if a merge was scheduled, but did not yet start
+  bool merge_pending;
+
+  // true if the Environment is closed; scheduled merges are skipped
+  bool closing;
 };
 
 } // namespace upscaledb
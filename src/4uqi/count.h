@@ -54,6 +54,13 @@ struct CountScanVisitor : public ScanVisitor
     count += length;
   }
 
+  // Operates on a compressed block; only requires the number of keys
+  virtual bool visit_block(const void *lowest_key, const void *highest_key,
+                  const void *record_array, size_t key_count) {
+    count += key_count;
+    return true;
+  }
+
   // Assigns the result to |result|
   virtual void assign_result(uqi_result_t *result) {
     uqi_result_initialize(result, UPS_TYPE_BINARY, UPS_TYPE_UINT64);
@@ -84,7 +91,7 @@ struct CountIfScanVisitor : public ScanVisitor
   };
 
   CountIfScanVisitor(const DbConfig *dbconf, SelectStatement *stmt)
-    : count(0), plugin(dbconf, stmt) {
+    : ScanVisitor(stmt), count(0), plugin(dbconf, stmt) {
     key_size = dbconf->key_size;
     record_size = dbconf->record_size;
   }
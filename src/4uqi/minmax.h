@@ -133,6 +133,35 @@ struct MinMaxScanVisitor : public MinMaxScanVisitorBase<Key, Record> {
       }
     }
   }
+
+  // Operates on a block of sorted keys; the minimum (or maximum) is either
+  // the lowest or the highest key of the block, therefore the block does
+  // not have to be decompressed
+  virtual bool visit_block(const void *lowest_key, const void *highest_key,
+                  const void *record_data, size_t length) {
+    if (NOTSET(P::statement->function.flags, UQI_STREAM_KEY))
+      return false;
+
+    Compare<typename Key::type> cmp;
+    typename Key::type lowest = *(const typename Key::type *)lowest_key;
+    typename Key::type highest = *(const typename Key::type *)highest_key;
+    Sequence<Record> records(record_data, length);
+
+    if (!cmp(highest, lowest)) {
+      if (cmp(lowest, P::key.value)) {
+        P::key = lowest;
+        P::copy_value(&records.begin()->value, records.begin()->size());
+      }
+    }
+    else {
+      typename Sequence<Record>::iterator last = records.end() - 1;
+      if (cmp(highest, P::key.value)) {
+        P::key = highest;
+        P::copy_value(&last->value, last->size());
+      }
+    }
+    return true;
+  }
 };
 
 template<typename Key, typename Record>
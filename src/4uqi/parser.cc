@@ -79,6 +79,23 @@ initialize_parsers()
       ;
 }
 
+// Splits the name of an aggregate function into function name and library
+// (delimiter is '@'), and imports the plugin if a library was specified
+static ups_status_t
+import_function(FunctionDesc &desc)
+{
+  size_t delim = desc.name.find('@');
+  if (delim != std::string::npos) {
+    desc.library = desc.name.data() + delim + 1;
+    desc.name = desc.name.substr(0, delim);
+    boost::algorithm::to_lower(desc.name);
+    return PluginManager::import(desc.library.c_str(), desc.name.c_str());
+  }
+
+  boost::algorithm::to_lower(desc.name);
+  return 0;
+}
+
 ups_status_t
 Parser::parse_select(const char *query, SelectStatement &stmt)
 {
@@ -93,6 +110,7 @@ Parser::parse_select(const char *query, SelectStatement &stmt)
   using boost::spirit::ascii::space;
   using boost::spirit::ascii::string;
   using boost::phoenix::ref;
+  using boost::phoenix::push_back;
 
   if (!initialized) {
     initialized = true;
@@ -106,11 +124,18 @@ Parser::parse_select(const char *query, SelectStatement &stmt)
 
   stmt.function.flags = 0;
   stmt.predicate.flags = 0;
+  stmt.additional_functions.clear();
+
+  // additional aggregate functions, separated by comma
+  std::vector<std::string> names;
+  std::vector<int> flags;
 
   parser %=
       -no_case[lit("distinct")] [ref(stmt.distinct) = true]
       >> plugin_name[boost::phoenix::ref(stmt.function.name) = _1]
         >> '(' >> input_clause [ref(stmt.function.flags) = _1] >> ')'
+      >> *(',' >> plugin_name[push_back(boost::phoenix::ref(names), _1)]
+        >> '(' >> input_clause [push_back(boost::phoenix::ref(flags), _1)] >> ')')
       >> from_clause [ref(stmt.dbid) = _1]
       >> -(where_clause[boost::phoenix::ref(stmt.predicate.name) = _1]
         >> '(' >> input_clause [ref(stmt.predicate.flags) = _1] >> ')')
@@ -142,6 +167,16 @@ Parser::parse_select(const char *query, SelectStatement &stmt)
     stmt.function_plg = PluginManager::get(stmt.function.name.c_str());
   }
 
+  // the additional functions are formatted in the same way
+  for (size_t i = 0; i < names.size(); i++) {
+    FunctionDesc desc;
+    desc.name = names[i];
+    desc.flags = flags[i];
+    if ((st = import_function(desc)))
+      return st;
+    stmt.additional_functions.push_back(desc);
+  }
+
   // the predicate is formatted in the same way, but is completeley optional
   if (!stmt.predicate.name.empty()) {
     delim = stmt.predicate.name.find('@');
@@ -165,6 +200,13 @@ Parser::parse_select(const char *query, SelectStatement &stmt)
       ups_trace(("'limit' restriction only allowed for TOP and BOTTOM"));
       return UPS_PARSER_ERROR;
     }
+    for (size_t i = 0; i < stmt.additional_functions.size(); i++) {
+      const std::string &name = stmt.additional_functions[i].name;
+      if (name != "top" && name != "bottom") {
+        ups_trace(("'limit' restriction only allowed for TOP and BOTTOM"));
+        return UPS_PARSER_ERROR;
+      }
+    }
   }
 
   return 0;
@@ -46,6 +46,12 @@ struct Result
       next_key_offset(0), next_record_offset(0) {
   }
 
+  ~Result() {
+    for (std::vector<Result *>::iterator it = columns.begin();
+            it != columns.end(); it++)
+      delete *it;
+  }
+
   void initialize(uint32_t key_type_, uint32_t record_type_) {
     key_type = key_type_;
     record_type = record_type_;
@@ -68,6 +74,17 @@ struct Result
     std::swap(record_offsets, other.record_offsets);
     std::swap(key_data, other.key_data);
     std::swap(record_data, other.record_data);
+    std::swap(columns, other.columns);
+  }
+
+  // Returns the result of the |index|th aggregate function; the result of
+  // the first function is stored in this object
+  Result *column(uint32_t index) {
+    if (index == 0)
+      return this;
+    if (index - 1 < columns.size())
+      return columns[index - 1];
+    return 0;
   }
 
   uint32_t row_count;
@@ -84,6 +101,10 @@ struct Result
   std::vector<uint8_t> key_data;
   std::vector<uint8_t> record_data;
 
+  // The results of additional aggregate functions (if the query specified
+  // more than one function), i.e. "COUNT($key), SUM($key) FROM ..."
+  std::vector<Result *> columns;
+
   void add_key(const char *str) {
     add_key(str, (uint32_t)::strlen(str) + 1);
   }
@@ -53,6 +53,10 @@ struct ScanVisitor
     : statement(stmt) {
   }
 
+  // Destructor
+  virtual ~ScanVisitor() {
+  }
+
   // Operates on a single key/value pair
   virtual void operator()(const void *key_data, uint16_t key_size, 
                   const void *record_data, uint32_t record_size) = 0;
@@ -61,6 +65,18 @@ struct ScanVisitor
   virtual void operator()(const void *key_array, const void *record_array,
                   size_t key_count) = 0;
 
+  // Operates on a block of sorted keys which is only described by its
+  // metadata: the lowest and the highest key, and the number of keys.
+  // |record_array| points to the records of this block, or is null if
+  // the records are not required. Used by KeyLists with compressed blocks.
+  //
+  // Returns false if the visitor requires the actual keys; then the block
+  // is decompressed and passed to operator()(key_array, record_array, ...)
+  virtual bool visit_block(const void *lowest_key, const void *highest_key,
+                  const void *record_array, size_t key_count) {
+    return false;
+  }
+
   // Assigns the internal result to |result|
   virtual void assign_result(uqi_result_t *result) = 0;
 
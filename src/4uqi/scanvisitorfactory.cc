@@ -18,9 +18,12 @@
 
 #include "0root/root.h"
 
+#include <algorithm>
+
 #include "1base/error.h"
 #include "4db/db_local.h"
 #include "4uqi/plugins.h"
+#include "4uqi/result.h"
 #include "4uqi/statements.h"
 #include "4uqi/scanvisitor.h"
 #include "4uqi/scanvisitorfactory.h"
@@ -137,11 +140,128 @@ struct PluginProxyIfScanVisitor : public ScanVisitor {
   PredicatePluginWrapper pred_plugin;
 };
 
+//
+// Evaluates several aggregate functions in a single pass. Each function
+// is implemented by its own ScanVisitor; every batch of keys/records is
+// forwarded to all of them while the data is still hot in the cache.
+// The results are returned as separate columns.
+//
+struct MultiScanVisitor : public ScanVisitor {
+  MultiScanVisitor(SelectStatement *stmt)
+    : ScanVisitor(stmt), statements(stmt->additional_functions.size() + 1) {
+  }
+
+  ~MultiScanVisitor() {
+    for (std::vector<ScanVisitor *>::iterator it = visitors.begin();
+            it != visitors.end(); it++)
+      delete *it;
+  }
+
+  // Creates the ScanVisitor instances, one per aggregate function. Returns
+  // false if one of them could not be created
+  bool initialize(LocalDb *db) {
+    bool requires_keys = false;
+    bool requires_records = false;
+
+    for (size_t i = 0; i < statements.size(); i++) {
+      SelectStatement *child = &statements[i];
+      *child = *statement;
+      child->additional_functions.clear();
+      if (i > 0) {
+        child->function = statement->additional_functions[i - 1];
+        child->function_plg = PluginManager::get(child->function.name.c_str());
+      }
+
+      ScanVisitor *visitor = ScanVisitorFactory::from_select(child, db);
+      if (!visitor)
+        return false;
+      visitors.push_back(visitor);
+      consumed_block.push_back(false);
+
+      requires_keys |= child->requires_keys;
+      requires_records |= child->requires_records;
+    }
+
+    // the Btree scan has to serve the streams of all functions
+    statement->requires_keys = requires_keys;
+    statement->requires_records = requires_records;
+    return true;
+  }
+
+  // Operates on a single key
+  virtual void operator()(const void *key_data, uint16_t key_size, 
+                  const void *record_data, uint32_t record_size) {
+    for (std::vector<ScanVisitor *>::iterator it = visitors.begin();
+            it != visitors.end(); it++)
+      (**it)(key_data, key_size, record_data, record_size);
+  }
+
+  // Operates on an array of keys; skips the visitors which already
+  // consumed this block in visit_block()
+  virtual void operator()(const void *key_data, const void *record_data,
+                  size_t length) {
+    for (size_t i = 0; i < visitors.size(); i++) {
+      if (!consumed_block[i])
+        (*visitors[i])(key_data, record_data, length);
+      consumed_block[i] = false;
+    }
+  }
+
+  // Operates on a compressed block; returns true only if every visitor
+  // accepts the block. Otherwise the block is decompressed and passed to
+  // operator()(key_array, ...), which then skips those visitors which
+  // accepted it
+  virtual bool visit_block(const void *lowest_key, const void *highest_key,
+                  const void *record_data, size_t key_count) {
+    bool all = true;
+    for (size_t i = 0; i < visitors.size(); i++) {
+      consumed_block[i] = visitors[i]->visit_block(lowest_key, highest_key,
+                              record_data, key_count);
+      all &= consumed_block[i];
+    }
+    if (all)
+      std::fill(consumed_block.begin(), consumed_block.end(), false);
+    return all;
+  }
+
+  // Assigns the result to |result|; the first function writes to |result|,
+  // all others to additional columns
+  virtual void assign_result(uqi_result_t *result) {
+    Result *r = (Result *)result;
+    visitors[0]->assign_result(result);
+    for (size_t i = 1; i < visitors.size(); i++) {
+      Result *column = new Result;
+      r->columns.push_back(column);
+      visitors[i]->assign_result((uqi_result_t *)column);
+    }
+  }
+
+  // One statement per function; its size is fixed after construction
+  // because the visitors store pointers to the elements
+  std::vector<SelectStatement> statements;
+
+  // One visitor per function
+  std::vector<ScanVisitor *> visitors;
+
+  // Set if the visitor consumed the current block in visit_block()
+  std::vector<bool> consumed_block;
+};
+
 ScanVisitor *
 ScanVisitorFactory::from_select(SelectStatement *stmt, LocalDb *db)
 {
   const DbConfig *cfg = &db->config;
 
+  // multiple aggregate functions (i.e. "COUNT($key), SUM($key)")?
+  if (!stmt->additional_functions.empty()) {
+    MultiScanVisitor *visitor = new MultiScanVisitor(stmt);
+    if (!visitor->initialize(db)) {
+      delete visitor;
+      return 0;
+    }
+    return visitor;
+  }
+
   // Predicate plugin required?
   if (!stmt->predicate.name.empty() && stmt->predicate_plg == 0) {
     ups_trace(("Invalid or unknown predicate function '%s'",
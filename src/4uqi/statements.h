@@ -26,6 +26,7 @@
 #include "0root/root.h"
 
 #include <string>
+#include <vector>
 
 #include "ups/upscaledb_uqi.h"
 
@@ -75,6 +76,11 @@ struct SelectStatement {
   // the resolved function plugin
   uqi_plugin_t *function_plg;
 
+  // additional aggregate functions which are evaluated in the same pass,
+  // i.e. "COUNT($key), SUM($key) FROM DATABASE 1"; |function| is the first
+  // function of this list
+  std::vector<FunctionDesc> additional_functions;
+
   // an optional predicate function (for the WHERE clause)
   FunctionDesc predicate;
 
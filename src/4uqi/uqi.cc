@@ -97,6 +97,18 @@ uqi_result_get_record_data(uqi_result_t *result, uint32_t *psize)
   return r->record_data.data();
 }
 
+UPS_EXPORT uint32_t UPS_CALLCONV
+uqi_result_get_column_count(uqi_result_t *result)
+{
+  return (uint32_t)((Result *)result)->columns.size() + 1;
+}
+
+UPS_EXPORT uqi_result_t *UPS_CALLCONV
+uqi_result_get_column(uqi_result_t *result, uint32_t column)
+{
+  return (uqi_result_t *)((Result *)result)->column(column);
+}
+
 UPS_EXPORT void UPS_CALLCONV
 uqi_result_close(uqi_result_t *result)
 {
@@ -89,6 +89,13 @@ prepare_record(ups_record_t *record)
   return true;
 }
 
+// Returns true if |txn| is a read-only snapshot (UPS_TXN_SNAPSHOT)
+static inline bool
+is_snapshot(Txn *txn)
+{
+  return txn != 0 && ISSET(txn->flags, UPS_TXN_SNAPSHOT);
+}
+
 static inline ups_status_t
 check_recno_key(ups_key_t *key, uint32_t flags)
 {
@@ -143,6 +150,10 @@ ups_txn_begin(ups_txn_t **htxn, ups_env_t *henv, const char *name,
       return UPS_INV_PARAMETER;
     }
 
+    // snapshots are always read-only
+    if (ISSET(flags, UPS_TXN_SNAPSHOT))
+      flags |= UPS_TXN_READ_ONLY;
+
     *ptxn = env->txn_begin(name, flags);
     return 0;
   }
@@ -319,6 +330,14 @@ ups_env_create(ups_env_t **henv, const char *filename,
     return UPS_INV_PARAMETER;
   }
 
+  /* in-memory? deduplication is not possible */
+  if (unlikely(ISSET(flags, UPS_IN_MEMORY)
+              && ISSET(flags, UPS_ENABLE_DEDUPLICATION))) {
+    ups_trace(("combination of UPS_IN_MEMORY and UPS_ENABLE_DEDUPLICATION "
+            "not allowed"));
+    return UPS_INV_PARAMETER;
+  }
+
   /* flag UPS_AUTO_RECOVERY implies UPS_ENABLE_TRANSACTIONS */
   if (ISSET(flags, UPS_AUTO_RECOVERY))
     flags |= UPS_ENABLE_TRANSACTIONS;
@@ -363,6 +382,70 @@ ups_env_create(ups_env_t **henv, const char *filename,
       case UPS_PARAM_JOURNAL_SWITCH_THRESHOLD:
         config.journal_switch_threshold = (uint32_t)param->value;
         break;
+      case UPS_PARAM_JOURNAL_CHECKPOINT_BYTES:
+        config.journal_checkpoint_bytes = param->value;
+        break;
+      case UPS_PARAM_JOURNAL_CHECKPOINT_SECONDS:
+        config.journal_checkpoint_seconds = (uint32_t)param->value;
+        break;
+      case UPS_PARAM_HOLE_PUNCH_SECONDS:
+        config.hole_punch_seconds = (uint32_t)param->value;
+        break;
+      case UPS_PARAM_MMAP_RESERVE_SIZE:
+        config.mmap_reserve_size = param->value;
+        break;
+      case UPS_PARAM_COLD_TIER_FILENAME:
+        if (ISSET(flags, UPS_IN_MEMORY)) {
+          ups_trace(("combination of UPS_IN_MEMORY and a capacity tier "
+                "not allowed"));
+          return UPS_INV_PARAMETER;
+        }
+        if (param->value)
+          config.cold_tier_filename = (const char *)param->value;
+        flags |= UPS_DISABLE_MMAP;
+        break;
+      case UPS_PARAM_FLASH_CACHE_FILENAME:
+        if (ISSET(flags, UPS_IN_MEMORY)) {
+          ups_trace(("combination of UPS_IN_MEMORY and a flash cache "
+                "not allowed"));
+          return UPS_INV_PARAMETER;
+        }
+        if (param->value)
+          config.flash_cache_filename = (const char *)param->value;
+        flags |= UPS_DISABLE_MMAP;
+        break;
+      case UPS_PARAM_FLASH_CACHE_SIZE:
+        if (param->value > 0)
+          config.flash_cache_size = param->value;
+        break;
+      case UPS_PARAM_VALUE_LOG_THRESHOLD:
+        if (ISSET(flags, UPS_IN_MEMORY) && param->value != 0) {
+          ups_trace(("combination of UPS_IN_MEMORY and a value log "
+                "not allowed"));
+          return UPS_INV_PARAMETER;
+        }
+        if (param->value > 0x80000000u) {
+          ups_trace(("value log threshold is too large"));
+          return UPS_INV_PARAMETER;
+        }
+        if (param->value == 1 || (param->value & (param->value - 1)) != 0) {
+          ups_trace(("value log threshold must be a power of two >= 2"));
+          return UPS_INV_PARAMETER;
+        }
+        config.value_log_threshold = (uint32_t)param->value;
+        break;
+      case UPS_PARAM_VALUE_LOG_SEGMENT_SIZE:
+        if (param->value > 0)
+          config.value_log_segment_size = param->value;
+        break;
+      case UPS_PARAM_CHECKSUM_ALGORITHM:
+        if (param->value != UPS_CHECKSUM_MURMURHASH3
+              && param->value != UPS_CHECKSUM_CRC32C) {
+          ups_trace(("unknown checksum algorithm"));
+          return UPS_INV_PARAMETER;
+        }
+        config.checksum_algorithm = (int)param->value;
+        break;
       case UPS_PARAM_LOG_DIRECTORY:
         config.log_filename = (const char *)param->value;
         break;
@@ -515,6 +598,44 @@ ups_env_open(ups_env_t **henv, const char *filename, uint32_t flags,
       case UPS_PARAM_JOURNAL_SWITCH_THRESHOLD:
         config.journal_switch_threshold = (uint32_t)param->value;
         break;
+      case UPS_PARAM_JOURNAL_CHECKPOINT_BYTES:
+        config.journal_checkpoint_bytes = param->value;
+        break;
+      case UPS_PARAM_JOURNAL_CHECKPOINT_SECONDS:
+        config.journal_checkpoint_seconds = (uint32_t)param->value;
+        break;
+      case UPS_PARAM_HOLE_PUNCH_SECONDS:
+        config.hole_punch_seconds = (uint32_t)param->value;
+        break;
+      case UPS_PARAM_MMAP_RESERVE_SIZE:
+        config.mmap_reserve_size = param->value;
+        break;
+      case UPS_PARAM_COLD_TIER_FILENAME:
+        if (param->value)
+          config.cold_tier_filename = (const char *)param->value;
+        flags |= UPS_DISABLE_MMAP;
+        break;
+      case UPS_PARAM_FLASH_CACHE_FILENAME:
+        if (param->value)
+          config.flash_cache_filename = (const char *)param->value;
+        flags |= UPS_DISABLE_MMAP;
+        break;
+      case UPS_PARAM_FLASH_CACHE_SIZE:
+        if (param->value > 0)
+          config.flash_cache_size = param->value;
+        break;
+      case UPS_PARAM_VALUE_LOG_THRESHOLD:
+        ups_trace(("The value log threshold is only allowed in "
+                    "ups_env_create"));
+        return UPS_INV_PARAMETER;
+      case UPS_PARAM_CHECKSUM_ALGORITHM:
+        ups_trace(("The checksum algorithm is only allowed in "
+                    "ups_env_create"));
+        return UPS_INV_PARAMETER;
+      case UPS_PARAM_VALUE_LOG_SEGMENT_SIZE:
+        if (param->value > 0)
+          config.value_log_segment_size = param->value;
+        break;
       case UPS_PARAM_LOG_DIRECTORY:
         config.log_filename = (const char *)param->value;
         break;
@@ -809,6 +930,54 @@ ups_env_flush(ups_env_t *henv, uint32_t flags)
   }
 }
 
+ups_status_t UPS_CALLCONV
+ups_env_train_compression_dictionary(ups_env_t *henv,
+                const ups_record_t *samples, uint32_t num_samples)
+{
+  Env *env = (Env *)henv;
+  if (unlikely(!env)) {
+    ups_trace(("parameter 'env' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(!samples)) {
+    ups_trace(("parameter 'samples' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+
+  try {
+    ScopedLock lock(env->mutex);
+    env->train_compression_dictionary(samples, num_samples);
+    return 0;
+  }
+  catch (Exception &ex) {
+    return ex.code;
+  }
+}
+
+ups_status_t UPS_CALLCONV
+ups_env_compact(ups_env_t *henv, uint32_t max_pages, uint32_t *relocated)
+{
+  Env *env = (Env *)henv;
+  if (unlikely(!env)) {
+    ups_trace(("parameter 'env' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+
+  if (relocated)
+    *relocated = 0;
+
+  try {
+    ScopedLock lock(env->mutex);
+    uint32_t count = env->compact(max_pages);
+    if (relocated)
+      *relocated = count;
+    return 0;
+  }
+  catch (Exception &ex) {
+    return ex.code;
+  }
+}
+
 ups_status_t UPS_CALLCONV
 ups_env_close(ups_env_t *henv, uint32_t flags)
 {
@@ -991,6 +1160,10 @@ ups_db_insert(ups_db_t *hdb, ups_txn_t *htxn, ups_key_t *key,
       ups_trace(("cannot insert in a read-only database"));
       return UPS_WRITE_PROTECTED;
     }
+    if (unlikely(is_snapshot(txn))) {
+      ups_trace(("cannot insert in a snapshot transaction"));
+      return UPS_WRITE_PROTECTED;
+    }
     if (unlikely(ISSET(flags, UPS_DUPLICATE)
         && NOTSET(db->flags(), UPS_ENABLE_DUPLICATE_KEYS))) {
       ups_trace(("database does not support duplicate keys "
@@ -1040,6 +1213,10 @@ ups_db_erase(ups_db_t *hdb, ups_txn_t *htxn, ups_key_t *key, uint32_t flags)
       ups_trace(("cannot erase from a read-only database"));
       return UPS_WRITE_PROTECTED;
     }
+    if (unlikely(is_snapshot(txn))) {
+      ups_trace(("cannot erase in a snapshot transaction"));
+      return UPS_WRITE_PROTECTED;
+    }
 
     flags &= ~UPS_DONT_LOCK;
 
@@ -1223,6 +1400,10 @@ ups_cursor_overwrite(ups_cursor_t *hcursor, ups_record_t *record,
       ups_trace(("cannot overwrite in a read-only database"));
       return UPS_WRITE_PROTECTED;
     }
+    if (unlikely(is_snapshot(cursor->txn))) {
+      ups_trace(("cannot overwrite in a snapshot transaction"));
+      return UPS_WRITE_PROTECTED;
+    }
 
     return cursor->overwrite(record, flags);
   }
@@ -1264,6 +1445,55 @@ ups_cursor_move(ups_cursor_t *hcursor, ups_key_t *key,
   }
 }
 
+UPS_EXPORT ups_status_t UPS_CALLCONV
+ups_cursor_move_batch(ups_cursor_t *hcursor, ups_key_t *keys,
+                ups_record_t *records, uint32_t *count, uint32_t flags)
+{
+  Cursor *cursor = (Cursor *)hcursor;
+
+  if (unlikely(!cursor)) {
+    ups_trace(("parameter 'cursor' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(!keys)) {
+    ups_trace(("parameter 'keys' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(!count || *count == 0)) {
+    ups_trace(("parameter 'count' must not be NULL or 0"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(ISSET(flags, UPS_CURSOR_NEXT)
+      == ISSET(flags, UPS_CURSOR_PREVIOUS))) {
+    ups_trace(("flags must contain either UPS_CURSOR_NEXT or "
+          "UPS_CURSOR_PREVIOUS"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(ISSETANY(flags, ~(UPS_CURSOR_NEXT | UPS_CURSOR_PREVIOUS
+                            | UPS_SKIP_DUPLICATES)))) {
+    ups_trace(("unsupported flags; only UPS_CURSOR_NEXT, "
+          "UPS_CURSOR_PREVIOUS and UPS_SKIP_DUPLICATES are allowed"));
+    return UPS_INV_PARAMETER;
+  }
+  for (uint32_t i = 0; i < *count; i++) {
+    if (unlikely(!prepare_key(&keys[i])))
+      return UPS_INV_PARAMETER;
+    if (unlikely(records && !prepare_record(&records[i])))
+      return UPS_INV_PARAMETER;
+  }
+
+  Db *db = cursor->db;
+  Env *env = db->env;
+
+  try {
+    ScopedLock lock(env->mutex);
+    return db->cursor_move_batch(cursor, keys, records, count, flags);
+  }
+  catch (Exception &ex) {
+    return ex.code;
+  }
+}
+
 UPS_EXPORT ups_status_t UPS_CALLCONV
 ups_cursor_find(ups_cursor_t *hcursor, ups_key_t *key, ups_record_t *record,
                 uint32_t flags)
@@ -1334,6 +1564,10 @@ ups_cursor_insert(ups_cursor_t *hcursor, ups_key_t *key, ups_record_t *record,
       ups_trace(("cannot insert to a read-only database"));
       return UPS_WRITE_PROTECTED;
     }
+    if (unlikely(is_snapshot(cursor->txn))) {
+      ups_trace(("cannot insert in a snapshot transaction"));
+      return UPS_WRITE_PROTECTED;
+    }
     if (unlikely(ISSET(flags, UPS_DUPLICATE)
         && NOTSET(db->flags(), UPS_ENABLE_DUPLICATE_KEYS))) {
       ups_trace(("database does not support duplicate keys "
@@ -1382,6 +1616,10 @@ ups_cursor_erase(ups_cursor_t *hcursor, uint32_t flags)
       ups_trace(("cannot erase from a read-only database"));
       return UPS_WRITE_PROTECTED;
     }
+    if (unlikely(is_snapshot(cursor->txn))) {
+      ups_trace(("cannot erase in a snapshot transaction"));
+      return UPS_WRITE_PROTECTED;
+    }
 
     return db->erase(cursor, cursor->txn, 0, flags);
   }
@@ -1472,6 +1710,91 @@ ups_cursor_get_record_size(ups_cursor_t *hcursor, uint32_t *size)
   }
 }
 
+ups_status_t UPS_CALLCONV
+ups_cursor_read_record_range(ups_cursor_t *hcursor, uint32_t offset,
+                uint32_t size, ups_record_t *record, uint32_t flags)
+{
+  Cursor *cursor = (Cursor *)hcursor;
+
+  if (unlikely(!cursor)) {
+    ups_trace(("parameter 'cursor' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(!record)) {
+    ups_trace(("parameter 'record' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(flags)) {
+    ups_trace(("function does not support a non-zero flags value"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(ISSET(record->flags, UPS_RECORD_USER_ALLOC)
+                && size > 0 && !record->data)) {
+    ups_trace(("UPS_RECORD_USER_ALLOC is set, but record->data is NULL"));
+    return UPS_INV_PARAMETER;
+  }
+
+  Db *db = cursor->db;
+
+  try {
+    ScopedLock lock(db->env->mutex);
+    cursor->read_record_range(offset, size, record, flags);
+    return 0;
+  }
+  catch (Exception &ex) {
+    return ex.code;
+  }
+}
+
+ups_status_t UPS_CALLCONV
+ups_cursor_write_record_range(ups_cursor_t *hcursor, uint32_t offset,
+                ups_record_t *record, uint32_t flags)
+{
+  Cursor *cursor = (Cursor *)hcursor;
+
+  if (unlikely(!cursor)) {
+    ups_trace(("parameter 'cursor' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(!record)) {
+    ups_trace(("parameter 'record' must not be NULL"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(flags)) {
+    ups_trace(("function does not support a non-zero flags value"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(!prepare_record(record)))
+    return UPS_INV_PARAMETER;
+
+  Db *db = cursor->db;
+
+  if (unlikely(db->config.record_size != UPS_RECORD_SIZE_UNLIMITED
+          && (uint64_t)offset + record->size > db->config.record_size)) {
+    ups_trace(("range exceeds the record size (%u)",
+          db->config.record_size));
+    return UPS_INV_RECORD_SIZE;
+  }
+
+  try {
+    ScopedLock lock(db->env->mutex);
+
+    if (unlikely(ISSET(db->flags(), UPS_READ_ONLY))) {
+      ups_trace(("cannot write to a read-only database"));
+      return UPS_WRITE_PROTECTED;
+    }
+    if (unlikely(is_snapshot(cursor->txn))) {
+      ups_trace(("cannot write in a snapshot transaction"));
+      return UPS_WRITE_PROTECTED;
+    }
+
+    return cursor->write_record_range(offset, record, flags);
+  }
+  catch (Exception &ex) {
+    return ex.code;
+  }
+}
+
 ups_status_t UPS_CALLCONV
 ups_cursor_close(ups_cursor_t *hcursor)
 {
@@ -1694,8 +2017,12 @@ ups_db_bulk_operations(ups_db_t *hdb, ups_txn_t *txn,
     ups_trace(("parameter 'operations' must not be NULL"));
     return UPS_INV_PARAMETER;
   }
-  if (unlikely(flags != 0)) {
-    ups_trace(("parameter 'flags' must be 0"));
+  if (unlikely(flags != 0 && flags != UPS_WRITE_BATCH)) {
+    ups_trace(("parameter 'flags' must be 0 or UPS_WRITE_BATCH"));
+    return UPS_INV_PARAMETER;
+  }
+  if (unlikely(txn != 0 && flags == UPS_WRITE_BATCH)) {
+    ups_trace(("UPS_WRITE_BATCH does not support Transactions"));
     return UPS_INV_PARAMETER;
   }
 
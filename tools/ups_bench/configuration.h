@@ -91,9 +91,11 @@ struct Configuration
       extkey_threshold(0), duptable_threshold(0), bulk_erase(false),
       disable_recovery(false),
       journal_compression(0), record_compression(0), key_compression(0),
-      read_only(false), enable_crc32(false), record_number32(false),
+      read_only(false), enable_crc32(false),
+      checksum_algorithm(UPS_CHECKSUM_MURMURHASH3), record_number32(false),
       record_number64(false), posix_fadvice(UPS_POSIX_FADVICE_NORMAL),
-      simulate_crashes(false), flush_txn_immediately(false) {
+      simulate_crashes(false), flush_txn_immediately(false),
+      flush_txn_in_background(false), train_dictionary(false) {
   }
 
   const char *
@@ -134,6 +136,8 @@ struct Configuration
       "zint32_maskedvbyte",
       "zint32_for",
       "zint32_simdfor",
+      "lz4",
+      "zstd",
     };
     std::cout << "Configuration: --seed=" << seed << " ";
     if (journal_compression)
@@ -199,6 +203,8 @@ struct Configuration
       std::cout << "--duptable-threshold=" << duptable_threshold << " ";
     if (enable_crc32)
       std::cout << "--enable-crc32 ";
+    if (checksum_algorithm == UPS_CHECKSUM_CRC32C)
+      std::cout << "--checksum=crc32c ";
     if (record_number32)
       std::cout << "--record-number32 ";
     if (record_number64)
@@ -212,7 +218,11 @@ struct Configuration
     if (simulate_crashes)
       std::cout << "--simulate-crashes ";
     if (flush_txn_immediately)
-      std::cout << "--flush-txn-immediately";
+      std::cout << "--flush-txn-immediately ";
+    if (flush_txn_in_background)
+      std::cout << "--flush-txn-in-background ";
+    if (train_dictionary)
+      std::cout << "--train-dictionary ";
     if (!filename.empty())
       std::cout << filename;
     else {
@@ -307,11 +317,14 @@ struct Configuration
   int key_compression;
   bool read_only;
   bool enable_crc32;
+  int checksum_algorithm;
   bool record_number32;
   bool record_number64;
   int posix_fadvice;
   bool simulate_crashes;
   bool flush_txn_immediately;
+  bool flush_txn_in_background;
+  bool train_dictionary;
 };
 
 #endif /* UPS_BENCH_CONFIGURATION_H */
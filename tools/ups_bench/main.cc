@@ -86,11 +86,14 @@
 #define ARG_KEY_COMPRESSION                     64
 #define ARG_READ_ONLY                           67
 #define ARG_ENABLE_CRC32                        68
+#define ARG_CHECKSUM                            76
 #define ARG_RECORD_NUMBER32                     69
 #define ARG_RECORD_NUMBER64                     70
 #define ARG_POSIX_FADVICE                       71
 #define ARG_SIMULATE_CRASHES                    72
 #define ARG_FLUSH_TXN_IMMEDIATELY               73
+#define ARG_FLUSH_TXN_IN_BACKGROUND             74
+#define ARG_TRAIN_DICTIONARY                    75
 
 /*
  * command line parameters
@@ -371,19 +374,22 @@ static option_t opts[] = {
     ARG_JOURNAL_COMPRESSION,
     0,
     "journal-compression",
-    "Pro: Enables journal compression ('none', 'zlib', 'snappy', 'lzf')",
+    "Pro: Enables journal compression ('none', 'zlib', 'snappy', 'lzf', "
+            "'lz4', 'zstd')",
     GETOPTS_NEED_ARGUMENT },
   {
     ARG_RECORD_COMPRESSION,
     0,
     "record-compression",
-    "Pro: Enables record compression ('none', 'zlib', 'snappy', 'lzf')",
+    "Pro: Enables record compression ('none', 'zlib', 'snappy', 'lzf', "
+            "'lz4', 'zstd')",
     GETOPTS_NEED_ARGUMENT },
   {
     ARG_KEY_COMPRESSION,
     0,
     "key-compression",
-    "Pro: Enables key compression ('none', 'zlib', 'snappy', 'lzf')",
+    "Pro: Enables key compression ('none', 'zlib', 'snappy', 'lzf', "
+            "'lz4', 'zstd')",
     GETOPTS_NEED_ARGUMENT },
   {
     ARG_READ_ONLY,
@@ -397,6 +403,13 @@ static option_t opts[] = {
     "enable-crc32",
     "Pro: Enables use of CRC32 verification",
     0 },
+  {
+    ARG_CHECKSUM,
+    0,
+    "checksum",
+    "Sets the checksum algorithm for --enable-crc32: 'murmurhash3' (default), "
+            "'crc32c'",
+    GETOPTS_NEED_ARGUMENT },
   {
     ARG_RECORD_NUMBER32,
     0,
@@ -427,6 +440,18 @@ static option_t opts[] = {
     "flush-txn-immediately",
     "Immediately flushes transactions after they are committed",
     0 },
+  {
+    ARG_FLUSH_TXN_IN_BACKGROUND,
+    0,
+    "flush-txn-in-background",
+    "Flushes committed transactions in a background thread",
+    0 },
+  {
+    ARG_TRAIN_DICTIONARY,
+    0,
+    "train-dictionary",
+    "Trains a compression dictionary for 'zstd' compression",
+    0 },
   {0, 0}
 };
 
@@ -441,6 +466,10 @@ parse_compression_type(std::string param)
     return (UPS_COMPRESSOR_SNAPPY);
   if (param == "lzf")
     return (UPS_COMPRESSOR_LZF);
+  if (param == "lz4")
+    return (UPS_COMPRESSOR_LZ4);
+  if (param == "zstd")
+    return (UPS_COMPRESSOR_ZSTD);
   if (param == "zint32_varbyte")
     return (UPS_COMPRESSOR_UINT32_VARBYTE);
   if (param == "zint32_simdcomp")
@@ -454,7 +483,8 @@ parse_compression_type(std::string param)
   if (param == "zint32_streamvbyte")
     return (UPS_COMPRESSOR_UINT32_STREAMVBYTE);
   ::printf("invalid compression specifier '%s': expecting 'none', 'zlib', "
-              "'snappy', 'lzf', 'zint32_varbyte', 'zint32_simdcomp', "
+              "'snappy', 'lzf', 'lz4', 'zstd', 'zint32_varbyte', "
+              "'zint32_simdcomp', "
               "'zint32_groupvarint', 'zint32_streamvbyte', "
               "'zint32_for', 'zint32_simdfor'\n",
               param.c_str());
@@ -799,6 +829,16 @@ parse_config(int argc, char **argv, Configuration *c)
     else if (opt == ARG_ENABLE_CRC32) {
       c->enable_crc32 = true;
     }
+    else if (opt == ARG_CHECKSUM) {
+      if (!strcmp(param, "murmurhash3"))
+        c->checksum_algorithm = UPS_CHECKSUM_MURMURHASH3;
+      else if (!strcmp(param, "crc32c"))
+        c->checksum_algorithm = UPS_CHECKSUM_CRC32C;
+      else {
+        printf("[FAIL] invalid parameter for 'checksum'\n");
+        exit(-1);
+      }
+    }
     else if (opt == ARG_RECORD_NUMBER32) {
       c->record_number32 = true;
       c->key_is_fixed_size = true;
@@ -821,6 +861,12 @@ parse_config(int argc, char **argv, Configuration *c)
     else if (opt == ARG_FLUSH_TXN_IMMEDIATELY) {
       c->flush_txn_immediately = true;
     }
+    else if (opt == ARG_FLUSH_TXN_IN_BACKGROUND) {
+      c->flush_txn_in_background = true;
+    }
+    else if (opt == ARG_TRAIN_DICTIONARY) {
+      c->train_dictionary = true;
+    }
     else if (opt == ARG_READ_ONLY) {
       c->read_only = true;
     }
@@ -915,6 +961,11 @@ print_metrics(Metrics *metrics, Configuration *conf)
       ratio = (float)metrics->upscaledb_metrics.journal_bytes_after_compression
                   / metrics->upscaledb_metrics.journal_bytes_before_compression;
     printf("\t%s journal_compression            %.3f\n", name, ratio);
+    printf("\t%s journal_compression_mbps       %.3f\n", name,
+                  total > 0
+                    ? metrics->upscaledb_metrics.journal_bytes_before_compression
+                          / total / (1024 * 1024)
+                    : 0.);
   }
 
   // print record compression ratio
@@ -926,6 +977,11 @@ print_metrics(Metrics *metrics, Configuration *conf)
       ratio = (float)metrics->upscaledb_metrics.record_bytes_after_compression
                   / metrics->upscaledb_metrics.record_bytes_before_compression;
     printf("\t%s record_compression             %.3f\n", name, ratio);
+    printf("\t%s record_compression_mbps        %.3f\n", name,
+                  total > 0
+                    ? metrics->upscaledb_metrics.record_bytes_before_compression
+                          / total / (1024 * 1024)
+                    : 0.);
   }
 
   // print key compression ratio
@@ -937,6 +993,11 @@ print_metrics(Metrics *metrics, Configuration *conf)
       ratio = (float)metrics->upscaledb_metrics.key_bytes_after_compression
                   / metrics->upscaledb_metrics.key_bytes_before_compression;
     printf("\t%s key_compression                %.3f\n", name, ratio);
+    printf("\t%s key_compression_mbps           %.3f\n", name,
+                  total > 0
+                    ? metrics->upscaledb_metrics.key_bytes_before_compression
+                          / total / (1024 * 1024)
+                    : 0.);
   }
 
   if (conf->metrics != Configuration::kMetricsAll || strcmp(name, "upscaledb"))
@@ -958,18 +1019,54 @@ print_metrics(Metrics *metrics, Configuration *conf)
           (long unsigned int)metrics->upscaledb_metrics.page_count_type_blob);
   printf("\tupscaledb page_count_type_page_manager %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.page_count_type_page_manager);
+  printf("\tupscaledb page_count_relocated        %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.page_count_relocated);
+  printf("\tupscaledb page_count_truncated        %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.page_count_truncated);
+  printf("\tupscaledb page_count_punched          %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.page_count_punched);
+  printf("\tupscaledb page_count_demoted          %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.page_count_demoted);
+  printf("\tupscaledb page_count_promoted         %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.page_count_promoted);
+  printf("\tupscaledb page_count_cold             %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.page_count_cold);
   printf("\tupscaledb freelist_hits               %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.freelist_hits);
   printf("\tupscaledb freelist_misses             %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.freelist_misses);
+  printf("\tupscaledb freelist_extents            %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.freelist_extents);
+  printf("\tupscaledb freelist_pages              %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.freelist_pages);
+  printf("\tupscaledb freelist_largest_extent     %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.freelist_largest_extent);
   printf("\tupscaledb cache_hits                  %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.cache_hits);
   printf("\tupscaledb cache_misses                %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.cache_misses);
+  printf("\tupscaledb flash_cache_hits            %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.flash_cache_hits);
+  printf("\tupscaledb flash_cache_misses          %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.flash_cache_misses);
+  printf("\tupscaledb readahead_pages             %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.readahead_pages);
+  printf("\tupscaledb readahead_hits              %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.readahead_hits);
+  printf("\tupscaledb readahead_wasted            %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.readahead_wasted);
   printf("\tupscaledb blob_total_allocated        %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.blob_total_allocated);
   printf("\tupscaledb blob_total_read             %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.blob_total_read);
+  printf("\tupscaledb blob_total_deduplicated     %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.blob_total_deduplicated);
+  printf("\tupscaledb value_log_bytes_written     %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.value_log_bytes_written);
+  printf("\tupscaledb value_log_bytes_relocated   %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.value_log_bytes_relocated);
+  printf("\tupscaledb value_log_segments_collected %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.value_log_segments_collected);
   printf("\tupscaledb btree_smo_split             %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.btree_smo_split);
   printf("\tupscaledb btree_smo_merge             %lu\n",
@@ -980,6 +1077,8 @@ print_metrics(Metrics *metrics, Configuration *conf)
           (long unsigned int)metrics->upscaledb_metrics.extended_duptables);
   printf("\tupscaledb journal_bytes_flushed       %lu\n",
           (long unsigned int)metrics->upscaledb_metrics.journal_bytes_flushed);
+  printf("\tupscaledb journal_page_base_reads     %lu\n",
+          (long unsigned int)metrics->upscaledb_metrics.journal_page_base_reads);
 }
 
 struct Callable {
@@ -16,6 +16,8 @@
  * See the file COPYING for License information.
  */
 
+#include <algorithm>
+#include <vector>
 #include <iostream>
 #include <boost/filesystem.hpp>
 
@@ -73,7 +75,7 @@ UpscaleDatabase::do_create_env()
 {
   ups_status_t st = 0;
   uint32_t flags = 0;
-  ups_parameter_t params[6] = {{0, 0}};
+  ups_parameter_t params[7] = {{0, 0}};
 
   ScopedLock lock(ms_mutex);
 
@@ -103,12 +105,18 @@ UpscaleDatabase::do_create_env()
       params[p].value = m_config->journal_compression;
       p++;
     }
+    if (m_config->checksum_algorithm != UPS_CHECKSUM_MURMURHASH3) {
+      params[p].name = UPS_PARAM_CHECKSUM_ALGORITHM;
+      params[p].value = m_config->checksum_algorithm;
+      p++;
+    }
 
     flags |= m_config->inmemory ? UPS_IN_MEMORY : 0; 
     flags |= m_config->no_mmap ? UPS_DISABLE_MMAP : 0; 
     flags |= m_config->cacheunlimited ? UPS_CACHE_UNLIMITED : 0;
     flags |= m_config->use_transactions ? UPS_ENABLE_TRANSACTIONS : 0;
     flags |= m_config->flush_txn_immediately ? UPS_FLUSH_TRANSACTIONS_IMMEDIATELY : 0;
+    flags |= m_config->flush_txn_in_background ? UPS_FLUSH_TRANSACTIONS_IN_BACKGROUND : 0;
     flags |= m_config->use_fsync ? UPS_ENABLE_FSYNC : 0;
     flags |= m_config->disable_recovery ? UPS_DISABLE_RECOVERY : 0;
     flags |= m_config->enable_crc32 ? UPS_ENABLE_CRC32 : 0;
@@ -122,6 +130,29 @@ UpscaleDatabase::do_create_env()
                               st, ups_strerror(st)));
       return (st);
     }
+
+    // train the dictionary with records which look like the generated ones
+    if (m_config->train_dictionary) {
+      const int kNumSamples = 1000;
+      std::vector<uint8_t> data(kNumSamples * m_config->rec_size);
+      std::vector<ups_record_t> samples(kNumSamples);
+      for (int i = 0; i < kNumSamples; i++) {
+        uint8_t *ptr = &data[i * m_config->rec_size];
+        for (int j = 0; j < m_config->rec_size; j++)
+          ptr[j] = (uint8_t)j;
+        ::memcpy(ptr, &i, std::min((int)sizeof(i), m_config->rec_size));
+        samples[i].data = ptr;
+        samples[i].size = (uint32_t)m_config->rec_size;
+      }
+
+      st = ups_env_train_compression_dictionary(ms_env, &samples[0],
+                      kNumSamples);
+      if (st) {
+        LOG_ERROR(("ups_env_train_compression_dictionary failed with "
+                        "error %d (%s)\n", st, ups_strerror(st)));
+        return (st);
+      }
+    }
   }
 
   // remote client/server? start the server, attach the environment and then
@@ -186,6 +217,7 @@ UpscaleDatabase::do_open_env()
                 ? (UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY)
                 : 0;
     flags |= m_config->flush_txn_immediately ? UPS_FLUSH_TRANSACTIONS_IMMEDIATELY : 0;
+    flags |= m_config->flush_txn_in_background ? UPS_FLUSH_TRANSACTIONS_IN_BACKGROUND : 0;
     flags |= m_config->use_fsync ? UPS_ENABLE_FSYNC : 0;
     flags |= m_config->disable_recovery ? UPS_DISABLE_RECOVERY : 0;
     flags |= m_config->read_only ? UPS_READ_ONLY : 0;
@@ -24,6 +24,7 @@
 #include "3page_manager/page_manager.h"
 #include "3btree/btree_flags.h"
 #include "3blob_manager/blob_manager_disk.h"
+#include "3blob_manager/blob_manager_vlog.h"
 #include "4db/db_local.h"
 #include "4context/context.h"
 
@@ -119,6 +120,303 @@ struct BlobManagerFixture : BaseFixture {
        .require_find(&key, buffer);
   }
 
+  void valueLogTest(uint32_t env_flags) {
+    const uint32_t count = 200;
+    ups_parameter_t params[] = {
+      { UPS_PARAM_PAGE_SIZE, 4096 },
+      { UPS_PARAM_VALUE_LOG_THRESHOLD, 1024 },
+      { UPS_PARAM_VALUE_LOG_SEGMENT_SIZE, 64 * 1024 },
+      { 0, 0 }
+    };
+
+    context->changeset.clear();
+    close();
+    require_create(env_flags, params);
+    require_parameter(UPS_PARAM_VALUE_LOG_THRESHOLD, 1024);
+    REQUIRE(os::file_exists("test.db.vlog"));
+    REQUIRE(os::file_exists("test.db.vlog.0"));
+
+    // large records are appended to the value log, small records are
+    // stored in the file
+    DbProxy dbp(db);
+    std::vector<uint8_t> small(100, 's');
+    std::vector<uint8_t> record(2000);
+    for (uint32_t i = 0; i < count; i++) {
+      std::fill(record.begin(), record.end(), (uint8_t)i);
+      dbp.require_insert(i, record);
+    }
+    dbp.require_insert(count, small);
+
+    ups_env_metrics_t metrics = {0};
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.value_log_bytes_written
+                == count * (record.size() + sizeof(PValueLogEntry)));
+
+    // overwrite all records, then erase every other key; the first
+    // segments no longer have live values
+    record.resize(3000);
+    for (uint32_t i = 0; i < count; i++) {
+      std::fill(record.begin(), record.end(), (uint8_t)(i + 1));
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      dbp.require_overwrite(&key, record);
+    }
+    for (uint32_t i = 0; i < count; i += 2)
+      dbp.require_erase(i);
+
+    uint32_t relocated = 0;
+    REQUIRE(0 == ups_env_compact(env, 0, &relocated));
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.value_log_segments_collected > 0);
+    REQUIRE(metrics.value_log_bytes_relocated > 0);
+    REQUIRE(!os::file_exists("test.db.vlog.0"));
+
+    // a second run has nothing to do
+    uint64_t collected = metrics.value_log_segments_collected;
+    REQUIRE(0 == ups_env_compact(env, 0, &relocated));
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.value_log_segments_collected == collected);
+
+    for (int pass = 0; pass < 2; pass++) {
+      dbp = DbProxy(db);
+      dbp.require_check_integrity();
+      for (uint32_t i = 0; i < count; i++) {
+        if (i % 2 == 0) {
+          ups_key_t key = ups_make_key(&i, sizeof(i));
+          ups_record_t rec = {0};
+          REQUIRE(UPS_KEY_NOT_FOUND == ups_db_find(db, 0, &key, &rec, 0));
+          continue;
+        }
+        std::fill(record.begin(), record.end(), (uint8_t)(i + 1));
+        dbp.require_find(i, record);
+      }
+      dbp.require_find(count, small);
+
+      // reopen the file; with Transactions, the journal is replayed
+      if (pass == 0) {
+        uint32_t close_flags = UPS_AUTO_CLEANUP;
+        uint32_t open_flags = env_flags;
+        if (env_flags & UPS_ENABLE_TRANSACTIONS) {
+          close_flags |= UPS_DONT_CLEAR_LOG;
+          open_flags |= UPS_AUTO_RECOVERY;
+        }
+        close(close_flags);
+        require_open(open_flags);
+      }
+    }
+
+    // the threshold can only be set when the Environment is created
+    close();
+    REQUIRE(UPS_INV_PARAMETER == ups_env_open(&env, "test.db", 0, &params[1]));
+    REQUIRE(UPS_INV_PARAMETER == ups_env_create(&env, "test.db",
+                            UPS_IN_MEMORY, 0644, &params[1]));
+
+    // the threshold must be a power of two
+    ups_parameter_t odd[] = {
+      { UPS_PARAM_VALUE_LOG_THRESHOLD, 1000 },
+      { 0, 0 }
+    };
+    REQUIRE(UPS_INV_PARAMETER == ups_env_create(&env, "test.db", 0, 0644,
+                            &odd[0]));
+
+    require_open();
+    context.reset(new Context(lenv(), 0, ldb()));
+  }
+
+  void require_cursor_record(ups_cursor_t *cursor,
+                  std::vector<uint8_t> &expected) {
+    ups_record_t rec = {0};
+    REQUIRE(0 == ups_cursor_move(cursor, 0, &rec, 0));
+    REQUIRE(rec.size == expected.size());
+    REQUIRE(0 == ::memcmp(rec.data, expected.data(), rec.size));
+  }
+
+  void recordRangeTest(uint32_t env_flags,
+                  uint32_t value_log_threshold = 0) {
+    ups_parameter_t params[] = {
+      { UPS_PARAM_PAGE_SIZE, 4096 },
+      { 0, 0 },
+      { 0, 0 }
+    };
+    if (value_log_threshold) {
+      params[1].name = UPS_PARAM_VALUE_LOG_THRESHOLD;
+      params[1].value = value_log_threshold;
+    }
+
+    context->changeset.clear();
+    close();
+    require_create(env_flags, params);
+
+    std::vector<uint8_t> expected(20000);
+    for (size_t i = 0; i < expected.size(); i++)
+      expected[i] = (uint8_t)(i % 251);
+
+    // small records are stored in the btree node
+    std::vector<uint8_t> tiny(4, 't');
+    DbProxy dbp(db);
+    dbp.require_insert(1, expected)
+       .require_insert(2, tiny);
+
+    // with Transactions, the cursor is bound to a Transaction which
+    // is committed at the end
+    ups_txn_t *txn = 0;
+    if (ISSET(env_flags, UPS_ENABLE_TRANSACTIONS))
+      REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+
+    uint32_t k = 1;
+    ups_key_t key = ups_make_key(&k, sizeof(k));
+    ups_cursor_t *cursor;
+    REQUIRE(0 == ups_cursor_create(&cursor, db, txn, 0));
+    REQUIRE(0 == ups_cursor_find(cursor, &key, 0, 0));
+
+    // read a range from the middle, then a range which is truncated
+    ups_record_t rec = {0};
+    REQUIRE(0 == ups_cursor_read_record_range(cursor, 5000, 3000, &rec, 0));
+    REQUIRE(rec.size == 3000u);
+    REQUIRE(0 == ::memcmp(rec.data, &expected[5000], rec.size));
+    REQUIRE(0 == ups_cursor_read_record_range(cursor, 19000, 5000, &rec, 0));
+    REQUIRE(rec.size == 1000u);
+    REQUIRE(0 == ::memcmp(rec.data, &expected[19000], rec.size));
+    REQUIRE(0 == ups_cursor_read_record_range(cursor, 20000, 10, &rec, 0));
+    REQUIRE(rec.size == 0u);
+    REQUIRE(UPS_INV_PARAMETER
+                == ups_cursor_read_record_range(cursor, 20001, 10, &rec, 0));
+
+    // read into user-allocated memory; the range crosses a page boundary
+    std::vector<uint8_t> user(5000);
+    rec.data = user.data();
+    rec.flags = UPS_RECORD_USER_ALLOC;
+    REQUIRE(0 == ups_cursor_read_record_range(cursor, 4000, 5000, &rec, 0));
+    REQUIRE(rec.size == 5000u);
+    REQUIRE(0 == ::memcmp(user.data(), &expected[4000], rec.size));
+
+    // overwrite a range in the middle
+    std::vector<uint8_t> patch(2500, 'x');
+    rec = ups_make_record(patch.data(), (uint32_t)patch.size());
+    REQUIRE(0 == ups_cursor_write_record_range(cursor, 7000, &rec, 0));
+    std::copy(patch.begin(), patch.end(), expected.begin() + 7000);
+    require_cursor_record(cursor, expected);
+
+    // append the record chunk by chunk
+    std::vector<uint8_t> chunk(1000);
+    for (int i = 0; i < 40; i++) {
+      std::fill(chunk.begin(), chunk.end(), (uint8_t)i);
+      rec = ups_make_record(chunk.data(), (uint32_t)chunk.size());
+      REQUIRE(0 == ups_cursor_write_record_range(cursor,
+                              (uint32_t)expected.size(), &rec, 0));
+      expected.insert(expected.end(), chunk.begin(), chunk.end());
+    }
+    uint32_t size = 0;
+    REQUIRE(0 == ups_cursor_get_record_size(cursor, &size));
+    REQUIRE(size == expected.size());
+    require_cursor_record(cursor, expected);
+
+    // the offset must not be beyond the end of the record
+    REQUIRE(UPS_INV_PARAMETER == ups_cursor_write_record_range(cursor,
+                            (uint32_t)expected.size() + 1, &rec, 0));
+
+    // small records are rewritten as a whole
+    k = 2;
+    REQUIRE(0 == ups_cursor_find(cursor, &key, 0, 0));
+    rec = ups_make_record(patch.data(), 100);
+    REQUIRE(0 == ups_cursor_write_record_range(cursor, 2, &rec, 0));
+    tiny.resize(2);
+    tiny.insert(tiny.end(), patch.begin(), patch.begin() + 100);
+    require_cursor_record(cursor, tiny);
+    rec = ups_make_record(0, 0);
+    REQUIRE(0 == ups_cursor_read_record_range(cursor, 1, 3, &rec, 0));
+    REQUIRE(rec.size == 3u);
+    REQUIRE(0 == ::memcmp(rec.data, &tiny[1], 3));
+
+    REQUIRE(0 == ups_cursor_close(cursor));
+    if (txn)
+      REQUIRE(0 == ups_txn_commit(txn, 0));
+    dbp.require_find(1, expected)
+       .require_find(2, tiny);
+
+    // verify the records after reopening the file
+    if (NOTSET(env_flags, UPS_IN_MEMORY)) {
+      close();
+      require_open(env_flags);
+      dbp = DbProxy(db);
+      dbp.require_check_integrity();
+      dbp.require_find(1, expected);
+      dbp.require_find(2, tiny);
+    }
+
+    context.reset(new Context(lenv(), 0, ldb()));
+  }
+
+  void deduplicationTest(uint32_t env_flags) {
+    const uint32_t count = 10;
+    ups_parameter_t params[] = {
+      { UPS_PARAM_PAGE_SIZE, 4096 },
+      { 0, 0 }
+    };
+
+    context->changeset.clear();
+    close();
+    REQUIRE(UPS_INV_PARAMETER == ups_env_create(&env, 0,
+                            UPS_IN_MEMORY | UPS_ENABLE_DEDUPLICATION, 0644, 0));
+    require_create(env_flags | UPS_ENABLE_DEDUPLICATION, params);
+
+    // a multi-page record and a small record, each inserted |count| times
+    std::vector<uint8_t> large(10000);
+    for (size_t i = 0; i < large.size(); i++)
+      large[i] = (uint8_t)(i % 251);
+    std::vector<uint8_t> small(500, 's');
+    std::vector<uint8_t> other(500, 'o');
+
+    DbProxy dbp(db);
+    for (uint32_t i = 0; i < count; i++) {
+      dbp.require_insert(i, large)
+         .require_insert(count + i, small);
+    }
+
+    // the same payloads share a blob
+    ups_env_metrics_t metrics = {0};
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.blob_total_allocated == 2u);
+    REQUIRE(metrics.blob_total_deduplicated == 2 * (count - 1));
+
+    // overwriting a shared record must not modify the other references
+    uint32_t k = 0;
+    ups_key_t key = ups_make_key(&k, sizeof(k));
+    dbp.require_overwrite(&key, other);
+    k = count;
+    dbp.require_overwrite(&key, large);
+
+    // erase some of the references
+    for (uint32_t i = 1; i < count / 2; i++)
+      dbp.require_erase(i)
+         .require_erase(count + i);
+
+    for (int pass = 0; pass < 2; pass++) {
+      dbp = DbProxy(db);
+      dbp.require_check_integrity()
+         .require_find(0u, other)
+         .require_find(count, large);
+      for (uint32_t i = count / 2; i < count; i++)
+        dbp.require_find(i, large)
+           .require_find(count + i, small);
+
+      // reopen the file; the reference counts are persistent
+      if (pass == 0) {
+        close();
+        require_open(env_flags | UPS_ENABLE_DEDUPLICATION);
+      }
+    }
+
+    // erase the remaining references
+    dbp.require_erase(0u)
+       .require_erase(count);
+    for (uint32_t i = count / 2; i < count; i++)
+      dbp.require_erase(i)
+         .require_erase(count + i);
+    dbp.require_check_integrity();
+
+    context.reset(new Context(lenv(), 0, ldb()));
+  }
+
   void allocReadFreeTest() {
     std::vector<uint8_t> buffer(64);
     std::fill(buffer.begin(), buffer.end(), 0x12);
@@ -307,6 +605,66 @@ TEST_CASE("BlobManager/overwriteMappedBlob", "")
   f.overwriteMappedBlob();
 }
 
+TEST_CASE("BlobManager/valueLogTest", "")
+{
+  BlobManagerFixture f;
+  f.valueLogTest(0);
+}
+
+TEST_CASE("BlobManager/valueLogTxnTest", "")
+{
+  BlobManagerFixture f;
+  f.valueLogTest(UPS_ENABLE_TRANSACTIONS);
+}
+
+TEST_CASE("BlobManager/deduplicationTest", "")
+{
+  BlobManagerFixture f;
+  f.deduplicationTest(0);
+}
+
+TEST_CASE("BlobManager/deduplicationCrc32Test", "")
+{
+  BlobManagerFixture f;
+  f.deduplicationTest(UPS_ENABLE_CRC32);
+}
+
+TEST_CASE("BlobManager/deduplicationTxnTest", "")
+{
+  BlobManagerFixture f;
+  f.deduplicationTest(UPS_ENABLE_TRANSACTIONS);
+}
+
+TEST_CASE("BlobManager/recordRangeTest", "")
+{
+  BlobManagerFixture f;
+  f.recordRangeTest(0);
+}
+
+TEST_CASE("BlobManager/recordRangeTxnTest", "")
+{
+  BlobManagerFixture f;
+  f.recordRangeTest(UPS_ENABLE_TRANSACTIONS);
+}
+
+TEST_CASE("BlobManager/recordRangeCrc32Test", "")
+{
+  BlobManagerFixture f;
+  f.recordRangeTest(UPS_ENABLE_CRC32);
+}
+
+TEST_CASE("BlobManager/recordRangeInMemoryTest", "")
+{
+  BlobManagerFixture f;
+  f.recordRangeTest(UPS_IN_MEMORY);
+}
+
+TEST_CASE("BlobManager/recordRangeValueLogTest", "")
+{
+  BlobManagerFixture f;
+  f.recordRangeTest(0, 16 * 1024);
+}
+
 TEST_CASE("BlobManager/allocReadFreeTest", "")
 {
   BlobManagerFixture f(UPS_ENABLE_TRANSACTIONS, 1024);
@@ -116,6 +116,24 @@ struct ChangesetFixture : BaseFixture {
       .require_get(pages[1].page->address(), nullptr)
       .require_get(pages[2].page->address(), nullptr);
   }
+
+  void emptyFlush() {
+    PageProxy page; // allocate this first, otherwise ~ChangesetProxy fails
+    ChangesetProxy ch(lenv());
+    uint64_t lsn = lenv()->lsn_manager.current;
+
+    // an empty changeset does not consume an lsn
+    ch.changeset.flush();
+    REQUIRE(lenv()->lsn_manager.current == lsn);
+
+    // neither does a changeset without modified pages
+    page.allocate(lenv())
+        .set_address(1024)
+        .set_dirty(false);
+    ch.put(page);
+    ch.changeset.flush();
+    REQUIRE(lenv()->lsn_manager.current == lsn);
+  }
 };
 
 TEST_CASE("Changeset/addPages")
@@ -136,5 +154,11 @@ TEST_CASE("Changeset/clear")
   f.clear();
 }
 
+TEST_CASE("Changeset/emptyFlush")
+{
+  ChangesetFixture f;
+  f.emptyFlush();
+}
+
 } // namespace upscaledb
 
@@ -41,6 +41,16 @@ TEST_CASE("Compression/factory", "")
 
   c.reset(CompressorFactory::create(UPS_COMPRESSOR_LZF));
   REQUIRE(c.get() != nullptr);
+
+#ifdef HAVE_LZ4_H
+  c.reset(CompressorFactory::create(UPS_COMPRESSOR_LZ4));
+  REQUIRE(c.get() != nullptr);
+#endif
+
+#ifdef HAVE_ZSTD_H
+  c.reset(CompressorFactory::create(UPS_COMPRESSOR_ZSTD));
+  REQUIRE(c.get() != nullptr);
+#endif
 }
 
 static void
@@ -76,6 +86,20 @@ TEST_CASE("Compression/lzf", "")
   simple_compressor_test(UPS_COMPRESSOR_LZF);
 }
 
+TEST_CASE("Compression/lz4", "")
+{
+#ifdef HAVE_LZ4_H
+  simple_compressor_test(UPS_COMPRESSOR_LZ4);
+#endif
+}
+
+TEST_CASE("Compression/zstd", "")
+{
+#ifdef HAVE_ZSTD_H
+  simple_compressor_test(UPS_COMPRESSOR_ZSTD);
+#endif
+}
+
 static void
 complex_journal_test(int library)
 {
@@ -134,6 +158,20 @@ TEST_CASE("Compression/LzfJournal", "")
   complex_journal_test(UPS_COMPRESSOR_LZF);
 }
 
+TEST_CASE("Compression/Lz4Journal", "")
+{
+#ifdef HAVE_LZ4_H
+  complex_journal_test(UPS_COMPRESSOR_LZ4);
+#endif
+}
+
+TEST_CASE("Compression/ZstdJournal", "")
+{
+#ifdef HAVE_ZSTD_H
+  complex_journal_test(UPS_COMPRESSOR_ZSTD);
+#endif
+}
+
 static void
 simple_record_test(int library)
 {
@@ -195,6 +233,20 @@ TEST_CASE("Compression/LzfRecord", "")
   simple_record_test(UPS_COMPRESSOR_LZF);
 }
 
+TEST_CASE("Compression/Lz4Record", "")
+{
+#ifdef HAVE_LZ4_H
+  simple_record_test(UPS_COMPRESSOR_LZ4);
+#endif
+}
+
+TEST_CASE("Compression/ZstdRecord", "")
+{
+#ifdef HAVE_ZSTD_H
+  simple_record_test(UPS_COMPRESSOR_ZSTD);
+#endif
+}
+
 TEST_CASE("Compression/negativeOpen", "")
 {
   ups_parameter_t p[] = {
@@ -306,6 +358,20 @@ TEST_CASE("Compression/LzfKey", "")
   simple_key_test(UPS_COMPRESSOR_LZF);
 }
 
+TEST_CASE("Compression/Lz4Key", "")
+{
+#ifdef HAVE_LZ4_H
+  simple_key_test(UPS_COMPRESSOR_LZ4);
+#endif
+}
+
+TEST_CASE("Compression/ZstdKey", "")
+{
+#ifdef HAVE_ZSTD_H
+  simple_key_test(UPS_COMPRESSOR_ZSTD);
+#endif
+}
+
 TEST_CASE("Compression/negativeKey", "")
 {
   ups_parameter_t param1[] = {
@@ -386,3 +452,94 @@ TEST_CASE("Compression/unknownCompressor", "")
   BaseFixture f;
   f.require_create(UPS_IN_MEMORY, 0, 0, params, UPS_INV_PARAMETER);
 }
+
+#ifdef HAVE_ZSTD_H
+static void
+fill_dictionary_record(std::vector<uint8_t> &rvec, int i)
+{
+  std::fill(rvec.begin(), rvec.end(), 0);
+  ::snprintf((char *)&rvec[0], rvec.size(),
+          "{\"id\": %d, \"name\": \"customer-%d\", \"country\": \"%s\", "
+          "\"status\": \"active\", \"balance\": %d.%02d}",
+          i, i * 7, i % 2 ? "Germany" : "France", i * 13, i % 100);
+}
+#endif
+
+TEST_CASE("Compression/ZstdDictionary", "")
+{
+#ifdef HAVE_ZSTD_H
+  ups_parameter_t env_params[] = {
+      { UPS_PARAM_JOURNAL_COMPRESSION, UPS_COMPRESSOR_ZSTD },
+      { 0, 0 }
+  };
+  ups_parameter_t db_params[] = {
+      { UPS_PARAM_RECORD_COMPRESSION, UPS_COMPRESSOR_ZSTD },
+      { 0, 0 }
+  };
+
+  BaseFixture f;
+  f.require_create(UPS_ENABLE_TRANSACTIONS, env_params, 0, db_params);
+
+  std::vector<uint8_t> kvec(8);
+  std::vector<uint8_t> rvec(128);
+
+  // train the dictionary
+  const int kSamples = 1000;
+  std::vector<std::vector<uint8_t> > data(kSamples,
+                  std::vector<uint8_t>(rvec.size()));
+  std::vector<ups_record_t> samples(kSamples);
+  for (int i = 0; i < kSamples; i++) {
+    fill_dictionary_record(data[i], i + 10000);
+    samples[i].data = &data[i][0];
+    samples[i].size = (uint32_t)data[i].size();
+  }
+  REQUIRE(UPS_INV_PARAMETER == ups_env_train_compression_dictionary(0,
+                          &samples[0], kSamples));
+  REQUIRE(UPS_INV_PARAMETER == ups_env_train_compression_dictionary(f.env,
+                          0, kSamples));
+  REQUIRE(0 == ups_env_train_compression_dictionary(f.env,
+                          &samples[0], kSamples));
+  // the dictionary cannot be replaced
+  REQUIRE(UPS_INV_PARAMETER == ups_env_train_compression_dictionary(f.env,
+                          &samples[0], kSamples));
+
+  DbProxy db(f.db);
+  for (int i = 0; i < 100; i++) {
+    ::sprintf((char *)&kvec[0], "%03d", i);
+    fill_dictionary_record(rvec, i);
+    db.require_insert(kvec, rvec);
+  }
+
+  // the records compress better than without dictionary
+  ups_env_metrics_t metrics;
+  REQUIRE(0 == ups_env_get_metrics(f.env, &metrics));
+  REQUIRE(metrics.record_bytes_after_compression * 2
+                  < metrics.record_bytes_before_compression);
+
+  // reopen, perform recovery; the dictionary is loaded from the file
+  f.close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG)
+   .require_open(UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY);
+  db = DbProxy(f.db);
+
+  for (int i = 0; i < 100; i++) {
+    ::sprintf((char *)&kvec[0], "%03d", i);
+    fill_dictionary_record(rvec, i);
+    db.require_find(kvec, rvec);
+  }
+
+  REQUIRE(UPS_INV_PARAMETER == ups_env_train_compression_dictionary(f.env,
+                          &samples[0], kSamples));
+
+  // a corrupt size of the dictionary is detected; the data would exceed
+  // the page even though the size is smaller than the page
+  uint64_t address = f.lenv()->header->compression_dictionary();
+  f.close();
+
+  uint32_t size = UPS_DEFAULT_PAGE_SIZE - Page::kSizeofPersistentHeader;
+  File file;
+  file.open("test.db", false);
+  file.pwrite(address + Page::kSizeofPersistentHeader, &size, sizeof(size));
+  file.close();
+  f.require_open(UPS_ENABLE_TRANSACTIONS, 0, UPS_INTEGRITY_VIOLATED);
+#endif
+}
@@ -23,6 +23,7 @@
 
 #include "fixture.hpp"
 
+#include "1base/crc32c.h"
 #include "1os/file.h"
 
 using namespace upscaledb;
@@ -133,3 +134,69 @@ TEST_CASE("Crc32/corruptMultipageBlobTest", "")
   db.require_find("1", v1, UPS_INTEGRITY_VIOLATED);
 }
 
+
+TEST_CASE("Crc32/crc32cTest", "")
+{
+  // the check value of the Castagnoli polynomial
+  REQUIRE(Crc32c::compute("123456789", 9) == 0xe3069283u);
+  REQUIRE(Crc32c::compute_portable("123456789", 9) == 0xe3069283u);
+  REQUIRE(Crc32c::compute("", 0) == 0u);
+
+  // hardware and software implementation return the same results for all
+  // sizes and alignments; the checksum can be computed incrementally
+  std::vector<uint8_t> data(1024 + 16);
+  for (size_t i = 0; i < data.size(); i++)
+    data[i] = (uint8_t)(i * 31 + 7);
+
+  for (size_t offset = 0; offset < 8; offset++) {
+    for (size_t size = 0; size < 1024; size += 13) {
+      uint32_t crc = Crc32c::compute(&data[offset], size);
+      REQUIRE(crc == Crc32c::compute_portable(&data[offset], size));
+
+      size_t half = size / 2;
+      uint32_t partial = Crc32c::compute(&data[offset], half);
+      REQUIRE(crc == Crc32c::compute(&data[offset + half], size - half,
+                              partial));
+    }
+  }
+}
+
+TEST_CASE("Crc32/checksumAlgorithmTest", "")
+{
+  ups_parameter_t params[] = {
+      {UPS_PARAM_CHECKSUM_ALGORITHM, UPS_CHECKSUM_CRC32C},
+      {0, 0}
+  };
+  ups_parameter_t invalid[] = {
+      {UPS_PARAM_CHECKSUM_ALGORITHM, 99},
+      {0, 0}
+  };
+
+  BaseFixture f;
+  f.require_create(UPS_ENABLE_CRC32, invalid, UPS_INV_PARAMETER);
+  f.require_create(UPS_ENABLE_CRC32, params)
+   .require_parameter(UPS_PARAM_CHECKSUM_ALGORITHM, UPS_CHECKSUM_CRC32C);
+
+  std::vector<uint8_t> v1(1024 * 32, 1);
+  DbProxy db(f.db);
+  db.require_insert("1", nullptr)
+    .require_insert("2", v1);
+  f.close();
+
+  // the algorithm is persisted, and can only be set when creating
+  // the Environment
+  f.require_open(UPS_ENABLE_CRC32, params, UPS_INV_PARAMETER);
+  f.require_open(UPS_ENABLE_CRC32)
+   .require_parameter(UPS_PARAM_CHECKSUM_ALGORITHM, UPS_CHECKSUM_CRC32C);
+  db = DbProxy(f.db);
+  db.require_find("1", nullptr)
+    .require_find("2", v1);
+  f.close();
+
+  // corruption is detected
+  garbagify_file("test.db", 1024 * 16 + 200);
+
+  f.require_open(UPS_ENABLE_CRC32);
+  db = DbProxy(f.db);
+  db.require_find("1", nullptr, UPS_INTEGRITY_VIOLATED);
+}
@@ -19,6 +19,7 @@
 #include "3rdparty/catch/catch.hpp"
 
 #include "2device/device.h"
+#include "2device/device_tiered.h"
 
 #include "os.hpp"
 #include "fixture.hpp"
@@ -178,6 +179,235 @@ struct DeviceFixture : BaseFixture {
       pp.require_payload(temp, page_size - Page::kSizeofPersistentHeader);
     }
   }
+
+  void sharedMmapTest() {
+    uint32_t page_size = UPS_DEFAULT_PAGE_SIZE;
+    std::vector<uint8_t> temp(page_size);
+    std::vector<uint8_t> buffer(page_size);
+    ups_parameter_t params[] = {
+        {UPS_PARAM_MMAP_RESERVE_SIZE, 64 * 1024 * 1024},
+        {0, 0}
+    };
+
+    close();
+    require_create(0, params);
+    require_parameter(UPS_PARAM_MMAP_RESERVE_SIZE, 64 * 1024 * 1024);
+
+    // the mapping grows with the file
+    DeviceProxy dp(lenv());
+    dp.require_truncate(page_size * 10);
+    REQUIRE(device()->is_mapped(0, page_size * 10));
+    REQUIRE(!device()->is_mapped(0, page_size * 11));
+
+    // modified pages are written to the file
+    for (uint8_t i = 2; i < 10; i++) {
+      PageProxy pp(lenv(), ldb());
+      dp.require_read_page(pp, i * page_size);
+      pp.require_allocated(false);
+      ::memset(pp.page->data(), i, page_size);
+      pp.set_dirty(true)
+        .require_flush();
+    }
+    for (uint8_t i = 2; i < 10; i++) {
+      std::fill(temp.begin(), temp.end(), i);
+      dp.require_read(i * page_size, buffer.data(), page_size);
+      REQUIRE(buffer == temp);
+    }
+
+    // and modifications of the file are visible in the mapping
+    std::fill(temp.begin(), temp.end(), 0x42);
+    dp.require_write(page_size * 3, temp.data(), page_size);
+    PageProxy pp(lenv(), ldb());
+    dp.require_read_page(pp, page_size * 3);
+    pp.require_allocated(false)
+      .require_data(temp.data(), page_size);
+    pp.close();
+
+    // the mapping shrinks with the file
+    dp.require_truncate(page_size * 5);
+    REQUIRE(device()->is_mapped(0, page_size * 5));
+    REQUIRE(!device()->is_mapped(0, page_size * 6));
+  }
+
+  void sharedMmapEnvTest(uint32_t env_flags) {
+    std::vector<uint8_t> record(100, 'x');
+    std::vector<uint8_t> blob(100 * 1024, 'y');
+    const uint32_t count = 10000;
+    uint32_t page_size = UPS_DEFAULT_PAGE_SIZE;
+    ups_parameter_t params[] = {
+        {UPS_PARAM_MMAP_RESERVE_SIZE, 64 * 1024 * 1024},
+        {0, 0}
+    };
+
+    close();
+    require_create(env_flags, params);
+
+    DbProxy dbp(db);
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_insert(i, i % 100 == 0 ? blob : record);
+
+    // the file is only mapped if recovery is disabled
+    bool shared = NOTSET(env_flags, UPS_ENABLE_TRANSACTIONS);
+    REQUIRE(device()->is_mapped(0, page_size * 10) == shared);
+
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_find(i, i % 100 == 0 ? blob : record);
+
+    // reopen the file and verify the data
+    close();
+    require_open(env_flags, params);
+    // otherwise the existing pages are mapped with MAP_PRIVATE
+    REQUIRE(device()->is_mapped(0, page_size * 10));
+    dbp = DbProxy(db);
+    dbp.require_check_integrity();
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_find(i, i % 100 == 0 ? blob : record);
+  }
+
+  void tieredTest() {
+    std::vector<uint8_t> blob(40 * 1024);
+    const uint32_t count = 500;
+    ups_parameter_t params[] = {
+        {UPS_PARAM_COLD_TIER_FILENAME, (uint64_t)"test.db.cold"},
+        {UPS_PARAM_CACHE_SIZE, 256 * 1024},
+        {0, 0}
+    };
+    ups_parameter_t cache_params[] = {
+        {UPS_PARAM_CACHE_SIZE, 256 * 1024},
+        {0, 0}
+    };
+
+    close();
+    require_create(0, params);
+    REQUIRE(device()->is_mapped(0, 1) == false);
+
+    // the evicted blob pages are moved to the capacity tier
+    DbProxy dbp(db);
+    for (uint32_t i = 0; i < count; i++) {
+      std::fill(blob.begin(), blob.end(), (uint8_t)i);
+      dbp.require_insert(i, blob);
+    }
+    REQUIRE(0 == ups_env_flush(env, 0));
+
+    // while inserting, the dirty pages are flushed asynchronously and
+    // possibly never evicted; the (clean) pages which are read now are
+    // evicted synchronously
+    for (uint32_t i = 0; i < count; i++) {
+      std::fill(blob.begin(), blob.end(), (uint8_t)i);
+      dbp.require_find(i, blob);
+    }
+    REQUIRE(0 == ups_env_flush(env, 0));
+
+    ups_env_metrics_t metrics = {0};
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.page_count_demoted > 0);
+    REQUIRE(metrics.page_count_cold > 0);
+
+    // pages which are read repeatedly move back to the fast tier
+    for (int loop = 0; loop < TieredDevice::kPromoteThreshold; loop++) {
+      for (uint32_t i = 0; i < count; i++) {
+        std::fill(blob.begin(), blob.end(), (uint8_t)i);
+        dbp.require_find(i, blob);
+      }
+    }
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.page_count_promoted > 0);
+
+    // the cold pages are modified in place
+    for (uint32_t i = 0; i < count; i += 2) {
+      std::fill(blob.begin(), blob.end(), (uint8_t)(i + 1));
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      dbp.require_overwrite(&key, blob);
+    }
+
+    // the page map is loaded without the parameter
+    close();
+    require_open(0, cache_params);
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.page_count_cold > 0);
+    dbp = DbProxy(db);
+    dbp.require_check_integrity();
+    for (uint32_t i = 0; i < count; i++) {
+      std::fill(blob.begin(), blob.end(), (uint8_t)(i % 2 ? i : i + 1));
+      dbp.require_find(i, blob);
+    }
+
+    // a new Environment removes the stale page map
+    close();
+    require_create(0);
+    close();
+    REQUIRE(false == File::exists("test.db.tier"));
+    File::remove("test.db.cold");
+  }
+
+  void demote(TieredDevice &dev, uint64_t address) {
+    Page page(&dev);
+    dev.read_page(&page, address);
+    dev.demote_page(&page);
+  }
+
+  void tieredRedemoteTest() {
+    const size_t page_size = UPS_DEFAULT_PAGE_SIZE;
+    const size_t count = 2 * TieredDevice::kDemoteBatchSize;
+    std::vector<uint8_t> buffer(page_size);
+    std::vector<uint64_t> addresses;
+
+    EnvConfig cfg = lenv()->config;
+    cfg.filename = "test.db.2";
+    cfg.cold_tier_filename = "test.db.2.cold";
+
+    TieredDevice dev(cfg);
+    dev.create();
+    for (size_t i = 0; i < count; i++) {
+      addresses.push_back(dev.alloc(page_size));
+      std::fill(buffer.begin(), buffer.end(), (uint8_t)i);
+      dev.write(addresses[i], buffer.data(), page_size);
+    }
+
+    // the first batch fills the slots 0 .. 63 (the page at address 0
+    // is never demoted)
+    for (size_t i = 1; i <= TieredDevice::kDemoteBatchSize; i++)
+      demote(dev, addresses[i]);
+    REQUIRE(dev.is_cold(addresses[1]));
+    REQUIRE(dev.is_cold(addresses[2]));
+
+    // page 1 moves back to the fast tier; its slot is free after flushing
+    std::fill(buffer.begin(), buffer.end(), (uint8_t)0xf1);
+    dev.write(addresses[1], buffer.data(), page_size);
+    dev.flush();
+
+    // page 2 moves back to the fast tier, and is demoted again (without
+    // flushing); now it's stored in the lower slot of page 1
+    std::fill(buffer.begin(), buffer.end(), (uint8_t)0xf2);
+    dev.write(addresses[2], buffer.data(), page_size);
+    demote(dev, addresses[2]);
+    for (size_t i = TieredDevice::kDemoteBatchSize + 1; i < count; i++)
+      demote(dev, addresses[i]);
+    REQUIRE(dev.is_cold(addresses[2]));
+
+    // simulate a crash: open a copy of the files
+    REQUIRE(true == os::copy("test.db.2", "test.db.3"));
+    REQUIRE(true == os::copy("test.db.2.tier", "test.db.3.tier"));
+    REQUIRE(true == os::copy("test.db.2.cold", "test.db.3.cold"));
+    dev.close();
+
+    cfg.filename = "test.db.3";
+    cfg.cold_tier_filename = "test.db.3.cold";
+    TieredDevice copy(cfg);
+    copy.open();
+    for (size_t i = 1; i < count; i++) {
+      copy.read(addresses[i], buffer.data(), page_size);
+      uint8_t expected = i == 1 ? 0xf1 : i == 2 ? 0xf2 : (uint8_t)i;
+      REQUIRE(buffer[0] == expected);
+      REQUIRE(buffer[page_size - 1] == expected);
+    }
+    copy.close();
+
+    const char *files[] = {"test.db.2", "test.db.2.tier", "test.db.2.cold",
+                "test.db.3", "test.db.3.tier", "test.db.3.cold"};
+    for (size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++)
+      File::remove(files[i]);
+  }
 };
 
 TEST_CASE("Device/newDelete", "")
@@ -234,6 +464,35 @@ TEST_CASE("Device/readWritePage", "")
   f.readWritePageTest();
 }
 
+TEST_CASE("Device/sharedMmap", "")
+{
+  DeviceFixture f(false);
+  f.sharedMmapTest();
+}
+
+TEST_CASE("Device/sharedMmapEnv", "")
+{
+  DeviceFixture f(false);
+  f.sharedMmapEnvTest(0);
+}
+
+TEST_CASE("Device/sharedMmapEnvTxn", "")
+{
+  DeviceFixture f(false);
+  f.sharedMmapEnvTest(UPS_ENABLE_TRANSACTIONS);
+}
+
+TEST_CASE("Device/tiered", "")
+{
+  DeviceFixture f(false);
+  f.tieredTest();
+}
+
+TEST_CASE("Device/tieredRedemote", "")
+{
+  DeviceFixture f(false);
+  f.tieredRedemoteTest();
+}
 
 TEST_CASE("Device/inmem/newDelete", "")
 {
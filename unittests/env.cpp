@@ -95,7 +95,7 @@ struct EnvFixture {
     bf.require_create(m_flags, parameters)
       .require_parameter(UPS_PARAM_CACHESIZE, 1024 * 128)
       .require_parameter(UPS_PARAM_PAGESIZE, 1024 * 64)
-      .require_parameter(UPS_PARAM_MAX_DATABASES, 2179);
+      .require_parameter(UPS_PARAM_MAX_DATABASES, 1421);
     
     if (NOTSET(m_flags, UPS_IN_MEMORY)) {
       bf.close()
@@ -104,7 +104,7 @@ struct EnvFixture {
 
     bf.require_parameter(UPS_PARAM_CACHESIZE, 1024 * 128)
       .require_parameter(UPS_PARAM_PAGESIZE, 1024 * 64)
-      .require_parameter(UPS_PARAM_MAX_DATABASES, 2179);
+      .require_parameter(UPS_PARAM_MAX_DATABASES, 1421);
 
     // now create 128 DBs
     for (int i = 0; i < 128; i++) {
@@ -762,7 +762,7 @@ struct EnvFixture {
   }
 
   void limitsReachedTest() {
-    const int MAX_DB = 540 + 1;
+    const int MAX_DB = 352 + 1;
     ups_db_t *db[MAX_DB];
 
     BaseFixture bf;
@@ -18,7 +18,11 @@
 
 #include "3rdparty/catch/catch.hpp"
 
+#include <algorithm>
+#include <boost/thread.hpp>
+
 #include "2lsn_manager/lsn_manager.h"
+#include "2lsn_manager/lsn_pipeline.h"
 #include "3journal/journal.h"
 #include "4txn/txn_local.h"
 
@@ -669,6 +673,135 @@ struct JournalFixture : BaseFixture {
     }
   }
 
+  void changesetDeltaTest() {
+    std::vector<uint8_t> record(8, 'a');
+    DbProxy dbp(db);
+    for (uint32_t i = 0; i < 100; i++)
+      dbp.require_insert(nullptr, i, record);
+
+    ups_env_metrics_t metrics;
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    uint64_t before = metrics.journal_bytes_flushed;
+    // the persisted images of the pages are read as the base of the deltas
+    REQUIRE(metrics.journal_page_base_reads > 0);
+
+    // overwriting a small record only logs the modified bytes of the page
+    uint32_t k = 50;
+    ups_key_t key = ups_make_key(&k, sizeof(k));
+    std::fill(record.begin(), record.end(), 'b');
+    dbp.require_overwrite(&key, record);
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.journal_bytes_flushed - before
+                < lenv()->config.page_size_bytes / 4);
+
+    // and the delta is applied during recovery
+    backup();
+    close(UPS_AUTO_CLEANUP);
+    restore();
+
+    require_open(UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY);
+    DbProxy(db).require_find(50u, record);
+  }
+
+  void checkpointTest() {
+    ups_parameter_t params[] = {
+      { UPS_PARAM_JOURNAL_CHECKPOINT_BYTES, 1 },
+      { 0, 0 }
+    };
+    close();
+    require_create(UPS_ENABLE_TRANSACTIONS, params, 0, nullptr);
+    require_parameter(UPS_PARAM_JOURNAL_CHECKPOINT_BYTES, 1);
+    require_parameter(UPS_PARAM_JOURNAL_CHECKPOINT_SECONDS, 0);
+
+    std::vector<uint8_t> record(64, 'c');
+    DbProxy dbp(db);
+    for (uint32_t i = 0; i < 1000; i++)
+      dbp.require_insert(nullptr, i, record);
+
+    // wait till the worker thread wrote the pending checkpoint
+    JournalState &state = lenv()->journal->state;
+    while (state.checkpoint_pending.load())
+      boost::this_thread::yield();
+
+    ups_env_metrics_t metrics;
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.journal_checkpoints > 0);
+    REQUIRE(metrics.journal_checkpoint_lsn > 0);
+    REQUIRE(metrics.journal_checkpoint_lsn < current_lsn());
+    REQUIRE(metrics.journal_recovery_bytes < metrics.journal_bytes_flushed);
+
+    // the journal contains the checkpoints
+    Journal::Iterator it;
+    PJournalEntry entry;
+    ByteArray auxbuffer;
+    int checkpoints = 0;
+    while (true) {
+      lenv()->journal->test_read_entry(&it, &entry, &auxbuffer);
+      if (entry.lsn == 0)
+        break;
+      if (entry.type == Journal::kEntryTypeCheckpoint) {
+        PJournalEntryCheckpoint *checkpoint
+                = (PJournalEntryCheckpoint *)auxbuffer.data();
+        REQUIRE(checkpoint->changeset_lsn < entry.lsn);
+        checkpoints++;
+      }
+    }
+    REQUIRE(checkpoints > 0);
+
+    // recovery skips the checkpointed changesets
+    backup();
+    close(UPS_AUTO_CLEANUP);
+    restore();
+
+    require_open(UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY);
+    REQUIRE(lenv()->journal->state.count_skipped_changesets > 0);
+
+    dbp = DbProxy(db);
+    for (uint32_t i = 0; i < 1000; i++)
+      dbp.require_find(i, record);
+  }
+
+  void recoverLargeRecordsTest() {
+#ifndef WIN32
+    // these records are referenced by the journal, not copied
+    std::vector<uint8_t> record(JournalRecord::kMinReferenceSize * 20);
+    for (size_t i = 0; i < record.size(); i++)
+      record[i] = (uint8_t)i;
+
+    // do not immediately flush the changeset after a commit
+    close();
+    require_create(UPS_DONT_FLUSH_TRANSACTIONS | UPS_ENABLE_TRANSACTIONS,
+                    nullptr, 0, nullptr);
+
+    ups_txn_t *txn;
+    REQUIRE(0 == ups_txn_begin(&txn, env, nullptr, 0, 0));
+    DbProxy dbp(db);
+    for (uint32_t i = 0; i < 10; i++) {
+      record[0] = (uint8_t)i;
+      dbp.require_insert(txn, i, record);
+    }
+    REQUIRE(0 == ups_txn_commit(txn, 0));
+
+    // all bytes were counted
+    ups_env_metrics_t metrics;
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    JournalState &state = lenv()->journal->state;
+    REQUIRE(metrics.journal_bytes_flushed
+                == state.files[0].file_size() + state.files[1].file_size());
+
+    // backup the files, then restore
+    backup();
+    close(UPS_AUTO_CLEANUP);
+    restore();
+
+    require_open(UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY);
+    for (uint32_t i = 0; i < 10; i++) {
+      record[0] = (uint8_t)i;
+      DbProxy(db).require_find(i, record);
+    }
+#endif
+  }
+
   void recoverEraseTest() {
     // create a transaction with many keys that are inserted, mostly
     // duplicates
@@ -1062,9 +1195,41 @@ struct JournalFixture : BaseFixture {
     // close the environment
     close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG);
 
-    // verify the journal file sizes
-    require_file_size("test.db.jrn0", 33664);
-    require_file_size("test.db.jrn1", 51168);
+    // verify the journal file sizes; the pages of the changesets are
+    // mostly logged as deltas
+    require_file_size("test.db.jrn0", 1435);
+    require_file_size("test.db.jrn1", 2825);
+  }
+
+  void recoverKeyCountTest() {
+    std::vector<uint8_t> record;
+    DbProxy dbp(db);
+    for (uint32_t i = 0; i < 100; i++) {
+      TxnProxy tp(env, nullptr, true);
+      dbp.require_insert(tp.txn, i, record);
+    }
+    for (uint32_t i = 0; i < 10; i++) {
+      TxnProxy tp(env, nullptr, true);
+      dbp.require_insert_duplicate(tp.txn, i, record);
+    }
+    for (uint32_t i = 90; i < 100; i++) {
+      TxnProxy tp(env, nullptr, true);
+      dbp.require_erase(tp.txn, i);
+    }
+
+    // the key counters were not yet written to disk; they are recalculated
+    // during recovery
+    backup();
+    close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG);
+    restore();
+    require_open(UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY);
+
+    uint64_t count = 0;
+    REQUIRE(0 == ups_db_count(db, 0, UPS_SKIP_DUPLICATES, &count));
+    REQUIRE(count == 90u);
+    REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+    REQUIRE(count == 100u);
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
   }
 
   void recoverWithCrc32Test() {
@@ -1107,6 +1272,123 @@ struct JournalFixture : BaseFixture {
     require_flags(UPS_ENABLE_CRC32, true);
     require_flags(UPS_ENABLE_FSYNC, true);
   }
+
+  // Flips a byte in the last occurrence of |pattern| in one of the
+  // journal files
+  void corrupt_journal(const std::vector<uint8_t> &pattern) {
+    const char *filenames[] = {"test.db.jrn0", "test.db.jrn1"};
+    for (int i = 0; i < 2; i++) {
+      File f;
+      f.open(filenames[i], 0);
+      std::vector<uint8_t> data(f.file_size());
+      if (data.size())
+        f.pread(0, data.data(), data.size());
+      std::vector<uint8_t>::iterator it = std::find_end(data.begin(),
+                      data.end(), pattern.begin(), pattern.end());
+      if (it != data.end()) {
+        uint8_t b = *it ^ 0xff;
+        f.pwrite(it - data.begin(), &b, 1);
+        f.close();
+        return;
+      }
+      f.close();
+    }
+    REQUIRE(!"pattern not found");
+  }
+
+  // Clears the checksum of the last insert entry whose data contains
+  // |pattern|
+  void clear_checksum(const std::vector<uint8_t> &pattern) {
+    const char *filenames[] = {"test.db.jrn0", "test.db.jrn1"};
+    for (int i = 0; i < 2; i++) {
+      File f;
+      f.open(filenames[i], 0);
+      uint64_t size = f.file_size();
+      uint64_t offset = 0;
+      uint64_t found = size;
+      PJournalEntry entry;
+      while (offset + sizeof(entry) <= size) {
+        f.pread(offset, &entry, sizeof(entry));
+        if (entry.lsn == 0)
+          break;
+        std::vector<uint8_t> data((size_t)entry.followup_size);
+        if (data.size())
+          f.pread(offset + sizeof(entry), data.data(), data.size());
+        if (entry.type == Journal::kEntryTypeInsert
+                && std::search(data.begin(), data.end(), pattern.begin(),
+                        pattern.end()) != data.end())
+          found = offset;
+        offset += sizeof(entry) + entry.followup_size;
+      }
+      if (found != size) {
+        f.pread(found, &entry, sizeof(entry));
+        entry.checksum = 0;
+        f.pwrite(found, &entry, sizeof(entry));
+        f.close();
+        return;
+      }
+      f.close();
+    }
+    REQUIRE(!"pattern not found");
+  }
+
+  void recoverTornEntryTest() {
+    std::vector<uint8_t> record1(16, 'a');
+    std::vector<uint8_t> record2(16, 'b');
+    DbProxy dbp(db);
+
+    TxnProxy tp1(env);
+    dbp.require_insert(tp1.txn, 1u, record1);
+    tp1.commit();
+    TxnProxy tp2(env);
+    dbp.require_insert(tp2.txn, 2u, record2);
+    tp2.commit();
+
+    JournalProxy(lenv()).flush_buffers();
+
+    backup();
+    close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG);
+    restore();
+
+    // damage the insert of the second transaction; recovery stops at
+    // this entry, and the second transaction is discarded
+    corrupt_journal(record2);
+
+    require_open(UPS_ENABLE_TRANSACTIONS | UPS_ENABLE_CRC32
+                    | UPS_AUTO_RECOVERY);
+    dbp = DbProxy(db);
+    dbp.require_find(1u, record1)
+       .require_find(2u, record2, UPS_KEY_NOT_FOUND);
+  }
+
+  void recoverZeroedChecksumTest() {
+    std::vector<uint8_t> record1(16, 'a');
+    std::vector<uint8_t> record2(16, 'b');
+    DbProxy dbp(db);
+
+    TxnProxy tp1(env);
+    dbp.require_insert(tp1.txn, 1u, record1);
+    tp1.commit();
+    TxnProxy tp2(env);
+    dbp.require_insert(tp2.txn, 2u, record2);
+    tp2.commit();
+
+    JournalProxy(lenv()).flush_buffers();
+
+    backup();
+    close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG);
+    restore();
+
+    // with UPS_ENABLE_CRC32 all entries are sealed; a torn header with a
+    // zeroed checksum ends the recovery
+    clear_checksum(record2);
+
+    require_open(UPS_ENABLE_TRANSACTIONS | UPS_ENABLE_CRC32
+                    | UPS_AUTO_RECOVERY);
+    dbp = DbProxy(db);
+    dbp.require_find(1u, record1)
+       .require_find(2u, record2, UPS_KEY_NOT_FOUND);
+  }
 };
 
 TEST_CASE("Journal/createClose", "")
@@ -1217,6 +1499,24 @@ TEST_CASE("Journal/recoverInsertTest", "")
   f.recoverInsertTest();
 }
 
+TEST_CASE("Journal/changesetDeltaTest", "")
+{
+  JournalFixture f;
+  f.changesetDeltaTest();
+}
+
+TEST_CASE("Journal/checkpointTest", "")
+{
+  JournalFixture f;
+  f.checkpointTest();
+}
+
+TEST_CASE("Journal/recoverLargeRecordsTest", "")
+{
+  JournalFixture f;
+  f.recoverLargeRecordsTest();
+}
+
 TEST_CASE("Journal/recoverEraseTest", "")
 {
   JournalFixture f;
@@ -1271,11 +1571,88 @@ TEST_CASE("Journal/issue71Test", "")
   f.issue71Test();
 }
 
+TEST_CASE("Journal/recoverKeyCountTest", "")
+{
+  JournalFixture f;
+  f.recoverKeyCountTest();
+}
+
 TEST_CASE("Journal/recoverWithCrc32Test", "")
 {
   JournalFixture f;
   f.recoverWithCrc32Test();
 }
 
-} // namespace upscaledb
+TEST_CASE("Journal/recoverTornEntryTest", "")
+{
+  JournalFixture f(UPS_ENABLE_CRC32);
+  f.recoverTornEntryTest();
+}
 
+TEST_CASE("Journal/recoverZeroedChecksumTest", "")
+{
+  JournalFixture f(UPS_ENABLE_CRC32);
+  f.recoverZeroedChecksumTest();
+}
+
+// Records the lsn and the payload of each consumed record
+struct LsnPipelineRecorder {
+  LsnPipelineRecorder(std::vector<uint64_t> *lsns_,
+                  std::vector<uint64_t> *payloads_)
+    : lsns(lsns_), payloads(payloads_) {
+  }
+
+  void operator()(uint64_t lsn, ByteArray &record, uint32_t flags) {
+    lsns->push_back(lsn);
+    payloads->push_back(*(uint64_t *)record.data());
+  }
+
+  std::vector<uint64_t> *lsns;
+  std::vector<uint64_t> *payloads;
+};
+
+typedef LsnPipeline<LsnPipelineRecorder> TestPipeline;
+
+// Publishes |loops| records; every 10th reservation is cancelled
+static void
+lsn_pipeline_writer(TestPipeline *pipeline, int loops)
+{
+  for (int i = 0; i < loops; i++) {
+    LsnTicket ticket = pipeline->reserve();
+    if (i % 10 == 9) {
+      pipeline->cancel(ticket);
+      continue;
+    }
+    pipeline->record(ticket).append((uint8_t *)&ticket.lsn,
+                    sizeof(ticket.lsn));
+    pipeline->publish(ticket, 0);
+  }
+}
+
+TEST_CASE("Journal/lsnPipelineTest", "")
+{
+  const int kThreads = 8;
+  const int kLoops = 10000;
+
+  LsnManager lsn_manager;
+  std::vector<uint64_t> lsns;
+  std::vector<uint64_t> payloads;
+  TestPipeline pipeline(&lsn_manager, LsnPipelineRecorder(&lsns, &payloads));
+
+  boost::thread_group threads;
+  for (int i = 0; i < kThreads; i++)
+    threads.create_thread(boost::bind(&lsn_pipeline_writer, &pipeline,
+                            kLoops));
+  threads.join_all();
+
+  // all published records were consumed exactly once, in lsn order
+  REQUIRE(lsns.size() == (size_t)kThreads * (kLoops - kLoops / 10));
+  REQUIRE(lsn_manager.current == (uint64_t)kThreads * kLoops + 1);
+  for (size_t i = 0; i < lsns.size(); i++) {
+    REQUIRE(payloads[i] == lsns[i]);
+    if (i > 0)
+      REQUIRE(lsns[i] > lsns[i - 1]);
+  }
+}
+
+} // namespace upscaledb
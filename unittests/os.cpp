@@ -207,6 +207,32 @@ TEST_CASE("Os/readWrite")
   }
 }
 
+TEST_CASE("Os/writev")
+{
+  FileProxy fp;
+  std::vector<uint8_t> data;
+  std::vector<File::IoBuffer> buffers;
+
+  // more buffers than a single writev() can take
+  for (uint32_t i = 0; i < 200; i++)
+    data.insert(data.end(), i % 7 == 0 ? 4096 : i + 1, (uint8_t)i);
+
+  size_t offset = 0;
+  for (uint32_t i = 0; i < 200; i++) {
+    File::IoBuffer b = {data.data() + offset, i % 7 == 0 ? 4096 : i + 1};
+    buffers.push_back(b);
+    offset += b.size;
+  }
+
+  fp.require_create("test.db", 0664);
+  fp.f.writev(buffers.data(), buffers.size());
+  fp.require_size(data.size());
+
+  std::vector<uint8_t> read(data.size());
+  fp.require_pread(0, read.data(), read.size());
+  REQUIRE(read == data);
+}
+
 TEST_CASE("Os/mmap")
 {
   uint32_t page_size = File::granularity();
@@ -19,6 +19,7 @@
 #include "3rdparty/catch/catch.hpp"
 
 #include "1base/pickle.h"
+#include "3cache/flash_cache.h"
 #include "3page_manager/freelist.h"
 #include "3page_manager/page_manager.h"
 #include "4context/context.h"
@@ -324,6 +325,37 @@ struct PageManagerFixture : BaseFixture {
 #endif
   }
 
+  void readAheadTest() {
+    const char *foo = "123456789012345567890123456789012345678901234567890";
+
+    close();
+    require_create(0);
+
+    DbProxy dbp(db);
+    for (uint32_t i = 0; i < 50000; i++)
+      dbp.require_insert(i, foo);
+
+    close();
+    require_open();
+
+    ups_cursor_t *cursor;
+    ups_key_t key = {0};
+    ups_record_t record = {0};
+    uint32_t count = 0;
+    REQUIRE(0 == ups_cursor_create(&cursor, db, 0, 0));
+    while (0 == ups_cursor_move(cursor, &key, &record, UPS_CURSOR_NEXT))
+      count++;
+    REQUIRE(count == 50000);
+    REQUIRE(0 == ups_cursor_close(cursor));
+
+    ups_env_metrics_t metrics;
+    lenv()->page_manager->fill_metrics(&metrics);
+    REQUIRE(metrics.readahead_pages > 0);
+    REQUIRE(metrics.readahead_hits > 0);
+    REQUIRE(metrics.readahead_hits + metrics.readahead_wasted
+                    <= metrics.readahead_pages);
+  }
+
   void collapseFreelistTest() {
     PageManager *page_manager = lenv()->page_manager.get();
     uint32_t page_size = lenv()->config.page_size_bytes;
@@ -340,9 +372,8 @@ struct PageManagerFixture : BaseFixture {
 
     page_manager->initialize(page_id);
 
-    REQUIRE(10 == page_manager->state->freelist.free_pages.size());
-    for (int i = 1; i < 10; i++)
-      REQUIRE(page_manager->state->freelist.free_pages[page_size * (1 + i * 15)] == 15);
+    REQUIRE(1 == page_manager->state->freelist.free_pages.size());
+    REQUIRE(page_manager->state->freelist.free_pages[page_size] == 150);
   }
 
   void encodeDecodeTest() {
@@ -404,6 +435,353 @@ struct PageManagerFixture : BaseFixture {
     REQUIRE(page2 != 0);
     REQUIRE(page2->address() == page1->address() + page_size * 2);
   }
+
+  void bestFitFreelistTest() {
+    uint32_t page_size = lenv()->config.page_size_bytes;
+    Freelist freelist(lenv()->config);
+
+    // adjacent extents are merged
+    freelist.put(page_size * 10, 1);
+    freelist.put(page_size * 12, 1);
+    freelist.put(page_size * 11, 1);
+    REQUIRE(freelist.free_pages.size() == 1);
+    REQUIRE(freelist.free_pages[page_size * 10] == 3);
+    REQUIRE(freelist.has(page_size * 11));
+    REQUIRE(!freelist.has(page_size * 13));
+
+    freelist.put(page_size * 20, 8);
+    freelist.put(page_size * 40, 1);
+    freelist.put(page_size * 50, 4);
+
+    ups_env_metrics_t metrics = {0};
+    freelist.fill_metrics(&metrics);
+    REQUIRE(metrics.freelist_extents == 4);
+    REQUIRE(metrics.freelist_pages == 16);
+    REQUIRE(metrics.freelist_largest_extent == 8);
+
+    // the smallest extent which is large enough is used
+    REQUIRE(freelist.alloc(1) == page_size * 40);
+    REQUIRE(freelist.alloc(4) == page_size * 50);
+    REQUIRE(freelist.alloc(2) == page_size * 10);
+    REQUIRE(freelist.free_pages[page_size * 12] == 1);
+    REQUIRE(freelist.alloc(9) == 0);
+    REQUIRE(freelist.alloc(8) == page_size * 20);
+
+    freelist.fill_metrics(&metrics);
+    REQUIRE(metrics.freelist_hits == 4);
+    REQUIRE(metrics.freelist_misses == 1);
+    REQUIRE(metrics.freelist_extents == 1);
+    REQUIRE(metrics.freelist_pages == 1);
+
+    // long extents survive encoding and decoding
+    freelist.put(page_size * 100, 1000);
+    uint8_t buffer[64] = {0};
+    std::pair<bool, Freelist::FreeMap::const_iterator> cont;
+    cont.first = false;
+    cont = freelist.encode_state(cont, buffer, sizeof(buffer));
+    REQUIRE(cont.first == false);
+
+    Freelist copy(lenv()->config);
+    copy.decode_state(buffer + 8);
+    REQUIRE(copy.free_pages.size() == 2);
+    REQUIRE(copy.free_pages[page_size * 12] == 1);
+    REQUIRE(copy.free_pages[page_size * 100] == 1000);
+    REQUIRE(copy.free_page_count == 1001);
+  }
+
+  void holePunchFreelistTest() {
+    uint32_t page_size = lenv()->config.page_size_bytes;
+    Freelist freelist(lenv()->config);
+    std::vector<std::pair<uint64_t, size_t> > extents;
+
+    freelist.put(page_size * 10, 2);
+    freelist.put(page_size * 20, 100);
+    freelist.put(page_size * 200, 64);
+
+    // extents which were freed after the deadline are skipped
+    freelist.collect_holes(::time(0) - 100, 64, &extents);
+    REQUIRE(extents.empty());
+
+    // small extents are skipped
+    freelist.collect_holes(::time(0) + 10, 64, &extents);
+    REQUIRE(extents.size() == 2);
+    REQUIRE(extents[0] == std::make_pair((uint64_t)page_size * 20, (size_t)100));
+    REQUIRE(extents[1] == std::make_pair((uint64_t)page_size * 200, (size_t)64));
+    REQUIRE(freelist.holes.size() == 2);
+
+    // extents are only punched once
+    extents.clear();
+    freelist.collect_holes(::time(0) + 10, 64, &extents);
+    REQUIRE(extents.empty());
+
+    // a merged extent keeps the free times of its parts (weighted by
+    // size), and only its remaining pages are punched
+    freelist.free_times[page_size * 20] = ::time(0) - 1000;
+    freelist.put(page_size * 120, 1);
+    REQUIRE(freelist.free_pages[page_size * 20] == 101);
+    REQUIRE(freelist.free_times[page_size * 20] < ::time(0) - 900);
+    freelist.collect_holes(::time(0) - 100, 64, &extents);
+    REQUIRE(extents.size() == 1);
+    REQUIRE(extents[0] == std::make_pair((uint64_t)page_size * 120, (size_t)1));
+    REQUIRE(freelist.holes.size() == 2);
+    REQUIRE(freelist.holes[page_size * 20] == 101);
+
+    // allocating a page splits the hole
+    REQUIRE(freelist.alloc(64) == page_size * 200);
+    REQUIRE(freelist.fill_hole(page_size * 200, 64) == true);
+    REQUIRE(freelist.holes.size() == 1);
+    REQUIRE(freelist.fill_hole(page_size * 10, 1) == false);
+    REQUIRE(freelist.fill_hole(page_size * 50, 1) == true);
+    REQUIRE(freelist.holes.size() == 2);
+    REQUIRE(freelist.holes[page_size * 20] == 30);
+    REQUIRE(freelist.holes[page_size * 51] == 70);
+
+    // truncating the file removes the holes
+    REQUIRE(freelist.truncate(page_size * 121) == page_size * 20);
+    REQUIRE(freelist.holes.empty());
+  }
+
+  void holePunchTest() {
+    std::vector<uint8_t> record(512, 'x');
+    const uint32_t count = 8000;
+    ups_db_t *db2;
+
+    close();
+    ups_parameter_t params[] = {
+        {UPS_PARAM_HOLE_PUNCH_SECONDS, 1},
+        {0, 0}
+    };
+    require_create(0, params);
+    REQUIRE(0 == ups_env_create_db(env, &db2, 2, 0, 0));
+
+    // the first database occupies a large contiguous range
+    DbProxy dbp(db);
+    DbProxy dbp2(db2);
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_insert(i, record);
+    for (uint32_t i = 0; i < 10; i++)
+      dbp2.require_insert(i, record);
+
+    REQUIRE(0 == ups_db_close(db, 0));
+    REQUIRE(0 == ups_env_erase_db(env, 1, 0));
+
+    uint64_t file_size = lenv()->device->file_size();
+    lenv()->page_manager->test_punch_holes(::time(0) + 10);
+
+    ups_env_metrics_t metrics = {0};
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+#ifdef __linux__
+    REQUIRE(metrics.page_count_punched
+              >= Freelist::kMinHoleSize / lenv()->config.page_size_bytes);
+#endif
+    // punching does not change the file size
+    REQUIRE(lenv()->device->file_size() == file_size);
+
+    // the punched pages are reused
+    REQUIRE(0 == ups_env_create_db(env, &db, 1, 0, 0));
+    dbp = DbProxy(db);
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_insert(i, record);
+    REQUIRE(lenv()->device->file_size() == file_size);
+
+    dbp.require_check_integrity();
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_find(i, record);
+
+    // reopen the file and verify the data
+    close();
+    require_open();
+    REQUIRE(0 == ups_env_open_db(env, &db2, 2, 0, 0));
+    dbp = DbProxy(db);
+    dbp2 = DbProxy(db2);
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_find(i, record);
+    for (uint32_t i = 0; i < 10; i++)
+      dbp2.require_find(i, record);
+  }
+
+  void compactTest(uint32_t env_flags) {
+    std::vector<uint8_t> record(8, 'x');
+    const uint32_t count = 20000;
+    ups_db_t *db2;
+
+    close();
+    require_create(env_flags);
+    REQUIRE(0 == ups_env_create_db(env, &db2, 2, 0, 0));
+
+    // the pages of both databases are interleaved
+    DbProxy dbp(db);
+    DbProxy dbp2(db2);
+    for (uint32_t i = 0; i < count; i++) {
+      dbp.require_insert(i, record);
+      dbp2.require_insert(i, record);
+    }
+
+    // free the pages of the first database; the second database is
+    // closed and has to be opened by ups_env_compact()
+    REQUIRE(0 == ups_db_close(db, 0));
+    REQUIRE(0 == ups_db_close(db2, 0));
+    REQUIRE(0 == ups_env_erase_db(env, 1, 0));
+
+    uint64_t file_size = lenv()->device->file_size();
+
+    // the work is split into several steps
+    uint32_t relocated = 0;
+    REQUIRE(0 == ups_env_compact(env, 5, &relocated));
+    REQUIRE(relocated == 5);
+
+    uint32_t total = relocated;
+    do {
+      REQUIRE(0 == ups_env_compact(env, 20, &relocated));
+      total += relocated;
+    } while (relocated > 0);
+
+    ups_env_metrics_t metrics = {0};
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.page_count_relocated == total);
+    REQUIRE(metrics.page_count_truncated > 0);
+#ifndef WIN32
+    REQUIRE(lenv()->device->file_size() < file_size / 2 + file_size / 4);
+#endif
+
+    REQUIRE(0 == ups_env_open_db(env, &db2, 2, 0, 0));
+    dbp2 = DbProxy(db2);
+    dbp2.require_check_integrity();
+    for (uint32_t i = 0; i < count; i++)
+      dbp2.require_find(i, record);
+
+    // reopen the file and verify the data; with Transactions, the
+    // journal is replayed
+    uint32_t close_flags = UPS_AUTO_CLEANUP;
+    uint32_t open_flags = env_flags;
+    if (env_flags & UPS_ENABLE_TRANSACTIONS) {
+      close_flags |= UPS_DONT_CLEAR_LOG;
+      open_flags |= UPS_AUTO_RECOVERY;
+    }
+    close(close_flags);
+    REQUIRE(0 == ups_env_open(&env, "test.db", open_flags, 0));
+    REQUIRE(0 == ups_env_open_db(env, &db2, 2, 0, 0));
+    dbp2 = DbProxy(db2);
+    dbp2.require_check_integrity();
+    for (uint32_t i = 0; i < count; i++)
+      dbp2.require_find(i, record);
+    close();
+
+    REQUIRE(0 == ups_env_open(&env, "test.db", UPS_READ_ONLY, 0));
+    REQUIRE(UPS_WRITE_PROTECTED == ups_env_compact(env, 0, 0));
+  }
+
+  // Returns the "is_clean" flag of the flash cache file
+  uint32_t flash_cache_is_clean(const char *filename) {
+    PFlashCacheHeader header;
+    FILE *f = ::fopen(filename, "rb");
+    REQUIRE(f != 0);
+    REQUIRE(1 == ::fread(&header, sizeof(header), 1, f));
+    ::fclose(f);
+    REQUIRE(header.magic == FlashCache::kMagic);
+    return header.is_clean;
+  }
+
+  void flashCacheTest() {
+    std::vector<uint8_t> record(8, 'x');
+    const uint32_t count = 50000;
+    ups_parameter_t params[] = {
+        {UPS_PARAM_FLASH_CACHE_FILENAME, (uint64_t)"test.db.flash"},
+        {UPS_PARAM_FLASH_CACHE_SIZE, 8 * 1024 * 1024},
+        {UPS_PARAM_CACHE_SIZE, 128 * 1024},
+        {0, 0}
+    };
+
+    close();
+    require_create(0, params);
+    DbProxy dbp(db);
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_insert(i, record);
+
+    // the index is not valid while the Environment is open
+    REQUIRE(flash_cache_is_clean("test.db.flash") == 0);
+    close();
+    REQUIRE(flash_cache_is_clean("test.db.flash") == 1);
+
+    // the leaves are admitted when they are evicted for the second time
+    require_open(0, params);
+    dbp = DbProxy(db);
+    for (int pass = 0; pass < 2; pass++) {
+      for (uint32_t i = 0; i < count; i++)
+        dbp.require_find(i, record);
+    }
+    REQUIRE(lenv()->page_manager->flash_cache->index.size() > 0);
+    close();
+
+    // the flash cache serves the misses after the Environment was reopened
+    require_open(0, params);
+    REQUIRE(lenv()->page_manager->flash_cache->index.size() > 0);
+    dbp = DbProxy(db);
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_find(i, record);
+    ups_env_metrics_t metrics = {0};
+    REQUIRE(0 == ups_env_get_metrics(env, &metrics));
+    REQUIRE(metrics.flash_cache_hits > 0);
+
+    // the modified pages are not stale
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_erase(i);
+    for (uint32_t i = 0; i < count; i += 2)
+      dbp.require_insert(i, record);
+    close();
+    require_open(0, params);
+    dbp = DbProxy(db);
+    dbp.require_check_integrity();
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_find(i, record, i % 2 ? UPS_KEY_NOT_FOUND : 0);
+
+    // the flash cache is discarded if the file was modified without it,
+    // even if the file size did not change
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_find(i, record, i % 2 ? UPS_KEY_NOT_FOUND : 0);
+    REQUIRE(lenv()->page_manager->flash_cache->index.size() > 0);
+    close();
+    require_open(0);
+    dbp = DbProxy(db);
+    std::vector<uint8_t> record2(8, 'y');
+    for (uint32_t i = 0; i < count; i += 2) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      dbp.require_overwrite(&key, record2);
+    }
+    close();
+    require_open(0, params);
+    REQUIRE(lenv()->page_manager->flash_cache->index.size() == 0);
+    dbp = DbProxy(db);
+    for (uint32_t i = 0; i < count; i += 2)
+      dbp.require_find(i, record2);
+
+    // the flash cache survives the reset of the PageManager when a
+    // transactional Environment is opened, but is discarded if the
+    // Journal is recovered
+    close();
+    require_create(UPS_ENABLE_TRANSACTIONS, params);
+    dbp = DbProxy(db);
+    for (uint32_t i = 0; i < count; i++)
+      dbp.require_insert(i, record);
+    for (int pass = 0; pass < 2; pass++) {
+      for (uint32_t i = 0; i < count; i++)
+        dbp.require_find(i, record);
+    }
+    close();
+    require_open(UPS_ENABLE_TRANSACTIONS, params);
+    REQUIRE(lenv()->page_manager->flash_cache->index.size() > 0);
+    dbp = DbProxy(db);
+    uint32_t zero = 0;
+    ups_key_t key = ups_make_key(&zero, sizeof(zero));
+    dbp.require_overwrite(&key, record2);
+    close(UPS_AUTO_CLEANUP | UPS_DONT_CLEAR_LOG);
+    require_open(UPS_ENABLE_TRANSACTIONS | UPS_AUTO_RECOVERY, params);
+    REQUIRE(lenv()->page_manager->flash_cache->index.size() == 0);
+    dbp = DbProxy(db);
+    dbp.require_find(0u, record2);
+    close();
+    File::remove("test.db.flash");
+  }
 };
 
 TEST_CASE("PageManager/fetchPage", "")
@@ -484,6 +862,12 @@ TEST_CASE("PageManager/issue60Test", "")
   f.issue60Test();
 }
 
+TEST_CASE("PageManager/readAheadTest", "")
+{
+  PageManagerFixture f(false);
+  f.readAheadTest();
+}
+
 TEST_CASE("PageManager/collapseFreelistTest", "")
 {
   PageManagerFixture f(false);
@@ -508,6 +892,42 @@ TEST_CASE("PageManager/allocMultiBlobs", "")
   f.allocMultiBlobs();
 }
 
+TEST_CASE("PageManager/bestFitFreelistTest", "")
+{
+  PageManagerFixture f(false);
+  f.bestFitFreelistTest();
+}
+
+TEST_CASE("PageManager/flashCacheTest", "")
+{
+  PageManagerFixture f(false);
+  f.flashCacheTest();
+}
+
+TEST_CASE("PageManager/holePunchFreelistTest", "")
+{
+  PageManagerFixture f(false);
+  f.holePunchFreelistTest();
+}
+
+TEST_CASE("PageManager/holePunchTest", "")
+{
+  PageManagerFixture f(false);
+  f.holePunchTest();
+}
+
+TEST_CASE("PageManager/compactTest", "")
+{
+  PageManagerFixture f(false);
+  f.compactTest(0);
+}
+
+TEST_CASE("PageManager/compactTxnTest", "")
+{
+  PageManagerFixture f(false);
+  f.compactTest(UPS_ENABLE_TRANSACTIONS);
+}
+
 TEST_CASE("PageManager-inmem/allocPage", "")
 {
   PageManagerFixture f(true);
@@ -73,9 +73,11 @@ usage() {
        "<use_compression> <inducer>\n");
   printf("usage: ./recovery erase <key_size> <i> <dupes> "
        "<use_compression> <inducer>\n");
+  printf("usage: ./recovery update <key_size> <rec_size> <i> "
+       "<use_compression> <inducer>\n");
   printf("usage: ./recovery recover <use_compression>\n");
   printf("usage: ./recovery verify <key_size> <rec_size> <i> <dupes> "
-       "<use_compression> <exist>\n");
+       "<use_compression> <exist> [<fill>]\n");
 }
 
 void
@@ -255,6 +257,84 @@ erase(int argc, char **argv) {
   }
 }
 
+void
+update(int argc, char **argv) {
+  if (argc != 7) {
+    usage();
+    exit(-1);
+  }
+
+  ups_status_t st = 0;
+  ups_db_t *db;
+  ups_env_t *env;
+
+  int key_size = (int)strtol(argv[2], 0, 0);
+  int rec_size = (int)strtol(argv[3], 0, 0);
+  int i     = (int)strtol(argv[4], 0, 0);
+  int use_compression = (int)strtol(argv[5], 0, 0);
+  int inducer = (int)strtol(argv[6], 0, 0);
+  printf("update: key_size=%d, rec_size=%d, i=%d, use_compression=%d, "
+         "inducer=%d\n", key_size, rec_size, i, use_compression, inducer);
+
+  ups_key_t key = {0};
+  key.data = malloc(key_size);
+  key.size = key_size;
+  memset(key.data, 0, key.size);
+
+  // the records are overwritten with a different fill byte; the modified
+  // pages are then logged as small deltas
+  ups_record_t rec = {0};
+  rec.data = malloc(rec_size);
+  rec.size = rec_size;
+  memset(rec.data, 'u', rec.size);
+
+  st = ups_env_open(&env, "recovery.db", UPS_ENABLE_TRANSACTIONS,
+            get_parameters(use_compression));
+  if (st) {
+    printf("ups_env_open failed: %d\n", (int)st);
+    exit(-1);
+  }
+  st = ups_env_open_db(env, &db, 1, 0, 0);
+  if (st) {
+    printf("ups_env_open_db failed: %d\n", (int)st);
+    exit(-1);
+  }
+
+  // create a new txn and overwrite the records
+  // flushing the txn will fail b/c of the error inducer
+  ups_txn_t *txn = 0;
+  st = ups_txn_begin(&txn, env, 0, 0, 0);
+  if (st) {
+    printf("ups_txn_begin failed: %d\n", (int)st);
+    exit(-1);
+  }
+
+  if (inducer) {
+    ErrorInducer::activate(true);
+    ErrorInducer::add(ErrorInducer::kChangesetFlush, inducer);
+  }
+
+  for (int j = 0; j < NUM_STEPS; j++) {
+    create_key(&key, i * NUM_STEPS + j);
+    st = ups_db_insert(db, txn, &key, &rec, UPS_OVERWRITE);
+    if (st) {
+      if (st == UPS_INTERNAL_ERROR)
+        break;
+      printf("ups_db_insert failed: %d (%s)\n", (int)st, ups_strerror(st));
+      exit(-1);
+    }
+  }
+
+  if (txn)
+    st = ups_txn_commit(txn, 0);
+  if (st == 0)
+    exit(0); // we must have skipped all induced errors
+  else if (st != UPS_INTERNAL_ERROR) {
+    printf("ups_txn_commit failed: %d\n", (int)st);
+    exit(-1);
+  }
+}
+
 void
 recover(int argc, char **argv) {
   if (argc != 3) {
@@ -296,7 +376,7 @@ recover(int argc, char **argv) {
 
 void
 verify(int argc, char **argv) {
-  if (argc != 8) {
+  if (argc != 8 && argc != 9) {
     usage();
     exit(-1);
   }
@@ -307,9 +387,10 @@ verify(int argc, char **argv) {
   int dupes   = (int)strtol(argv[5], 0, 0);
   int use_compression = (int)strtol(argv[6], 0, 0);
   int exist   = (int)strtol(argv[7], 0, 0);
+  int fill    = argc == 9 ? (int)strtol(argv[8], 0, 0) : 0;
   printf("verify: key_size=%d, rec_size=%d, i=%d, dupes=%d, "
-         "use_compression=%d, exist=%d\n", key_size, rec_size, maxi,
-         dupes, use_compression, exist);
+         "use_compression=%d, exist=%d, fill=%d\n", key_size, rec_size, maxi,
+         dupes, use_compression, exist, fill);
 
   ups_status_t st;
   ups_db_t *db;
@@ -323,7 +404,7 @@ verify(int argc, char **argv) {
   ups_record_t rec = {0};
   rec.data = malloc(rec_size);
   rec.size = rec_size;
-  memset(rec.data, 0, rec.size);
+  memset(rec.data, fill, rec.size);
 
   ups_record_t rec2 = {0};
 
@@ -395,6 +476,10 @@ main(int argc, char **argv) {
     erase(argc, argv);
     return 0;
   }
+  if (!strcmp("update", mode)) {
+    update(argc, argv);
+    return 0;
+  }
   if (!strcmp("recover", mode)) {
     recover(argc, argv);
     return 0;
@@ -158,6 +158,30 @@ sub extended_duplicate_test {
   }
 }
 
+sub update_test {
+  $cmprsn = shift;
+  for ($i = $inducer_start; $i < $inducer_stop; $i++) {
+    unlink("recovery.db");
+    unlink("recovery.db.jrn0");
+    unlink("recovery.db.jrn1");
+
+    print "===========================================================\n";
+    print "inserting $max keys...\n";
+    for ($k = 0; $k < $max; $k++) {
+      check(system("./recovery insert 64 8 $k 0 $cmprsn 0"));
+      check(system("./recovery recover $cmprsn"));
+    }
+
+    # 117 is the fill byte ('u') of the updated records
+    print "updating $max keys...\n";
+    for ($k = 0; $k < $max; $k++) {
+      system("./recovery update 64 8 $k $cmprsn $i");
+      check(system("./recovery recover $cmprsn"));
+      check(system("./recovery verify 64 8 $k 0 $cmprsn 1 117"));
+    }
+  }
+}
+
 print "----------------------------\nsimple_test\n";
 simple_test(0);
 
@@ -173,5 +197,8 @@ extended_duplicate_test(0);
 print "----------------------------\nbig_records_test\n";
 big_records_test(0);
 
+print "----------------------------\nupdate_test\n";
+update_test(0);
+
 print "\nsuccess!\n";
 exit(0);
@@ -130,7 +130,7 @@ struct RemoteFixture {
 
     REQUIRE((unsigned)UPS_DEFAULT_CACHE_SIZE == params[0].value);
     REQUIRE((uint64_t)(1024 * 16) == params[1].value);
-    REQUIRE((uint64_t)540 == params[2].value);
+    REQUIRE((uint64_t)352 == params[2].value);
     REQUIRE((uint64_t)UPS_ENABLE_TRANSACTIONS == params[3].value);
     REQUIRE(0644ull == params[4].value);
     REQUIRE(0 == ::strcmp("test.db", (char *)params[5].value));
@@ -19,6 +19,9 @@
 
 #include "3rdparty/catch/catch.hpp"
 
+#include <string>
+#include <vector>
+
 #include <ups/upscaledb.h>
 
 #include "4db/db_local.h"
@@ -109,9 +112,9 @@ struct TxnFixture : BaseFixture {
 
     // clean up
     ldb()->txn_index->remove(node1);
-    delete node1;
+    ldb()->txn_index->release_node(node1);
     ldb()->txn_index->remove(node2);
-    delete node2;
+    ldb()->txn_index->release_node(node2);
   }
 
   void txnMultipleNodesTest() {
@@ -128,11 +131,122 @@ struct TxnFixture : BaseFixture {
 
     // clean up
     ldb()->txn_index->remove(node1);
-    delete node1;
+    ldb()->txn_index->release_node(node1);
     ldb()->txn_index->remove(node2);
-    delete node2;
+    ldb()->txn_index->release_node(node2);
     ldb()->txn_index->remove(node3);
-    delete node3;
+    ldb()->txn_index->release_node(node3);
+  }
+
+  void indexTest(ups_db_t *hdb, bool long_keys) {
+    const int kKeys = 5000;
+    TxnIndex *index = ldb(hdb)->txn_index.get();
+    bool numeric = ldb(hdb)->config.key_type == UPS_TYPE_UINT64;
+
+    // the TxnNodes only store a pointer to the key, therefore the key
+    // data must stay valid
+    std::vector<uint64_t> numbers(kKeys);
+    std::vector<std::string> strings(kKeys);
+    std::vector<ups_key_t> keys(kKeys);
+    for (int i = 0; i < kKeys; i++) {
+      if (numeric) {
+        numbers[i] = i;
+        keys[i] = ups_make_key(&numbers[i], sizeof(uint64_t));
+      }
+      else {
+        char buffer[64];
+        ::snprintf(buffer, sizeof(buffer), long_keys
+                        ? "a-long-common-key-prefix-%08d"
+                        : "%08d", i);
+        strings[i] = buffer;
+        keys[i] = ups_make_key((void *)strings[i].c_str(),
+                        (uint16_t)(strings[i].size() + 1));
+      }
+    }
+
+    // insert the keys in pseudo-random order; the pages are split
+    std::vector<TxnNode *> nodes(kKeys);
+    bool node_created;
+    for (int j = 0; j < kKeys; j++) {
+      int i = (j * 7919) % kKeys;
+      nodes[i] = index->store(&keys[i], &node_created);
+      REQUIRE(node_created == true);
+    }
+    for (int i = 0; i < kKeys; i++) {
+      REQUIRE(nodes[i] == index->store(&keys[i], &node_created));
+      REQUIRE(node_created == false);
+      REQUIRE(nodes[i] == index->get(&keys[i], 0));
+    }
+
+    // walk forward and backward through the siblings
+    TxnNode *node = index->first();
+    for (int i = 0; i < kKeys; i++, node = node->next_sibling())
+      REQUIRE(node == nodes[i]);
+    REQUIRE(node == nullptr);
+    node = index->last();
+    for (int i = kKeys - 1; i >= 0; i--, node = node->previous_sibling())
+      REQUIRE(node == nodes[i]);
+    REQUIRE(node == nullptr);
+
+    // remove every odd key, then use approximate matching
+    for (int i = kKeys - 1; i >= 0; i--) {
+      if (i & 1) {
+        index->remove(nodes[i]);
+        index->release_node(nodes[i]);
+      }
+    }
+    for (int i = 1; i < kKeys - 1; i += 2) {
+      REQUIRE(nullptr == index->get(&keys[i], 0));
+      REQUIRE(nodes[i + 1] == index->get(&keys[i], UPS_FIND_GEQ_MATCH));
+      REQUIRE(nodes[i - 1] == index->get(&keys[i], UPS_FIND_LEQ_MATCH));
+      REQUIRE(nodes[i + 1] == index->get(&keys[i], UPS_FIND_GT_MATCH));
+      REQUIRE(nodes[i - 1] == index->get(&keys[i], UPS_FIND_LT_MATCH));
+      REQUIRE(nodes[i + 1] == index->get(&keys[i - 1], UPS_FIND_GT_MATCH));
+      if (i > 1)
+        REQUIRE(nodes[i - 3] == index->get(&keys[i - 1], UPS_FIND_LT_MATCH));
+    }
+    REQUIRE(nullptr == index->get(&keys[0], UPS_FIND_LT_MATCH));
+    REQUIRE(nullptr == index->get(&keys[kKeys - 2], UPS_FIND_GT_MATCH));
+
+    // remove the remaining keys
+    for (int i = 0; i < kKeys; i += 2) {
+      REQUIRE(index->first() == nodes[i]);
+      index->remove(nodes[i]);
+      index->release_node(nodes[i]);
+    }
+    REQUIRE(index->first() == nullptr);
+    REQUIRE(index->last() == nullptr);
+
+    // store the keys again and remove them in pseudo-random order; the
+    // tree shrinks till the root is a leaf again
+    for (int i = 0; i < kKeys; i++)
+      nodes[i] = index->store(&keys[i], &node_created);
+    for (int j = 0; j < kKeys; j++) {
+      int i = (j * 7919) % kKeys;
+      index->remove(nodes[i]);
+      index->release_node(nodes[i]);
+      REQUIRE(nullptr == index->get(&keys[i], 0));
+      if (j % 100 == 0)
+        REQUIRE(index->last() == index->get(&keys[kKeys - 1],
+                                UPS_FIND_LEQ_MATCH));
+    }
+    REQUIRE(index->first() == nullptr);
+    REQUIRE(index->last() == nullptr);
+  }
+
+  void indexBinaryTest() {
+    indexTest(db, false);
+    indexTest(db, true);
+  }
+
+  void indexNumericTest() {
+    ups_db_t *db2;
+    ups_parameter_t params[] = {
+        {UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT64},
+        {0, 0}
+    };
+    REQUIRE(0 == ups_env_create_db(env, &db2, 2, 0, params));
+    indexTest(db2, false);
   }
 
   void txnMultipleOpsTest() {
@@ -457,6 +571,18 @@ TEST_CASE("Txn/txnMultipleNodesTest", "")
   f.txnMultipleNodesTest();
 }
 
+TEST_CASE("Txn/indexBinaryTest", "")
+{
+  TxnFixture f;
+  f.indexBinaryTest();
+}
+
+TEST_CASE("Txn/indexNumericTest", "")
+{
+  TxnFixture f;
+  f.indexNumericTest();
+}
+
 TEST_CASE("Txn/txnMultipleOpsTest", "")
 {
   TxnFixture f;
@@ -864,6 +990,170 @@ struct HighLevelTxnFixture : BaseFixture {
 
     close();
   }
+
+  // Counts the keys which are visible to a cursor in |txn|
+  uint32_t countWithCursor(ups_txn_t *txn) {
+    ups_cursor_t *cursor;
+    ups_key_t key = {0};
+    ups_record_t rec = {0};
+    uint32_t count = 0;
+
+    REQUIRE(0 == ups_cursor_create(&cursor, db, txn, 0));
+    while (0 == ups_cursor_move(cursor, &key, &rec, UPS_CURSOR_NEXT))
+      count++;
+    REQUIRE(0 == ups_cursor_close(cursor));
+    return count;
+  }
+
+  void snapshotTest() {
+    ups_txn_t *snapshot, *writer, *txn;
+    uint64_t count;
+
+    require_create(UPS_ENABLE_TRANSACTIONS);
+    REQUIRE(0 == insert(0, "key1", "rec1", 0));
+    REQUIRE(0 == insert(0, "key2", "rec2", 0));
+
+    // |writer| started before the snapshot, but commits later
+    REQUIRE(0 == ups_txn_begin(&writer, env, 0, 0, 0));
+    REQUIRE(0 == insert(writer, "key1", "new1", UPS_OVERWRITE));
+
+    REQUIRE(0 == ups_txn_begin(&snapshot, env, 0, 0, UPS_TXN_SNAPSHOT));
+
+    // uncommitted modifications are invisible, and do not conflict
+    REQUIRE(0 == find(snapshot, "key1", "rec1"));
+    REQUIRE(UPS_TXN_CONFLICT == find(0, "key1", "rec1"));
+
+    // modifications which are committed after the snapshot began are
+    // invisible as well
+    REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+    REQUIRE(0 == insert(txn, "key3", "rec3", 0));
+    ups_key_t key2 = ups_make_key((void *)"key2", 5);
+    REQUIRE(0 == ups_db_erase(db, txn, &key2, 0));
+    REQUIRE(0 == ups_txn_commit(txn, 0));
+    REQUIRE(0 == ups_txn_commit(writer, 0));
+    REQUIRE(0 == ups_env_flush(env, 0));
+
+    REQUIRE(0 == find(snapshot, "key1", "rec1"));
+    REQUIRE(0 == find(snapshot, "key2", "rec2"));
+    REQUIRE(UPS_KEY_NOT_FOUND == find(snapshot, "key3", "rec3"));
+    REQUIRE(2u == countWithCursor(snapshot));
+    REQUIRE(0 == ups_db_count(db, snapshot, 0, &count));
+    REQUIRE(2ull == count);
+
+    // the other transactions see the new state
+    REQUIRE(0 == find(0, "key1", "new1"));
+    REQUIRE(UPS_KEY_NOT_FOUND == find(0, "key2", "rec2"));
+    REQUIRE(0 == find(0, "key3", "rec3"));
+    REQUIRE(2u == countWithCursor(0));
+
+    // snapshots are read-only
+    REQUIRE(UPS_WRITE_PROTECTED == insert(snapshot, "key4", "rec4", 0));
+
+    REQUIRE(0 == ups_txn_commit(snapshot, 0));
+    REQUIRE(0 == find(0, "key1", "new1"));
+    REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+    REQUIRE(2ull == count);
+
+    // after a reopen all transactions were flushed
+    close();
+    require_open(UPS_ENABLE_TRANSACTIONS);
+    REQUIRE(0 == find(0, "key1", "new1"));
+    REQUIRE(UPS_KEY_NOT_FOUND == find(0, "key2", "rec2"));
+    REQUIRE(0 == find(0, "key3", "rec3"));
+  }
+
+  void arenaAllocationTest() {
+    ups_txn_t *txn;
+    ups_env_metrics_t before = {0}, after = {0};
+    const int kOperations = 10000;
+
+    require_create(UPS_ENABLE_TRANSACTIONS);
+    REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+    REQUIRE(0 == ups_env_get_metrics(env, &before));
+    for (int i = 0; i < kOperations; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = ups_make_record(&i, sizeof(i));
+      REQUIRE(0 == ups_db_insert(db, txn, &key, &rec, 0));
+    }
+    REQUIRE(0 == ups_env_get_metrics(env, &after));
+
+    // TxnOperations and TxnNodes are allocated in large chunks
+    REQUIRE(after.mem_total_allocations - before.mem_total_allocations
+                < (uint64_t)kOperations / 10);
+
+    // erase the keys in the same transaction, then commit
+    for (int i = 0; i < kOperations; i += 2) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      REQUIRE(0 == ups_db_erase(db, txn, &key, 0));
+    }
+    REQUIRE(0 == ups_txn_commit(txn, 0));
+    REQUIRE(0 == ups_env_flush(env, 0));
+
+    for (int i = 0; i < kOperations; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = {0};
+      REQUIRE((i & 1 ? 0 : UPS_KEY_NOT_FOUND)
+                    == ups_db_find(db, 0, &key, &rec, 0));
+    }
+  }
+
+  int countQueuedTxns() {
+    ScopedLock lock(lenv()->mutex);
+    int count = 0;
+    for (Txn *t = lenv()->txn_manager->oldest_txn(); t; t = t->next())
+      count++;
+    return count;
+  }
+
+  void backgroundMergeTest() {
+    const int kTxns = 1000;
+
+    require_create(UPS_ENABLE_TRANSACTIONS
+                    | UPS_FLUSH_TRANSACTIONS_IN_BACKGROUND);
+    LocalTxnManager *tm = (LocalTxnManager *)lenv()->txn_manager.get();
+    REQUIRE(tm->merger.get() != 0);
+
+    for (int i = 0; i < kTxns; i++) {
+      ups_txn_t *txn;
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = ups_make_record(&i, sizeof(i));
+      REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+      REQUIRE(0 == ups_db_insert(db, txn, &key, &rec, 0));
+      REQUIRE(0 == ups_txn_commit(txn, 0));
+
+      // if the background thread falls behind then the committing
+      // thread has to flush
+      REQUIRE(countQueuedTxns() < Globals::ms_flush_threshold
+                    * LocalTxnManager::kMaxBacklogFactor);
+    }
+
+    // wait till the background thread is idle
+    while (true) {
+      ScopedLock lock(lenv()->mutex);
+      if (!tm->merge_pending)
+        break;
+      lock.unlock();
+      boost::this_thread::yield();
+    }
+    REQUIRE(countQueuedTxns() < Globals::ms_flush_threshold);
+
+    for (int i = 0; i < kTxns; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = {0};
+      REQUIRE(0 == ups_db_find(db, 0, &key, &rec, 0));
+      REQUIRE(i == *(int *)rec.data);
+    }
+
+    // the remaining Txns are flushed when the Environment is closed
+    close();
+    require_open();
+    for (int i = 0; i < kTxns; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = {0};
+      REQUIRE(0 == ups_db_find(db, 0, &key, &rec, 0));
+      REQUIRE(i == *(int *)rec.data);
+    }
+  }
 };
 
 TEST_CASE("Txn/high/noPersistentDatabaseFlagTest", "")
@@ -957,6 +1247,24 @@ TEST_CASE("Txn/high/insertTxnsWithDelay", "")
     f.insertTxnsWithDelay(i);
 }
 
+TEST_CASE("Txn/high/snapshotTest", "")
+{
+  HighLevelTxnFixture f;
+  f.snapshotTest();
+}
+
+TEST_CASE("Txn/high/arenaAllocationTest", "")
+{
+  HighLevelTxnFixture f;
+  f.arenaAllocationTest();
+}
+
+TEST_CASE("Txn/high/backgroundMergeTest", "")
+{
+  HighLevelTxnFixture f;
+  f.backgroundMergeTest();
+}
+
 struct InMemoryTxnFixture : BaseFixture {
   InMemoryTxnFixture() {
     require_create(UPS_IN_MEMORY | UPS_ENABLE_TRANSACTIONS, 0,
@@ -1340,6 +1340,81 @@ struct UpscaledbFixture : BaseFixture {
     REQUIRE(count == 4000 + 10);
   }
 
+  void persistentCountTest() {
+    ups_parameter_t ps[] = { { UPS_PARAM_PAGESIZE, 1024 * 4 }, { 0, 0 } };
+    uint64_t count = 0;
+
+    close();
+    require_create(0, ps, UPS_ENABLE_DUPLICATE_KEYS, nullptr);
+
+    for (unsigned i = 1; i <= 4000; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = ups_make_record(&i, sizeof(i));
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &rec, 0));
+    }
+
+    // add duplicates to key 5 and key 6
+    for (unsigned i = 1; i <= 10; i++) {
+      unsigned k = 5 + (i % 2);
+      ups_key_t key = ups_make_key(&k, sizeof(k));
+      ups_record_t rec = ups_make_record(&i, sizeof(i));
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &rec, UPS_DUPLICATE));
+    }
+
+    // overwriting does not change the counters
+    unsigned k = 7;
+    ups_key_t key = ups_make_key(&k, sizeof(k));
+    ups_record_t rec = ups_make_record(&k, sizeof(k));
+    REQUIRE(0 == ups_db_insert(db, 0, &key, &rec, UPS_OVERWRITE));
+
+    // erase a key with all duplicates
+    k = 5;
+    REQUIRE(0 == ups_db_erase(db, 0, &key, 0));
+    // erase a single key
+    k = 8;
+    REQUIRE(0 == ups_db_erase(db, 0, &key, 0));
+    // erase a single duplicate
+    ups_cursor_t *cursor;
+    k = 6;
+    REQUIRE(0 == ups_cursor_create(&cursor, db, 0, 0));
+    REQUIRE(0 == ups_cursor_find(cursor, &key, 0, 0));
+    REQUIRE(0 == ups_cursor_erase(cursor, 0));
+    REQUIRE(0 == ups_cursor_close(cursor));
+
+    REQUIRE(0 == ups_db_count(db, 0, UPS_SKIP_DUPLICATES, &count));
+    REQUIRE(count == 4000 - 2);
+    REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+    REQUIRE(count == 4000 + 10 - 6 - 1 - 1);
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+
+    // the counters are persistent
+    close();
+    require_open();
+    REQUIRE(0 == ups_db_count(db, 0, UPS_SKIP_DUPLICATES, &count));
+    REQUIRE(count == 4000 - 2);
+    REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+    REQUIRE(count == 4000 + 10 - 6 - 1 - 1);
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+
+    // after a crash the counters are recalculated: the pages are written,
+    // but not the counters
+    for (unsigned i = 4001; i <= 5000; i++) {
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = ups_make_record(&i, sizeof(i));
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &rec, 0));
+    }
+    lenv()->page_manager->flush_all_pages();
+    REQUIRE(true == os::copy("test.db", "test.db.bak"));
+    close();
+    REQUIRE(true == os::copy("test.db.bak", "test.db"));
+    require_open();
+    REQUIRE(0 == ups_db_count(db, 0, UPS_SKIP_DUPLICATES, &count));
+    REQUIRE(count == 5000 - 2);
+    REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+    REQUIRE(count == 5000 + 10 - 6 - 1 - 1);
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+  }
+
   void unlimitedCacheTest() {
     ups_key_t key = {0};
     ups_record_t rec = ups_make_record((void *)"hello", 6);
@@ -2097,6 +2172,265 @@ struct UpscaledbFixture : BaseFixture {
     REQUIRE(UPS_INV_PARAMETER == ups_db_bulk_operations(db, 0,
                             ops.data(), 2, 0));
   }
+
+  void writeBatch(uint32_t env_flags) {
+    const int kKeys = 2000;
+    std::vector<uint32_t> numbers(kKeys);
+    std::vector<ups_operation_t> ops;
+    uint64_t count;
+
+    close();
+    require_create(env_flags);
+
+    // insert the keys in descending order, erase every third key
+    for (int i = kKeys - 1; i >= 0; i--) {
+      numbers[i] = i;
+      ups_key_t key = ups_make_key(&numbers[i], sizeof(uint32_t));
+      ups_record_t rec = ups_make_record(&numbers[i], sizeof(uint32_t));
+      ops.push_back({UPS_OP_INSERT, key, rec, 0});
+      if (i % 3 == 0)
+        ops.push_back({UPS_OP_ERASE, key, rec, 0});
+    }
+    REQUIRE(0 == ups_db_bulk_operations(db, 0, ops.data(), ops.size(),
+                            UPS_WRITE_BATCH));
+    for (size_t i = 0; i < ops.size(); i++)
+      REQUIRE(0 == ops[i].result);
+
+    DbProxy dbp(db);
+    std::vector<uint8_t> empty;
+    for (int i = 0; i < kKeys; i++) {
+      std::vector<uint8_t> record((uint8_t *)&numbers[i],
+                            (uint8_t *)&numbers[i] + sizeof(uint32_t));
+      if (i % 3 == 0)
+        dbp.require_find((uint32_t)i, empty, UPS_KEY_NOT_FOUND);
+      else
+        dbp.require_find((uint32_t)i, record);
+    }
+    REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+    REQUIRE(count == (uint64_t)(kKeys - (kKeys + 2) / 3));
+
+    // a failing operation: none of the operations is applied
+    uint32_t n0 = 0, n1 = 1, n4 = 4, n9999 = 9999;
+    ops.clear();
+    ops.push_back({UPS_OP_INSERT, ups_make_key(&n0, sizeof(n0)),
+                            ups_make_record(&n0, sizeof(n0)), 0});
+    ops.push_back({UPS_OP_ERASE, ups_make_key(&n9999, sizeof(n9999)),
+                            ups_make_record(0, 0), 0});
+    REQUIRE(UPS_KEY_NOT_FOUND == ups_db_bulk_operations(db, 0, ops.data(),
+                            ops.size(), UPS_WRITE_BATCH));
+    REQUIRE(UPS_KEY_NOT_FOUND == ops[1].result);
+    dbp.require_find(0u, empty, UPS_KEY_NOT_FOUND);
+
+    ops.clear();
+    ops.push_back({UPS_OP_ERASE, ups_make_key(&n4, sizeof(n4)),
+                            ups_make_record(0, 0), 0});
+    ops.push_back({UPS_OP_INSERT, ups_make_key(&n1, sizeof(n1)),
+                            ups_make_record(&n1, sizeof(n1)), 0});
+    REQUIRE(UPS_DUPLICATE_KEY == ups_db_bulk_operations(db, 0, ops.data(),
+                            ops.size(), UPS_WRITE_BATCH));
+    REQUIRE(UPS_DUPLICATE_KEY == ops[1].result);
+    REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+    REQUIRE(count == (uint64_t)(kKeys - (kKeys + 2) / 3));
+
+    // with UPS_OVERWRITE, the same batch succeeds
+    ops[1].flags = UPS_OVERWRITE;
+    ops.push_back({UPS_OP_INSERT, ups_make_key(&n4, sizeof(n4)),
+                            ups_make_record(&n0, sizeof(n0)), 0});
+    REQUIRE(0 == ups_db_bulk_operations(db, 0, ops.data(), ops.size(),
+                            UPS_WRITE_BATCH));
+    std::vector<uint8_t> record((uint8_t *)&n0,
+                            (uint8_t *)&n0 + sizeof(uint32_t));
+    dbp.require_find(4u, record);
+
+    // an active Transaction: the batch is applied through a Transaction
+    if (ISSET(env_flags, UPS_ENABLE_TRANSACTIONS)) {
+      ups_txn_t *txn;
+      ups_key_t key = ups_make_key(&n9999, sizeof(n9999));
+      ups_record_t rec = ups_make_record(&n9999, sizeof(n9999));
+      REQUIRE(0 == ups_txn_begin(&txn, env, 0, 0, 0));
+      REQUIRE(0 == ups_db_insert(db, txn, &key, &rec, 0));
+
+      ops.clear();
+      ops.push_back({UPS_OP_INSERT, ups_make_key(&n0, sizeof(n0)),
+                            ups_make_record(&n0, sizeof(n0)), 0});
+      ops.push_back({UPS_OP_INSERT, key, rec, 0});
+      REQUIRE(UPS_TXN_CONFLICT == ups_db_bulk_operations(db, 0, ops.data(),
+                            ops.size(), UPS_WRITE_BATCH));
+      REQUIRE(0 == ups_txn_commit(txn, 0));
+      dbp.require_find(0u, empty, UPS_KEY_NOT_FOUND);
+    }
+
+    // a failure while the batch is applied: the keys which were already
+    // modified are restored
+    std::vector<uint32_t> more(100);
+    uint64_t expected_count;
+    REQUIRE(0 == ups_db_count(db, 0, 0, &expected_count));
+    ops.clear();
+    ops.push_back({UPS_OP_ERASE, ups_make_key(&n1, sizeof(n1)),
+                            ups_make_record(0, 0), 0});
+    ops.push_back({UPS_OP_INSERT, ups_make_key(&numbers[2], sizeof(n1)),
+                            ups_make_record(&n0, sizeof(n0)), UPS_OVERWRITE});
+    for (size_t i = 0; i < more.size(); i++) {
+      more[i] = 5000 + (uint32_t)i;
+      ops.push_back({UPS_OP_INSERT, ups_make_key(&more[i], sizeof(uint32_t)),
+                            ups_make_record(&more[i], sizeof(uint32_t)), 0});
+    }
+    ErrorInducer::activate(true);
+    ErrorInducer::add(ErrorInducer::kWriteBatch, 50, UPS_IO_ERROR);
+    REQUIRE(UPS_IO_ERROR == ups_db_bulk_operations(db, 0, ops.data(),
+                            ops.size(), UPS_WRITE_BATCH));
+    ErrorInducer::activate(false);
+    REQUIRE(UPS_IO_ERROR == ops[49].result);
+    record.assign((uint8_t *)&numbers[1], (uint8_t *)&numbers[1] + 4);
+    dbp.require_find(1u, record);
+    record.assign((uint8_t *)&numbers[2], (uint8_t *)&numbers[2] + 4);
+    dbp.require_find(2u, record);
+    for (size_t i = 0; i < more.size(); i++)
+      dbp.require_find(more[i], empty, UPS_KEY_NOT_FOUND);
+    REQUIRE(0 == ups_db_count(db, 0, 0, &count));
+    REQUIRE(count == expected_count);
+    REQUIRE(0 == ups_db_check_integrity(db, 0));
+
+    // invalid parameters
+    ops.clear();
+    ops.push_back({UPS_OP_FIND, ups_make_key(&n1, sizeof(n1)),
+                            ups_make_record(0, 0), 0});
+    REQUIRE(UPS_INV_PARAMETER == ups_db_bulk_operations(db, 0, ops.data(),
+                            ops.size(), UPS_WRITE_BATCH));
+    REQUIRE(UPS_INV_PARAMETER == ups_db_bulk_operations(db, 0, ops.data(),
+                            ops.size(), 0x1234));
+  }
+
+  void writeBatchTest() {
+    writeBatch(UPS_IN_MEMORY);
+    writeBatch(0);
+    writeBatch(UPS_ENABLE_TRANSACTIONS);
+  }
+
+  // Reads all keys with ups_cursor_move_batch() in batches of |batch_size|
+  // and compares them against the inserted keys
+  void verifyMoveBatch(uint32_t batch_size, bool with_records,
+                  uint32_t flags, uint32_t max_key) {
+    ups_cursor_t *cursor;
+    std::vector<ups_key_t> keys(batch_size);
+    std::vector<ups_record_t> records(batch_size);
+    bool forward = ISSET(flags, UPS_CURSOR_NEXT);
+    uint32_t expected = forward ? 1 : max_key;
+    uint32_t total = 0;
+
+    REQUIRE(0 == ups_cursor_create(&cursor, db, 0, 0));
+    while (true) {
+      uint32_t count = batch_size;
+      ups_status_t st = ups_cursor_move_batch(cursor, keys.data(),
+                            with_records ? records.data() : 0, &count, flags);
+      if (st == UPS_KEY_NOT_FOUND)
+        break;
+      REQUIRE(st == 0);
+      REQUIRE(count > 0);
+      REQUIRE(count <= batch_size);
+      REQUIRE(total + count <= max_key);
+      for (uint32_t i = 0; i < count; i++) {
+        REQUIRE(keys[i].size == sizeof(uint32_t));
+        REQUIRE(*(uint32_t *)keys[i].data == expected);
+        if (with_records) {
+          REQUIRE(records[i].size == sizeof(uint32_t));
+          REQUIRE(*(uint32_t *)records[i].data == expected * 3);
+        }
+        expected = forward ? expected + 1 : expected - 1;
+      }
+      total += count;
+      // a short batch signals the end of the database
+      if (count < batch_size)
+        break;
+    }
+    REQUIRE(total == max_key);
+    REQUIRE(0 == ups_cursor_close(cursor));
+  }
+
+  void moveBatch(uint32_t env_flags, uint32_t db_flags,
+                  ups_parameter_t *db_params) {
+    ups_parameter_t ps[] = { { UPS_PARAM_PAGESIZE, 1024 * 16 }, { 0, 0 } };
+    const uint32_t max_key = 10000;
+
+    close();
+    require_create(env_flags, ps, db_flags, db_params);
+
+    for (uint32_t i = 1; i <= max_key; i++) {
+      uint32_t r = i * 3;
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t rec = ups_make_record(&r, sizeof(r));
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &rec, 0));
+    }
+
+    // batches smaller and larger than a leaf node
+    verifyMoveBatch(7, true, UPS_CURSOR_NEXT, max_key);
+    verifyMoveBatch(7, false, UPS_CURSOR_NEXT, max_key);
+    verifyMoveBatch(1000, true, UPS_CURSOR_NEXT, max_key);
+    verifyMoveBatch(1000, false, UPS_CURSOR_NEXT, max_key);
+    verifyMoveBatch(13, true, UPS_CURSOR_PREVIOUS, max_key);
+  }
+
+  void moveBatchTest() {
+    ups_parameter_t pod[] = {
+        { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32 },
+        { UPS_PARAM_RECORD_SIZE, sizeof(uint32_t) },
+        { 0, 0 }
+    };
+    ups_parameter_t zint32[] = {
+        { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32 },
+        { UPS_PARAM_KEY_COMPRESSION, UPS_COMPRESSOR_UINT32_VARBYTE },
+        { 0, 0 }
+    };
+    ups_parameter_t custom[] = {
+        { UPS_PARAM_KEY_TYPE, UPS_TYPE_UINT32 },
+        { 0, 0 }
+    };
+
+    moveBatch(0, 0, pod);
+    moveBatch(0, 0, zint32);
+    moveBatch(0, 0, custom);
+    moveBatch(0, UPS_ENABLE_DUPLICATE_KEYS, custom);
+    moveBatch(UPS_ENABLE_TRANSACTIONS, 0, pod);
+  }
+
+  void moveBatchUserAllocTest() {
+    uint32_t i = 7, r = 21;
+    ups_key_t key = ups_make_key(&i, sizeof(i));
+    ups_record_t rec = ups_make_record(&r, sizeof(r));
+    REQUIRE(0 == ups_db_insert(db, 0, &key, &rec, 0));
+
+    uint32_t kbuf = 0, rbuf = 0;
+    ups_key_t k = ups_make_key(&kbuf, sizeof(kbuf));
+    k.flags = UPS_KEY_USER_ALLOC;
+    ups_record_t rc = ups_make_record(&rbuf, sizeof(rbuf));
+    rc.flags = UPS_RECORD_USER_ALLOC;
+    uint32_t count = 1;
+
+    ups_cursor_t *cursor;
+    REQUIRE(0 == ups_cursor_create(&cursor, db, 0, 0));
+    REQUIRE(0 == ups_cursor_move_batch(cursor, &k, &rc, &count,
+                            UPS_CURSOR_NEXT));
+    REQUIRE(count == 1);
+    REQUIRE(kbuf == 7);
+    REQUIRE(rbuf == 21);
+
+    // negative tests
+    REQUIRE(UPS_INV_PARAMETER == ups_cursor_move_batch(0, &k, 0, &count,
+                            UPS_CURSOR_NEXT));
+    REQUIRE(UPS_INV_PARAMETER == ups_cursor_move_batch(cursor, 0, 0, &count,
+                            UPS_CURSOR_NEXT));
+    REQUIRE(UPS_INV_PARAMETER == ups_cursor_move_batch(cursor, &k, 0, 0,
+                            UPS_CURSOR_NEXT));
+    count = 0;
+    REQUIRE(UPS_INV_PARAMETER == ups_cursor_move_batch(cursor, &k, 0, &count,
+                            UPS_CURSOR_NEXT));
+    count = 1;
+    REQUIRE(UPS_INV_PARAMETER == ups_cursor_move_batch(cursor, &k, 0, &count,
+                            UPS_CURSOR_NEXT | UPS_CURSOR_PREVIOUS));
+    REQUIRE(UPS_INV_PARAMETER == ups_cursor_move_batch(cursor, &k, 0, &count,
+                            UPS_CURSOR_FIRST));
+    REQUIRE(0 == ups_cursor_close(cursor));
+  }
 };
 
 TEST_CASE("Upscaledb/versionTest", "")
@@ -2357,6 +2691,12 @@ TEST_CASE("Upscaledb/recordCountTest", "")
   f.recordCountTest();
 }
 
+TEST_CASE("Upscaledb/persistentCountTest", "")
+{
+  UpscaledbFixture f;
+  f.persistentCountTest();
+}
+
 TEST_CASE("Upscaledb/unlimitedCacheTest", "")
 {
   UpscaledbFixture f;
@@ -2575,4 +2915,22 @@ TEST_CASE("Upscaledb/bulkNegativeTests", "")
   f.bulkNegativeTests();
 }
 
+TEST_CASE("Upscaledb/writeBatchTest", "")
+{
+  UpscaledbFixture f;
+  f.writeBatchTest();
+}
+
+TEST_CASE("Upscaledb/moveBatchTest", "")
+{
+  UpscaledbFixture f;
+  f.moveBatchTest();
+}
+
+TEST_CASE("Upscaledb/moveBatchUserAllocTest", "")
+{
+  UpscaledbFixture f;
+  f.moveBatchUserAllocTest();
+}
+
 } // namespace upscaledb
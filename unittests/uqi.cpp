@@ -976,6 +976,23 @@ TEST_CASE("Uqi/parserTest", "")
   REQUIRE(upscaledb::Parser::parse_select("SUM($key, $record) FROM database 1",
                 stmt) == 0);
   REQUIRE(stmt.function.flags == (UQI_STREAM_KEY | UQI_STREAM_RECORD));
+  REQUIRE(stmt.additional_functions.empty());
+
+  REQUIRE(upscaledb::Parser::parse_select("COUNT($key), SUM($record), "
+                "MAX($key, $record) FROM database 1", stmt) == 0);
+  REQUIRE(stmt.function.name == "count");
+  REQUIRE(stmt.function.flags == UQI_STREAM_KEY);
+  REQUIRE(stmt.additional_functions.size() == 2);
+  REQUIRE(stmt.additional_functions[0].name == "sum");
+  REQUIRE(stmt.additional_functions[0].flags == UQI_STREAM_RECORD);
+  REQUIRE(stmt.additional_functions[1].name == "max");
+  REQUIRE(stmt.additional_functions[1].flags
+                == (UQI_STREAM_KEY | UQI_STREAM_RECORD));
+
+  REQUIRE(upscaledb::Parser::parse_select("COUNT($key), FROM database 1",
+                stmt) == UPS_PARSER_ERROR);
+  REQUIRE(upscaledb::Parser::parse_select("TOP($key), COUNT($key) "
+                "FROM database 1 LIMIT 10", stmt) == UPS_PARSER_ERROR);
 }
 
 TEST_CASE("Uqi/closedDatabaseTest", "")
@@ -1399,6 +1416,70 @@ struct QueryFixture : BaseFixture {
                             "from database 1", &rp.result));
   }
 
+  void multipleFunctionsTest() {
+    uint64_t count = 0;
+    uint64_t sum = 0;
+    uint32_t min = std::numeric_limits<uint32_t>::max();
+    uint32_t max = 0;
+    uint64_t filtered_count = 0;
+    uint64_t filtered_sum = 0;
+
+    for (uint32_t i = 1; i <= 5000; i++) {
+      uint32_t v = (uint32_t)::rand() % 10000;
+      ups_key_t key = ups_make_key(&i, sizeof(i));
+      ups_record_t record = ups_make_record(&v, sizeof(v));
+      REQUIRE(0 == ups_db_insert(db, 0, &key, &record, 0));
+      count++;
+      sum += v;
+      min = std::min(min, v);
+      max = std::max(max, v);
+      if (i < 2500) {
+        filtered_count++;
+        filtered_sum += v;
+      }
+    }
+
+    ResultProxy rp;
+    REQUIRE(0 == uqi_select(env, "COUNT($record), SUM($record), "
+                            "MIN($record), MAX($record) from database 1",
+                            &rp.result));
+    REQUIRE(uqi_result_get_column_count(rp.result) == 4);
+    REQUIRE(uqi_result_get_column(rp.result, 0) == rp.result);
+    REQUIRE(uqi_result_get_column(rp.result, 4) == nullptr);
+
+    ResultProxy column;
+    column.result = uqi_result_get_column(rp.result, 0);
+    column.require("COUNT", UPS_TYPE_UINT64, count);
+    column.result = uqi_result_get_column(rp.result, 1);
+    column.require("SUM", UPS_TYPE_UINT64, sum);
+    column.result = uqi_result_get_column(rp.result, 2);
+    column.require_record(0, &min, sizeof(min));
+    column.result = uqi_result_get_column(rp.result, 3);
+    column.require_record(0, &max, sizeof(max));
+    column.result = nullptr;
+    rp.close();
+
+    uqi_plugin_t plugin = {0};
+    plugin.name = "multi_pred";
+    plugin.type = UQI_PLUGIN_PREDICATE;
+    plugin.pred = key_predicate;
+    REQUIRE(0 == uqi_register_plugin(&plugin));
+
+    REQUIRE(0 == uqi_select(env, "count($key), sum($record) from database 1 "
+                            "where multi_pred($key)", &rp.result));
+    REQUIRE(uqi_result_get_column_count(rp.result) == 2);
+    column.result = uqi_result_get_column(rp.result, 0);
+    column.require("COUNT", UPS_TYPE_UINT64, filtered_count);
+    column.result = uqi_result_get_column(rp.result, 1);
+    column.require("SUM", UPS_TYPE_UINT64, filtered_sum);
+    column.result = nullptr;
+    rp.close();
+
+    // a single unknown function fails the whole query
+    REQUIRE(UPS_PARSER_ERROR == uqi_select(env, "count($key), foo($key) "
+                            "from database 1", &rp.result));
+  }
+
   void minMaxBinaryTest() {
     int count = 200;
     double min_record = std::numeric_limits<double>::max();
@@ -1808,6 +1889,12 @@ TEST_CASE("Uqi/minMaxTest", "")
   f.minMaxTest();
 }
 
+TEST_CASE("Uqi/multipleFunctionsTest", "")
+{
+  QueryFixture f(0, UPS_TYPE_UINT32, UPS_TYPE_UINT32);
+  f.multipleFunctionsTest();
+}
+
 TEST_CASE("Uqi/minMaxBinaryTest", "")
 {
   QueryFixture f(0, UPS_TYPE_BINARY, UPS_TYPE_REAL64);
@@ -151,6 +151,63 @@ struct Zint32Fixture : BaseFixture {
     REQUIRE(*(double *)uqi_result_get_record_data(result, &size) == 14999.5);
 
     uqi_result_close(result);
+
+    // COUNT, MIN and MAX are answered from the block metadata
+    REQUIRE(0 == uqi_select(env, "COUNT($key) from database 1", &result));
+    REQUIRE(*(uint64_t *)uqi_result_get_record_data(result, &size) == 30000ull);
+    uqi_result_close(result);
+
+    REQUIRE(0 == uqi_select(env, "MIN($key) from database 1", &result));
+    uqi_result_get_key(result, 0, &key);
+    REQUIRE(*(uint32_t *)key.data == 0u);
+    uqi_result_close(result);
+
+    REQUIRE(0 == uqi_select(env, "MAX($key) from database 1", &result));
+    uqi_result_get_key(result, 0, &key);
+    REQUIRE(*(uint32_t *)key.data == 29999u);
+    uqi_result_close(result);
+
+    // several functions: the block is only decompressed if one of them
+    // requires the keys, and then not visited twice by the others
+    REQUIRE(0 == uqi_select(env, "COUNT($key), MAX($key) from database 1",
+                            &result));
+    REQUIRE(*(uint64_t *)uqi_result_get_record_data(
+                            uqi_result_get_column(result, 0), &size)
+                    == 30000ull);
+    uqi_result_get_key(uqi_result_get_column(result, 1), 0, &key);
+    REQUIRE(*(uint32_t *)key.data == 29999u);
+    uqi_result_close(result);
+
+    REQUIRE(0 == uqi_select(env, "COUNT($key), SUM($key), MIN($key) "
+                            "from database 1", &result));
+    REQUIRE(*(uint64_t *)uqi_result_get_record_data(
+                            uqi_result_get_column(result, 0), &size)
+                    == 30000ull);
+    REQUIRE(*(uint64_t *)uqi_result_get_record_data(
+                            uqi_result_get_column(result, 1), &size)
+                    == 449985000ull);
+    uqi_result_get_key(uqi_result_get_column(result, 2), 0, &key);
+    REQUIRE(*(uint32_t *)key.data == 0u);
+    uqi_result_close(result);
+
+    // start the scan in the middle of a block
+    ups_cursor_t *cursor;
+    uint32_t start = 12345;
+    key = ups_make_key(&start, sizeof(start));
+    REQUIRE(0 == ups_cursor_create(&cursor, db, 0, 0));
+    REQUIRE(0 == ups_cursor_find(cursor, &key, 0, 0));
+    REQUIRE(0 == uqi_select_range(env, "COUNT($key), SUM($key), MIN($key) "
+                            "from database 1", cursor, 0, &result));
+    REQUIRE(*(uint64_t *)uqi_result_get_record_data(
+                            uqi_result_get_column(result, 0), &size)
+                    == 17655ull);
+    REQUIRE(*(uint64_t *)uqi_result_get_record_data(
+                            uqi_result_get_column(result, 1), &size)
+                    == 373791660ull);
+    uqi_result_get_key(uqi_result_get_column(result, 2), 0, &key);
+    REQUIRE(*(uint32_t *)key.data == start);
+    uqi_result_close(result);
+    REQUIRE(0 == ups_cursor_close(cursor));
   }
 
   void uqiTestDuplicate() {